@@ -23,6 +23,7 @@
 #include <utils/Condition.h>
 #include <utils/Mutex.h>
 
+#include <atomic>
 #include <vector>
 
 namespace filament {
@@ -50,6 +51,10 @@ class CommandBufferQueue {
     size_t mHighWatermark = 0;
     bool mExitRequested = false;
 
+    // total time spent blocked in flush() and waitForCommands(), in nanoseconds
+    std::atomic<uint64_t> mFlushWaitTime = { 0 };
+    mutable std::atomic<uint64_t> mCommandsWaitTime = { 0 };
+
 public:
     // requiredSize: guaranteed available space after flush()
     CommandBufferQueue(size_t requiredSize, size_t bufferSize);
@@ -73,6 +78,16 @@ public:
 
     // returns from waitForCommands() immediately.
     void requestExit();
+
+    // total time flush() blocked waiting for space, in nanoseconds
+    uint64_t getFlushWaitTime() const noexcept {
+        return mFlushWaitTime.load(std::memory_order_relaxed);
+    }
+
+    // total time waitForCommands() blocked waiting for commands, in nanoseconds
+    uint64_t getCommandsWaitTime() const noexcept {
+        return mCommandsWaitTime.load(std::memory_order_relaxed);
+    }
 };
 
 } // namespace backend
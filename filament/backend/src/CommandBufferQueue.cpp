@@ -23,8 +23,14 @@
 
 #include "private/backend/CommandStream.h"
 
+#include <chrono>
+
 using namespace utils;
 
+static uint64_t nanoseconds(std::chrono::steady_clock::duration d) noexcept {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+}
+
 namespace filament {
 namespace backend {
 
@@ -96,9 +102,12 @@ void CommandBufferQueue::flush() noexcept {
         // unfortunately, there is not enough space left, we'll have to wait.
         mCondition.notify_one(); // too bad there isn't a notify-and-wait
         SYSTRACE_NAME("waiting: CircularBuffer::flush()");
+        const auto start = std::chrono::steady_clock::now();
         mCondition.wait(lock, [this, requiredSize]() -> bool {
             return mFreeSpace >= requiredSize;
         });
+        mFlushWaitTime.fetch_add(nanoseconds(std::chrono::steady_clock::now() - start),
+                std::memory_order_relaxed);
     }
 }
 
@@ -107,8 +116,13 @@ std::vector<CommandBufferQueue::Slice> CommandBufferQueue::waitForCommands() con
         return std::move(mCommandBuffersToExecute);
     }
     std::unique_lock<utils::Mutex> lock(mLock);
-    while (mCommandBuffersToExecute.empty() && !mExitRequested) {
-        mCondition.wait(lock);
+    if (mCommandBuffersToExecute.empty() && !mExitRequested) {
+        const auto start = std::chrono::steady_clock::now();
+        do {
+            mCondition.wait(lock);
+        } while (mCommandBuffersToExecute.empty() && !mExitRequested);
+        mCommandsWaitTime.fetch_add(nanoseconds(std::chrono::steady_clock::now() - start),
+                std::memory_order_relaxed);
     }
     return std::move(mCommandBuffersToExecute);
 }
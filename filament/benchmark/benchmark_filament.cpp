@@ -38,12 +38,18 @@ class FilamentFixture : public benchmark::Fixture {
 protected:
     static constexpr size_t BATCH_SIZE = 512;
 
+    static constexpr size_t MAX_FRUSTUM_COUNT = 8;
+
     Frustum frustum{};
+    std::vector<Frustum> frustums;
     std::vector<float3> boxesCenter;
     std::vector<float3> boxesExtent;
     std::vector<float4> spheres;
     Culler::result_type* UTILS_RESTRICT visibles = nullptr;
+    const Culler::Isa bestIsa = Culler::Test::getIsa();
 
+    void boxCulling(benchmark::State& state, Culler::Isa isa);
+    void sphereCulling(benchmark::State& state, Culler::Isa isa);
 
 public:
     FilamentFixture() {
@@ -54,6 +60,14 @@ public:
         const size_t batch = BATCH_SIZE;
         frustum = Frustum{ mat4f::perspective(45.0f, 1.0f, 0.1f, 100.0f) };
 
+        // e.g. the camera, shadow cascades and spot light shadows, looking in various directions
+        frustums.push_back(frustum);
+        for (size_t i = 1; i < MAX_FRUSTUM_COUNT; i++) {
+            float3 const target{ rand(gen), rand(gen), rand(gen) };
+            frustums.emplace_back(mat4f::perspective(45.0f, 1.0f, 0.1f, 100.0f) *
+                    mat4f::lookAt(float3{ 0 }, target, float3{ 0, 1, 0 }));
+        }
+
         boxesCenter.resize(batch);
         boxesExtent.resize(batch);
         spheres.resize(batch);
@@ -81,7 +95,12 @@ public:
     }
 };
 
-BENCHMARK_F(FilamentFixture, boxCulling)(benchmark::State& state) {
+void FilamentFixture::boxCulling(benchmark::State& state, Culler::Isa isa) {
+    if (!Culler::Test::setIsa(isa)) {
+        state.SkipWithError("instruction set not supported");
+        return;
+    }
+    state.SetLabel(Culler::Test::getIsaName(isa));
     {
         PerformanceCounters pc(state);
         for (auto _ : state) {
@@ -91,9 +110,15 @@ BENCHMARK_F(FilamentFixture, boxCulling)(benchmark::State& state) {
         pc.stop();
         state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
     }
+    Culler::Test::setIsa(bestIsa);
 }
 
-BENCHMARK_F(FilamentFixture, sphereCulling)(benchmark::State& state) {
+void FilamentFixture::sphereCulling(benchmark::State& state, Culler::Isa isa) {
+    if (!Culler::Test::setIsa(isa)) {
+        state.SkipWithError("instruction set not supported");
+        return;
+    }
+    state.SetLabel(Culler::Test::getIsaName(isa));
     {
         PerformanceCounters pc(state);
         for (auto _ : state) {
@@ -103,4 +128,60 @@ BENCHMARK_F(FilamentFixture, sphereCulling)(benchmark::State& state) {
         pc.stop();
         state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
     }
+    Culler::Test::setIsa(bestIsa);
+}
+
+// the best instruction set supported by the CPU
+BENCHMARK_F(FilamentFixture, boxCulling)(benchmark::State& state) {
+    boxCulling(state, bestIsa);
+}
+
+BENCHMARK_F(FilamentFixture, sphereCulling)(benchmark::State& state) {
+    sphereCulling(state, bestIsa);
+}
+
+// the auto-vectorized kernels, for reference
+BENCHMARK_F(FilamentFixture, boxCullingScalar)(benchmark::State& state) {
+    boxCulling(state, Culler::Isa::SCALAR);
+}
+
+BENCHMARK_F(FilamentFixture, sphereCullingScalar)(benchmark::State& state) {
+    sphereCulling(state, Culler::Isa::SCALAR);
+}
+
+// K frustums in a single pass over the AABBs
+BENCHMARK_DEFINE_F(FilamentFixture, boxCullingFrustums)(benchmark::State& state) {
+    const size_t frustumCount = size_t(state.range(0));
+    state.SetLabel(Culler::Test::getIsaName(bestIsa));
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            Culler::intersects(visibles, frustums.data(), frustumCount,
+                    boxesCenter.data(), boxesExtent.data(), BATCH_SIZE, 0);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
+    }
 }
+
+// K passes over the AABBs, for reference
+BENCHMARK_DEFINE_F(FilamentFixture, boxCullingFrustumsSeparate)(benchmark::State& state) {
+    const size_t frustumCount = size_t(state.range(0));
+    state.SetLabel(Culler::Test::getIsaName(bestIsa));
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            for (size_t i = 0; i < frustumCount; i++) {
+                Culler::intersects(visibles, frustums[i],
+                        boxesCenter.data(), boxesExtent.data(), BATCH_SIZE, i);
+            }
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
+    }
+}
+
+BENCHMARK_REGISTER_F(FilamentFixture, boxCullingFrustums)->Arg(1)->Arg(4)->Arg(8);
+BENCHMARK_REGISTER_F(FilamentFixture, boxCullingFrustumsSeparate)->Arg(1)->Arg(4)->Arg(8);
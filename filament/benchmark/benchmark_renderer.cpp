@@ -0,0 +1,443 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * End-to-end CPU cost of a frame, i.e. Renderer::beginFrame(), render() and endFrame(), with
+ * synthetic scenes rendered headless on the NOOP backend, so that it runs on machines without
+ * a GPU.
+ *
+ * Besides the time per frame, each benchmark reports:
+ * - the average time of each Renderer::FrameStage in ms, over the frames of the timed loop
+ *   (see Renderer::getFrameTimings()),
+ * - "frames", the number of frames these averages cover,
+ * - "allocs", the number of operator new calls per frame, on all threads.
+ *
+ * Results can be compared across commits with Google Benchmark's JSON output, e.g.:
+ *     benchmark_renderer --benchmark_out=renderer.json --benchmark_out_format=json
+ */
+
+#include "PerformanceCounters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <filament/Box.h>
+#include <filament/Camera.h>
+#include <filament/Engine.h>
+#include <filament/IndexBuffer.h>
+#include <filament/LightManager.h>
+#include <filament/Material.h>
+#include <filament/MaterialInstance.h>
+#include <filament/RenderableManager.h>
+#include <filament/Renderer.h>
+#include <filament/Scene.h>
+#include <filament/TransformManager.h>
+#include <filament/VertexBuffer.h>
+#include <filament/View.h>
+
+#include <utils/Entity.h>
+#include <utils/EntityManager.h>
+
+#include <math/mat4.h>
+#include <math/vec3.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace filament;
+using namespace filament::math;
+using namespace utils;
+
+// ------------------------------------------------------------------------------------------------
+// Allocation counting
+// ------------------------------------------------------------------------------------------------
+
+static std::atomic<uint64_t> sAllocationCount{ 0 };
+
+void* operator new(size_t size) {
+    sAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// a unit cube, shared by all renderables
+static const float3 CUBE_VERTICES[] = {
+        { -1, -1,  1 }, {  1, -1,  1 }, {  1,  1,  1 }, { -1,  1,  1 },
+        { -1, -1, -1 }, {  1, -1, -1 }, {  1,  1, -1 }, { -1,  1, -1 },
+};
+
+static const uint16_t CUBE_INDICES[] = {
+        0, 1, 2,  2, 3, 0,      // front
+        1, 5, 6,  6, 2, 1,      // right
+        5, 4, 7,  7, 6, 5,      // back
+        4, 0, 3,  3, 7, 4,      // left
+        3, 2, 6,  6, 7, 3,      // top
+        4, 5, 1,  1, 0, 4,      // bottom
+};
+
+static const char* const STAGE_NAMES[Renderer::FRAME_STAGE_COUNT] = {
+        "scenePrepare",
+        "culling",
+        "froxelize",
+        "commandGeneration",
+        "commandSort",
+        "driver",
+        "shadows",
+        "commandRecording",
+        "flushWait",
+};
+
+class RendererFixture : public benchmark::Fixture {
+protected:
+    static constexpr uint32_t WIDTH = 1280;
+    static constexpr uint32_t HEIGHT = 720;
+
+    // objects are spread in a box in front of the camera, about a third of them are visible
+    static constexpr float SCENE_EXTENT = 200.0f;
+
+    Engine* engine = nullptr;
+    SwapChain* swapChain = nullptr;
+    Renderer* renderer = nullptr;
+    Scene* scene = nullptr;
+    View* view = nullptr;
+    Camera* camera = nullptr;
+    VertexBuffer* vertexBuffer = nullptr;
+    IndexBuffer* indexBuffer = nullptr;
+    std::vector<Entity> entities;
+    std::default_random_engine gen; // NOLINT
+    uint32_t lastFrameId = 0;
+
+    // The Renderer numbers its frames from 1, skipped frames included. Keeping count here tells
+    // which timings belong to the timed loop.
+    bool beginFrame() {
+        lastFrameId++;
+        return renderer->beginFrame(swapChain);
+    }
+
+    float3 randomPosition() {
+        std::uniform_real_distribution<float> xy(-SCENE_EXTENT * 0.5f, SCENE_EXTENT * 0.5f);
+        std::uniform_real_distribution<float> z(-SCENE_EXTENT, 0.0f);
+        return { xy(gen), xy(gen), z(gen) };
+    }
+
+    Entity createEntity() {
+        Entity e = EntityManager::get().create();
+        entities.push_back(e);
+        return e;
+    }
+
+    void addRenderable(Entity e, size_t boneCount = 0) {
+        RenderableManager::Builder builder(1);
+        builder.boundingBox({ { 0, 0, 0 }, { 1, 1, 1 } })
+                .material(0, engine->getDefaultMaterial()->getDefaultInstance())
+                .geometry(0, RenderableManager::PrimitiveType::TRIANGLES,
+                        vertexBuffer, indexBuffer)
+                .castShadows(true)
+                .receiveShadows(true);
+        if (boneCount) {
+            builder.skinning(boneCount);
+        }
+        builder.build(*engine, e);
+        scene->addEntity(e);
+    }
+
+    // renderables with their own transform, at random positions
+    void addRenderables(size_t count) {
+        TransformManager& tcm = engine->getTransformManager();
+        for (size_t i = 0; i < count; i++) {
+            Entity e = createEntity();
+            tcm.create(e, {}, mat4f::translation(randomPosition()));
+            addRenderable(e);
+        }
+    }
+
+    // a shadow casting sun, and point lights at random positions
+    void addLights(size_t count) {
+        Entity sun = createEntity();
+        LightManager::Builder(LightManager::Type::SUN)
+                .direction({ 0.2f, -1.0f, -0.4f })
+                .intensity(100000.0f)
+                .castShadows(true)
+                .build(*engine, sun);
+        scene->addEntity(sun);
+        for (size_t i = 0; i < count; i++) {
+            Entity e = createEntity();
+            LightManager::Builder(LightManager::Type::POINT)
+                    .position(randomPosition())
+                    .intensity(10000.0f)
+                    .falloff(10.0f)
+                    .build(*engine, e);
+            scene->addEntity(e);
+        }
+    }
+
+    void createScene() {
+        vertexBuffer = VertexBuffer::Builder()
+                .vertexCount(8)
+                .bufferCount(1)
+                .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+                .build(*engine);
+        vertexBuffer->setBufferAt(*engine, 0, { CUBE_VERTICES, sizeof(CUBE_VERTICES) });
+        indexBuffer = IndexBuffer::Builder()
+                .indexCount(36)
+                .bufferType(IndexBuffer::IndexType::USHORT)
+                .build(*engine);
+        indexBuffer->setBuffer(*engine, { CUBE_INDICES, sizeof(CUBE_INDICES) });
+
+        scene = engine->createScene();
+        camera = engine->createCamera();
+        camera->setProjection(60.0, double(WIDTH) / HEIGHT, 0.1, SCENE_EXTENT);
+        view = engine->createView();
+        view->setScene(scene);
+        view->setCamera(camera);
+        view->setViewport({ 0, 0, WIDTH, HEIGHT });
+    }
+
+    template<typename Animate>
+    void run(benchmark::State& state, Animate animate);
+
+public:
+    void SetUp(const benchmark::State&) override {
+        gen.seed(1234);
+        lastFrameId = 0;
+        engine = Engine::create(Engine::Backend::NOOP);
+        swapChain = engine->createSwapChain(WIDTH, HEIGHT);
+        renderer = engine->createRenderer();
+        createScene();
+    }
+
+    void TearDown(const benchmark::State&) override {
+        for (Entity e : entities) {
+            engine->destroy(e);
+        }
+        EntityManager::get().destroy(entities.size(), entities.data());
+        entities.clear();
+        engine->destroy(view);
+        engine->destroy(camera);
+        engine->destroy(scene);
+        engine->destroy(indexBuffer);
+        engine->destroy(vertexBuffer);
+        engine->destroy(renderer);
+        engine->destroy(swapChain);
+        Engine::destroy(&engine);
+    }
+};
+
+template<typename Animate>
+void RendererFixture::run(benchmark::State& state, Animate animate) {
+    // warm up, so that the per-view buffers are sized for the scene
+    for (size_t i = 0; i < 4; i++) {
+        if (beginFrame()) {
+            renderer->render(view);
+            renderer->endFrame();
+        }
+    }
+    engine->flushAndWait();
+
+    // Timings arrive a few frames late, and only the last FRAME_TIMINGS_HISTORY_SIZE are kept,
+    // so they're accumulated as they arrive. Frames before firstFrameId are the warm-up's.
+    const uint32_t firstFrameId = lastFrameId + 1;
+    uint32_t measuredFrameId = 0;
+    size_t measuredFrames = 0;
+    uint64_t stageTotals[Renderer::FRAME_STAGE_COUNT] = {};
+    auto measure = [&]() {
+        Renderer::FrameTimings timings[Renderer::FRAME_TIMINGS_HISTORY_SIZE];
+        const size_t count = renderer->getFrameTimings(timings,
+                Renderer::FRAME_TIMINGS_HISTORY_SIZE);
+        // the most recent frame comes first, accumulate the oldest first
+        for (size_t i = count; i-- > 0;) {
+            Renderer::FrameTimings const& t = timings[i];
+            if (t.frameId >= firstFrameId && t.frameId > measuredFrameId) {
+                for (size_t stage = 0; stage < Renderer::FRAME_STAGE_COUNT; stage++) {
+                    stageTotals[stage] += t.stages[stage];
+                }
+                measuredFrameId = t.frameId;
+                measuredFrames++;
+            }
+        }
+    };
+
+    uint64_t skippedFrames = 0;
+    const uint64_t allocationCount = sAllocationCount.load(std::memory_order_relaxed);
+    {
+        PerformanceCounters pc(state);
+        uint32_t frame = 0;
+        for (auto _ : state) {
+            animate(frame++);
+            // the backend is running behind, the NOOP backend catches up immediately
+            while (!beginFrame()) {
+                skippedFrames++;
+                engine->flushAndWait();
+            }
+            renderer->render(view);
+            renderer->endFrame();
+            // often enough that no frame falls out of the history, outside of the timed frames
+            if (frame % (Renderer::FRAME_TIMINGS_HISTORY_SIZE / 2) == 0) {
+                state.PauseTiming();
+                measure();
+                state.ResumeTiming();
+            }
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations());
+    }
+    const uint64_t allocations = sAllocationCount.load(std::memory_order_relaxed) - allocationCount;
+
+    // The last frames are timed once the backend has executed them and the Renderer's sync
+    // thread has seen their fence, which flushAndWait() doesn't wait for.
+    engine->flushAndWait();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    measure();
+    while (measuredFrameId < lastFrameId && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        measure();
+    }
+
+    if (measuredFrames) {
+        for (size_t stage = 0; stage < Renderer::FRAME_STAGE_COUNT; stage++) {
+            state.counters[STAGE_NAMES[stage]] =
+                    double(stageTotals[stage]) * 1e-6 / double(measuredFrames);
+        }
+    }
+    state.counters["frames"] = double(measuredFrames);
+    state.counters["allocs"] = { double(allocations), benchmark::Counter::kAvgIterations };
+    state.counters["skipped"] = double(skippedFrames);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Each frame writes the uniforms, bones and draw commands of its visible renderables and shadow
+// casters to the command stream. Only CONFIG_MIN_COMMAND_BUFFERS_SIZE (1 MiB) of it is guaranteed
+// to be free, and nothing checks that a frame stays within it, so the scenes are small enough to
+// fit even when all their renderables are visible: about 2000 renderables, or 100 skinned ones
+// with 64 bones each.
+
+// many static renderables and a few lights
+BENCHMARK_DEFINE_F(RendererFixture, renderables)(benchmark::State& state) {
+    addRenderables(size_t(state.range(0)));
+    addLights(16);
+    run(state, [](uint32_t) {});
+}
+
+// a few renderables and many lights, more than the renderer can use at once
+BENCHMARK_DEFINE_F(RendererFixture, lights)(benchmark::State& state) {
+    addRenderables(1000);
+    addLights(size_t(state.range(0)));
+    run(state, [](uint32_t) {});
+}
+
+// skinned characters, whose bones are all updated every frame
+BENCHMARK_DEFINE_F(RendererFixture, skinnedCrowd)(benchmark::State& state) {
+    constexpr size_t BONE_COUNT = 64;
+    const size_t count = size_t(state.range(0));
+    TransformManager& tcm = engine->getTransformManager();
+    RenderableManager& rcm = engine->getRenderableManager();
+    std::vector<RenderableManager::Instance> characters;
+    for (size_t i = 0; i < count; i++) {
+        Entity e = createEntity();
+        tcm.create(e, {}, mat4f::translation(randomPosition()));
+        addRenderable(e, BONE_COUNT);
+        characters.push_back(rcm.getInstance(e));
+    }
+    addLights(16);
+
+    std::vector<mat4f> bones(BONE_COUNT);
+    run(state, [&](uint32_t frame) {
+        for (size_t i = 0; i < BONE_COUNT; i++) {
+            bones[i] = mat4f::rotation(0.01f * float(frame + i), float3{ 0, 1, 0 });
+        }
+        for (RenderableManager::Instance ci : characters) {
+            rcm.setBones(ci, bones.data(), BONE_COUNT);
+        }
+    });
+}
+
+// chains of renderables parented to each other, whose roots move every frame
+BENCHMARK_DEFINE_F(RendererFixture, hierarchy)(benchmark::State& state) {
+    constexpr size_t NODE_COUNT = 2048;
+    const size_t depth = size_t(state.range(0));
+    TransformManager& tcm = engine->getTransformManager();
+    std::vector<TransformManager::Instance> roots;
+    for (size_t i = 0; i < NODE_COUNT / depth; i++) {
+        TransformManager::Instance parent;
+        for (size_t j = 0; j < depth; j++) {
+            Entity e = createEntity();
+            if (j == 0) {
+                tcm.create(e, {}, mat4f::translation(randomPosition()));
+                roots.push_back(tcm.getInstance(e));
+            } else {
+                tcm.create(e, parent, mat4f::translation(float3{ 0, 0, -0.5f }));
+            }
+            parent = tcm.getInstance(e);
+            addRenderable(e);
+        }
+    }
+    addLights(16);
+
+    run(state, [&](uint32_t frame) {
+        const mat4f rotation = mat4f::rotation(0.01f * float(frame), float3{ 0, 1, 0 });
+        tcm.openLocalTransformTransaction();
+        for (TransformManager::Instance root : roots) {
+            tcm.setTransform(root, mat4f::translation(tcm.getTransform(root)[3].xyz) * rotation);
+        }
+        tcm.commitLocalTransformTransaction();
+    });
+}
+
+BENCHMARK_REGISTER_F(RendererFixture, renderables)
+        ->Arg(500)->Arg(1000)->Arg(2000)
+        ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_REGISTER_F(RendererFixture, lights)
+        ->Arg(10)->Arg(256)->Arg(4096)
+        ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_REGISTER_F(RendererFixture, skinnedCrowd)
+        ->Arg(10)->Arg(100)
+        ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_REGISTER_F(RendererFixture, hierarchy)
+        ->Arg(4)->Arg(64)->Arg(1024)
+        ->Unit(benchmark::kMillisecond)->UseRealTime();
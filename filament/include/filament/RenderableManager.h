@@ -81,6 +81,11 @@ public:
     using Instance = utils::EntityInstance<RenderableManager>;
     using PrimitiveType = backend::PrimitiveType;
 
+    /**
+     * Maximum number of levels of detail of a renderable.
+     */
+    static constexpr size_t MAX_LEVEL_COUNT = 4;
+
     /**
      * Checks if the given entity already has a renderable component.
      */
@@ -104,6 +109,24 @@ public:
         float reserved = 0;
     };
 
+    /**
+     * A cluster is a contiguous range of a primitive's indices with bounds that allow the
+     * renderer to skip it when it can't be seen, e.g. a meshlet produced by meshoptimizer.
+     *
+     * The bounds are in object space. The normal cone is given as in meshoptimizer: the cluster
+     * faces away from the camera when
+     * dot(normalize(coneApex - cameraPosition), coneAxis) >= coneCutoff.
+     */
+    struct Cluster {
+        uint32_t offset = 0;            //!< first index, from the start of the index buffer
+        uint32_t count = 0;             //!< number of indices
+        math::float3 center = {};       //!< bounding sphere center
+        float radius = 0;               //!< bounding sphere radius
+        math::float3 coneApex = {};     //!< apex of the normal cone
+        math::float3 coneAxis = {};     //!< axis of the normal cone
+        float coneCutoff = 1;           //!< 1 disables the cone test
+    };
+
     /**
      * Adds renderable components to entities using a builder pattern.
      */
@@ -160,6 +183,73 @@ public:
          */
         Builder& material(size_t index, MaterialInstance const* materialInstance) noexcept;
 
+        /**
+         * Gives the renderable several levels of detail, 1 by default.
+         *
+         * Each level has the number of primitives passed to the Builder constructor. Level 0 is
+         * the most detailed, its primitives are the ones specified with geometry() and material(),
+         * the other levels are specified with levelGeometry() and levelMaterial().
+         *
+         * Each frame, the level is chosen from the size of the renderable's bounding sphere on
+         * screen, as seen from the culling camera: level i is used when the sphere covers at
+         * least screenSizes[i] of the viewport height, the last level is used otherwise. Switching
+         * levels only happens once the size is a little past a threshold, to avoid popping.
+         *
+         * \see View::setLodBias()
+         *
+         * @param count number of levels, up to MAX_LEVEL_COUNT
+         * @param screenSizes count - 1 decreasing fractions of the viewport height, e.g. 0.5
+         *                    for a renderable covering half the height of the viewport
+         */
+        Builder& levelsOfDetail(uint8_t count, float const* screenSizes) noexcept;
+
+        /**
+         * Specifies the geometry data for a primitive of the given level of detail.
+         *
+         * @param level level of detail, must be less than the count passed to levelsOfDetail()
+         *
+         * \see geometry(), levelsOfDetail()
+         */
+        Builder& levelGeometry(uint8_t level, size_t index, PrimitiveType type,
+                VertexBuffer* vertices, IndexBuffer* indices, size_t offset, size_t count) noexcept;
+
+        /**
+         * Binds a material instance to a primitive of the given level of detail.
+         *
+         * @param level level of detail, must be less than the count passed to levelsOfDetail()
+         *
+         * \see material(), levelsOfDetail()
+         */
+        Builder& levelMaterial(uint8_t level, size_t index,
+                MaterialInstance const* materialInstance) noexcept;
+
+        /**
+         * Splits a primitive into clusters that are culled individually against the view
+         * frustum and, for back-face culled materials, against the camera position. Only the
+         * surviving index ranges are drawn in the color pass, shadow passes draw the whole
+         * primitive.
+         *
+         * The clusters must be sorted, contiguous and cover the primitive's indices exactly.
+         * The array is copied, it only needs to stay valid until build() is called.
+         *
+         * @param index zero-based index of the primitive, must be less than the count passed to Builder constructor
+         * @param clusters array of count clusters
+         * @param count number of clusters
+         *
+         * \see Cluster
+         */
+        Builder& clusters(size_t index, Cluster const* clusters, size_t count) noexcept;
+
+        /**
+         * Splits a primitive of the given level of detail into clusters.
+         *
+         * @param level level of detail, must be less than the count passed to levelsOfDetail()
+         *
+         * \see clusters(), levelsOfDetail()
+         */
+        Builder& levelClusters(uint8_t level, size_t index,
+                Cluster const* clusters, size_t count) noexcept;
+
         /**
          * The axis-aligned bounding box of the renderable.
          *
@@ -292,6 +382,8 @@ public:
             MaterialInstance const* materialInstance = nullptr;
             PrimitiveType type = PrimitiveType::TRIANGLES;
             uint16_t blendOrder = 0;
+            Cluster const* clusters = nullptr;
+            size_t clusterCount = 0;
         };
     };
 
@@ -381,6 +473,20 @@ public:
      */
     size_t getPrimitiveCount(Instance instance) const noexcept;
 
+    /**
+     * Gets the immutable number of levels of detail of the given renderable.
+     */
+    size_t getLevelCount(Instance instance) const noexcept;
+
+    /**
+     * Changes the screen-size thresholds of the levels of detail of the given renderable.
+     *
+     * @param screenSizes getLevelCount() - 1 decreasing fractions of the viewport height
+     *
+     * \see Builder::levelsOfDetail()
+     */
+    void setLevelsOfDetail(Instance instance, float const* screenSizes) noexcept;
+
     /**
      * Changes the material instance binding for the given primitive.
      *
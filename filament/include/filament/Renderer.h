@@ -26,6 +26,7 @@
 
 #include <backend/PresentCallable.h>
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace filament {
@@ -68,6 +69,66 @@ class PixelBufferDescriptor;
  */
 class UTILS_PUBLIC Renderer : public FilamentAPI {
 public:
+    /**
+     * CPU hardware counters of one stage of a frame.
+     *
+     * Counters are measured on the thread running the stage, work handed off to other threads
+     * (e.g. parallel jobs) is not included. They are only available on Linux and Android, when
+     * the kernel allows access to perf events. Otherwise, or if the CPU doesn't support a
+     * counter, its value is zero.
+     */
+    struct CpuCounters {
+        uint64_t instructions = 0;          //!< instructions retired
+        uint64_t cycles = 0;                //!< CPU cycles
+        uint64_t l1dReferences = 0;         //!< L1 data cache references
+        uint64_t l1dMisses = 0;             //!< L1 data cache misses
+        uint64_t branchInstructions = 0;    //!< branch instructions retired
+        uint64_t branchMisses = 0;          //!< mispredicted branches
+    };
+
+    /**
+     * The stages of a frame for which timings and CPU hardware counters are recorded.
+     *
+     * Stages don't overlap on a given thread: e.g. the time spent setting up shadows during
+     * culling only counts towards SHADOWS.
+     */
+    enum class FrameStage : uint8_t {
+        SCENE_PREPARE,          //!< gathering the renderables and lights of the Scene
+        CULLING,                //!< frustum and shadow culling, visibility partitioning
+        FROXELIZE,              //!< assigning lights to froxels
+        COMMAND_GENERATION,     //!< generating the draw commands
+        COMMAND_SORT,           //!< sorting the draw commands
+        DRIVER,                 //!< executing the frame's commands on the backend thread
+        SHADOWS,                //!< setting up the shadow map and recording the shadow pass
+        COMMAND_RECORDING,      //!< recording the commands of the color and post-process passes
+        FLUSH_WAIT,             //!< main thread blocked waiting for room in the command buffer
+    };
+
+    //! Number of FrameStage values
+    static constexpr size_t FRAME_STAGE_COUNT = 9;
+
+    /**
+     * CPU hardware counters of all stages of a frame, indexed by FrameStage.
+     */
+    struct FrameCpuCounters {
+        uint32_t frameId = 0;
+        CpuCounters stages[FRAME_STAGE_COUNT];
+    };
+
+    /**
+     * Wall-clock times of a frame, in nanoseconds.
+     *
+     * Stages running on other threads, i.e. FROXELIZE and DRIVER, overlap with the stages of
+     * the main thread. DRIVER excludes the time the backend thread spends waiting for commands.
+     * FLUSH_WAIT covers the time since the end of the previous frame, so that it includes the
+     * flush ending that frame; waits during a stage are also counted in that stage.
+     */
+    struct FrameTimings {
+        uint32_t frameId = 0;
+        uint64_t frameTime = 0;                     //!< main thread, beginFrame() to endFrame()
+        uint64_t stages[FRAME_STAGE_COUNT] = {};    //!< indexed by FrameStage
+    };
+
      /**
       * Get the Engine that created this Renderer.
       *
@@ -419,6 +480,48 @@ public:
      * getUserTime()
      */
     void resetUserTime();
+
+    /**
+     * Enables sampling of the CPU hardware counters of each stage of a frame.
+     *
+     * Sampling is disabled by default. Sampling every frame is relatively cheap, it costs a few
+     * system calls per stage.
+     *
+     * @param interval Counters are sampled every `interval` frames, 0 disables sampling.
+     *
+     * @see getFrameCpuCounters()
+     */
+    void setCpuCountersSamplingInterval(uint32_t interval) noexcept;
+
+    /**
+     * Retrieves the CPU hardware counters of the most recently sampled frames.
+     *
+     * Counters become available a few frames after they're sampled, once the frame's commands
+     * have been executed by the backend.
+     *
+     * @param out Array receiving up to `count` entries, most recent frame first.
+     * @param count Size of the `out` array.
+     * @return The number of entries written to `out`.
+     *
+     * @see setCpuCountersSamplingInterval()
+     */
+    size_t getFrameCpuCounters(FrameCpuCounters* out, size_t count) const noexcept;
+
+    /**
+     * Retrieves the timings of the most recent frames.
+     *
+     * Timings are recorded for every frame, the Renderer keeps those of the last
+     * FRAME_TIMINGS_HISTORY_SIZE frames. Like CPU counters, they become available a few frames
+     * later, once the frame's commands have been executed by the backend.
+     *
+     * @param out Array receiving up to `count` entries, most recent frame first.
+     * @param count Size of the `out` array.
+     * @return The number of entries written to `out`.
+     */
+    size_t getFrameTimings(FrameTimings* out, size_t count) const noexcept;
+
+    //! Number of frames whose timings are kept, see getFrameTimings()
+    static constexpr size_t FRAME_TIMINGS_HISTORY_SIZE = 32;
 };
 
 } // namespace filament
@@ -94,10 +94,24 @@ public:
     struct UTILS_PUBLIC PrefilterOptions {
         uint16_t sampleCount = 8;   //!< sample count used for filtering
         bool mirror = true;         //!< whether the environment must be mirrored
+        /**
+         * Uses a quarter of sampleCount (at least 2) and filters each sample over a wider area
+         * to hide the noise. This is much faster but blurrier, and intended for environments
+         * updated at runtime.
+         */
+        bool fast = false;
     private:
         UTILS_UNUSED uintptr_t reserved[3] = {};
     };
 
+    /**
+     * Callback invoked once generatePrefilterMipmapAsync() has uploaded all mipmap levels.
+     *
+     * @param texture   The texture that was prefiltered.
+     * @param user      The user pointer given to generatePrefilterMipmapAsync().
+     */
+    using PrefilterCallback = void(*)(Texture* texture, void* user);
+
 
     //! Use Builder to construct a Texture object instance
     class Builder : public BuilderBase<BuilderDetails> {
@@ -420,7 +434,8 @@ public:
      * The reflections cubemap's dimension must be a power-of-two.
      *
      * @warning This operation is computationally intensive, especially with large environments and
-     *          is currently synchronous. Expect about 1ms for a 16x16 cubemap.
+     *          is synchronous. Expect about 1ms for a 16x16 cubemap. See
+     *          generatePrefilterMipmapAsync() for an asynchronous version.
      *
      * @param engine        Reference to the filament::Engine to associate this IndirectLight with.
      * @param buffer        Client-side buffer containing the images to set.
@@ -434,6 +449,35 @@ public:
     void generatePrefilterMipmap(Engine& engine,
             PixelBufferDescriptor&& buffer, const FaceOffsets& faceOffsets,
             PrefilterOptions const* options = nullptr);
+
+    /**
+     * Asynchronous version of generatePrefilterMipmap().
+     *
+     * The source data is copied before this call returns, then the mipmap levels are generated
+     * in the background, at a lower priority than rendering. Each level is uploaded to the
+     * texture as soon as it's ready, during Renderer::beginFrame(), starting with the sharpest.
+     * Until then, the texture keeps its previous content.
+     *
+     * Calling generatePrefilterMipmap() or generatePrefilterMipmapAsync() again, or destroying
+     * the texture, cancels the pending work, in which case the callback is not called.
+     *
+     * @param engine        Reference to the filament::Engine to associate this IndirectLight with.
+     * @param buffer        Client-side buffer containing the images to set.
+     * @param faceOffsets   Offsets in bytes into \p buffer for all six images. The offsets
+     *                      are specified in the following order: +x, -x, +y, -y, +z, -z
+     * @param options       Optional parameter to controlling user-specified quality and options.
+     * @param callback      Optional callback invoked on the Engine's thread, from
+     *                      Renderer::beginFrame(), once all levels are uploaded.
+     * @param user          Opaque pointer passed to the callback.
+     *
+     * @exception utils::PreConditionPanic if the source data constraints are not respected.
+     *
+     * @see generatePrefilterMipmap()
+     */
+    void generatePrefilterMipmapAsync(Engine& engine,
+            PixelBufferDescriptor&& buffer, const FaceOffsets& faceOffsets,
+            PrefilterOptions const* options = nullptr,
+            PrefilterCallback callback = nullptr, void* user = nullptr);
 };
 
 } // namespace filament
@@ -116,6 +116,52 @@ public:
         bool homogeneousScaling = false;                //!< set to true to force homogeneous scaling
     };
 
+    /**
+     * The CPU budget controller lowers the CPU cost of a View when frames take longer than a
+     * target frame time on the CPU, and restores it when they're comfortably faster. Unlike
+     * dynamic resolution, it reacts to the CPU time of the frame's stages (see
+     * Renderer::getFrameTimings()), and adjusts settings whose cost scales with the size of the
+     * scene:
+     *
+     * - geometry: the level of detail bias is raised up to maxLodBias (see setLodBias()),
+     *   reacting to the CULLING, COMMAND_GENERATION and COMMAND_RECORDING stages.
+     * - shadows: the shadow distance is shortened down to minShadowDistanceScale, so that
+     *   fewer renderables cast shadows, reacting to the SHADOWS stage.
+     * - lighting: the number of point and spot lights and the number of froxels are lowered
+     *   down to minLightCountRatio and minFroxelCountRatio, reacting to the part of the
+     *   FROXELIZE stage that isn't overlapped by COMMAND_GENERATION and COMMAND_SORT, which run
+     *   at the same time on the main thread.
+     *
+     * Each of these moves by steps. When over budget, the one whose stages took the most time
+     * is lowered by a step; when under budget, the one whose stages took the least time is
+     * restored by a step. The CPU time of a frame is the longest of the main thread's time,
+     * excluding the time it waited on the backend, and of the backend thread's time.
+     *
+     * enabled:   enable or disable the controller on a View
+     * targetFrameTimeMilli: CPU time budget of a frame in milliseconds
+     * headRoomRatio: settings are restored only when the CPU time is below the budget
+     *                minus this ratio of the budget, which avoids oscillating around it
+     * history:   number of frames the CPU time is filtered over before each decision
+     * restoreDelay: number of frames that must be under budget before a step is restored,
+     *               steps are lowered without delay
+     *
+     * \note
+     * The controller relies on the timings measured by the Renderer, which are only available
+     * on platforms with threads. Frame timings are measured for the whole frame, so with
+     * several views the controllers of all views react to their combined cost.
+     */
+    struct CpuBudgetOptions {
+        float targetFrameTimeMilli = 1000.0f / 60.0f;   //!< CPU time budget of a frame
+        float headRoomRatio = 0.2f;                     //!< hysteresis, as a ratio of the budget
+        float maxLodBias = 2.0f;                        //!< largest level of detail bias added
+        float minShadowDistanceScale = 0.25f;           //!< shortest shadow distance, as a ratio
+        float minLightCountRatio = 0.25f;               //!< fewest lights, as a ratio
+        float minFroxelCountRatio = 0.25f;              //!< fewest froxels, as a ratio
+        uint8_t history = 5;                            //!< history size
+        uint8_t restoreDelay = 30;                      //!< frames under budget before restoring
+        bool enabled = false;                           //!< enable or disable the controller
+    };
+
     enum class QualityLevel : int8_t {
         LOW,
         MEDIUM,
@@ -402,6 +448,26 @@ public:
      */
     void setShadowsEnabled(bool enabled) noexcept;
 
+    /**
+     * Biases the selection of the levels of detail of renderables. 0 by default.
+     *
+     * Each unit of bias halves the screen size renderables are assumed to have when their level
+     * of detail is picked, so positive values select coarser levels, and negative values finer
+     * ones. This can be used to trade quality for performance dynamically.
+     *
+     * @param bias the level of detail bias
+     *
+     * @see RenderableManager::Builder::levelsOfDetail()
+     */
+    void setLodBias(float bias) noexcept;
+
+    /**
+     * Returns the level of detail bias.
+     *
+     * @see setLodBias()
+     */
+    float getLodBias() const noexcept;
+
     /**
      * Specifies an offscreen render target to render into.
      *
@@ -512,6 +578,21 @@ public:
      */
     DynamicResolutionOptions getDynamicResolutionOptions() const noexcept;
 
+    /**
+     * Sets the CPU budget controller options for this view. Refer to CpuBudgetOptions for more
+     * information about how the controller behaves. Changing the options restores the full
+     * quality of the view.
+     *
+     * @param options The CPU budget controller options to use on this view
+     */
+    void setCpuBudgetOptions(CpuBudgetOptions const& options) noexcept;
+
+    /**
+     * Returns the CPU budget controller options associated with this view.
+     * @return value set by setCpuBudgetOptions().
+     */
+    CpuBudgetOptions getCpuBudgetOptions() const noexcept;
+
     /**
      * Sets the rendering quality for this view. Refer to RenderQuality for more
      * information about the different settings available.
@@ -18,23 +18,124 @@
 
 #include <math/fast.h>
 
+#include <utils/architecture.h>
+
+#include <algorithm>
+
+#include <assert.h>
+
+#if defined(__SSE2__)
+#   include <immintrin.h>
+#   define FILAMENT_CULLER_HAS_SSE2 1
+#   if defined(__i386__) || defined(__x86_64__)
+#       define FILAMENT_CULLER_HAS_AVX 1
+#   endif
+#endif
+
+#if defined(__ARM_NEON)
+#   include <arm_neon.h>
+#   define FILAMENT_CULLER_HAS_NEON 1
+#endif
+
 using namespace filament::math;
 
 namespace filament {
 namespace details {
 
-void Culler::intersects(
+/*
+ * All kernels process 'count' items, which must be a multiple of 8. Boxes can be tested against
+ * several frustums in a single pass, frustum f setting bit 'bit + f' of the results. They are
+ * tested against each plane with:
+ *      dot(p.xyz, center) - dot(abs(p.xyz), extent) + p.w
+ * and spheres with:
+ *      dot(p.xyz, sphere.xyz) + p.w - sphere.w
+ * An item is visible if all its dot products are negative. The SIMD kernels transpose the
+ * AoS inputs to SoA in registers and evaluate these expressions in the same order as the scalar
+ * kernels, so all kernels produce the same results.
+ */
+
+using result_type = Culler::result_type;
+
+using BoxKernel = void (*)(result_type* results, float4 const* planes, size_t frustumCount,
+        float3 const* center, float3 const* extent, size_t count, size_t bit);
+
+using SphereKernel = void (*)(result_type* results, float4 const* planes,
+        float4 const* spheres, size_t count);
+
+// ------------------------------------------------------------------------------------------------
+// Scalar
+// ------------------------------------------------------------------------------------------------
+
+static void boxesScalar(
         result_type* UTILS_RESTRICT results,
-        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT planes,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+
+    // we use a vectorize width of 8 because, on ARMv8 it allows the compiler to write eight
+    // 8-bits results in one go. Without this it has to do 4 separate byte writes, which
+    // ends-up being slower.
+    #pragma clang loop vectorize_width(8)
+    for (size_t i = 0; i < count; i++) {
+        int visible = ~0;
+
+        #pragma clang loop unroll(full)
+        for (size_t j = 0; j < 6; j++) {
+            // clang doesn't seem to generate vector * scalar instructions, which leads
+            // to increased register pressure and stack spills
+            const float dot =
+                    planes[j].x * center[i].x - std::abs(planes[j].x) * extent[i].x +
+                    planes[j].y * center[i].y - std::abs(planes[j].y) * extent[i].y +
+                    planes[j].z * center[i].z - std::abs(planes[j].z) * extent[i].z +
+                    planes[j].w;
+
+            visible &= fast::signbit(dot) << bit;
+        }
+
+        results[i] |= result_type(visible);
+    }
+}
+
+static void boxesScalar(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes, size_t frustumCount,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    if (frustumCount == 1) {
+        // this loop is simpler to vectorize
+        boxesScalar(results, planes, center, extent, count, bit);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        int mask = 0;
+        for (size_t f = 0; f < frustumCount; f++) {
+            float4 const* const UTILS_RESTRICT p = planes + f * 6;
+            int visible = ~0;
+            for (size_t j = 0; j < 6; j++) {
+                const float dot =
+                        p[j].x * center[i].x - std::abs(p[j].x) * extent[i].x +
+                        p[j].y * center[i].y - std::abs(p[j].y) * extent[i].y +
+                        p[j].z * center[i].z - std::abs(p[j].z) * extent[i].z +
+                        p[j].w;
+                visible &= fast::signbit(dot);
+            }
+            mask |= visible << (bit + f);
+        }
+        results[i] |= result_type(mask);
+    }
+}
+
+static void spheresScalar(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
         float4 const* UTILS_RESTRICT b,
         size_t count) noexcept {
 
-    float4 const * const UTILS_RESTRICT planes = frustum.mPlanes;
-
     // we use a vectorize width of 8 because, on ARMv8 it allow the compiler to write 8
     // 8-bits results in one go. Without this it has to do 4 separate byte writes, which
     // ends-up being slower.
-    count = round(count); // capacity guaranteed to be multiple of 8
     #pragma clang loop vectorize_width(8)
     for (size_t i = 0; i < count; i++) {
         int visible = ~0;
@@ -54,38 +155,527 @@ void Culler::intersects(
     }
 }
 
-void Culler::intersects(
+// the planes, followed by the absolute values of their normals
+static inline void prepareBoxPlanes(float* UTILS_RESTRICT out,
+        float4 const* UTILS_RESTRICT planes, size_t frustumCount) noexcept {
+    for (size_t j = 0; j < frustumCount * 6; j++, out += 7) {
+        out[0] = planes[j].x;
+        out[1] = planes[j].y;
+        out[2] = planes[j].z;
+        out[3] = planes[j].w;
+        out[4] = std::abs(planes[j].x);
+        out[5] = std::abs(planes[j].y);
+        out[6] = std::abs(planes[j].z);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// SSE2, this is the baseline on x86-64.
+// ------------------------------------------------------------------------------------------------
+
+#if FILAMENT_CULLER_HAS_SSE2
+
+// a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+static inline void transpose3(__m128 a, __m128 b, __m128 c,
+        __m128& x, __m128& y, __m128& z) noexcept {
+    __m128 const xy = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));    // x2 y2 x3 y3
+    __m128 const yz = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));    // y0 z0 y1 z1
+    x = _mm_shuffle_ps(a, xy, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm_shuffle_ps(yz, c, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+// returns the visibility bits of the 4 boxes starting at c and e
+static inline __m128i boxes4Sse2(float const* UTILS_RESTRICT p, size_t frustumCount, size_t bit,
+        float const* UTILS_RESTRICT c, float const* UTILS_RESTRICT e) noexcept {
+    __m128 cx, cy, cz, ex, ey, ez;
+    transpose3(_mm_loadu_ps(c), _mm_loadu_ps(c + 4), _mm_loadu_ps(c + 8), cx, cy, cz);
+    transpose3(_mm_loadu_ps(e), _mm_loadu_ps(e + 4), _mm_loadu_ps(e + 8), ex, ey, ez);
+    __m128i mask = _mm_setzero_si128();
+    for (size_t f = 0; f < frustumCount; f++) {
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (size_t j = 0; j < 6; j++, p += 7) {
+            __m128 dot = _mm_sub_ps(
+                    _mm_mul_ps(_mm_set1_ps(p[0]), cx), _mm_mul_ps(_mm_set1_ps(p[4]), ex));
+            dot = _mm_add_ps(dot, _mm_mul_ps(_mm_set1_ps(p[1]), cy));
+            dot = _mm_sub_ps(dot, _mm_mul_ps(_mm_set1_ps(p[5]), ey));
+            dot = _mm_add_ps(dot, _mm_mul_ps(_mm_set1_ps(p[2]), cz));
+            dot = _mm_sub_ps(dot, _mm_mul_ps(_mm_set1_ps(p[6]), ez));
+            dot = _mm_add_ps(dot, _mm_set1_ps(p[3]));
+            visible = _mm_and_ps(visible, dot);
+        }
+        __m128i const inside = _mm_srai_epi32(_mm_castps_si128(visible), 31);
+        mask = _mm_or_si128(mask, _mm_and_si128(inside, _mm_set1_epi32(1 << (bit + f))));
+    }
+    return mask;
+}
+
+// returns 1 for the visible spheres among the 4 spheres starting at s
+static inline __m128i spheres4Sse2(float const* UTILS_RESTRICT p,
+        float const* UTILS_RESTRICT s) noexcept {
+    __m128 sx = _mm_loadu_ps(s);
+    __m128 sy = _mm_loadu_ps(s + 4);
+    __m128 sz = _mm_loadu_ps(s + 8);
+    __m128 sw = _mm_loadu_ps(s + 12);
+    _MM_TRANSPOSE4_PS(sx, sy, sz, sw);
+    __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (size_t j = 0; j < 6; j++, p += 4) {
+        __m128 dot = _mm_add_ps(
+                _mm_mul_ps(_mm_set1_ps(p[0]), sx), _mm_mul_ps(_mm_set1_ps(p[1]), sy));
+        dot = _mm_add_ps(dot, _mm_mul_ps(_mm_set1_ps(p[2]), sz));
+        dot = _mm_add_ps(dot, _mm_set1_ps(p[3]));
+        dot = _mm_sub_ps(dot, sw);
+        visible = _mm_and_ps(visible, dot);
+    }
+    return _mm_srli_epi32(_mm_castps_si128(visible), 31);
+}
+
+// narrows two vectors of 4 masks (each between 0 and 255) to 8 bytes
+static inline __m128i narrow(__m128i lo, __m128i hi) noexcept {
+    return _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+}
+
+static void boxesSse2(
         result_type* UTILS_RESTRICT results,
-        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT planes, size_t frustumCount,
         float3 const* UTILS_RESTRICT center,
         float3 const* UTILS_RESTRICT extent,
         size_t count, size_t bit) noexcept {
+    float p[Culler::MAX_FRUSTUM_COUNT * 6 * 7];
+    prepareBoxPlanes(p, planes, frustumCount);
+    for (size_t i = 0; i < count; i += 8) {
+        float const* c = &center[i].x;
+        float const* e = &extent[i].x;
+        __m128i const lo = boxes4Sse2(p, frustumCount, bit, c, e);
+        __m128i const hi = boxes4Sse2(p, frustumCount, bit, c + 12, e + 12);
+        __m128i* const r = (__m128i*)(results + i);
+        _mm_storel_epi64(r, _mm_or_si128(_mm_loadl_epi64(r), narrow(lo, hi)));
+    }
+}
+
+static void spheresSse2(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT spheres,
+        size_t count) noexcept {
+    float const* p = &planes[0].x;
+    for (size_t i = 0; i < count; i += 8) {
+        float const* s = &spheres[i].x;
+        __m128i const lo = spheres4Sse2(p, s);
+        __m128i const hi = spheres4Sse2(p, s + 16);
+        _mm_storel_epi64((__m128i*)(results + i), narrow(lo, hi));
+    }
+}
 
-    float4 const * UTILS_RESTRICT const planes = frustum.mPlanes;
+#endif // FILAMENT_CULLER_HAS_SSE2
 
-    // we use a vectorize width of 8 because, on ARMv8 it allows the compiler to write eight
-    // 8-bits results in one go. Without this it has to do 4 separate byte writes, which
-    // ends-up being slower.
-    count = round(count); // capacity guaranteed to be multiple of 8
-    #pragma clang loop vectorize_width(8)
-    for (size_t i = 0; i < count; i++) {
-        int visible = ~0;
+// ------------------------------------------------------------------------------------------------
+// AVX2, 8 items per iteration
+// ------------------------------------------------------------------------------------------------
 
-        #pragma clang loop unroll(full)
+#if FILAMENT_CULLER_HAS_AVX
+
+UTILS_TARGET("avx2")
+static inline __m256 loadu2(float const* lo, float const* hi) noexcept {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+}
+
+// same as transpose3(), independently in each 128-bits lane
+UTILS_TARGET("avx2")
+static inline void transpose3(__m256 a, __m256 b, __m256 c,
+        __m256& x, __m256& y, __m256& z) noexcept {
+    __m256 const xy = _mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+    __m256 const yz = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+    x = _mm256_shuffle_ps(a, xy, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm256_shuffle_ps(yz, c, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+// narrows 8 masks (each between 0 and 255) to 8 bytes
+UTILS_TARGET("avx2")
+static inline __m128i narrow(__m256i mask) noexcept {
+    return narrow(_mm256_castsi256_si128(mask), _mm256_extracti128_si256(mask, 1));
+}
+
+// returns the visibility bits of the 8 boxes starting at c and e
+UTILS_TARGET("avx2")
+static inline __m256i boxes8Avx2(float const* UTILS_RESTRICT p, size_t frustumCount, size_t bit,
+        float const* UTILS_RESTRICT c, float const* UTILS_RESTRICT e) noexcept {
+    // the low lanes hold boxes 0 to 3, the high lanes boxes 4 to 7
+    __m256 cx, cy, cz, ex, ey, ez;
+    transpose3(loadu2(c, c + 12), loadu2(c + 4, c + 16), loadu2(c + 8, c + 20), cx, cy, cz);
+    transpose3(loadu2(e, e + 12), loadu2(e + 4, e + 16), loadu2(e + 8, e + 20), ex, ey, ez);
+    __m256i mask = _mm256_setzero_si256();
+    for (size_t f = 0; f < frustumCount; f++) {
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (size_t j = 0; j < 6; j++, p += 7) {
+            __m256 dot = _mm256_sub_ps(
+                    _mm256_mul_ps(_mm256_broadcast_ss(p + 0), cx),
+                    _mm256_mul_ps(_mm256_broadcast_ss(p + 4), ex));
+            dot = _mm256_add_ps(dot, _mm256_mul_ps(_mm256_broadcast_ss(p + 1), cy));
+            dot = _mm256_sub_ps(dot, _mm256_mul_ps(_mm256_broadcast_ss(p + 5), ey));
+            dot = _mm256_add_ps(dot, _mm256_mul_ps(_mm256_broadcast_ss(p + 2), cz));
+            dot = _mm256_sub_ps(dot, _mm256_mul_ps(_mm256_broadcast_ss(p + 6), ez));
+            dot = _mm256_add_ps(dot, _mm256_broadcast_ss(p + 3));
+            visible = _mm256_and_ps(visible, dot);
+        }
+        __m256i const inside = _mm256_srai_epi32(_mm256_castps_si256(visible), 31);
+        mask = _mm256_or_si256(mask, _mm256_and_si256(inside, _mm256_set1_epi32(1 << (bit + f))));
+    }
+    return mask;
+}
+
+UTILS_TARGET("avx2")
+static void boxesAvx2(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes, size_t frustumCount,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    float p[Culler::MAX_FRUSTUM_COUNT * 6 * 7];
+    prepareBoxPlanes(p, planes, frustumCount);
+    for (size_t i = 0; i < count; i += 8) {
+        __m256i const mask = boxes8Avx2(p, frustumCount, bit, &center[i].x, &extent[i].x);
+        __m128i* const r = (__m128i*)(results + i);
+        _mm_storel_epi64(r, _mm_or_si128(_mm_loadl_epi64(r), narrow(mask)));
+    }
+}
+
+UTILS_TARGET("avx2")
+static void spheresAvx2(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT spheres,
+        size_t count) noexcept {
+    float const* const p = &planes[0].x;
+    for (size_t i = 0; i < count; i += 8) {
+        // the low lanes hold spheres 0 to 3, the high lanes spheres 4 to 7
+        float const* s = &spheres[i].x;
+        __m256 const r0 = loadu2(s +  0, s + 16);
+        __m256 const r1 = loadu2(s +  4, s + 20);
+        __m256 const r2 = loadu2(s +  8, s + 24);
+        __m256 const r3 = loadu2(s + 12, s + 28);
+        __m256 const t0 = _mm256_unpacklo_ps(r0, r1);   // x0 x1 y0 y1
+        __m256 const t1 = _mm256_unpacklo_ps(r2, r3);   // x2 x3 y2 y3
+        __m256 const t2 = _mm256_unpackhi_ps(r0, r1);   // z0 z1 w0 w1
+        __m256 const t3 = _mm256_unpackhi_ps(r2, r3);   // z2 z3 w2 w3
+        __m256 const sx = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 const sy = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 const sz = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 const sw = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
         for (size_t j = 0; j < 6; j++) {
-            // clang doesn't seem to generate vector * scalar instructions, which leads
-            // to increased register pressure and stack spills
-            const float dot =
-                    planes[j].x * center[i].x - std::abs(planes[j].x) * extent[i].x +
-                    planes[j].y * center[i].y - std::abs(planes[j].y) * extent[i].y +
-                    planes[j].z * center[i].z - std::abs(planes[j].z) * extent[i].z +
-                    planes[j].w;
+            float const* pj = p + j * 4;
+            __m256 dot = _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_broadcast_ss(pj + 0), sx),
+                    _mm256_mul_ps(_mm256_broadcast_ss(pj + 1), sy));
+            dot = _mm256_add_ps(dot, _mm256_mul_ps(_mm256_broadcast_ss(pj + 2), sz));
+            dot = _mm256_add_ps(dot, _mm256_broadcast_ss(pj + 3));
+            dot = _mm256_sub_ps(dot, sw);
+            visible = _mm256_and_ps(visible, dot);
+        }
+        __m256i const mask = _mm256_srli_epi32(_mm256_castps_si256(visible), 31);
+        _mm_storel_epi64((__m128i*)(results + i), narrow(mask));
+    }
+}
 
-            visible &= fast::signbit(dot) << bit;
+// ------------------------------------------------------------------------------------------------
+// AVX-512, 16 items per iteration, the remaining 8 are processed with AVX2
+// ------------------------------------------------------------------------------------------------
+
+// gathers component k of 16 consecutive float3, whose 48 floats are in a, b and c
+UTILS_TARGET("avx512f")
+static inline __m512 gather3(__m512 a, __m512 b, __m512 c, int k) noexcept {
+    // lane l needs float 3*l+k, the permutes only use the low bits of the indices
+    __m512i const index = _mm512_add_epi32(_mm512_setr_epi32(
+            0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 33, 36, 39, 42, 45), _mm512_set1_epi32(k));
+    __mmask16 const fromC = k < 2 ? __mmask16(0xF800) : __mmask16(0xFC00);
+    return _mm512_mask_permutexvar_ps(_mm512_permutex2var_ps(a, index, b), fromC, index, c);
+}
+
+// gathers component k of 16 consecutive float4, whose 64 floats are in a, b, c and d
+UTILS_TARGET("avx512f")
+static inline __m512 gather4(__m512 a, __m512 b, __m512 c, __m512 d, int k) noexcept {
+    __m512i const index = _mm512_add_epi32(_mm512_setr_epi32(
+            0, 4, 8, 12, 16, 20, 24, 28, 32, 36, 40, 44, 48, 52, 56, 60), _mm512_set1_epi32(k));
+    return _mm512_mask_blend_ps(__mmask16(0xFF00),
+            _mm512_permutex2var_ps(a, index, b), _mm512_permutex2var_ps(c, index, d));
+}
+
+// returns a mask of the lanes whose sign bit is set
+UTILS_TARGET("avx512f")
+static inline __mmask16 signMask(__m512 v) noexcept {
+    return _mm512_cmplt_epi32_mask(_mm512_castps_si512(v), _mm512_setzero_si512());
+}
+
+UTILS_TARGET("avx512f")
+static void boxesAvx512(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes, size_t frustumCount,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    float p[Culler::MAX_FRUSTUM_COUNT * 6 * 7];
+    prepareBoxPlanes(p, planes, frustumCount);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        float const* c = &center[i].x;
+        float const* e = &extent[i].x;
+        __m512 const c0 = _mm512_loadu_ps(c);
+        __m512 const c1 = _mm512_loadu_ps(c + 16);
+        __m512 const c2 = _mm512_loadu_ps(c + 32);
+        __m512 const e0 = _mm512_loadu_ps(e);
+        __m512 const e1 = _mm512_loadu_ps(e + 16);
+        __m512 const e2 = _mm512_loadu_ps(e + 32);
+        __m512 const cx = gather3(c0, c1, c2, 0);
+        __m512 const cy = gather3(c0, c1, c2, 1);
+        __m512 const cz = gather3(c0, c1, c2, 2);
+        __m512 const ex = gather3(e0, e1, e2, 0);
+        __m512 const ey = gather3(e0, e1, e2, 1);
+        __m512 const ez = gather3(e0, e1, e2, 2);
+
+        __m512i mask = _mm512_setzero_si512();
+        float const* pf = p;
+        for (size_t f = 0; f < frustumCount; f++) {
+            __m512 visible = _mm512_castsi512_ps(_mm512_set1_epi32(-1));
+            for (size_t j = 0; j < 6; j++, pf += 7) {
+                __m512 dot = _mm512_sub_ps(
+                        _mm512_mul_ps(_mm512_set1_ps(pf[0]), cx),
+                        _mm512_mul_ps(_mm512_set1_ps(pf[4]), ex));
+                dot = _mm512_add_ps(dot, _mm512_mul_ps(_mm512_set1_ps(pf[1]), cy));
+                dot = _mm512_sub_ps(dot, _mm512_mul_ps(_mm512_set1_ps(pf[5]), ey));
+                dot = _mm512_add_ps(dot, _mm512_mul_ps(_mm512_set1_ps(pf[2]), cz));
+                dot = _mm512_sub_ps(dot, _mm512_mul_ps(_mm512_set1_ps(pf[6]), ez));
+                dot = _mm512_add_ps(dot, _mm512_set1_ps(pf[3]));
+                visible = _mm512_castsi512_ps(_mm512_and_si512(
+                        _mm512_castps_si512(visible), _mm512_castps_si512(dot)));
+            }
+            mask = _mm512_mask_or_epi32(mask, signMask(visible),
+                    mask, _mm512_set1_epi32(1 << (bit + f)));
         }
+        __m128i* const r = (__m128i*)(results + i);
+        _mm_storeu_si128(r, _mm_or_si128(_mm_loadu_si128(r), _mm512_cvtepi32_epi8(mask)));
+    }
+    if (i < count) {
+        boxesAvx2(results + i, planes, frustumCount, center + i, extent + i, count - i, bit);
+    }
+}
 
-        results[i] |= result_type(visible);
+UTILS_TARGET("avx512f")
+static void spheresAvx512(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT spheres,
+        size_t count) noexcept {
+    float const* const p = &planes[0].x;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        float const* s = &spheres[i].x;
+        __m512 const s0 = _mm512_loadu_ps(s);
+        __m512 const s1 = _mm512_loadu_ps(s + 16);
+        __m512 const s2 = _mm512_loadu_ps(s + 32);
+        __m512 const s3 = _mm512_loadu_ps(s + 48);
+        __m512 const sx = gather4(s0, s1, s2, s3, 0);
+        __m512 const sy = gather4(s0, s1, s2, s3, 1);
+        __m512 const sz = gather4(s0, s1, s2, s3, 2);
+        __m512 const sw = gather4(s0, s1, s2, s3, 3);
+
+        __m512 visible = _mm512_castsi512_ps(_mm512_set1_epi32(-1));
+        for (size_t j = 0; j < 6; j++) {
+            float const* pj = p + j * 4;
+            __m512 dot = _mm512_add_ps(
+                    _mm512_mul_ps(_mm512_set1_ps(pj[0]), sx),
+                    _mm512_mul_ps(_mm512_set1_ps(pj[1]), sy));
+            dot = _mm512_add_ps(dot, _mm512_mul_ps(_mm512_set1_ps(pj[2]), sz));
+            dot = _mm512_add_ps(dot, _mm512_set1_ps(pj[3]));
+            dot = _mm512_sub_ps(dot, sw);
+            visible = _mm512_castsi512_ps(_mm512_and_si512(
+                    _mm512_castps_si512(visible), _mm512_castps_si512(dot)));
+        }
+        __m512i const mask = _mm512_maskz_set1_epi32(signMask(visible), 1);
+        _mm_storeu_si128((__m128i*)(results + i), _mm512_cvtepi32_epi8(mask));
+    }
+    if (i < count) {
+        spheresAvx2(results + i, planes, spheres + i, count - i);
+    }
+}
+
+#endif // FILAMENT_CULLER_HAS_AVX
+
+// ------------------------------------------------------------------------------------------------
+// NEON, 8 items per iteration
+// ------------------------------------------------------------------------------------------------
+
+#if FILAMENT_CULLER_HAS_NEON
+
+// returns the visibility bits of the 4 boxes starting at c and e
+static inline uint32x4_t boxes4Neon(float const* UTILS_RESTRICT p, size_t frustumCount,
+        size_t bit, float const* UTILS_RESTRICT c, float const* UTILS_RESTRICT e) noexcept {
+    float32x4x3_t const cv = vld3q_f32(c);
+    float32x4x3_t const ev = vld3q_f32(e);
+    uint32x4_t mask = vdupq_n_u32(0);
+    for (size_t f = 0; f < frustumCount; f++) {
+        uint32x4_t visible = vdupq_n_u32(~0u);
+        for (size_t j = 0; j < 6; j++, p += 7) {
+            float32x4_t dot = vsubq_f32(
+                    vmulq_n_f32(cv.val[0], p[0]), vmulq_n_f32(ev.val[0], p[4]));
+            dot = vaddq_f32(dot, vmulq_n_f32(cv.val[1], p[1]));
+            dot = vsubq_f32(dot, vmulq_n_f32(ev.val[1], p[5]));
+            dot = vaddq_f32(dot, vmulq_n_f32(cv.val[2], p[2]));
+            dot = vsubq_f32(dot, vmulq_n_f32(ev.val[2], p[6]));
+            dot = vaddq_f32(dot, vdupq_n_f32(p[3]));
+            visible = vandq_u32(visible, vreinterpretq_u32_f32(dot));
+        }
+        uint32x4_t const inside = vshrq_n_u32(visible, 31);
+        mask = vorrq_u32(mask, vshlq_u32(inside, vdupq_n_s32(int32_t(bit + f))));
+    }
+    return mask;
+}
+
+// returns 1 for the visible spheres among the 4 spheres starting at s
+static inline uint32x4_t spheres4Neon(float const* UTILS_RESTRICT p,
+        float const* UTILS_RESTRICT s) noexcept {
+    float32x4x4_t const sv = vld4q_f32(s);
+    uint32x4_t visible = vdupq_n_u32(~0u);
+    for (size_t j = 0; j < 6; j++, p += 4) {
+        float32x4_t dot = vaddq_f32(vmulq_n_f32(sv.val[0], p[0]), vmulq_n_f32(sv.val[1], p[1]));
+        dot = vaddq_f32(dot, vmulq_n_f32(sv.val[2], p[2]));
+        dot = vaddq_f32(dot, vdupq_n_f32(p[3]));
+        dot = vsubq_f32(dot, sv.val[3]);
+        visible = vandq_u32(visible, vreinterpretq_u32_f32(dot));
+    }
+    return vshrq_n_u32(visible, 31);
+}
+
+static inline uint8x8_t narrow(uint32x4_t lo, uint32x4_t hi) noexcept {
+    return vmovn_u16(vcombine_u16(vmovn_u32(lo), vmovn_u32(hi)));
+}
+
+static void boxesNeon(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes, size_t frustumCount,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    float p[Culler::MAX_FRUSTUM_COUNT * 6 * 7];
+    prepareBoxPlanes(p, planes, frustumCount);
+    for (size_t i = 0; i < count; i += 8) {
+        float const* c = &center[i].x;
+        float const* e = &extent[i].x;
+        uint8x8_t const mask = narrow(
+                boxes4Neon(p, frustumCount, bit, c, e),
+                boxes4Neon(p, frustumCount, bit, c + 12, e + 12));
+        vst1_u8(results + i, vorr_u8(vld1_u8(results + i), mask));
+    }
+}
+
+static void spheresNeon(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT spheres,
+        size_t count) noexcept {
+    float const* const p = &planes[0].x;
+    for (size_t i = 0; i < count; i += 8) {
+        float const* s = &spheres[i].x;
+        vst1_u8(results + i, narrow(spheres4Neon(p, s), spheres4Neon(p, s + 16)));
+    }
+}
+
+#endif // FILAMENT_CULLER_HAS_NEON
+
+// ------------------------------------------------------------------------------------------------
+// Dispatch
+// ------------------------------------------------------------------------------------------------
+
+struct Kernels {
+    Culler::Isa isa;
+    BoxKernel boxes;
+    SphereKernel spheres;
+};
+
+static bool getKernels(Culler::Isa isa, Kernels& kernels) noexcept {
+    using Isa = Culler::Isa;
+    switch (isa) {
+        case Isa::SCALAR:
+            kernels = { isa, boxesScalar, spheresScalar };
+            return true;
+#if FILAMENT_CULLER_HAS_SSE2
+        case Isa::SSE2:
+            kernels = { isa, boxesSse2, spheresSse2 };
+            return true;
+#endif
+#if FILAMENT_CULLER_HAS_AVX
+        case Isa::AVX2:
+            if (utils::hasCpuFeature(utils::CpuFeature::AVX2)) {
+                kernels = { isa, boxesAvx2, spheresAvx2 };
+                return true;
+            }
+            return false;
+        case Isa::AVX512:
+            if (utils::hasCpuFeature(utils::CpuFeature::AVX2) &&
+                    utils::hasCpuFeature(utils::CpuFeature::AVX512F)) {
+                kernels = { isa, boxesAvx512, spheresAvx512 };
+                return true;
+            }
+            return false;
+#endif
+#if FILAMENT_CULLER_HAS_NEON
+        case Isa::NEON:
+            kernels = { isa, boxesNeon, spheresNeon };
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+static Kernels& kernels() noexcept {
+    static Kernels sKernels = []() {
+        using Isa = Culler::Isa;
+        Kernels kernels{};
+        for (Isa isa : { Isa::AVX512, Isa::AVX2, Isa::SSE2, Isa::NEON, Isa::SCALAR }) {
+            if (getKernels(isa, kernels)) {
+                break;
+            }
+        }
+        return kernels;
+    }();
+    return sKernels;
+}
+
+void Culler::intersects(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+    count = round(count); // capacity guaranteed to be multiple of 8
+    kernels().spheres(results, frustum.mPlanes, b, count);
+}
+
+void Culler::intersects(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    count = round(count); // capacity guaranteed to be multiple of 8
+    kernels().boxes(results, frustum.mPlanes, 1, center, extent, count, bit);
+}
+
+void Culler::intersects(
+        result_type* UTILS_RESTRICT results,
+        Frustum const* UTILS_RESTRICT frustums, size_t frustumCount,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    assert(frustumCount <= MAX_FRUSTUM_COUNT && bit + frustumCount <= MAX_FRUSTUM_COUNT);
+    float4 planes[MAX_FRUSTUM_COUNT * 6];
+    for (size_t f = 0; f < frustumCount; f++) {
+        std::copy_n(frustums[f].mPlanes, 6, planes + f * 6);
     }
+    count = round(count); // capacity guaranteed to be multiple of 8
+    kernels().boxes(results, planes, frustumCount, center, extent, count, bit);
 }
 
 /*
@@ -135,5 +725,24 @@ void Culler::Test::intersects(
     Culler::intersects(results, frustum, b, count);
 }
 
+bool Culler::Test::setIsa(Isa isa) noexcept {
+    return getKernels(isa, kernels());
+}
+
+Culler::Isa Culler::Test::getIsa() noexcept {
+    return kernels().isa;
+}
+
+const char* Culler::Test::getIsaName(Isa isa) noexcept {
+    switch (isa) {
+        case Isa::SCALAR:   return "scalar";
+        case Isa::SSE2:     return "SSE2";
+        case Isa::AVX2:     return "AVX2";
+        case Isa::AVX512:   return "AVX-512";
+        case Isa::NEON:     return "NEON";
+    }
+    return "unknown";
+}
+
 } // namespace details
 } // namespace filament
@@ -46,6 +46,7 @@
 #include <utils/Panic.h>
 #include <utils/Systrace.h>
 
+#include <algorithm>
 #include <memory>
 
 #include "generated/resources/materials.h"
@@ -363,6 +364,45 @@ void FEngine::prepare() {
     for (auto& material : mMaterials) {
         material->getDefaultInstance()->commit(driver);
     }
+
+    if (UTILS_UNLIKELY(!mPrefilteringTextures.empty())) {
+        uploadPrefilteredTextures();
+    }
+}
+
+void FEngine::addPrefilteringTexture(FTexture* texture) {
+    mPrefilteringTextures.push_back(texture);
+}
+
+void FEngine::removePrefilteringTexture(FTexture* texture) noexcept {
+    auto& textures = mPrefilteringTextures;
+    textures.erase(std::remove(textures.begin(), textures.end(), texture), textures.end());
+}
+
+void FEngine::uploadPrefilteredTextures() {
+    struct Completed {
+        FTexture* texture;
+        FTexture::PrefilterCompletion completion;
+    };
+    std::vector<Completed> completed;
+
+    auto& textures = mPrefilteringTextures;
+    textures.erase(std::remove_if(textures.begin(), textures.end(),
+            [this, &completed](FTexture* texture) {
+                FTexture::PrefilterCompletion completion{};
+                if (texture->uploadPrefilteredLevels(*this, &completion)) {
+                    completed.push_back({ texture, completion });
+                    return true;
+                }
+                return false;
+            }), textures.end());
+
+    // callbacks are called last, they're allowed to use the engine
+    for (Completed const& item : completed) {
+        if (item.completion.callback) {
+            item.completion.callback(item.texture, item.completion.user);
+        }
+    }
 }
 
 void FEngine::gc() {
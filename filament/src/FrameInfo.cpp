@@ -21,10 +21,14 @@
 #include <utils/JobSystem.h>
 #include <utils/Log.h>
 #include <utils/Systrace.h>
+#include <utils/ThreadLocal.h>
 
 #include <math/scalar.h>
 
+#include <algorithm>
 #include <cmath>
+#include <iterator>
+#include <memory>
 
 namespace filament {
 using namespace utils;
@@ -55,6 +59,78 @@ void FrameInfo::lap(FrameInfoManager* mgr, lap_id id) {
     });
 }
 
+// Opened on first use for each thread, the counters are closed when the thread exits.
+static UTILS_DEFINE_TLS(std::unique_ptr<Profiler>) sThreadProfiler;
+
+Profiler::Counters FrameInfo::readThreadCounters() noexcept {
+    std::unique_ptr<Profiler>& profiler = sThreadProfiler;
+    if (UTILS_UNLIKELY(!profiler)) {
+        profiler.reset(new Profiler(Profiler::EV_CPU_CYCLES |
+                Profiler::EV_L1D_RATES | Profiler::EV_BPU_RATES));
+        profiler->start();
+    }
+    return profiler->readCounters();
+}
+
+void FrameInfo::addCpuCounters(Stage stage, Profiler::Counters const& counters) noexcept {
+    Renderer::CpuCounters& c = cpuCounters[size_t(stage)];
+    c.instructions       += counters.getInstructions();
+    c.cycles             += counters.getCpuCycles();
+    c.l1dReferences      += counters.getL1DReferences();
+    c.l1dMisses          += counters.getL1DMisses();
+    c.branchInstructions += counters.getBranchInstructions();
+    c.branchMisses       += counters.getBranchMisses();
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// innermost active scope of each thread
+static UTILS_DEFINE_TLS(FrameStageScope*) sCurrentScope(nullptr);
+
+FrameStageScope::FrameStageScope(FrameInfo* info, FrameInfo::Stage stage) noexcept
+        : mInfo(info), mStage(stage) {
+    if (UTILS_LIKELY(info)) {
+        mBegin = sample();
+        // pause the enclosing scope
+        mParent = sCurrentScope;
+        if (mParent) {
+            mParent->add(mBegin);
+        }
+        sCurrentScope = this;
+    }
+}
+
+void FrameStageScope::stop() noexcept {
+    if (UTILS_LIKELY(mInfo)) {
+        assert(sCurrentScope == this);
+        const Sample end = sample();
+        add(end);
+        // resume the enclosing scope
+        if (mParent) {
+            mParent->mBegin = end;
+        }
+        sCurrentScope = mParent;
+        mInfo = nullptr;
+    }
+}
+
+FrameStageScope::Sample FrameStageScope::sample() const noexcept {
+    Sample s{ FrameInfo::clock::now(), {} };
+    if (UTILS_UNLIKELY(mInfo->sampleCpuCounters)) {
+        s.counters = FrameInfo::readThreadCounters();
+    }
+    return s;
+}
+
+void FrameStageScope::add(Sample const& end) noexcept {
+    mInfo->addStageTime(mStage, end.time - mBegin.time);
+    if (UTILS_UNLIKELY(mInfo->sampleCpuCounters)) {
+        mInfo->addCpuCounters(mStage, end.counters - mBegin.counters);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
 void FrameInfo::endFrame(FrameInfoManager* mgr) {
     Fence* fence = mgr->getEngine().createFence(FFence::Type::HARD);
     mgr->push([this, mgr, fence]() {
@@ -78,6 +154,23 @@ void FrameInfoManager::beginFrame(uint32_t frameId) {
     mCurrentFrameInfo = info;
     if (info) {
         info->frame = frameId;
+        info->frameBegin = clock::now();
+        std::fill(std::begin(info->stageTimes), std::end(info->stageTimes), 0);
+        info->sampleCpuCounters = mCpuCountersInterval && (frameId % mCpuCountersInterval) == 0;
+        if (UTILS_UNLIKELY(info->sampleCpuCounters)) {
+            std::fill(std::begin(info->cpuCounters), std::end(info->cpuCounters),
+                    Renderer::CpuCounters{});
+        }
+        // This must be queued before the fence created by FrameInfo::beginFrame(), so that
+        // it executes before the frame is canceled, or finished.
+        backend::CommandBufferQueue const& queue = mEngine.getCommandBufferQueue();
+        mEngine.getDriverApi().queueCommand([info, &queue]() {
+            info->driverBegin = clock::now();
+            info->driverWaitBegin = queue.getCommandsWaitTime();
+            if (UTILS_UNLIKELY(info->sampleCpuCounters)) {
+                info->driverCountersBegin = FrameInfo::readThreadCounters();
+            }
+        });
         info->beginFrame(this);
     }
 }
@@ -86,6 +179,24 @@ void FrameInfoManager::endFrame() {
     FrameInfo* const info = mCurrentFrameInfo;
     if (info) {
         mCurrentFrameInfo = nullptr;
+
+        backend::CommandBufferQueue const& queue = mEngine.getCommandBufferQueue();
+        const uint64_t flushWaitTime = queue.getFlushWaitTime();
+        info->stageTimes[size_t(FrameInfo::Stage::FLUSH_WAIT)] = flushWaitTime - mFlushWaitTime;
+        mFlushWaitTime = flushWaitTime;
+        info->frameTime = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                clock::now() - info->frameBegin).count());
+
+        // the backend thread's time, not counting the time it waits for the main thread
+        mEngine.getDriverApi().queueCommand([info, &queue]() {
+            const uint64_t waitTime = queue.getCommandsWaitTime() - info->driverWaitBegin;
+            info->addStageTime(FrameInfo::Stage::DRIVER,
+                    clock::now() - info->driverBegin - std::chrono::nanoseconds(waitTime));
+            if (UTILS_UNLIKELY(info->sampleCpuCounters)) {
+                info->addCpuCounters(FrameInfo::Stage::DRIVER,
+                        FrameInfo::readThreadCounters() - info->driverCountersBegin);
+            }
+        });
         info->endFrame(this);
     }
 }
@@ -118,12 +229,48 @@ void FrameInfoManager::finish(FrameInfo* info) noexcept {
     }
     // add a copy of the new element to the history
     history.push_back(*info);
+    if (info->sampleCpuCounters) {
+        auto& cpuCountersHistory = mCpuCountersHistory;
+        if (cpuCountersHistory.size() >= HISTORY_COUNT) {
+            cpuCountersHistory.pop_front();
+        }
+        Renderer::FrameCpuCounters counters;
+        counters.frameId = info->frame;
+        std::copy(std::begin(info->cpuCounters), std::end(info->cpuCounters), counters.stages);
+        cpuCountersHistory.push_back(counters);
+    }
+    Renderer::FrameTimings& timings = mFrameTimingsHistory[mFrameTimingsHead];
+    timings.frameId = info->frame;
+    timings.frameTime = info->frameTime;
+    std::copy(std::begin(info->stageTimes), std::end(info->stageTimes), timings.stages);
+    mFrameTimingsHead = (mFrameTimingsHead + 1) % mFrameTimingsHistory.size();
+    mFrameTimingsCount = std::min(mFrameTimingsCount + 1, mFrameTimingsHistory.size());
     lock.unlock();
 
     // return the item to the pool without the lock held
     mPoolArena.free(info);
 }
 
+size_t FrameInfoManager::getFrameCpuCounters(
+        Renderer::FrameCpuCounters* out, size_t count) const noexcept {
+    std::unique_lock<std::mutex> lock(mLock);
+    auto const& history = mCpuCountersHistory;
+    count = std::min(count, history.size());
+    std::copy_n(history.rbegin(), count, out);
+    return count;
+}
+
+size_t FrameInfoManager::getFrameTimings(
+        Renderer::FrameTimings* out, size_t count) const noexcept {
+    std::unique_lock<std::mutex> lock(mLock);
+    auto const& history = mFrameTimingsHistory;
+    count = std::min(count, mFrameTimingsCount);
+    for (size_t i = 0; i < count; i++) {
+        out[i] = history[(mFrameTimingsHead + history.size() - 1 - i) % history.size()];
+    }
+    return count;
+}
+
 // ------------------------------------------------------------------------------------------------
 
 FrameInfoManager::SyncThread::~SyncThread() {
@@ -20,9 +20,12 @@
 #include "details/Engine.h"
 
 #include <filament/Fence.h>
+#include <filament/Renderer.h>
 
 #include <utils/Allocator.h>
+#include <utils/Profiler.h>
 
+#include <array>
 #include <deque>
 #include <chrono>
 #include <condition_variable>
@@ -60,14 +63,71 @@ public:
         LAP_5,
     };
 
+    using Stage = Renderer::FrameStage;
+
     void beginFrame(FrameInfoManager* mgr);
     void lap(FrameInfoManager* mgr, lap_id id);
     void endFrame(FrameInfoManager* mgr);
 
+    // CPU hardware counters of the calling thread, counting since the thread's first call
+    static utils::Profiler::Counters readThreadCounters() noexcept;
+
+    void addCpuCounters(Stage stage, utils::Profiler::Counters const& counters) noexcept;
+
+    void addStageTime(Stage stage, clock::duration d) noexcept {
+        stageTimes[size_t(stage)] += uint64_t(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    }
+
     static constexpr size_t MAX_LAPS_IDS = 8;
 
     uint32_t frame = 0;
     time_point laps[MAX_LAPS_IDS] = { time_point::max() };
+
+    // wall-clock times, recorded for every frame
+    time_point frameBegin;
+    uint64_t frameTime;
+    uint64_t stageTimes[Renderer::FRAME_STAGE_COUNT];
+    time_point driverBegin;
+    uint64_t driverWaitBegin;
+
+    // CPU hardware counters, only valid if sampleCpuCounters is set
+    bool sampleCpuCounters = false;
+    Renderer::CpuCounters cpuCounters[Renderer::FRAME_STAGE_COUNT];
+    utils::Profiler::Counters driverCountersBegin;
+};
+
+// Adds the time spent by the calling thread during the lifetime of this object, and its CPU
+// hardware counters if the frame is sampled, to a stage of a frame. Scopes can nest on a given
+// thread, the enclosing scope is paused while a nested scope is active, so that stages never
+// overlap. Does nothing if the frame is null.
+class FrameStageScope {
+public:
+    FrameStageScope(FrameInfo* info, FrameInfo::Stage stage) noexcept;
+
+    ~FrameStageScope() noexcept {
+        stop();
+    }
+
+    // ends the scope early, nested scopes must have ended
+    void stop() noexcept;
+
+    FrameStageScope(FrameStageScope const&) = delete;
+    FrameStageScope& operator=(FrameStageScope const&) = delete;
+
+private:
+    struct Sample {
+        FrameInfo::time_point time;
+        utils::Profiler::Counters counters;
+    };
+
+    Sample sample() const noexcept;
+    void add(Sample const& end) noexcept;
+
+    FrameInfo* mInfo;
+    FrameInfo::Stage const mStage;
+    FrameStageScope* mParent = nullptr;
+    Sample mBegin;
 };
 
 class FrameInfoManager {
@@ -128,6 +188,19 @@ public:
         return mFrameInfoHistory;
     }
 
+    void setCpuCountersSamplingInterval(uint32_t interval) noexcept {
+        mCpuCountersInterval = interval;
+    }
+
+    // the current frame, null outside of beginFrame() / endFrame()
+    FrameInfo* getCurrentFrameInfo() const noexcept {
+        return mCurrentFrameInfo;
+    }
+
+    size_t getFrameCpuCounters(Renderer::FrameCpuCounters* out, size_t count) const noexcept;
+
+    size_t getFrameTimings(Renderer::FrameTimings* out, size_t count) const noexcept;
+
     // no user serviceable part below...
 
     template<typename CALLABLE, typename ... ARGS>
@@ -175,8 +248,19 @@ private:
     SyncThread mSyncThread;
     FrameInfo* mCurrentFrameInfo = nullptr;
 
+    uint32_t mCpuCountersInterval = 0;
+
+    // time the main thread spent blocked in flush(), as of the end of the last frame
+    uint64_t mFlushWaitTime = 0;
+
     mutable std::mutex mLock;
     std::vector<FrameInfo> mFrameInfoHistory;
+    // sampled frames only, oldest first
+    std::deque<Renderer::FrameCpuCounters> mCpuCountersHistory;
+    // all frames, a ring buffer whose next entry is mFrameTimingsHead
+    std::array<Renderer::FrameTimings, Renderer::FRAME_TIMINGS_HISTORY_SIZE> mFrameTimingsHistory;
+    size_t mFrameTimingsHead = 0;
+    size_t mFrameTimingsCount = 0;
 };
 
 
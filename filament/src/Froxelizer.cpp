@@ -133,6 +133,13 @@ void Froxelizer::setOptions(float zLightNear, float zLightFar) noexcept {
     }
 }
 
+void Froxelizer::setMaxFroxelCount(size_t count) noexcept {
+    count = std::min(count, FROXEL_BUFFER_ENTRY_COUNT_MAX);
+    if (UTILS_UNLIKELY(mMaxFroxelCount != count)) {
+        mMaxFroxelCount = uint16_t(count);
+        mDirtyFlags |= VIEWPORT_CHANGED;
+    }
+}
 
 void Froxelizer::setViewport(filament::Viewport const& viewport) noexcept {
     if (UTILS_UNLIKELY(mViewport != viewport)) {
@@ -203,18 +210,20 @@ bool Froxelizer::prepare(
 
 void Froxelizer::computeFroxelLayout(
         uint2* dim, uint16_t* countX, uint16_t* countY, uint16_t* countZ,
-        filament::Viewport const& viewport) noexcept {
+        filament::Viewport const& viewport, size_t maxFroxelCount) noexcept {
 
     if (SUPPORTS_NON_SQUARE_FROXELS == false) {
-        // calculate froxel dimension from FROXEL_BUFFER_ENTRY_COUNT_MAX and viewport
+        // calculate froxel dimension from maxFroxelCount and viewport
         // - Start from the maximum number of froxels we can use in the x-y plane
         size_t froxelSliceCount = FEngine::CONFIG_FROXEL_SLICE_COUNT;
-        size_t froxelPlaneCount = FROXEL_BUFFER_ENTRY_COUNT_MAX / froxelSliceCount;
+        size_t froxelPlaneCount = std::max(size_t(1), maxFroxelCount / froxelSliceCount);
         // - compute the number of square froxels we need in width and height, rounded down
         //   solving: |  froxelCountX * froxelCountY == froxelPlaneCount
         //            |  froxelCountX / froxelCountY == width / height
-        size_t froxelCountX = size_t(std::sqrt(froxelPlaneCount * viewport.width  / viewport.height));
-        size_t froxelCountY = size_t(std::sqrt(froxelPlaneCount * viewport.height / viewport.width));
+        size_t froxelCountX = std::max(size_t(1),
+                size_t(std::sqrt(froxelPlaneCount * viewport.width  / viewport.height)));
+        size_t froxelCountY = std::max(size_t(1),
+                size_t(std::sqrt(froxelPlaneCount * viewport.height / viewport.width)));
         // - copmute the froxels dimensions, rounded up
         size_t froxelSizeX = (viewport.width  + froxelCountX - 1) / froxelCountX;
         size_t froxelSizeY = (viewport.height + froxelCountY - 1) / froxelCountY;
@@ -251,7 +260,8 @@ bool Froxelizer::update() noexcept {
 
         uint2 froxelDimension;
         uint16_t froxelCountX, froxelCountY, froxelCountZ;
-        computeFroxelLayout(&froxelDimension, &froxelCountX, &froxelCountY, &froxelCountZ, viewport);
+        computeFroxelLayout(&froxelDimension, &froxelCountX, &froxelCountY, &froxelCountZ,
+                viewport, mMaxFroxelCount);
 
         mFroxelDimension = froxelDimension;
         mClipToFroxelX = (0.5f * viewport.width)  / froxelDimension.x;
@@ -266,7 +276,7 @@ bool Froxelizer::update() noexcept {
                << froxelDimension.x << "x" << froxelDimension.y << io::endl
                << "Froxel: " << froxelCountX << "x" << froxelCountY << "x" << froxelSliceCount
                << " = " << (froxelCountX * froxelCountY * froxelSliceCount)
-               << " (" << FROXEL_BUFFER_ENTRY_COUNT_MAX - froxelCountX * froxelCountY * froxelSliceCount << " lost)"
+               << " (" << mMaxFroxelCount - froxelCountX * froxelCountY * froxelSliceCount << " lost)"
                << io::endl;
 #endif
 
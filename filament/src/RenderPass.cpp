@@ -49,10 +49,16 @@ RenderPass::RenderPass(FEngine& engine,
 }
 
 void RenderPass::setGeometry(FScene::RenderableSoa const& soa, Range<uint32_t> vr,
-        backend::Handle<backend::HwUniformBuffer> uboHandle) noexcept {
+        backend::Handle<backend::HwUniformBuffer> uboHandle,
+        backend::Handle<backend::HwUniformBuffer> bonesHandle) noexcept {
     mRenderableSoa = &soa;
     mVisibleRenderables = vr;
     mUboHandle = uboHandle;
+    mBonesHandle = bonesHandle;
+}
+
+void RenderPass::setIndexRanges(Slice<const FRenderPrimitive::IndexRange> ranges) noexcept {
+    mIndexRanges = ranges;
 }
 
 void RenderPass::setCamera(const CameraInfo& camera) noexcept {
@@ -199,9 +205,11 @@ void RenderPass::recordDriverCommands(FEngine::DriverApi& driver, const Command*
                 mPolygonOffsetOverride ? &dummyPolyOffset : &pipeline.polygonOffset;
 
         Handle<HwUniformBuffer> uboHandle = mUboHandle;
+        Handle<HwUniformBuffer> bonesHandle = mBonesHandle;
         FMaterialInstance const* UTILS_RESTRICT mi = nullptr;
         FMaterial const* UTILS_RESTRICT ma = nullptr;
         auto const& customCommands = mCustomCommands;
+        auto const& indexRanges = mIndexRanges;
 
         auto updateMaterial = [&](FMaterialInstance const* materialInstance) {
             mi = materialInstance;
@@ -240,9 +248,20 @@ void RenderPass::recordDriverCommands(FEngine::DriverApi& driver, const Command*
             size_t offset = info.index * sizeof(PerRenderableUib);
             driver.bindUniformBufferRange(BindingPoints::PER_RENDERABLE,
                     uboHandle, offset, sizeof(PerRenderableUib));
-            if (UTILS_UNLIKELY(info.perRenderableBones)) {
-                driver.bindUniformBuffer(BindingPoints::PER_RENDERABLE_BONES,
-                        info.perRenderableBones);
+            if (UTILS_UNLIKELY(info.hasIndexRange)) {
+                // Culled clusters draw a part of the primitive, whose range is restored right
+                // away since other draws of the same primitive expect all of it.
+                FRenderPrimitive::IndexRange const& r = indexRanges[info.indexRange];
+                driver.setRenderPrimitiveRange(info.primitiveHandle, r.type,
+                        r.offset, 0, 0, r.count);
+                driver.draw(pipeline, info.primitiveHandle);
+                driver.setRenderPrimitiveRange(info.primitiveHandle, r.type,
+                        r.primitiveOffset, 0, 0, r.primitiveCount);
+                continue;
+            }
+            if (UTILS_UNLIKELY(info.bonesOffset != FScene::NO_BONES)) {
+                driver.bindUniformBufferRange(BindingPoints::PER_RENDERABLE_BONES, bonesHandle,
+                        info.bonesOffset, CONFIG_MAX_BONE_COUNT * sizeof(PerRenderableUibBone));
             }
             driver.draw(pipeline, info.primitiveHandle);
         }
@@ -369,7 +388,7 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
     auto const* const UTILS_RESTRICT soaReversedWinding = soa.data<FScene::REVERSED_WINDING_ORDER>();
     auto const* const UTILS_RESTRICT soaVisibility      = soa.data<FScene::VISIBILITY_STATE>();
     auto const* const UTILS_RESTRICT soaPrimitives      = soa.data<FScene::PRIMITIVES>();
-    auto const* const UTILS_RESTRICT soaBonesUbh        = soa.data<FScene::BONES_UBH>();
+    auto const* const UTILS_RESTRICT soaBonesOffset     = soa.data<FScene::BONES_OFFSET>();
 
     const bool hasShadowing = renderFlags & HAS_SHADOWING;
     const bool viewInverseFrontFaces = renderFlags & HAS_INVERSE_FRONT_FACES;
@@ -425,7 +444,7 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
 
         cmdColor.key = makeField(soaVisibility[i].priority, PRIORITY_MASK, PRIORITY_SHIFT);
         cmdColor.primitive.index = (uint16_t)i;
-        cmdColor.primitive.perRenderableBones = soaBonesUbh[i];
+        const uint32_t bonesOffset = soaBonesOffset[i];
         materialVariant.setShadowReceiver(soaVisibility[i].receiveShadows & hasShadowing);
         materialVariant.setSkinning(soaVisibility[i].skinning || soaVisibility[i].morphing);
 
@@ -436,7 +455,6 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
         cmdDepth.key |= makeField(soaVisibility[i].priority, PRIORITY_MASK, PRIORITY_SHIFT);
         cmdDepth.key |= makeField(distanceBits, DISTANCE_BITS_MASK, DISTANCE_BITS_SHIFT);
         cmdDepth.primitive.index = (uint16_t)i;
-        cmdDepth.primitive.perRenderableBones = soaBonesUbh[i];
         cmdDepth.primitive.materialVariant.setSkinning(soaVisibility[i].skinning || soaVisibility[i].morphing);
         cmdDepth.primitive.rasterState.inverseFrontFaces = inverseFrontFaces;
 
@@ -451,8 +469,12 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
          */
         for (auto const& primitive : primitives) {
             FMaterialInstance const* const mi = primitive.getMaterialInstance();
+            const uint32_t indexRange = primitive.getIndexRange();
+            const bool hasIndexRange = indexRange != FRenderPrimitive::NO_INDEX_RANGE;
             if (colorPass) {
                 cmdColor.primitive.primitiveHandle = primitive.getHwHandle();
+                cmdColor.primitive.hasIndexRange = hasIndexRange;
+                cmdColor.primitive.bonesOffset = hasIndexRange ? indexRange : bonesOffset;
                 cmdColor.primitive.materialVariant = materialVariant;
                 RenderPass::setupColorCommand(cmdColor, depthPass, mi, inverseFrontFaces);
 
@@ -539,6 +561,8 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
 
                 // unconditionally write the command
                 cmdDepth.primitive.primitiveHandle = primitive.getHwHandle();
+                cmdDepth.primitive.hasIndexRange = hasIndexRange;
+                cmdDepth.primitive.bonesOffset = hasIndexRange ? indexRange : bonesOffset;
                 cmdDepth.primitive.mi = mi;
                 cmdDepth.primitive.rasterState.culling = mi->getCullingMode();
                 *curr = cmdDepth;
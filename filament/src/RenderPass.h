@@ -21,6 +21,7 @@
 
 #include "details/Camera.h"
 #include "details/Material.h"
+#include "details/RenderPrimitive.h"
 #include "details/Scene.h"
 
 #include "private/backend/DriverApiForward.h"
@@ -219,11 +220,15 @@ public:
     struct PrimitiveInfo { // 24 bytes
         FMaterialInstance const* mi = nullptr;                          // 8 bytes (4)
         backend::Handle<backend::HwRenderPrimitive> primitiveHandle;    // 4 bytes
-        backend::Handle<backend::HwUniformBuffer> perRenderableBones;   // 4 bytes
+        union {
+            // culled clusters are never skinned, so their draws don't need bonesOffset
+            uint32_t bonesOffset = FScene::NO_BONES;    // if !hasIndexRange
+            uint32_t indexRange;                        // if hasIndexRange, see setIndexRanges()
+        };                                                              // 4 bytes
         backend::RasterState rasterState;                               // 4 bytes
         uint16_t index = 0;                                             // 2 bytes
         Variant materialVariant;                                        // 1 byte
-        uint8_t reserved = {};                                          // 1 byte
+        bool hasIndexRange = false;                                     // 1 byte
     };
 
     struct alignas(8) Command {     // 32 bytes
@@ -238,6 +243,7 @@ public:
     };
     static_assert(std::is_trivially_destructible<Command>::value,
             "Command isn't trivially destructible");
+    static_assert(sizeof(Command) == 32, "Command doesn't fit in half a cache-line");
 
     using RenderFlags = uint8_t;
     static constexpr RenderFlags HAS_SHADOWING           = 0x01;
@@ -250,7 +256,10 @@ public:
     void overridePolygonOffset(backend::PolygonOffset* polygonOffset) noexcept;
     void overrideMaterial(FMaterial const* material, FMaterialInstance const* mi) noexcept;
     void setGeometry(FScene::RenderableSoa const& soa, utils::Range<uint32_t> vr,
-            backend::Handle<backend::HwUniformBuffer> uboHandle) noexcept;
+            backend::Handle<backend::HwUniformBuffer> uboHandle,
+            backend::Handle<backend::HwUniformBuffer> bonesHandle) noexcept;
+    // the ranges drawn by the primitives that were split by FView::cullClusters()
+    void setIndexRanges(utils::Slice<const FRenderPrimitive::IndexRange> ranges) noexcept;
     void setCamera(const CameraInfo& camera) noexcept;
     void setRenderFlags(RenderFlags flags) noexcept;
 
@@ -324,6 +333,9 @@ private:
     utils::Range<uint32_t> mVisibleRenderables{};
     // the UBO containing the data for the renderables
     backend::Handle<backend::HwUniformBuffer> mUboHandle;
+    backend::Handle<backend::HwUniformBuffer> mBonesHandle;
+    // the index ranges of the culled clusters, indexed by PrimitiveInfo::indexRange
+    utils::Slice<const FRenderPrimitive::IndexRange> mIndexRanges;
 
     // info about the camera
     CameraInfo mCamera;
@@ -21,6 +21,8 @@
 #include "details/IndexBuffer.h"
 #include "details/Material.h"
 
+#include <algorithm>
+
 namespace filament {
 namespace details {
 
@@ -49,12 +51,28 @@ void FRenderPrimitive::init(backend::DriverApi& driver,
 
         mPrimitiveType = entry.type;
         mEnabledAttributes = enabledAttributes;
+
+        if (entry.clusterCount) {
+            Cluster* clusters = new Cluster[entry.clusterCount];
+            std::copy_n(entry.clusters, entry.clusterCount, clusters);
+            mClusters = { clusters, uint32_t(entry.clusterCount) };
+            mIndexOffset = uint32_t(entry.offset);
+            mIndexCount = uint32_t(entry.count);
+        }
     }
 }
 
 void FRenderPrimitive::terminate(FEngine& engine) {
     FEngine::DriverApi& driver = engine.getDriverApi();
     driver.destroyRenderPrimitive(mHandle);
+    clearClusters();
+}
+
+void FRenderPrimitive::clearClusters() noexcept {
+    delete[] mClusters.data();
+    mClusters = {};
+    mIndexOffset = 0;
+    mIndexCount = 0;
 }
 
 void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType type,
@@ -72,6 +90,9 @@ void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType typ
 
     mPrimitiveType = type;
     mEnabledAttributes = enabledAttributes;
+
+    // the clusters described the previous geometry
+    clearClusters();
 }
 
 void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType type, size_t offset,
@@ -80,6 +101,7 @@ void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType typ
     driver.setRenderPrimitiveRange(mHandle, type,
             (uint32_t)offset, (uint32_t)minIndex, (uint32_t)maxIndex, (uint32_t)count);
     mPrimitiveType = type;
+    clearClusters();
 }
 
 } // namespace details
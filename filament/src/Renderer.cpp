@@ -197,6 +197,11 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     bool fxaa = view.getAntiAliasing() == View::AntiAliasing::FXAA;
     uint8_t msaa = view.getSampleCount();
     float2 scale = view.updateScale(mFrameInfoManager.getLastFrameTime());
+
+    Renderer::FrameTimings timings;
+    if (mFrameInfoManager.getFrameTimings(&timings, 1)) {
+        view.updateCpuBudget(timings, mFrameId);
+    }
     if (!hasPostProcess) {
         // dynamic scaling and FXAA are part of the post-process phase and can't happen if
         // it's disabled.
@@ -212,11 +217,17 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
         return;
     }
 
-    view.prepare(engine, driver, arena, svp, getShaderUserTime());
+    // receives the timings of the frame's stages, null without threading
+    FrameInfo* const frameInfo = mFrameInfoManager.getCurrentFrameInfo();
+
+    view.prepare(engine, driver, arena, svp, getShaderUserTime(), frameInfo);
 
     // start froxelization immediately, it has no dependencies
     JobSystem::Job* jobFroxelize = js.runAndRetain(js.createJob(nullptr,
-            [&engine, &view](JobSystem&, JobSystem::Job*) { view.froxelize(engine); }));
+            [&engine, &view, frameInfo](JobSystem&, JobSystem::Job*) {
+                FrameStageScope counters(frameInfo, FrameInfo::Stage::FROXELIZE);
+                view.froxelize(engine);
+            }));
 
     /*
      * Allocate command buffer.
@@ -244,7 +255,10 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
      */
 
     if (view.hasShadowing()) {
-        view.getShadowMap().render(driver, pass, view);
+        {
+            FrameStageScope counters(frameInfo, FrameInfo::Stage::SHADOWS);
+            view.getShadowMap().render(driver, pass, view);
+        }
         driver.flush(); // Kick the GPU since we're done with this render target
         engine.flush(); // Wake-up the driver thread
         commands.clear();
@@ -282,10 +296,13 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
 
     CameraInfo const& cameraInfo = view.getCameraInfo();
     pass.setCamera(cameraInfo);
-    pass.setGeometry(scene.getRenderableData(), view.getVisibleRenderables(), scene.getRenderableUBO());
+    pass.setGeometry(scene.getRenderableData(), view.getVisibleRenderables(),
+            scene.getRenderableUBO(), scene.getBonesUBO());
 
     view.updatePrimitivesLod(engine, cameraInfo,
             scene.getRenderableData(), view.getVisibleRenderables());
+    pass.setIndexRanges(view.cullClusters(engine, arena,
+            scene.getRenderableData(), view.getVisibleRenderables()));
     view.prepareCamera(cameraInfo, svp);
     view.commitUniforms(driver);
 
@@ -297,8 +314,14 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     // SSAO pass -- automatically culled if not used
     if (useSSAO) {
         auto curr = pass.getCommands().end();
-        pass.appendCommands(RenderPass::CommandTypeFlags::DEPTH);
-        pass.sortCommands(curr);
+        {
+            FrameStageScope counters(frameInfo, FrameInfo::Stage::COMMAND_GENERATION);
+            pass.appendCommands(RenderPass::CommandTypeFlags::DEPTH);
+        }
+        {
+            FrameStageScope counters(frameInfo, FrameInfo::Stage::COMMAND_SORT);
+            pass.sortCommands(curr);
+        }
     }
 
     FrameGraphId<FrameGraphTexture> ssao = ppm.ssao(fg, pass, svp, cameraInfo, view.getAmbientOcclusionOptions());
@@ -308,8 +331,15 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     // generate the normal commands
     RenderPass::CommandTypeFlags commandType = getCommandType(view.getDepthPrepass());
     Command* colorPassBegin = pass.getCommands().end();
-    pass.appendCommands(commandType);
-    Command const* colorPassEnd = pass.sortCommands(colorPassBegin);
+    {
+        FrameStageScope counters(frameInfo, FrameInfo::Stage::COMMAND_GENERATION);
+        pass.appendCommands(commandType);
+    }
+    Command const* colorPassEnd;
+    {
+        FrameStageScope counters(frameInfo, FrameInfo::Stage::COMMAND_SORT);
+        colorPassEnd = pass.sortCommands(colorPassBegin);
+    }
 
     // We only honor the view's color buffer clear flags, depth/stencil are handled by the framefraph
     uint8_t viewClearFlags = view.getClearFlags() & (uint8_t)TargetBufferFlags::ALL;
@@ -432,7 +462,10 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     fg.compile();
     //fg.export_graphviz(slog.d);
 
-    fg.execute(engine, driver);
+    {
+        FrameStageScope counters(frameInfo, FrameInfo::Stage::COMMAND_RECORDING);
+        fg.execute(engine, driver);
+    }
 
     commands.clear();
 
@@ -715,4 +748,16 @@ void Renderer::resetUserTime() {
     upcast(this)->resetUserTime();
 }
 
+void Renderer::setCpuCountersSamplingInterval(uint32_t interval) noexcept {
+    upcast(this)->setCpuCountersSamplingInterval(interval);
+}
+
+size_t Renderer::getFrameCpuCounters(FrameCpuCounters* out, size_t count) const noexcept {
+    return upcast(this)->getFrameCpuCounters(out, count);
+}
+
+size_t Renderer::getFrameTimings(FrameTimings* out, size_t count) const noexcept {
+    return upcast(this)->getFrameTimings(out, count);
+}
+
 } // namespace filament
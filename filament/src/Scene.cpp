@@ -28,6 +28,7 @@
 
 #include <utils/compiler.h>
 #include <utils/EntityManager.h>
+#include <utils/JobSystem.h>
 #include <utils/Range.h>
 #include <utils/Zip2Iterator.h>
 
@@ -118,13 +119,16 @@ void FScene::prepare(const mat4f& worldOriginTransform) {
             // compute the world AABB so we can perform culling
             const Box worldAABB = rigidTransform(rcm.getAABB(ri), worldTransform);
 
+            // the actual offset is assigned once we know which renderables are visible
+            const uint32_t bonesOffset = rcm.getBones(ri) ? 0 : NO_BONES;
+
             // we know there is enough space in the array
             sceneData.push_back_unsafe(
                     ri,                       // RENDERABLE_INSTANCE
                     worldTransform,           // WORLD_TRANSFORM
                     reversedWindingOrder,     // REVERSED_WINDING_ORDER
                     rcm.getVisibility(ri),    // VISIBILITY_STATE
-                    rcm.getBonesUbh(ri),      // BONES_UBH
+                    bonesOffset,              // BONES_OFFSET
                     worldAABB.center,         // WORLD_AABB_CENTER
                     0,                        // VISIBLE_MASK
                     rcm.getMorphWeights(ri),  // MORPH_WEIGHTS
@@ -149,7 +153,8 @@ void FScene::prepare(const mat4f& worldOriginTransform) {
                     lightData.elementAt<FScene::DIRECTION>(0)       = d;
                     lightData.elementAt<FScene::LIGHT_INSTANCE>(0)  = li;
                 }
-            } else {
+            } else if (lcm.isLightCaster(li) && lcm.getIntensity(li) > 0.0f) {
+                // lights that can't contribute are never visible, we don't even gather them
                 const float4 p = worldTransform * float4{ lcm.getLocalPosition(li), 1 };
                 float3 d = 0;
                 if (!lcm.isPointLight(li) || lcm.isIESLight(li)) {
@@ -157,21 +162,46 @@ void FScene::prepare(const mat4f& worldOriginTransform) {
                     // using mat3f::getTransformForNormals handles non-uniform scaling
                     d = normalize(mat3f::getTransformForNormals(worldTransform.upperLeft()) * d);
                 }
+                const float cosOuterSquared = lcm.isSpotLight(li) ?
+                        lcm.getCosOuterSquared(li) : NO_SPOT_CONE;
                 lightData.push_back_unsafe(
-                        float4{ p.xyz, lcm.getRadius(li) }, d, li, {}, {});
+                        float4{ p.xyz, lcm.getRadius(li) }, d, li, {}, {}, cosOuterSquared);
             }
         }
     }
 
     // some elements past the end of the array will be accessed by SIMD code, we need to make
     // sure the data is valid enough as not to produce errors such as divide-by-zero
-    // (e.g. in computeLightRanges())
-    for (size_t i = lightData.size(), e = (lightData.size() + 3u) & ~3u; i < e; i++) {
+    // (e.g. in computeLightRanges() or in the culling kernels)
+    for (size_t i = lightData.size(), e = Culler::round(lightData.size()); i < e; i++) {
         new(lightData.data<POSITION_RADIUS>() + i) float4{ 0, 0, 0, 1 };
     }
 }
 
-void FScene::updateUBOs(utils::Range<uint32_t> visibleRenderables, backend::Handle<backend::HwUniformBuffer> renderableUbh) noexcept {
+size_t FScene::computeBonesOffsets(utils::Range<uint32_t> visibleRenderables) noexcept {
+    FRenderableManager const& rcm = mEngine.getRenderableManager();
+    auto const* const UTILS_RESTRICT instances = mRenderableData.data<RENDERABLE_INSTANCE>();
+    uint32_t* const UTILS_RESTRICT offsets = mRenderableData.data<BONES_OFFSET>();
+
+    // Palettes start on a 256 bytes boundary, which is the largest uniform buffer offset
+    // alignment we can expect (i.e. 4 bones).
+    constexpr uint32_t BONES_PER_ALIGNMENT = 256u / sizeof(PerRenderableUibBone);
+    uint32_t offset = 0;
+    for (uint32_t i : visibleRenderables) {
+        if (UTILS_UNLIKELY(offsets[i] != NO_BONES)) {
+            offsets[i] = offset;
+            // renderables with morphing but no skinning still need a valid binding
+            const uint32_t count = std::max(rcm.getBoneCount(instances[i]), 1u);
+            offset += ((count + BONES_PER_ALIGNMENT - 1u) / BONES_PER_ALIGNMENT) *
+                    (BONES_PER_ALIGNMENT * sizeof(PerRenderableUibBone));
+        }
+    }
+    return offset;
+}
+
+void FScene::updateUBOs(utils::Range<uint32_t> visibleRenderables,
+        backend::Handle<backend::HwUniformBuffer> renderableUbh,
+        backend::Handle<backend::HwUniformBuffer> bonesUbh, size_t bonesSize) noexcept {
     FEngine::DriverApi& driver = mEngine.getDriverApi();
     const size_t size = visibleRenderables.size() * sizeof(PerRenderableUib);
 
@@ -220,21 +250,48 @@ void FScene::updateUBOs(utils::Range<uint32_t> visibleRenderables, backend::Hand
     // TODO: handle static objects separately
     mRenderableViewUbh = renderableUbh;
     driver.loadUniformBuffer(renderableUbh, { buffer, size });
+
+    // all bone palettes are copied into a single buffer with one upload, see computeBonesOffsets()
+    mBonesViewUbh = bonesUbh;
+    if (bonesSize) {
+        FRenderableManager const& rcm = mEngine.getRenderableManager();
+        auto const* const instances = sceneData.data<RENDERABLE_INSTANCE>();
+        uint32_t const* const offsets = sceneData.data<BONES_OFFSET>();
+        char* const bones = static_cast<char*>(driver.allocate(bonesSize));
+
+        auto work = [&rcm, instances, offsets, bones](uint32_t startIndex, uint32_t count) {
+            for (uint32_t i = startIndex, end = startIndex + count; i < end; i++) {
+                if (UTILS_UNLIKELY(offsets[i] != NO_BONES)) {
+                    UniformBuffer const* palette = rcm.getBones(instances[i]);
+                    memcpy(bones + offsets[i], palette->getBuffer(), palette->getSize());
+                }
+            }
+        };
+
+        JobSystem& js = mEngine.getJobSystem();
+        auto job = jobs::parallel_for(js, nullptr, visibleRenderables.first,
+                (uint32_t)visibleRenderables.size(), std::ref(work), jobs::CountSplitter<64>());
+        js.runAndWait(job);
+
+        driver.loadUniformBuffer(bonesUbh, { bones, bonesSize });
+    }
 }
 
 void FScene::terminate(FEngine& engine) {
-    // DO NOT destroy this UBO, it's owned by the View
+    // DO NOT destroy these UBOs, they're owned by the View
     mRenderableViewUbh.clear();
+    mBonesViewUbh.clear();
 }
 
-void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootArena, backend::Handle<backend::HwUniformBuffer> lightUbh) noexcept {
+void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootArena,
+        backend::Handle<backend::HwUniformBuffer> lightUbh, size_t maxLightCount) noexcept {
     FEngine::DriverApi& driver = mEngine.getDriverApi();
     FLightManager& lcm = mEngine.getLightManager();
     FScene::LightSoa& lightData = getLightData();
 
     /*
      * Here we copy our lights data into the GPU buffer, some lights might be left out if there
-     * are more than the GPU buffer allows (i.e. 256).
+     * are more than the GPU buffer allows (i.e. 256), or than maxLightCount.
      *
      * We always sort lights by distance to the camera plane so that:
      * - we can build light trees
@@ -246,7 +303,7 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootAren
     size_t const size = lightData.size();
 
     // always allocate at least 4 entries, because the vectorized loops below rely on that
-    float* const UTILS_RESTRICT distances = arena.allocate<float>((size + 3u) & 3u, CACHELINE_SIZE);
+    float* const UTILS_RESTRICT distances = arena.allocate<float>((size + 3u) & ~3u, CACHELINE_SIZE);
 
     // pre-compute the lights' distance to the camera plane, for sorting below
     // - we don't skip the directional light, because we don't care, it's ignored during sorting
@@ -259,10 +316,11 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootAren
             [](auto const& lhs, auto const& rhs) { return lhs.second < rhs.second; });
 
     // drop excess lights
-    lightData.resize(std::min(size, CONFIG_MAX_LIGHT_COUNT + DIRECTIONAL_LIGHTS_COUNT));
+    maxLightCount = std::min(maxLightCount, CONFIG_MAX_LIGHT_COUNT);
+    lightData.resize(std::min(size, maxLightCount + DIRECTIONAL_LIGHTS_COUNT));
 
     // number of point/spot lights
-    size_t positionalLightCount = size - DIRECTIONAL_LIGHTS_COUNT;
+    size_t positionalLightCount = lightData.size() - DIRECTIONAL_LIGHTS_COUNT;
 
     // compute the light ranges (needed when building light trees)
     float2* const zrange = lightData.data<FScene::SCREEN_SPACE_Z_RANGE>();
@@ -272,7 +330,7 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootAren
 
     auto const* UTILS_RESTRICT directions   = lightData.data<FScene::DIRECTION>();
     auto const* UTILS_RESTRICT instances    = lightData.data<FScene::LIGHT_INSTANCE>();
-    for (size_t i = DIRECTIONAL_LIGHTS_COUNT, c = size; i < c; ++i) {
+    for (size_t i = DIRECTIONAL_LIGHTS_COUNT, c = lightData.size(); i < c; ++i) {
         const size_t gpuIndex = i - DIRECTIONAL_LIGHTS_COUNT;
         auto li = instances[i];
         lp[gpuIndex].positionFalloff      = { spheres[i].xyz, lcm.getSquaredFalloffInv(li) };
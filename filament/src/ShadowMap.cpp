@@ -179,7 +179,8 @@ void ShadowMap::render(DriverApi& driver, RenderPass& pass, FView& view) noexcep
     pass.setCamera(cameraInfo);
 
     FView::Range visibleRenderables = view.getVisibleShadowCasters();
-    pass.setGeometry(scene.getRenderableData(), visibleRenderables, scene.getRenderableUBO());
+    pass.setGeometry(scene.getRenderableData(), visibleRenderables,
+            scene.getRenderableUBO(), scene.getBonesUBO());
 
     view.updatePrimitivesLod(engine, cameraInfo, scene.getRenderableData(), visibleRenderables);
     view.prepareCamera(cameraInfo, viewport);
@@ -207,7 +208,7 @@ void ShadowMap::terminate(DriverApi& driverApi) noexcept {
 
 void ShadowMap::update(
         const FScene::LightSoa& lightData, size_t index, FScene const* scene,
-        details::CameraInfo const& camera, uint8_t visibleLayers) noexcept {
+        details::CameraInfo const& camera, uint8_t visibleLayers, float distanceScale) noexcept {
     // this is the hard part here, find a good frustum for our camera
 
     auto& lcm = mEngine.getLightManager();
@@ -221,9 +222,11 @@ void ShadowMap::update(
             .constant = params.options.polygonOffsetConstant
     };
     mat4f projection(camera.cullingProjection);
-    if (params.options.shadowFar > 0.0f) {
+    const float shadowFar = (params.options.shadowFar > 0.0f ?
+            params.options.shadowFar : camera.zf) * distanceScale;
+    if (params.options.shadowFar > 0.0f || (distanceScale < 1.0f && shadowFar > camera.zn)) {
         float n = camera.zn;
-        float f = params.options.shadowFar;
+        float f = shadowFar;
         if (std::abs(projection[2].w) <= std::numeric_limits<float>::epsilon()) {
             // perspective projection
             projection[2].z =     (f + n) / (n - f);
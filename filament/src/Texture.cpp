@@ -28,8 +28,15 @@
 #include <ibl/CubemapUtils.h>
 #include <ibl/Image.h>
 
+#include <utils/JobSystem.h>
 #include <utils/Panic.h>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 using namespace utils;
 
 namespace filament {
@@ -120,7 +127,10 @@ FTexture::FTexture(FEngine& engine, const Builder& builder) {
 }
 
 // frees driver resources, object becomes invalid
+FTexture::~FTexture() noexcept = default;
+
 void FTexture::terminate(FEngine& engine) {
+    cancelPrefilterMipmap(engine);
     FEngine::DriverApi& driver = engine.getDriverApi();
     driver.destroyTexture(mHandle);
 }
@@ -267,22 +277,18 @@ auto make_copyable_function(F&& f) {
     };
 }
 
-void FTexture::generatePrefilterMipmap(FEngine& engine,
-        PixelBufferDescriptor&& buffer, const FaceOffsets& faceOffsets,
-        PrefilterOptions const* options) {
-    using namespace ibl;
+static bool validatePrefilterSource(FTexture const& texture,
+        Texture::PixelBufferDescriptor const& buffer) {
     using namespace backend;
-    using namespace math;
 
-    const size_t size = getWidth();
-    const size_t stride = buffer.stride ? buffer.stride : size;
+    const size_t size = texture.getWidth();
 
     /* validate input data */
 
     if (!ASSERT_PRECONDITION_NON_FATAL(buffer.format == PixelDataFormat::RGB ||
                                        buffer.format == PixelDataFormat::RGBA,
             "input data format must be RGB or RGBA")) {
-        return;
+        return false;
     }
 
     if (!ASSERT_PRECONDITION_NON_FATAL(
@@ -290,45 +296,32 @@ void FTexture::generatePrefilterMipmap(FEngine& engine,
             buffer.type == PixelDataType::HALF ||
             buffer.type == PixelDataType::UINT_10F_11F_11F_REV,
             "input data type must be FLOAT, HALF or UINT_10F_11F_11F_REV")) {
-        return;
+        return false;
     }
 
     /* validate texture */
 
     if (!ASSERT_PRECONDITION_NON_FATAL(!(size & (size-1)),
             "input data cubemap dimensions must be a power-of-two")) {
-        return;
+        return false;
     }
 
-    if (!ASSERT_PRECONDITION_NON_FATAL(!isCompressed(),
+    if (!ASSERT_PRECONDITION_NON_FATAL(!texture.isCompressed(),
             "reflections texture cannot be compressed")) {
-        return;
+        return false;
     }
 
+    return true;
+}
 
-    PrefilterOptions defaultOptions;
-    options = options ? options : &defaultOptions;
-
-    JobSystem& js = engine.getJobSystem();
-    FEngine::DriverApi& driver = engine.getDriverApi();
-
-    auto generateMipmaps = [](JobSystem& js,
-            std::vector<Cubemap>& levels, std::vector<Image>& images) {
-        Image temp;
-        const Cubemap& base(levels[0]);
-        size_t dim = base.getDimensions();
-        size_t mipLevel = 0;
-        while (dim > 1) {
-            dim >>= 1u;
-            Cubemap dst = CubemapUtils::create(temp, dim);
-            const Cubemap& src(levels[mipLevel++]);
-            CubemapUtils::downsampleCubemapLevelBoxFilter(js, dst, src);
-            dst.makeSeamless();
-            images.push_back(std::move(temp));
-            levels.push_back(std::move(dst));
-        }
-    };
+// converts the source environment to a Cubemap, stored in image
+static ibl::Cubemap createPrefilterSource(Texture::PixelBufferDescriptor const& buffer,
+        const Texture::FaceOffsets& faceOffsets, size_t size, ibl::Image& image) {
+    using namespace ibl;
+    using namespace backend;
+    using namespace math;
 
+    const size_t stride = buffer.stride ? buffer.stride : size;
 
     /*
      * Create a Cubemap data structure
@@ -362,12 +355,12 @@ void FTexture::generatePrefilterMipmap(FEngine& engine,
     assert(bytesPerPixel);
 
     Image temp;
-    Cubemap cml = CubemapUtils::create(temp, size);
+    Cubemap cubemap = CubemapUtils::create(temp, size);
     for (size_t j = 0; j < 6; j++) {
         Cubemap::Face face = (Cubemap::Face)j;
-        Image const& image = cml.getImageForFace(face);
+        Image const& faceImage = cubemap.getImageForFace(face);
         for (size_t y = 0; y < size; y++) {
-            Cubemap::Texel* out = (Cubemap::Texel*)image.getPixelRef(0, y);
+            Cubemap::Texel* out = (Cubemap::Texel*)faceImage.getPixelRef(0, y);
             if (buffer.type == PixelDataType::FLOAT) {
                 float3 const* src = pointermath::add((float3 const*)buffer.buffer, faceOffsets[j]);
                 src = pointermath::add(src, y * stride * bytesPerPixel);
@@ -400,31 +393,52 @@ void FTexture::generatePrefilterMipmap(FEngine& engine,
         }
     }
 
-    /*
-     * Create the mipmap chain
-     */
-
-    std::vector<Image> images;
-    std::vector<Cubemap> levels;
-    images.reserve(getLevels());
-    levels.reserve(getLevels());
-
-    images.push_back(std::move(temp));
-    levels.push_back(std::move(cml));
+    image = std::move(temp);
+    return cubemap;
+}
 
-    const float3 mirror = options->mirror ? float3{ -1, 1, 1 } : float3{ 1, 1, 1 };
+// Generates the prefiltered levels from the mipmap chain of the environment, which must contain
+// its base level, sharpest level first. emit(level, image, offsets) is called for each level as
+// soon as it's ready. Stops early if canceled is set.
+template<typename EMIT>
+static void prefilterLevels(JobSystem& js,
+        std::vector<ibl::Image>& images, std::vector<ibl::Cubemap>& levels,
+        Texture::PrefilterOptions const& options, std::atomic_bool const& canceled, EMIT emit) {
+    using namespace ibl;
+    using namespace math;
 
     // make the cubemap seamless
     levels[0].makeSeamless();
 
     // Now generate all the mipmap levels
-    generateMipmaps(js, levels, images);
+    Image temp;
+    const size_t size = levels[0].getDimensions();
+    for (size_t dim = size, mipLevel = 0; dim > 1; mipLevel++) {
+        dim >>= 1u;
+        Cubemap dst = CubemapUtils::create(temp, dim);
+        const Cubemap& src(levels[mipLevel]);
+        CubemapUtils::downsampleCubemapLevelBoxFilter(js, dst, src);
+        dst.makeSeamless();
+        images.push_back(std::move(temp));
+        levels.push_back(std::move(dst));
+    }
+
+    const float3 mirror = options.mirror ? float3{ -1, 1, 1 } : float3{ 1, 1, 1 };
+
+    // The fast mode uses a quarter of the samples, and filters each of them over an area 4 times
+    // larger (one more level of the mipmap chain) to hide the noise.
+    const size_t numSamples = options.fast ?
+            std::max(size_t(2), size_t(options.sampleCount / 4u)) : options.sampleCount;
+    const float lodBias = options.fast ? 1.0f : 0.0f;
 
     // Finally generate each pre-filtered mipmap level
     const size_t baseExp = ctz(size);
-    size_t numSamples = options->sampleCount;
     const size_t numLevels = baseExp + 1;
     for (ssize_t i = baseExp; i >= 0; --i) {
+        if (canceled.load(std::memory_order_relaxed)) {
+            return;
+        }
+
         const size_t dim = 1U << i;
         const size_t level = baseExp - i;
         const float lod = saturate(level / (numLevels - 1.0f));
@@ -432,11 +446,8 @@ void FTexture::generatePrefilterMipmap(FEngine& engine,
 
         Image image;
         Cubemap dst = CubemapUtils::create(image, dim);
-        CubemapIBL::roughnessFilter(js, dst, levels, linearRoughness, numSamples, mirror, true);
-
-        Texture::PixelBufferDescriptor pbd(image.getData(), image.getSize(),
-                Texture::PixelBufferDescriptor::PixelDataFormat::RGB,
-                Texture::PixelBufferDescriptor::PixelDataType::FLOAT, 1, 0, 0, image.getStride());
+        CubemapIBL::roughnessFilter(js, dst, levels, linearRoughness, numSamples, mirror, true,
+                {}, lodBias);
 
         uintptr_t base = uintptr_t(image.getData());
         backend::FaceOffsets offsets{};
@@ -444,17 +455,153 @@ void FTexture::generatePrefilterMipmap(FEngine& engine,
             Image const& faceImage = dst.getImageForFace((Cubemap::Face)j);
             offsets[j] = uintptr_t(faceImage.getData()) - base;
         }
-        // upload all 6 faces into the texture
-        driver.updateCubeImage(mHandle, level, std::move(pbd), offsets);
+        emit(level, std::move(image), offsets);
+    }
+}
+
+static void uploadPrefilteredLevel(FEngine::DriverApi& driver, Handle<HwTexture> handle,
+        size_t level, ibl::Image&& image, backend::FaceOffsets const& offsets) {
+    Texture::PixelBufferDescriptor pbd(image.getData(), image.getSize(),
+            Texture::PixelBufferDescriptor::PixelDataFormat::RGB,
+            Texture::PixelBufferDescriptor::PixelDataType::FLOAT, 1, 0, 0, image.getStride());
+
+    // upload all 6 faces into the texture
+    driver.updateCubeImage(handle, level, std::move(pbd), offsets);
+
+    // enqueue a commands that holds the image data until it's executed
+    driver.queueCommand(make_copyable_function([data = image.detach()]() {}));
+}
 
-        // enqueue a commands that holds the image data until it's executed
-        driver.queueCommand(make_copyable_function([data = image.detach()]() {}));
+void FTexture::generatePrefilterMipmap(FEngine& engine,
+        PixelBufferDescriptor&& buffer, const FaceOffsets& faceOffsets,
+        PrefilterOptions const* options) {
+    if (!validatePrefilterSource(*this, buffer)) {
+        return;
     }
 
+    // this replaces the result of a pending asynchronous prefiltering
+    cancelPrefilterMipmap(engine);
+
+    PrefilterOptions defaultOptions;
+    options = options ? options : &defaultOptions;
+
+    std::vector<ibl::Image> images;
+    std::vector<ibl::Cubemap> levels;
+    images.reserve(getMaxLevelCount());
+    levels.reserve(getMaxLevelCount());
+    images.emplace_back();
+    levels.push_back(createPrefilterSource(buffer, faceOffsets, getWidth(), images[0]));
+
+    FEngine::DriverApi& driver = engine.getDriverApi();
+    const std::atomic_bool canceled = { false };
+    prefilterLevels(engine.getJobSystem(), images, levels, *options, canceled,
+            [&driver, handle = mHandle](size_t level, ibl::Image&& image,
+                    backend::FaceOffsets const& offsets) {
+                uploadPrefilteredLevel(driver, handle, level, std::move(image), offsets);
+            });
+
     // no need to call the user callback because buffer is a reference and it'll be destroyed
     // by the caller (without being move()d here).
 }
 
+struct FTexture::PrefilterTask {
+    struct Level {
+        size_t level;
+        ibl::Image image;
+        backend::FaceOffsets offsets;
+    };
+
+    // inputs, only accessed by the job
+    std::vector<ibl::Image> images;
+    std::vector<ibl::Cubemap> levels;
+    PrefilterOptions options;
+
+    JobSystem::Job* job = nullptr;
+    std::atomic_bool canceled = { false };
+    PrefilterCallback callback = nullptr;
+    void* user = nullptr;
+    size_t remaining = 0;   // levels not uploaded yet
+
+    std::mutex lock;
+    std::vector<Level> ready;   // levels generated but not uploaded yet, guarded by lock
+};
+
+void FTexture::generatePrefilterMipmapAsync(FEngine& engine,
+        PixelBufferDescriptor&& buffer, const FaceOffsets& faceOffsets,
+        PrefilterOptions const* options, PrefilterCallback callback, void* user) {
+    if (!validatePrefilterSource(*this, buffer)) {
+        return;
+    }
+
+    // this replaces the result of a pending asynchronous prefiltering
+    cancelPrefilterMipmap(engine);
+
+    // the conversion of the source is fast, and frees the caller's buffer immediately
+    std::unique_ptr<PrefilterTask> task(new PrefilterTask);
+    task->images.reserve(getMaxLevelCount());
+    task->levels.reserve(getMaxLevelCount());
+    task->images.emplace_back();
+    task->levels.push_back(
+            createPrefilterSource(buffer, faceOffsets, getWidth(), task->images[0]));
+    task->options = options ? *options : PrefilterOptions{};
+    task->callback = callback;
+    task->user = user;
+    task->remaining = size_t(ctz(getWidth())) + 1;
+
+    JobSystem& js = engine.getJobSystem();
+    PrefilterTask* const t = task.get();
+    JobSystem::Job* job = js.createJob(nullptr, [t](JobSystem& js, JobSystem::Job*) {
+        prefilterLevels(js, t->images, t->levels, t->options, t->canceled,
+                [t](size_t level, ibl::Image&& image, backend::FaceOffsets const& offsets) {
+                    std::lock_guard<std::mutex> guard(t->lock);
+                    t->ready.push_back({ level, std::move(image), offsets });
+                });
+        // we don't need the inputs anymore
+        t->images.clear();
+        t->levels.clear();
+    });
+
+    // prefiltering must not delay the jobs of the frames being rendered
+    task->job = js.runAndRetain(job, JobSystem::BACKGROUND);
+    mPrefilterTask = std::move(task);
+    engine.addPrefilteringTexture(this);
+}
+
+bool FTexture::uploadPrefilteredLevels(FEngine& engine, PrefilterCompletion* completion) {
+    PrefilterTask* const task = mPrefilterTask.get();
+    assert(task);
+
+    std::vector<PrefilterTask::Level> ready;
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        std::swap(ready, task->ready);
+    }
+
+    FEngine::DriverApi& driver = engine.getDriverApi();
+    for (auto& level : ready) {
+        uploadPrefilteredLevel(driver, mHandle, level.level, std::move(level.image), level.offsets);
+    }
+    task->remaining -= ready.size();
+    if (task->remaining) {
+        return false;
+    }
+
+    // all levels are uploaded, the job is finished or about to
+    engine.getJobSystem().waitAndRelease(task->job);
+    *completion = { task->callback, task->user };
+    mPrefilterTask.reset();
+    return true;
+}
+
+void FTexture::cancelPrefilterMipmap(FEngine& engine) {
+    PrefilterTask* const task = mPrefilterTask.get();
+    if (task) {
+        task->canceled.store(true, std::memory_order_relaxed);
+        engine.getJobSystem().waitAndRelease(task->job);
+        engine.removePrefilteringTexture(this);
+        mPrefilterTask.reset();
+    }
+}
 
 } // namespace details
 
@@ -537,4 +684,11 @@ void Texture::generatePrefilterMipmap(Engine& engine, Texture::PixelBufferDescri
     upcast(this)->generatePrefilterMipmap(upcast(engine), std::move(buffer), faceOffsets, options);
 }
 
+void Texture::generatePrefilterMipmapAsync(Engine& engine,
+        Texture::PixelBufferDescriptor&& buffer, const Texture::FaceOffsets& faceOffsets,
+        PrefilterOptions const* options, PrefilterCallback callback, void* user) {
+    upcast(this)->generatePrefilterMipmapAsync(upcast(engine), std::move(buffer), faceOffsets,
+            options, callback, user);
+}
+
 } // namespace filament
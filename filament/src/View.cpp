@@ -16,6 +16,8 @@
 
 #include "details/View.h"
 
+#include "FrameInfo.h"
+
 #include "details/Engine.h"
 #include "details/Culler.h"
 #include "details/DFG.h"
@@ -23,6 +25,7 @@
 #include "details/IndirectLight.h"
 #include "details/MaterialInstance.h"
 #include "details/Renderer.h"
+#include "details/RenderPrimitive.h"
 #include "details/RenderTarget.h"
 #include "details/Scene.h"
 #include "details/Skybox.h"
@@ -40,7 +43,9 @@
 #include <math/scalar.h>
 #include <math/fast.h>
 
+#include <limits>
 #include <memory>
+#include <new>
 
 
 using namespace filament::math;
@@ -96,6 +101,7 @@ void FView::terminate(FEngine& engine) {
     driver.destroyUniformBuffer(mLightUbh);
     driver.destroySamplerGroup(mPerViewSbh);
     driver.destroyUniformBuffer(mRenderableUbh);
+    driver.destroyUniformBuffer(mBonesUbh);
     mDirectionalShadowMap.terminate(driver);
     mFroxelizer.terminate(driver);
 }
@@ -260,6 +266,149 @@ float2 FView::updateScale(duration frameTime) noexcept {
     return mScale;
 }
 
+void FView::setCpuBudgetOptions(CpuBudgetOptions const& options) noexcept {
+    CpuBudgetOptions& cpuBudget = mCpuBudget.options;
+    cpuBudget = options;
+
+    // same frame time and history limits as dynamic resolution
+    cpuBudget.history = std::min(cpuBudget.history, uint8_t(MAX_FRAMETIME_HISTORY));
+    cpuBudget.history = std::max(cpuBudget.history, uint8_t(3));
+    cpuBudget.targetFrameTimeMilli =
+            clamp(cpuBudget.targetFrameTimeMilli, 1000.0f / 240.0f, 1000.0f);
+    cpuBudget.headRoomRatio = saturate(cpuBudget.headRoomRatio);
+
+    // a setting can't be raised above its full quality, and some lights and froxels must remain
+    cpuBudget.maxLodBias = std::max(cpuBudget.maxLodBias, 0.0f);
+    cpuBudget.minShadowDistanceScale = saturate(cpuBudget.minShadowDistanceScale);
+    cpuBudget.minLightCountRatio = clamp(cpuBudget.minLightCountRatio, 1.0f / 16.0f, 1.0f);
+    cpuBudget.minFroxelCountRatio = clamp(cpuBudget.minFroxelCountRatio, 1.0f / 16.0f, 1.0f);
+
+    // restore the full quality, and start from a known (and current) state
+    std::fill(std::begin(mCpuBudget.steps), std::end(mCpuBudget.steps), 0);
+    mCpuBudget.settle = true;
+}
+
+void FView::updateCpuBudget(Renderer::FrameTimings const& timings, uint32_t frameId) noexcept {
+    CpuBudget& budget = mCpuBudget;
+    CpuBudgetOptions const& options = budget.options;
+    if (!options.enabled) {
+        return;
+    }
+
+    // the settings of the next frame differ from the measured ones, start over
+    auto settle = [&budget, frameId]() {
+        budget.settleFrameId = frameId;
+        budget.historySize = 0;
+        budget.underBudgetCount = 0;
+        std::fill(std::begin(budget.costs), std::end(budget.costs), 0.0f);
+    };
+
+    if (UTILS_UNLIKELY(budget.settle)) {
+        budget.settle = false;
+        settle();
+    }
+
+    // use each frame once, and only the frames rendered with the current settings
+    if (int32_t(timings.frameId - budget.lastFrameId) <= 0 ||
+        int32_t(timings.frameId - budget.settleFrameId) < 0) {
+        return;
+    }
+    budget.lastFrameId = timings.frameId;
+
+    using Stage = Renderer::FrameStage;
+    auto stageTime = [&timings](Stage stage) {
+        return float(timings.stages[size_t(stage)]) * 1e-6f;
+    };
+
+    // the frame is as long as its slowest thread, the main thread's time waiting on the
+    // backend thread is already accounted for by the latter
+    const float mainThreadTime =
+            std::max(0.0f, float(timings.frameTime) * 1e-6f - stageTime(Stage::FLUSH_WAIT));
+    const float frameTime = std::max(mainThreadTime, stageTime(Stage::DRIVER));
+
+    budget.costs[size_t(CpuBudgetSetting::GEOMETRY)] += stageTime(Stage::CULLING) +
+            stageTime(Stage::COMMAND_GENERATION) + stageTime(Stage::COMMAND_RECORDING);
+    budget.costs[size_t(CpuBudgetSetting::SHADOWS)] += stageTime(Stage::SHADOWS);
+    // froxelization runs on a worker thread while the main thread generates and sorts the
+    // commands, only the part that outlasts them delays the frame
+    budget.costs[size_t(CpuBudgetSetting::LIGHTING)] += std::max(0.0f, stageTime(Stage::FROXELIZE) -
+            stageTime(Stage::COMMAND_GENERATION) - stageTime(Stage::COMMAND_SORT));
+
+    // this is like doing { pop_back(); push_front(); }
+    auto& history = budget.history;
+    details::move_backward(history.begin(), history.end() - 1, history.end());
+    history.front() = frameTime;
+    budget.historySize = std::min(budget.historySize + 1, size_t(options.history));
+    if (budget.historySize < options.history) {
+        // don't make any decision if we don't have enough data
+        return;
+    }
+
+    // apply a median filter, so that isolated slow frames don't lower the quality
+    std::array<float, MAX_FRAMETIME_HISTORY> median; // NOLINT -- it's initialized below
+    std::copy_n(history.begin(), budget.historySize, median.begin());
+    std::nth_element(median.begin(), median.begin() + budget.historySize / 2,
+            median.begin() + budget.historySize);
+    const float filteredFrameTime = median[budget.historySize / 2];
+
+    // finds the setting that can still be moved whose stages cost the most, or the least
+    auto pick = [&budget](bool lower) {
+        size_t found = CPU_BUDGET_SETTING_COUNT;
+        for (size_t i = 0; i < CPU_BUDGET_SETTING_COUNT; i++) {
+            const bool movable = lower ?
+                    budget.steps[i] < CPU_BUDGET_STEP_COUNT : budget.steps[i] > 0;
+            if (movable && (found == CPU_BUDGET_SETTING_COUNT ||
+                    (lower ? budget.costs[i] > budget.costs[found] :
+                             budget.costs[i] < budget.costs[found]))) {
+                found = i;
+            }
+        }
+        return found;
+    };
+
+    if (filteredFrameTime > options.targetFrameTimeMilli) {
+        // over budget, lower the quality right away
+        budget.underBudgetCount = 0;
+        const size_t setting = pick(true);
+        if (setting < CPU_BUDGET_SETTING_COUNT) {
+            budget.steps[setting]++;
+            settle();
+        }
+    } else if (filteredFrameTime < options.targetFrameTimeMilli * (1.0f - options.headRoomRatio)) {
+        // comfortably under budget for a while, restore some quality
+        if (++budget.underBudgetCount >= options.restoreDelay) {
+            const size_t setting = pick(false);
+            if (setting < CPU_BUDGET_SETTING_COUNT) {
+                budget.steps[setting]--;
+                settle();
+            }
+        }
+    } else {
+        budget.underBudgetCount = 0;
+    }
+}
+
+float FView::getEffectiveLodBias() const noexcept {
+    return mLodBias + mCpuBudget.options.maxLodBias * getCpuBudgetRatio(CpuBudgetSetting::GEOMETRY);
+}
+
+float FView::getShadowDistanceScale() const noexcept {
+    return lerp(1.0f, mCpuBudget.options.minShadowDistanceScale,
+            getCpuBudgetRatio(CpuBudgetSetting::SHADOWS));
+}
+
+size_t FView::getMaxLightCount() const noexcept {
+    const float scale = lerp(1.0f, mCpuBudget.options.minLightCountRatio,
+            getCpuBudgetRatio(CpuBudgetSetting::LIGHTING));
+    return size_t(float(CONFIG_MAX_LIGHT_COUNT) * scale);
+}
+
+size_t FView::getMaxFroxelCount() const noexcept {
+    const float scale = lerp(1.0f, mCpuBudget.options.minFroxelCountRatio,
+            getCpuBudgetRatio(CpuBudgetSetting::LIGHTING));
+    return size_t(float(FROXEL_BUFFER_ENTRY_COUNT_MAX) * scale);
+}
+
 void FView::setClearColor(float4 const& clearColor) noexcept {
     mClearColor = clearColor;
 }
@@ -279,8 +428,8 @@ bool FView::isSkyboxVisible() const noexcept {
     return skybox != nullptr && (skybox->getLayerMask() & mVisibleLayers);
 }
 
-void FView::prepareShadowing(FEngine& engine, backend::DriverApi& driver,
-        FScene::RenderableSoa& renderableData, FScene::LightSoa const& lightData) noexcept {
+bool FView::prepareShadowCamera(FEngine& engine,
+        FScene::LightSoa const& lightData, Frustum& shadowFrustum) noexcept {
     SYSTRACE_CALL();
 
     // setup shadow mapping
@@ -292,14 +441,28 @@ void FView::prepareShadowing(FEngine& engine, backend::DriverApi& driver,
     FLightManager::Instance directionalLight = lightData.elementAt<FScene::LIGHT_INSTANCE>(0);
     mHasShadowing = mShadowingEnabled && directionalLight && lcm.isShadowCaster(directionalLight);
     if (UTILS_UNLIKELY(mHasShadowing)) {
-        // compute the frustum for this light
+        // compute the frustum for this light, this doesn't depend on the culling results
+        ShadowMap& shadowMap = mDirectionalShadowMap;
+        shadowMap.update(lightData, 0, mScene, mViewingCameraInfo, mVisibleLayers,
+                getShadowDistanceScale());
+        if (shadowMap.hasVisibleShadows()) {
+            shadowFrustum = shadowMap.getCamera().getFrustum();
+            return true;
+        }
+    }
+    return false;
+}
+
+void FView::prepareShadowing(FEngine& engine, backend::DriverApi& driver,
+        FScene::LightSoa const& lightData) noexcept {
+    SYSTRACE_CALL();
+
+    auto& lcm = engine.getLightManager();
+    FLightManager::Instance directionalLight = lightData.elementAt<FScene::LIGHT_INSTANCE>(0);
+    if (UTILS_UNLIKELY(mHasShadowing)) {
         ShadowMap& shadowMap = mDirectionalShadowMap;
-        shadowMap.update(lightData, 0, mScene, mViewingCameraInfo, mVisibleLayers);
         if (shadowMap.hasVisibleShadows()) {
-            // Cull shadow casters
             UniformBuffer& u = mPerViewUb;
-            Frustum const& frustum = shadowMap.getCamera().getFrustum();
-            FView::prepareVisibleShadowCasters(engine.getJobSystem(), frustum, renderableData);
 
             // allocates shadowmap driver resources
             shadowMap.prepare(driver, mPerViewSb);
@@ -323,9 +486,9 @@ void FView::prepareLighting(FEngine& engine, FEngine::DriverApi& driver, ArenaSc
     const CameraInfo& camera = mViewingCameraInfo;
     FScene* const scene = mScene;
 
-    scene->prepareDynamicLights(camera, arena, mLightUbh);
+    scene->prepareDynamicLights(camera, arena, mLightUbh, getMaxLightCount());
 
-    // here the array of visible lights has been shrunk to CONFIG_MAX_LIGHT_COUNT
+    // here the array of visible lights has been shrunk to getMaxLightCount()
     auto const& lightData = scene->getLightData();
 
     // trace the number of visible lights
@@ -399,6 +562,7 @@ void FView::prepareLighting(FEngine& engine, FEngine::DriverApi& driver, ArenaSc
     mHasDynamicLighting = scene->getLightData().size() > FScene::DIRECTIONAL_LIGHTS_COUNT;
     if (mHasDynamicLighting) {
         Froxelizer& froxelizer = mFroxelizer;
+        froxelizer.setMaxFroxelCount(getMaxFroxelCount());
         if (froxelizer.prepare(driver, arena, viewport, camera.projection, camera.zn, camera.zf)) {
             froxelizer.updateUniforms(u); // update our uniform buffer if needed
         }
@@ -406,7 +570,8 @@ void FView::prepareLighting(FEngine& engine, FEngine::DriverApi& driver, ArenaSc
 }
 
 void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& arena,
-        filament::Viewport const& viewport, float4 const& userTime) noexcept {
+        filament::Viewport const& viewport, float4 const& userTime,
+        FrameInfo* frameInfo) noexcept {
     JobSystem& js = engine.getJobSystem();
 
     /*
@@ -470,24 +635,42 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
             // world origin transform, use only for debugging
             .worldOrigin        = worldOriginCamera
     };
-    mCullingFrustum = FCamera::getFrustum(
-            mCullingCamera->getCullingProjectionMatrix(),
-            FCamera::getViewMatrix(worldOriginScene * mCullingCamera->getModelMatrix()));
+    const mat4f cullingModel(worldOriginScene * mCullingCamera->getModelMatrix());
+    const mat4f cullingView(FCamera::getViewMatrix(cullingModel));
+    mCullingFrustum = FCamera::getFrustum(mCullingCamera->getCullingProjectionMatrix(), cullingView);
+    // orthographic cameras look at everything from the same direction, i.e. from infinity
+    mCullingEye = mCullingCamera->getCullingProjectionMatrix()[2][3] != 0 ?
+            float4{ cullingModel[3].xyz, 1 } : float4{ normalize(cullingModel[2].xyz), 0 };
+
+    const mat4f cullingViewProjection =
+            mat4f{ mCullingCamera->getCullingProjectionMatrix() } * cullingView;
+    mLodCamera = {
+            .clipW = { cullingViewProjection[0].w, cullingViewProjection[1].w,
+                       cullingViewProjection[2].w, cullingViewProjection[3].w },
+            .scale = float(mCullingCamera->getCullingProjectionMatrix()[1][1])
+    };
 
     /*
      * Gather all information needed to render this scene. Apply the world origin to all
      * objects in the scene.
      */
-    scene->prepare(worldOriginScene);
+    {
+        FrameStageScope counters(frameInfo, FrameInfo::Stage::SCENE_PREPARE);
+        scene->prepare(worldOriginScene);
+    }
 
     /*
      * Light culling: runs in parallel with Renderable culling (below)
      */
 
+    // only counts the work done on this thread, not the light culling job
+    FrameStageScope cullingCounters(frameInfo, FrameInfo::Stage::CULLING);
+
+    uint32_t* const lightChunkCounts = arena.allocate<uint32_t>(
+            getLightCullingChunkCount(scene->getLightData().size()));
     auto prepareVisibleLightsJob = js.runAndRetain(js.createJob(nullptr,
-            [&frustum = mCullingFrustum, &engine, scene](JobSystem& js, JobSystem::Job*) {
-                FView::prepareVisibleLights(
-                        engine.getLightManager(), js, frustum, scene->getLightData());
+            [&frustum = mCullingFrustum, scene, lightChunkCounts](JobSystem& js, JobSystem::Job*) {
+                FView::prepareVisibleLights(js, frustum, scene->getLightData(), lightChunkCounts);
             }));
 
     Range merged;
@@ -499,19 +682,32 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
         std::uninitialized_fill(cullingMask.begin(), cullingMask.end(), 0);
 
         /*
-         * Culling: as soon as possible we perform our camera-culling
-         * (this will set the VISIBLE_RENDERABLE bit)
+         * Shadowing: compute the shadow camera, so that shadow casters can be culled along with
+         * the renderables
          */
 
-        prepareVisibleRenderables(js, mCullingFrustum, renderableData);
+        Frustum shadowFrustum;
+        FrameStageScope shadowCameraCounters(frameInfo, FrameInfo::Stage::SHADOWS);
+        const bool cullShadowCasters =
+                prepareShadowCamera(engine, scene->getLightData(), shadowFrustum);
+        shadowCameraCounters.stop();
+
+        /*
+         * Culling: cull the renderables against the camera and the shadow camera in a single
+         * pass (this will set the VISIBLE_RENDERABLE and VISIBLE_SHADOW_CASTER bits)
+         */
 
+        prepareVisibleRenderables(js, mCullingFrustum,
+                cullShadowCasters ? &shadowFrustum : nullptr, renderableData);
 
         /*
-         * Shadowing: compute the shadow camera and cull shadow casters
-         * (this will set the VISIBLE_SHADOW_CASTER bit)
+         * Shadowing: allocate the shadow map and set its uniforms
          */
 
-        prepareShadowing(engine, driver, renderableData, scene->getLightData());
+        {
+            FrameStageScope counters(frameInfo, FrameInfo::Stage::SHADOWS);
+            prepareShadowing(engine, driver, scene->getLightData());
+        }
 
         /*
          * partition the array of renderable w.r.t their visibility:
@@ -552,9 +748,31 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
         } else {
             // TODO: should we shrink the underlying UBO at some point?
         }
-        scene->updateUBOs(merged, mRenderableUbh);
+
+        // All the bone palettes live in a single UBO, each draw binds its own range. According
+        // to the OpenGL ES 3.2 specification in 7.6.3 Uniform Buffer Object Bindings:
+        //
+        //     the uniform block must be populated with a buffer object with a size no smaller
+        //     than the minimum required size of the uniform block (the value of
+        //     UNIFORM_BLOCK_DATA_SIZE).
+        //
+        // So each range covers CONFIG_MAX_BONE_COUNT bones, even though palettes are packed
+        // tightly; the ranges overlap, and the buffer has room for a full range past the last
+        // palette. The buffer is DYNAMIC, so that these offsets are the actual buffer offsets.
+        constexpr size_t bonesRangeSize = CONFIG_MAX_BONE_COUNT * sizeof(PerRenderableUibBone);
+        const size_t bonesSize = scene->computeBonesOffsets(merged);
+        if (bonesSize && mBonesUBOSize < bonesSize + bonesRangeSize) {
+            // allocate 1/3 extra
+            mBonesUBOSize = uint32_t((4u * bonesSize + 2u) / 3u + bonesRangeSize);
+            driver.destroyUniformBuffer(mBonesUbh);
+            mBonesUbh = driver.createUniformBuffer(mBonesUBOSize, backend::BufferUsage::DYNAMIC);
+        }
+
+        scene->updateUBOs(merged, mRenderableUbh, mBonesUbh, bonesSize);
     }
 
+    cullingCounters.stop();
+
     /*
      * Prepare lighting -- this is where we update the lights UBOs, set-up the IBL,
      * set-up the froxelization parameters.
@@ -573,10 +791,6 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
     mPerViewUb.setUniform(offsetof(PerViewUib, time), fraction);
     mPerViewUb.setUniform(offsetof(PerViewUib, userTime), userTime);
 
-    // upload the renderables's dirty UBOs
-    engine.getRenderableManager().prepare(driver,
-            renderableData.data<FScene::RENDERABLE_INSTANCE>(), merged);
-
     // set uniforms and samplers
     bindPerViewUniformsAndSamplers(driver);
 }
@@ -677,36 +891,41 @@ void FView::commitFroxels(backend::DriverApi& driverApi) const noexcept {
 
 UTILS_NOINLINE
 void FView::prepareVisibleRenderables(JobSystem& js,
-        Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept {
+        Frustum const& frustum, Frustum const* shadowFrustum,
+        FScene::RenderableSoa& renderableData) const noexcept {
     SYSTRACE_CALL();
     if (UTILS_LIKELY(isFrustumCullingEnabled())) {
-        FView::cullRenderables(js, renderableData, frustum, VISIBLE_RENDERABLE_BIT);
+        if (shadowFrustum) {
+            static_assert(VISIBLE_SHADOW_CASTER_BIT == VISIBLE_RENDERABLE_BIT + 1,
+                    "frustums must set consecutive bits");
+            const Frustum frustums[] = { frustum, *shadowFrustum };
+            FView::cullRenderables(js, renderableData, frustums, 2, VISIBLE_RENDERABLE_BIT);
+        } else {
+            FView::cullRenderables(js, renderableData, &frustum, 1, VISIBLE_RENDERABLE_BIT);
+        }
     } else {
         std::uninitialized_fill(renderableData.begin<FScene::VISIBLE_MASK>(),
                   renderableData.end<FScene::VISIBLE_MASK>(), VISIBLE_RENDERABLE);
+        if (shadowFrustum) {
+            FView::cullRenderables(js, renderableData, shadowFrustum, 1,
+                    VISIBLE_SHADOW_CASTER_BIT);
+        }
     }
 }
 
-UTILS_NOINLINE
-void FView::prepareVisibleShadowCasters(JobSystem& js,
-        Frustum const& lightFrustum, FScene::RenderableSoa& renderableData) noexcept {
-    SYSTRACE_CALL();
-    FView::cullRenderables(js, renderableData, lightFrustum, VISIBLE_SHADOW_CASTER_BIT);
-}
-
-void FView::cullRenderables(JobSystem& js,
-        FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit) noexcept {
+void FView::cullRenderables(JobSystem& js, FScene::RenderableSoa& renderableData,
+        Frustum const* frustums, size_t frustumCount, size_t bit) noexcept {
 
     float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
     float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
     uint8_t     * visibleArray    = renderableData.data<FScene::VISIBLE_MASK>();
 
     // culling job (this runs on multiple threads)
-    auto functor = [&frustum, worldAABBCenter, worldAABBExtent, visibleArray, bit]
+    auto functor = [frustums, frustumCount, worldAABBCenter, worldAABBExtent, visibleArray, bit]
             (uint32_t index, uint32_t c) {
         Culler::intersects(
                 visibleArray + index,
-                frustum,
+                frustums, frustumCount,
                 worldAABBCenter + index,
                 worldAABBExtent + index, c, bit);
     };
@@ -717,71 +936,284 @@ void FView::cullRenderables(JobSystem& js,
     js.runAndWait(job);
 }
 
-void FView::prepareVisibleLights(FLightManager const& lcm, utils::JobSystem&,
-        Frustum const& frustum, FScene::LightSoa& lightData) noexcept {
+void FView::prepareVisibleLights(JobSystem& js, Frustum const& frustum,
+        FScene::LightSoa& lightData, uint32_t* chunkCounts) noexcept {
     SYSTRACE_CALL();
+    assert(lightData.size() >= FScene::DIRECTIONAL_LIGHTS_COUNT);
 
     auto const* UTILS_RESTRICT sphereArray     = lightData.data<FScene::POSITION_RADIUS>();
     auto const* UTILS_RESTRICT directions      = lightData.data<FScene::DIRECTION>();
-    auto const* UTILS_RESTRICT instanceArray   = lightData.data<FScene::LIGHT_INSTANCE>();
+    auto const* UTILS_RESTRICT cosOuterSquared = lightData.data<FScene::SPOT_COS_OUTER_SQUARED>();
     auto      * UTILS_RESTRICT visibleArray    = lightData.data<FScene::VISIBILITY>();
 
-    Culler::intersects(visibleArray, frustum, sphereArray, lightData.size());
-
     const float4* const UTILS_RESTRICT planes = frustum.getNormalizedPlanes();
-    // the directional light is considered visible
-    size_t visibleLightCount = FScene::DIRECTIONAL_LIGHTS_COUNT;
-    // skip directional light
-    for (size_t i = FScene::DIRECTIONAL_LIGHTS_COUNT; i < lightData.size(); i++) {
-        FLightManager::Instance li = instanceArray[i];
-        if (visibleArray[i]) {
-            if (!lcm.isLightCaster(li)) {
-                visibleArray[i] = 0;
-                continue;
-            }
-            if (lcm.getIntensity(li) <= 0.0f) {
-                visibleArray[i] = 0;
-                continue;
-            }
-            // cull spotlights that cannot possibly intersect the view frustum
-            if (lcm.isSpotLight(li)) {
-                const float3 position = sphereArray[i].xyz;
-                const float3 axis = directions[i];
-                const float cosSqr = lcm.getCosOuterSquared(li);
-                bool invisible = false;
-                for (size_t j = 0; j < 6; ++j) {
-                    const float p = dot(position + planes[j].xyz * planes[j].w, planes[j].xyz);
-                    const float c = dot(planes[j].xyz, axis);
-                    invisible |= ((1.0f - c * c) < cosSqr && c > 0 && p > 0);
-                }
-                if (invisible) {
-                    visibleArray[i] = 0;
-                    continue;
+    const uint32_t size = uint32_t(lightData.size());
+    const uint32_t chunkCount = getLightCullingChunkCount(size);
+
+    /*
+     * Each chunk is culled, then compacted in place so that its visible lights come first,
+     * in order. This is where all the work happens, and it runs on multiple threads.
+     */
+
+    auto work = [&lightData, sphereArray, directions, cosOuterSquared, visibleArray, planes,
+            &frustum, size, chunkCounts](uint32_t firstChunk, uint32_t count) {
+        for (uint32_t chunk = firstChunk; chunk < firstChunk + count; chunk++) {
+            const uint32_t start = chunk * LIGHT_CULLING_CHUNK_SIZE;
+            const uint32_t end = std::min(start + LIGHT_CULLING_CHUNK_SIZE, size);
+
+            // chunks are a multiple of Culler::MODULO, so Culler doesn't overrun the next chunk
+            Culler::intersects(visibleArray + start, frustum, sphereArray + start, end - start);
+
+            // the directional light is always visible, and isn't a spot light
+            const uint32_t first = std::max(start, uint32_t(FScene::DIRECTIONAL_LIGHTS_COUNT));
+            cullSpotLights(visibleArray + first, planes, sphereArray + first,
+                    directions + first, cosOuterSquared + first, end - first);
+
+            uint32_t visibleCount = first - start;
+            for (uint32_t i = first; i < end; i++) {
+                if (visibleArray[i]) {
+                    const uint32_t dst = start + visibleCount++;
+                    if (dst != i) {
+                        lightData.forEach([dst, i](auto p) { p[dst] = p[i]; });
+                    }
                 }
             }
-            visibleLightCount++;
+            chunkCounts[chunk] = visibleCount;
         }
-    }
+    };
 
-    // Partition array such that all visible lights appear first
-    UTILS_UNUSED_IN_RELEASE auto last =
-            std::partition(lightData.begin() + FScene::DIRECTIONAL_LIGHTS_COUNT, lightData.end(),
-                    [](auto const& it) {
-                        return it.template get<FScene::VISIBILITY>() != 0;
-                    });
-    assert(visibleLightCount == size_t(last - lightData.begin()));
+    auto job = jobs::parallel_for(js, nullptr, 0, chunkCount,
+            std::ref(work), jobs::CountSplitter<1, 8>());
+    js.runAndWait(job);
+
+    /*
+     * Close the gaps between the chunks, this only moves contiguous runs of visible lights.
+     */
+
+    uint32_t visibleLightCount = chunkCount ? chunkCounts[0] : 0;
+    for (uint32_t chunk = 1; chunk < chunkCount; chunk++) {
+        const uint32_t start = chunk * LIGHT_CULLING_CHUNK_SIZE;
+        const uint32_t count = chunkCounts[chunk];
+        lightData.forEach([start, count, visibleLightCount](auto p) {
+            std::move(p + start, p + start + count, p + visibleLightCount);
+        });
+        visibleLightCount += count;
+    }
 
     lightData.resize(visibleLightCount);
 }
 
+UTILS_NOINLINE
+void FView::cullSpotLights(
+        Culler::result_type* UTILS_RESTRICT visible,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT spheres,
+        float3 const* UTILS_RESTRICT directions,
+        float const* UTILS_RESTRICT cosOuterSquared, size_t count) noexcept {
+    // Culls the spot lights that cannot possibly intersect the view frustum. This has no
+    // branches so it can be vectorized; lights that are not spot lights have a negative
+    // cosOuterSquared, which never culls them.
+    for (size_t i = 0; i < count; i++) {
+        const float3 position = spheres[i].xyz;
+        const float3 axis = directions[i];
+        const float cosSqr = cosOuterSquared[i];
+        bool invisible = false;
+        for (size_t j = 0; j < 6; ++j) {
+            const float p = dot(position + planes[j].xyz * planes[j].w, planes[j].xyz);
+            const float c = dot(planes[j].xyz, axis);
+            invisible |= ((1.0f - c * c) < cosSqr && c > 0 && p > 0);
+        }
+        visible[i] = invisible ? Culler::result_type(0) : visible[i];
+    }
+}
+
 void FView::updatePrimitivesLod(FEngine& engine, const CameraInfo&,
         FScene::RenderableSoa& renderableData, Range visible) noexcept {
-    FRenderableManager const& rcm = engine.getRenderableManager();
+    SYSTRACE_CALL();
+
+    FRenderableManager& rcm = engine.getRenderableManager();
+    auto const* const UTILS_RESTRICT instances = renderableData.data<FScene::RENDERABLE_INSTANCE>();
+    float3 const* const UTILS_RESTRICT centers = renderableData.data<FScene::WORLD_AABB_CENTER>();
+    float3 const* const UTILS_RESTRICT extents = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+    auto* const UTILS_RESTRICT primitives = renderableData.data<FScene::PRIMITIVES>();
+
+    // a positive bias makes renderables look smaller, i.e. selects coarser levels
+    const LodCamera camera = mLodCamera;
+    const float biasScale = std::exp2(-getEffectiveLodBias());
+    // w only depends on the position for perspective projections
+    const bool perspective = camera.clipW.xyz != float3{ 0 };
+
+    // instances range from 1 to the component count, this must be sized before the jobs start
+    mLodStates.resize(rcm.getComponentCount() + 1);
+    LodState* const UTILS_RESTRICT states = mLodStates.data();
+
+    auto work = [&rcm, instances, centers, extents, primitives, states, camera, biasScale,
+            perspective](uint32_t startIndex, uint32_t count) {
+        for (uint32_t index = startIndex, end = startIndex + count; index < end; index++) {
+            const auto ri = instances[index];
+            uint8_t level = 0;
+            if (UTILS_UNLIKELY(rcm.getLevelCount(ri) > 1)) {
+                // fraction of the viewport height covered by the bounding sphere, w is the
+                // distance along the view direction for perspective projections, 1 otherwise.
+                // A perspective camera inside the sphere is covered by it.
+                const float radius = length(extents[index]);
+                const float w = dot(camera.clipW.xyz, centers[index]) + camera.clipW.w;
+                const float screenSize = (!perspective || w > radius) ?
+                        radius * camera.scale * biasScale / w : std::numeric_limits<float>::max();
+                // start from the finest level for renderables this view hasn't seen yet
+                LodState& state = states[ri.asValue()];
+                const Entity entity = rcm.getEntity(ri);
+                const uint8_t current = state.entity == entity ? state.level : uint8_t(0);
+                level = FRenderableManager::selectLevel(rcm.getLevelOfDetail(ri), current,
+                        screenSize);
+                state = { entity, level };
+            }
+            primitives[index] = rcm.getRenderPrimitives(ri, level);
+        }
+    };
+
+    // each visible renderable is updated independently, so this splits trivially
+    JobSystem& js = engine.getJobSystem();
+    auto job = jobs::parallel_for(js, nullptr, visible.first, (uint32_t)visible.size(),
+            std::ref(work), jobs::CountSplitter<64>());
+    js.runAndWait(job);
+}
+
+Slice<const FRenderPrimitive::IndexRange> FView::cullClusters(FEngine& engine, ArenaScope& arena,
+        FScene::RenderableSoa& renderableData, Range visible) const noexcept {
+    if (UTILS_UNLIKELY(!isFrustumCullingEnabled())) {
+        return {};
+    }
+    return cullClusters(engine.getJobSystem(), arena, mCullingFrustum, mCullingEye,
+            isFrontFaceWindingInverted(), renderableData, visible);
+}
+
+Slice<const FRenderPrimitive::IndexRange> FView::cullClusters(JobSystem& js, ArenaScope& arena,
+        Frustum const& frustum, float4 eye, bool inverseFrontFaces,
+        FScene::RenderableSoa& renderableData, Range visible) noexcept {
+    SYSTRACE_CALL();
+
+    auto const* const UTILS_RESTRICT transforms = renderableData.data<FScene::WORLD_TRANSFORM>();
+    auto const* const UTILS_RESTRICT reversed = renderableData.data<FScene::REVERSED_WINDING_ORDER>();
+    auto const* const UTILS_RESTRICT visibility = renderableData.data<FScene::VISIBILITY_STATE>();
+    auto* const UTILS_RESTRICT primitives = renderableData.data<FScene::PRIMITIVES>();
+
+    // Find the renderables that have clusters and reserve room for their culled primitives. The
+    // surviving clusters are drawn as ranges of adjacent clusters, so a primitive with n
+    // clusters needs at most (n + 1) / 2 draws.
+    uint32_t* const candidates = arena.allocate<uint32_t>(visible.size());
+    uint32_t* const offsets = arena.allocate<uint32_t>(visible.size());
+    uint32_t candidateCount = 0;
+    uint32_t culledCount = 0;
     for (uint32_t index : visible) {
-        uint8_t level = 0; // TODO: pick the proper level of detail
-        auto ri = renderableData.elementAt<FScene::RENDERABLE_INSTANCE>(index);
-        renderableData.elementAt<FScene::PRIMITIVES>(index) = rcm.getRenderPrimitives(ri, level);
+        // the bounds of the clusters don't hold for deformed geometry
+        const FRenderableManager::Visibility v = visibility[index];
+        if (!v.culling || v.skinning || v.morphing) {
+            continue;
+        }
+        bool clustered = false;
+        uint32_t count = 0;
+        for (FRenderPrimitive const& primitive : primitives[index]) {
+            const uint32_t clusterCount = primitive.getClusters().size();
+            clustered |= clusterCount > 0;
+            count += std::max(1u, (clusterCount + 1u) / 2u);
+        }
+        if (clustered) {
+            candidates[candidateCount] = index;
+            offsets[candidateCount] = culledCount;
+            candidateCount++;
+            culledCount += count;
+        }
+    }
+
+    if (!candidateCount) {
+        return {};
     }
+
+    // the range of culled[i] is ranges[i], if it has one
+    FRenderPrimitive* const culled = arena.allocate<FRenderPrimitive>(culledCount);
+    FRenderPrimitive::IndexRange* const ranges =
+            arena.allocate<FRenderPrimitive::IndexRange>(culledCount);
+    float4 const* const planes = frustum.getNormalizedPlanes();
+
+    auto work = [=](uint32_t startIndex, uint32_t count) {
+        for (uint32_t c = startIndex, end = startIndex + count; c < end; c++) {
+            const uint32_t index = candidates[c];
+            const mat4f& model = transforms[index];
+
+            // Spheres are scaled by the largest axis. The normal cones only survive
+            // transforms that preserve angles and winding.
+            const float3 scales = { length2(model[0].xyz), length2(model[1].xyz),
+                                    length2(model[2].xyz) };
+            const float maxScale = std::sqrt(max(scales));
+            const bool conformal = max(scales) <= min(scales) * 1.001f;
+            const bool backFaces = conformal && !(reversed[index] ^ inverseFrontFaces);
+
+            FRenderPrimitive* const first = culled + offsets[c];
+            FRenderPrimitive* out = first;
+            for (FRenderPrimitive const& primitive : primitives[index]) {
+                Slice<const FRenderPrimitive::Cluster> const clusters = primitive.getClusters();
+                if (clusters.empty()) {
+                    new(out++) FRenderPrimitive(primitive);
+                    continue;
+                }
+
+                auto emit = [&](uint32_t offset, uint32_t count) {
+                    const uint32_t i = uint32_t(out - culled);
+                    ranges[i] = { offset, count,
+                            primitive.getIndexOffset(), primitive.getIndexCount(),
+                            primitive.getPrimitiveType() };
+                    (new(out++) FRenderPrimitive(primitive))->setIndexRange(i);
+                };
+
+                // double-sided transparent objects draw their back faces in a separate pass
+                FMaterialInstance const* const mi = primitive.getMaterialInstance();
+                const bool coneCulling = backFaces &&
+                        mi->getCullingMode() == CullingMode::BACK &&
+                        mi->getMaterial()->getTransparencyMode() !=
+                                TransparencyMode::TWO_PASSES_TWO_SIDES;
+
+                uint32_t runOffset = 0;
+                uint32_t runCount = 0;
+                for (FRenderPrimitive::Cluster const& cluster : clusters) {
+                    const float3 center = (model * float4{ cluster.center, 1 }).xyz;
+                    const float radius = cluster.radius * maxScale;
+                    bool invisible = false;
+                    for (size_t j = 0; j < 6; j++) {
+                        invisible |= dot(planes[j].xyz, center) + planes[j].w - radius > 0;
+                    }
+                    if (coneCulling) {
+                        const float3 apex = (model * float4{ cluster.coneApex, 1 }).xyz;
+                        const float3 axis = normalize(model.upperLeft() * cluster.coneAxis);
+                        const float3 direction = apex * eye.w - eye.xyz;
+                        invisible |= dot(normalize(direction), axis) >= cluster.coneCutoff;
+                    }
+                    if (invisible) {
+                        continue;
+                    }
+                    if (runCount && runOffset + runCount == cluster.offset) {
+                        runCount += cluster.count;
+                        continue;
+                    }
+                    if (runCount) {
+                        emit(runOffset, runCount);
+                    }
+                    runOffset = cluster.offset;
+                    runCount = cluster.count;
+                }
+                if (runCount) {
+                    emit(runOffset, runCount);
+                }
+            }
+            primitives[index] = { first, uint32_t(out - first) };
+        }
+    };
+
+    auto job = jobs::parallel_for(js, nullptr, 0, candidateCount,
+            std::ref(work), jobs::CountSplitter<16>());
+    js.runAndWait(job);
+
+    return { ranges, culledCount };
 }
 
 } // namespace details
@@ -863,6 +1295,14 @@ void View::setShadowsEnabled(bool enabled) noexcept {
     upcast(this)->setShadowsEnabled(enabled);
 }
 
+void View::setLodBias(float bias) noexcept {
+    upcast(this)->setLodBias(bias);
+}
+
+float View::getLodBias() const noexcept {
+    return upcast(this)->getLodBias();
+}
+
 void View::setRenderTarget(RenderTarget* renderTarget, TargetBufferFlags discard) noexcept {
     upcast(this)->setRenderTarget(upcast(renderTarget), discard);
 }
@@ -915,6 +1355,14 @@ View::DynamicResolutionOptions View::getDynamicResolutionOptions() const noexcep
     return upcast(this)->getDynamicResolutionOptions();
 }
 
+void View::setCpuBudgetOptions(const CpuBudgetOptions& options) noexcept {
+    upcast(this)->setCpuBudgetOptions(options);
+}
+
+View::CpuBudgetOptions View::getCpuBudgetOptions() const noexcept {
+    return upcast(this)->getCpuBudgetOptions();
+}
+
 void View::setRenderQuality(const RenderQuality& renderQuality) noexcept {
     upcast(this)->setRenderQuality(renderQuality);
 }
@@ -241,6 +241,8 @@ private:
         using Base::gc;
         using Base::swap;
 
+        Sim() noexcept : Base(Base::Lookup::SPARSE_SET) { }
+
         struct Proxy {
             // all of this gets inlined
             UTILS_ALWAYS_INLINE
@@ -29,6 +29,8 @@
 #include <utils/Log.h>
 #include <utils/Panic.h>
 
+#include <limits>
+
 using namespace filament::math;
 using namespace utils;
 
@@ -38,7 +40,10 @@ using namespace details;
 
 struct RenderableManager::BuilderDetails {
     using Entry = RenderableManager::Builder::Entry;
-    std::vector<Entry> mEntries;
+    std::vector<Entry> mEntries;    // the primitives of all levels, one level after the other
+    size_t mPrimitiveCount = 0;     // per level
+    uint8_t mLevelCount = 1;
+    float mScreenSizes[MAX_LEVEL_COUNT - 1] = {};
     Box mAABB;
     uint8_t mLayerMask = 0x1;
     uint8_t mPriority = 0x4;
@@ -51,7 +56,7 @@ struct RenderableManager::BuilderDetails {
     mat4f const* mUserBoneMatrices = nullptr;
 
     explicit BuilderDetails(size_t count)
-            : mEntries(count), mCulling(true), mCastShadows(false), mReceiveShadows(true),
+            : mEntries(count), mPrimitiveCount(count), mCulling(true), mCastShadows(false), mReceiveShadows(true),
               mMorphingEnabled(false) {
     }
     // this is only needed for the explicit instantiation below
@@ -85,7 +90,7 @@ RenderableManager::Builder& RenderableManager::Builder::geometry(size_t index,
         PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices,
         size_t offset, size_t minIndex, size_t maxIndex, size_t count) noexcept {
     std::vector<Entry>& entries = mImpl->mEntries;
-    if (index < entries.size()) {
+    if (index < mImpl->mPrimitiveCount) {
         entries[index].vertices = vertices;
         entries[index].indices = indices;
         entries[index].offset = offset;
@@ -99,12 +104,60 @@ RenderableManager::Builder& RenderableManager::Builder::geometry(size_t index,
 
 RenderableManager::Builder& RenderableManager::Builder::material(size_t index,
         MaterialInstance const* materialInstance) noexcept {
-    if (index < mImpl->mEntries.size()) {
+    if (index < mImpl->mPrimitiveCount) {
         mImpl->mEntries[index].materialInstance = materialInstance;
     }
     return *this;
 }
 
+RenderableManager::Builder& RenderableManager::Builder::levelsOfDetail(
+        uint8_t count, float const* screenSizes) noexcept {
+    count = std::max(uint8_t(1), std::min(count, uint8_t(MAX_LEVEL_COUNT)));
+    mImpl->mLevelCount = count;
+    std::copy_n(screenSizes, count - 1u, mImpl->mScreenSizes);
+    mImpl->mEntries.resize(count * mImpl->mPrimitiveCount);
+    return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::levelGeometry(uint8_t level, size_t index,
+        PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices,
+        size_t offset, size_t count) noexcept {
+    if (level < mImpl->mLevelCount && index < mImpl->mPrimitiveCount) {
+        Entry& entry = mImpl->mEntries[level * mImpl->mPrimitiveCount + index];
+        entry.vertices = vertices;
+        entry.indices = indices;
+        entry.offset = offset;
+        entry.minIndex = 0;
+        entry.maxIndex = vertices->getVertexCount() - 1;
+        entry.count = count;
+        entry.type = type;
+    }
+    return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::levelMaterial(uint8_t level, size_t index,
+        MaterialInstance const* materialInstance) noexcept {
+    if (level < mImpl->mLevelCount && index < mImpl->mPrimitiveCount) {
+        mImpl->mEntries[level * mImpl->mPrimitiveCount + index].materialInstance = materialInstance;
+    }
+    return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::clusters(size_t index,
+        Cluster const* clusters, size_t count) noexcept {
+    return levelClusters(0, index, clusters, count);
+}
+
+RenderableManager::Builder& RenderableManager::Builder::levelClusters(uint8_t level, size_t index,
+        Cluster const* clusters, size_t count) noexcept {
+    if (level < mImpl->mLevelCount && index < mImpl->mPrimitiveCount) {
+        Entry& entry = mImpl->mEntries[level * mImpl->mPrimitiveCount + index];
+        entry.clusters = clusters;
+        entry.clusterCount = count;
+    }
+    return *this;
+}
+
 RenderableManager::Builder& RenderableManager::Builder::boundingBox(const Box& axisAlignedBoundingBox) noexcept {
     mImpl->mAABB = axisAlignedBoundingBox;
     return *this;
@@ -160,8 +213,9 @@ RenderableManager::Builder& RenderableManager::Builder::morphing(bool enable) no
 }
 
 RenderableManager::Builder& RenderableManager::Builder::blendOrder(size_t index, uint16_t blendOrder) noexcept {
-    if (index < mImpl->mEntries.size()) {
-        mImpl->mEntries[index].blendOrder = blendOrder;
+    // the blend order applies to the primitive at all levels of detail
+    for (size_t i = index, c = mImpl->mEntries.size(); i < c; i += mImpl->mPrimitiveCount) {
+        mImpl->mEntries[i].blendOrder = blendOrder;
     }
     return *this;
 }
@@ -209,6 +263,20 @@ RenderableManager::Builder::Result RenderableManager::Builder::build(Engine& eng
             return Error;
         }
 
+        // clusters must tile the primitive's index range exactly
+        size_t clusterEnd = entry.offset;
+        for (size_t c = 0; c < entry.clusterCount; c++) {
+            clusterEnd = entry.clusters[c].offset == clusterEnd ?
+                    clusterEnd + entry.clusters[c].count : std::numeric_limits<size_t>::max();
+        }
+        if (!ASSERT_PRECONDITION_NON_FATAL(!entry.clusterCount ||
+                        clusterEnd == entry.offset + entry.count,
+                "[entity=%u, primitive @ %u] clusters don't cover the primitive's indices",
+                entity.getId(), i)) {
+            entry.vertices = nullptr;
+            return Error;
+        }
+
         // this can't be an error because (1) those values are not immutable, so the caller
         // could fix later, and (2) the material's shader will work (i.e. compile), and
         // use the default values for this attribute, which maybe be acceptable.
@@ -275,6 +343,10 @@ void FRenderableManager::create(
         }
         setPrimitives(ci, { rp, size_type(builder->mEntries.size()) });
 
+        LevelOfDetail& lod = manager[ci].lod;
+        lod.count = builder->mLevelCount;
+        setLevelsOfDetail(ci, builder->mScreenSizes);
+
         setAxisAlignedBoundingBox(ci, builder->mAABB);
         setLayerMask(ci, builder->mLayerMask);
         setPriority(ci, builder->mPriority);
@@ -288,21 +360,7 @@ void FRenderableManager::create(
         const size_t count = builder->mSkinningBoneCount;
         if (UTILS_UNLIKELY(count > 0 || builder->mMorphingEnabled)) {
             std::unique_ptr<Bones>& bones = manager[ci].bones;
-            // Note that we are sizing the bones UBO according to CONFIG_MAX_BONE_COUNT rather than
-            // mSkinningBoneCount. According to the OpenGL ES 3.2 specification in 7.6.3 Uniform
-            // Buffer Object Bindings:
-            //
-            //     the uniform block must be populated with a buffer object with a size no smaller
-            //     than the minimum required size of the uniform block (the value of
-            //     UNIFORM_BLOCK_DATA_SIZE).
-            //
-            // This unfortunately means that we are using a large memory footprint for skinned
-            // renderables. In the future we could try addressing this by implementing a paging
-            // system such that multiple skinned renderables will share regions within a single
-            // large block of bones.
             bones = std::unique_ptr<Bones>(new Bones{
-                    driver.createUniformBuffer(CONFIG_MAX_BONE_COUNT * sizeof(PerRenderableUibBone),
-                            backend::BufferUsage::DYNAMIC),
                     UniformBuffer{ count * sizeof(PerRenderableUibBone) },
                     count
             });
@@ -353,16 +411,10 @@ void FRenderableManager::destroyComponent(Instance ci) noexcept {
     auto& manager = mManager;
     FEngine& engine = mEngine;
 
-    FEngine::DriverApi& driver = engine.getDriverApi();
-
     // See create(RenderableManager::Builder&, Entity)
     destroyComponentPrimitives(engine, manager[ci].primitives);
 
-    // destroy the bones structures if any
-    std::unique_ptr<Bones> const& bones = manager[ci].bones;
-    if (bones) {
-        driver.destroyUniformBuffer(bones->handle);
-    }
+    // the bones structures, if any, are destroyed with the component
 }
 
 void FRenderableManager::destroyComponentPrimitives(
@@ -374,28 +426,21 @@ void FRenderableManager::destroyComponentPrimitives(
 }
 
 
-void FRenderableManager::prepare(
-        backend::DriverApi& UTILS_RESTRICT driver,
-        Instance const* UTILS_RESTRICT instances,
-        utils::Range<uint32_t> list) const noexcept {
-    auto& manager = mManager;
-
-    std::unique_ptr<Bones>  const * const UTILS_RESTRICT bones = manager.raw_array<BONES>();
-    for (uint32_t index : list) {
-        size_t i = instances[index].asValue();
-        assert(i);  // we should never get the null instance here
-        if (UTILS_UNLIKELY(bones[i])) {
-            if (bones[i]->bones.isDirty()) {
-                driver.loadUniformBuffer(bones[i]->handle, bones[i]->bones.toBufferDescriptor(driver));
-            }
-        }
+Slice<FRenderPrimitive> FRenderableManager::getRenderPrimitives(
+        Instance instance, uint8_t level) const noexcept {
+    Slice<FRenderPrimitive> primitives = mManager[instance].primitives;
+    const size_t count = getLevelCount(instance);
+    if (UTILS_UNLIKELY(level >= count)) {
+        return {};
     }
+    const size_t size = primitives.size() / count;
+    return { primitives.begin() + level * size, Slice<FRenderPrimitive>::size_type(size) };
 }
 
 void FRenderableManager::setMaterialInstanceAt(Instance instance, uint8_t level,
         size_t primitiveIndex, FMaterialInstance const* mi) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].setMaterialInstance(upcast(mi));
             AttributeBitset required = mi->getMaterial()->getRequiredAttributes();
@@ -412,7 +457,7 @@ void FRenderableManager::setMaterialInstanceAt(Instance instance, uint8_t level,
 MaterialInstance* FRenderableManager::getMaterialInstanceAt(
         Instance instance, uint8_t level, size_t primitiveIndex) const noexcept {
     if (instance) {
-        const Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> const primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             // We store the material instance as const because we don't want to change it internally
             // but when the user queries it, we want to allow them to call setParameter()
@@ -425,7 +470,7 @@ MaterialInstance* FRenderableManager::getMaterialInstanceAt(
 void FRenderableManager::setBlendOrderAt(Instance instance, uint8_t level,
         size_t primitiveIndex, uint16_t order) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].setBlendOrder(order);
         }
@@ -435,7 +480,7 @@ void FRenderableManager::setBlendOrderAt(Instance instance, uint8_t level,
 AttributeBitset FRenderableManager::getEnabledAttributesAt(
         Instance instance, uint8_t level, size_t primitiveIndex) const noexcept {
     if (instance) {
-        Slice<FRenderPrimitive> const& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> const primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             return primitives[primitiveIndex].getEnabledAttributes();
         }
@@ -447,7 +492,7 @@ void FRenderableManager::setGeometryAt(Instance instance, uint8_t level, size_t
         PrimitiveType type, FVertexBuffer* vertices, FIndexBuffer* indices,
         size_t offset, size_t count) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].set(mEngine, type, vertices, indices, offset,
                     0, vertices->getVertexCount() - 1, count);
@@ -458,7 +503,7 @@ void FRenderableManager::setGeometryAt(Instance instance, uint8_t level, size_t
 void FRenderableManager::setGeometryAt(Instance instance, uint8_t level, size_t primitiveIndex,
         PrimitiveType type, size_t offset, size_t count) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].set(mEngine, type, offset, 0, 0, count);
         }
@@ -588,6 +633,14 @@ size_t RenderableManager::getPrimitiveCount(Instance instance) const noexcept {
     return upcast(this)->getPrimitiveCount(instance, 0);
 }
 
+size_t RenderableManager::getLevelCount(Instance instance) const noexcept {
+    return upcast(this)->getLevelCount(instance);
+}
+
+void RenderableManager::setLevelsOfDetail(Instance instance, float const* screenSizes) noexcept {
+    upcast(this)->setLevelsOfDetail(instance, screenSizes);
+}
+
 void RenderableManager::setMaterialInstanceAt(Instance instance,
         size_t primitiveIndex, MaterialInstance const* materialInstance) noexcept {
     upcast(this)->setMaterialInstanceAt(instance, 0, primitiveIndex, upcast(materialInstance));
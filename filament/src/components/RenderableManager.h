@@ -35,6 +35,8 @@
 #include <utils/Slice.h>
 #include <utils/Range.h>
 
+#include <algorithm>
+
 // for gtest
 class FilamentTest_Bones_Test;
 
@@ -58,6 +60,16 @@ public:
         bool morphing       : 1;
     };
 
+    // Screen-size thresholds of the levels of detail of a renderable. Level i is used when the
+    // renderable covers at least screenSizes[i] of the viewport height, the last level otherwise.
+    struct LevelOfDetail {
+        float screenSizes[MAX_LEVEL_COUNT - 1];
+        uint8_t count;      // number of levels, all levels have the same number of primitives
+    };
+
+    // relative change of screen size needed to switch level, to avoid popping at the thresholds
+    static constexpr float LOD_HYSTERESIS = 0.1f;
+
     explicit FRenderableManager(FEngine& engine) noexcept;
     ~FRenderableManager();
 
@@ -76,16 +88,18 @@ public:
         return mManager.getInstance(e);
     }
 
+    size_t getComponentCount() const noexcept {
+        return mManager.getComponentCount();
+    }
+
+    utils::Entity getEntity(Instance i) const noexcept {
+        return mManager.getEntity(i);
+    }
+
     void create(const RenderableManager::Builder& builder, utils::Entity entity);
 
     void destroy(utils::Entity e) noexcept;
 
-    // - instances is a list of Instance (typically the list from a given scene)
-    // - list is a list of index in 'instances' (typically the visible ones)
-    void prepare(backend::DriverApi& driver,
-            RenderableManager::Instance const* instances,
-            utils::Range<uint32_t> list) const noexcept;
-
     void gc(utils::EntityManager& em) noexcept {
         mManager.gc(em);
     }
@@ -105,6 +119,7 @@ public:
     inline void setSkinning(Instance instance, bool enable) noexcept;
     inline void setMorphing(Instance instance, bool enable) noexcept;
     inline void setPrimitives(Instance instance, utils::Slice<FRenderPrimitive> const& primitives) noexcept;
+    inline void setLevelsOfDetail(Instance instance, float const* screenSizes) noexcept;
     inline void setBones(Instance instance, Bone const* transforms, size_t boneCount, size_t offset = 0) noexcept;
     inline void setBones(Instance instance, math::mat4f const* transforms, size_t boneCount, size_t offset = 0) noexcept;
     inline void setMorphWeights(Instance instance, const math::float4& weights) noexcept;
@@ -122,11 +137,19 @@ public:
     inline uint8_t getPriority(Instance instance) const noexcept;
     inline filament::math::float4 getMorphWeights(Instance instance) const noexcept;
 
-    inline backend::Handle<backend::HwUniformBuffer> getBonesUbh(Instance instance) const noexcept;
+    // the bone palette of skinned or morphed renderables, nullptr for other renderables
+    inline UniformBuffer const* getBones(Instance instance) const noexcept;
     inline uint32_t getBoneCount(Instance instance) const noexcept;
 
 
-    inline size_t getLevelCount(Instance instance) const noexcept { return 1; }
+    inline size_t getLevelCount(Instance instance) const noexcept;
+    inline LevelOfDetail const& getLevelOfDetail(Instance instance) const noexcept;
+
+    // returns the level to use for a renderable covering screenSize of the viewport height,
+    // only leaving the current level once the size is LOD_HYSTERESIS past a threshold. The
+    // current level is the one selected last, which is tracked by each view.
+    static inline uint8_t selectLevel(LevelOfDetail const& lod, uint8_t current,
+            float screenSize) noexcept;
     inline size_t getPrimitiveCount(Instance instance, uint8_t level) const noexcept;
     void setMaterialInstanceAt(Instance instance, uint8_t level,
             size_t primitiveIndex, FMaterialInstance const* materialInstance) noexcept;
@@ -138,16 +161,15 @@ public:
             PrimitiveType type, size_t offset, size_t count) noexcept;
     void setBlendOrderAt(Instance instance, uint8_t level, size_t primitiveIndex, uint16_t blendOrder) noexcept;
     AttributeBitset getEnabledAttributesAt(Instance instance, uint8_t level, size_t primitiveIndex) const noexcept;
-    inline utils::Slice<FRenderPrimitive> const& getRenderPrimitives(Instance instance, uint8_t level) const noexcept;
-    inline utils::Slice<FRenderPrimitive>& getRenderPrimitives(Instance instance, uint8_t level) noexcept;
+    utils::Slice<FRenderPrimitive> getRenderPrimitives(Instance instance, uint8_t level) const noexcept;
 
 private:
     void destroyComponent(Instance ci) noexcept;
     static void destroyComponentPrimitives(FEngine& engine,
             utils::Slice<FRenderPrimitive>& primitives) noexcept;
 
+    // the bone palettes are copied into the view's bones UBO each frame, see FScene::updateUBOs()
     struct Bones {
-        filament::backend::Handle<backend::HwUniformBuffer> handle;
         UniformBuffer bones;
         size_t count;
     };
@@ -161,8 +183,9 @@ private:
         LAYERS,             // user data
         MORPH_WEIGHTS,      // user data
         VISIBILITY,         // user data
-        PRIMITIVES,         // user data
-        BONES,              // filament data, UBO storing a pointer to the bones information
+        PRIMITIVES,         // user data, the primitives of all levels, one level after the other
+        LOD,                // user data
+        BONES,              // filament data, the bone palette
     };
 
     using Base = utils::SingleInstanceComponentManager<
@@ -171,6 +194,7 @@ private:
             filament::math::float4,          // MORPH_WEIGHTS
             Visibility,                      // VISIBILITY
             utils::Slice<FRenderPrimitive>,  // PRIMITIVES
+            LevelOfDetail,                   // LOD
             std::unique_ptr<Bones>           // BONES
     >;
 
@@ -178,6 +202,8 @@ private:
         using Base::gc;
         using Base::swap;
 
+        Sim() noexcept : Base(Base::Lookup::SPARSE_SET) { }
+
         struct Proxy {
             // all of this gets inlined
             UTILS_ALWAYS_INLINE
@@ -191,6 +217,7 @@ private:
                 Field<MORPH_WEIGHTS> morphWeights;
                 Field<VISIBILITY>   visibility;
                 Field<PRIMITIVES>   primitives;
+                Field<LOD>          lod;
                 Field<BONES>        bones;
             };
         };
@@ -278,6 +305,13 @@ void FRenderableManager::setPrimitives(Instance instance,
     }
 }
 
+void FRenderableManager::setLevelsOfDetail(Instance instance, float const* screenSizes) noexcept {
+    if (instance) {
+        LevelOfDetail& lod = mManager[instance].lod;
+        std::copy_n(screenSizes, lod.count - 1u, lod.screenSizes);
+    }
+}
+
 FRenderableManager::Visibility
 FRenderableManager::getVisibility(Instance instance) const noexcept {
     return mManager[instance].visibility;
@@ -311,9 +345,9 @@ Box const& FRenderableManager::getAABB(Instance instance) const noexcept {
     return mManager[instance].aabb;
 }
 
-backend::Handle<backend::HwUniformBuffer> FRenderableManager::getBonesUbh(Instance instance) const noexcept {
+UniformBuffer const* FRenderableManager::getBones(Instance instance) const noexcept {
     std::unique_ptr<Bones> const& bones = mManager[instance].bones;
-    return bones ? bones->handle : backend::Handle<backend::HwUniformBuffer>{};
+    return bones ? &bones->bones : nullptr;
 }
 
 inline uint32_t FRenderableManager::getBoneCount(Instance instance) const noexcept {
@@ -321,14 +355,37 @@ inline uint32_t FRenderableManager::getBoneCount(Instance instance) const noexce
     return bones ? bones->count : 0;
 }
 
-utils::Slice<FRenderPrimitive> const& FRenderableManager::getRenderPrimitives(
-        Instance instance, uint8_t level) const noexcept {
-    return mManager[instance].primitives;
+size_t FRenderableManager::getLevelCount(Instance instance) const noexcept {
+    LevelOfDetail const& lod = mManager[instance].lod;
+    return lod.count;
+}
+
+FRenderableManager::LevelOfDetail const& FRenderableManager::getLevelOfDetail(
+        Instance instance) const noexcept {
+    return mManager[instance].lod;
 }
 
-utils::Slice<FRenderPrimitive>& FRenderableManager::getRenderPrimitives(
-        Instance instance, uint8_t level) noexcept {
-    return mManager[instance].primitives;
+uint8_t FRenderableManager::selectLevel(LevelOfDetail const& lod, uint8_t current,
+        float screenSize) noexcept {
+    // the first level whose threshold is met by the size
+    auto levelAt = [&lod](float size) -> uint8_t {
+        uint8_t level = 0;
+        while (level < lod.count - 1u && size < lod.screenSizes[level]) {
+            level++;
+        }
+        return level;
+    };
+    // a finer level is only selected if the size is clearly above its threshold, and a coarser
+    // level only if the size is clearly below the current level's threshold.
+    const uint8_t finer = levelAt(screenSize * (1.0f / (1.0f + LOD_HYSTERESIS)));
+    const uint8_t coarser = levelAt(screenSize * (1.0f + LOD_HYSTERESIS));
+    if (finer < current) {
+        return finer;
+    }
+    if (coarser > current) {
+        return coarser;
+    }
+    return current;
 }
 
 size_t FRenderableManager::getPrimitiveCount(Instance instance, uint8_t level) const noexcept {
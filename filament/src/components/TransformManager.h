@@ -127,6 +127,8 @@ private:
         using Base::gc;
         using Base::swap;
 
+        Sim() noexcept : Base(Base::Lookup::SPARSE_SET) { }
+
         typename Base::SoA& getSoA() { return mData; }
 
         struct Proxy {
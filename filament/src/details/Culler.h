@@ -48,6 +48,19 @@ public:
 
     using result_type = uint8_t;
 
+    // maximum number of frustums an AABB can be tested against in a single pass
+    static constexpr size_t MAX_FRUSTUM_COUNT = sizeof(result_type) * 8;
+
+    // Instruction sets the culling kernels are written for. The best one supported by the CPU
+    // is picked at runtime.
+    enum class Isa : uint8_t {
+        SCALAR,     // relies on auto-vectorization
+        SSE2,
+        AVX2,
+        AVX512,
+        NEON
+    };
+
     /*
      * returns whether each AABB in an array intersects with the frustum
      */
@@ -57,6 +70,17 @@ public:
             math::float3 const* extent,
             size_t count, size_t bit) noexcept;
 
+    /*
+     * returns whether each AABB in an array intersects with each of the given frustums, in a
+     * single pass over the AABBs. Frustum f sets bit 'bit + f' of the results, which can't
+     * exceed MAX_FRUSTUM_COUNT bits.
+     */
+    static void intersects(result_type* results,
+            Frustum const* frustums, size_t frustumCount,
+            math::float3 const* center,
+            math::float3 const* extent,
+            size_t count, size_t bit) noexcept;
+
     /*
      * returns whether each sphere in an array intersects with the frustum
      */
@@ -92,6 +116,15 @@ public:
                 Frustum const& frustum,
                 math::float4 const* b,
                 size_t count) noexcept;
+
+        // Selects the kernels used by all culling functions, returns false if the CPU doesn't
+        // support this instruction set. This is not thread-safe and only meant for tests and
+        // benchmarks.
+        static bool setIsa(Isa isa) noexcept;
+
+        static Isa getIsa() noexcept;
+
+        static const char* getIsaName(Isa isa) noexcept;
     };
 };
 
@@ -70,6 +70,7 @@ class DebugServer;
 #include <chrono>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace filament {
 
@@ -140,6 +141,9 @@ public:
 
     backend::Driver& getDriver() const noexcept { return *mDriver; }
     DriverApi& getDriverApi() noexcept { return mCommandStream; }
+    backend::CommandBufferQueue const& getCommandBufferQueue() const noexcept {
+        return mCommandBufferQueue;
+    }
     DFG* getDFG() const noexcept { return mDFG.get(); }
 
     // the per-frame Area is used by all Renderer, so they must run in sequence and
@@ -270,6 +274,10 @@ public:
     void prepare();
     void gc();
 
+    // textures whose prefiltered mipmaps are being generated asynchronously
+    void addPrefilteringTexture(FTexture* texture);
+    void removePrefilteringTexture(FTexture* texture) noexcept;
+
     filaflat::ShaderBuilder& getVertexShaderBuilder() const noexcept {
         return mVertexShaderBuilder;
     }
@@ -291,6 +299,7 @@ private:
 
     int loop();
     void flushCommandBuffer(backend::CommandBufferQueue& commandBufferQueue);
+    void uploadPrefilteredTextures();
 
     template<typename T, typename L>
     void terminateAndDestroy(const T* p, ResourceList<T, L>& list);
@@ -332,6 +341,8 @@ private:
     ResourceList<FSkybox> mSkyboxes{ "Skybox" };
     ResourceList<FRenderTarget> mRenderTargets{ "RenderTarget" };
 
+    std::vector<FTexture*> mPrefilteringTextures;
+
     mutable uint32_t mMaterialId = 0;
 
     // FMaterialInstance are handled directly by FMaterial
@@ -102,6 +102,10 @@ public:
 
     void setOptions(float zLightNear, float zLightFar) noexcept;
 
+    // Limits the number of froxels, which can't exceed FROXEL_BUFFER_ENTRY_COUNT_MAX. Fewer
+    // froxels make froxelization cheaper, at the cost of a coarser light culling.
+    void setMaxFroxelCount(size_t count) noexcept;
+
     /*
      * Allocate per-frame data structures for froxelization.
      *
@@ -225,7 +229,7 @@ private:
 
     static void computeFroxelLayout(
             math::uint2* dim, uint16_t* countX, uint16_t* countY, uint16_t* countZ,
-            Viewport const& viewport) noexcept;
+            Viewport const& viewport, size_t maxFroxelCount) noexcept;
 
     // internal state dependant on the viewport and needed for froxelizing
     LinearAllocatorArena mArena;                    // ~256 KiB
@@ -264,6 +268,7 @@ private:
     float mNear = 0.0f;        // camera near
     float mZLightFar = FEngine::CONFIG_Z_LIGHT_FAR;
     float mZLightNear = FEngine::CONFIG_Z_LIGHT_NEAR;  // light near (first slice)
+    uint16_t mMaxFroxelCount = FROXEL_BUFFER_ENTRY_COUNT_MAX;
 
     // track if we need to update our internal state before froxelizing
     uint8_t mDirtyFlags = 0;
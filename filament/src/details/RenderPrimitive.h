@@ -24,6 +24,9 @@
 #include <backend/Handle.h>
 
 #include <utils/compiler.h>
+#include <utils/Slice.h>
+
+#include <limits>
 
 namespace filament {
 namespace details {
@@ -35,6 +38,19 @@ class FRenderer;
 
 class FRenderPrimitive {
 public:
+    using Cluster = RenderableManager::Cluster;
+
+    // A range of indices drawn instead of the whole primitive, made by cluster culling. The
+    // primitive's own range is kept so it can be restored after the draw.
+    struct IndexRange {
+        uint32_t offset;
+        uint32_t count;
+        uint32_t primitiveOffset;
+        uint32_t primitiveCount;
+        backend::PrimitiveType type;
+    };
+    static constexpr uint32_t NO_INDEX_RANGE = std::numeric_limits<uint32_t>::max();
+
     FRenderPrimitive() noexcept = default;
 
     void init(backend::DriverApi& driver, const RenderableManager::Builder::Entry& entry) noexcept;
@@ -55,17 +71,34 @@ public:
     AttributeBitset getEnabledAttributes() const noexcept { return mEnabledAttributes; }
     uint16_t getBlendOrder() const noexcept { return mBlendOrder; }
 
+    // The clusters and the index range they cover. The range is only tracked for clustered
+    // primitives; it is empty otherwise.
+    utils::Slice<const Cluster> getClusters() const noexcept { return mClusters; }
+    uint32_t getIndexOffset() const noexcept { return mIndexOffset; }
+    uint32_t getIndexCount() const noexcept { return mIndexCount; }
+
+    // Index of the IndexRange to draw, or NO_INDEX_RANGE to draw the whole primitive. Only set
+    // on the per-frame copies made by cluster culling.
+    uint32_t getIndexRange() const noexcept { return mIndexRange; }
+    void setIndexRange(uint32_t index) noexcept { mIndexRange = index; }
+
     void setMaterialInstance(FMaterialInstance const* mi) noexcept { mMaterialInstance = mi; }
     void setBlendOrder(uint16_t order) noexcept {
         mBlendOrder = static_cast<uint16_t>(order & 0x7FFF);
     }
 
 private:
+    void clearClusters() noexcept;
+
     FMaterialInstance const* mMaterialInstance = nullptr;
     backend::Handle<backend::HwRenderPrimitive> mHandle;
     backend::PrimitiveType mPrimitiveType = backend::PrimitiveType::NONE;
     AttributeBitset mEnabledAttributes;
     uint16_t mBlendOrder = 0;
+    utils::Slice<const Cluster> mClusters;
+    uint32_t mIndexOffset = 0;
+    uint32_t mIndexCount = 0;
+    uint32_t mIndexRange = NO_INDEX_RANGE;
 };
 
 } // namespace details
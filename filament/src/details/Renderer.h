@@ -80,6 +80,18 @@ public:
 
     void resetUserTime();
 
+    void setCpuCountersSamplingInterval(uint32_t interval) noexcept {
+        mFrameInfoManager.setCpuCountersSamplingInterval(interval);
+    }
+
+    size_t getFrameCpuCounters(FrameCpuCounters* out, size_t count) const noexcept {
+        return mFrameInfoManager.getFrameCpuCounters(out, count);
+    }
+
+    size_t getFrameTimings(FrameTimings* out, size_t count) const noexcept {
+        return mFrameInfoManager.getFrameTimings(out, count);
+    }
+
     void readPixels(uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
             backend::PixelBufferDescriptor&& buffer);
 
@@ -36,6 +36,7 @@
 #include <utils/Range.h>
 
 #include <cstddef>
+#include <limits>
 #include <tsl/robin_set.h>
 
 namespace filament {
@@ -78,18 +79,27 @@ public:
     // for that in a few places.
     static constexpr size_t DIRECTIONAL_LIGHTS_COUNT = 1;
 
+    // BONES_OFFSET of the renderables that don't have bones
+    static constexpr uint32_t NO_BONES = std::numeric_limits<uint32_t>::max();
+
     explicit FScene(FEngine& engine);
     ~FScene() noexcept;
     void terminate(FEngine& engine);
 
     void prepare(const math::mat4f& worldOriginTransform);
-    void prepareDynamicLights(const CameraInfo& camera, ArenaScope& arena, backend::Handle<backend::HwUniformBuffer> lightUbh) noexcept;
+    // keeps at most maxLightCount point and spot lights, the closest to the camera
+    void prepareDynamicLights(const CameraInfo& camera, ArenaScope& arena,
+            backend::Handle<backend::HwUniformBuffer> lightUbh, size_t maxLightCount) noexcept;
 
 
     filament::backend::Handle<backend::HwUniformBuffer> getRenderableUBO() const noexcept {
         return mRenderableViewUbh;
     }
 
+    filament::backend::Handle<backend::HwUniformBuffer> getBonesUBO() const noexcept {
+        return mBonesViewUbh;
+    }
+
     /*
      * Storage for per-frame renderable data
      */
@@ -99,7 +109,7 @@ public:
         WORLD_TRANSFORM,        // 16 | instance of the Transform component
         REVERSED_WINDING_ORDER, //  1 | det(WORLD_TRANSFORM)<0
         VISIBILITY_STATE,       //  1 | visibility data of the component
-        BONES_UBH,              //  4 | bones uniform buffer handle
+        BONES_OFFSET,           //  4 | offset of the bone palette in the bones UBO
         WORLD_AABB_CENTER,      // 12 | world-space bounding box center of the renderable
         VISIBLE_MASK,           //  1 | each bit represents a visibility in a pass
         MORPH_WEIGHTS,          //  4 | floats for morphing
@@ -118,7 +128,7 @@ public:
             math::mat4f,                                // WORLD_TRANSFORM
             bool,                                       // REVERSED_WINDING_ORDER
             FRenderableManager::Visibility,             // VISIBILITY_STATE
-            backend::Handle<backend::HwUniformBuffer>,  // BONES_UBH
+            uint32_t,                                   // BONES_OFFSET
             math::float3,                               // WORLD_AABB_CENTER
             Culler::result_type,                        // VISIBLE_MASK
             math::float4,                               // MORPH_WEIGHTS
@@ -152,7 +162,8 @@ public:
         DIRECTION,
         LIGHT_INSTANCE,
         VISIBILITY,
-        SCREEN_SPACE_Z_RANGE
+        SCREEN_SPACE_Z_RANGE,
+        SPOT_COS_OUTER_SQUARED
     };
 
     using LightSoa = utils::StructureOfArrays<
@@ -160,13 +171,23 @@ public:
             math::float3,
             FLightManager::Instance,
             Culler::result_type,
-            math::float2
+            math::float2,
+            float
     >;
 
+    // SPOT_COS_OUTER_SQUARED of lights that aren't spot lights, their cone is never culled
+    static constexpr float NO_SPOT_CONE = -1.0f;
+
     LightSoa const& getLightData() const noexcept { return mLightData; }
     LightSoa& getLightData() noexcept { return mLightData; }
 
-    void updateUBOs(utils::Range<uint32_t> visibleRenderables, backend::Handle<backend::HwUniformBuffer> renderableUbh) noexcept;
+    // Suballocates the bone palettes of the visible renderables that have bones, one after
+    // the other, and returns the size they need in the bones UBO.
+    size_t computeBonesOffsets(utils::Range<uint32_t> visibleRenderables) noexcept;
+
+    void updateUBOs(utils::Range<uint32_t> visibleRenderables,
+            backend::Handle<backend::HwUniformBuffer> renderableUbh,
+            backend::Handle<backend::HwUniformBuffer> bonesUbh, size_t bonesSize) noexcept;
 
 private:
     static inline void computeLightRanges(math::float2* zrange,
@@ -196,6 +217,7 @@ private:
     RenderableSoa mRenderableData;
     LightSoa mLightData;
     backend::Handle<backend::HwUniformBuffer> mRenderableViewUbh; // This is actually owned by the view.
+    backend::Handle<backend::HwUniformBuffer> mBonesViewUbh; // This is actually owned by the view.
 };
 
 FILAMENT_UPCAST(Scene)
@@ -44,9 +44,11 @@ public:
     void terminate(backend::DriverApi& driverApi) noexcept;
 
     // Call once per frame if the light, scene (or visible layers) or camera changes.
-    // This computes the light's camera.
+    // This computes the light's camera. distanceScale shortens the distance up to which
+    // shadows are cast, which defaults to the camera's far plane.
     void update(const FScene::LightSoa& lightData, size_t index, FScene const* scene,
-            details::CameraInfo const& camera, uint8_t visibleLayers) noexcept;
+            details::CameraInfo const& camera, uint8_t visibleLayers,
+            float distanceScale = 1.0f) noexcept;
 
     void render(backend::DriverApi& driver, RenderPass& pass, FView& view) noexcept;
 
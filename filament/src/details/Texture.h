@@ -25,6 +25,8 @@
 
 #include <utils/compiler.h>
 
+#include <memory>
+
 namespace filament {
 namespace details {
 
@@ -38,6 +40,7 @@ public:
             size_t stride, size_t height, size_t alignment) noexcept;
 
     FTexture(FEngine& engine, const Builder& builder);
+    ~FTexture() noexcept;
 
     // frees driver resources, object becomes invalid
     void terminate(FEngine& engine);
@@ -64,6 +67,22 @@ public:
             PixelBufferDescriptor&& buffer, const FaceOffsets& faceOffsets,
             PrefilterOptions const* options);
 
+    void generatePrefilterMipmapAsync(FEngine& engine,
+            PixelBufferDescriptor&& buffer, const FaceOffsets& faceOffsets,
+            PrefilterOptions const* options, PrefilterCallback callback, void* user);
+
+    struct PrefilterCompletion {
+        PrefilterCallback callback;
+        void* user;
+    };
+
+    // Uploads the levels generated asynchronously since the last call. Returns true once all
+    // levels are uploaded, the callback to invoke is then returned in completion.
+    bool uploadPrefilteredLevels(FEngine& engine, PrefilterCompletion* completion);
+
+    // stops and waits for the asynchronous prefiltering, if any
+    void cancelPrefilterMipmap(FEngine& engine);
+
     void setExternalImage(FEngine& engine, void* image) noexcept;
     void setExternalImage(FEngine& engine, void* image, size_t plane) noexcept;
     void setExternalStream(FEngine& engine, FStream* stream) noexcept;
@@ -87,6 +106,7 @@ public:
 
 private:
     friend class Texture;
+    struct PrefilterTask;
     backend::Handle<backend::HwTexture> mHandle;
     uint32_t mWidth = 1;
     uint32_t mHeight = 1;
@@ -97,6 +117,7 @@ private:
     uint8_t mSampleCount = 1;
     FStream* mStream = nullptr;
     Usage mUsage = Usage::DEFAULT;
+    std::unique_ptr<PrefilterTask> mPrefilterTask;
 };
 
 
@@ -17,6 +17,7 @@
 #ifndef TNT_FILAMENT_DETAILS_VIEW_H
 #define TNT_FILAMENT_DETAILS_VIEW_H
 
+#include <filament/Renderer.h>
 #include <filament/View.h>
 
 #include "upcast.h"
@@ -26,6 +27,7 @@
 #include "details/Allocators.h"
 #include "details/Camera.h"
 #include "details/Froxelizer.h"
+#include "details/RenderPrimitive.h"
 #include "details/RenderTarget.h"
 #include "details/ShadowMap.h"
 #include "details/Scene.h"
@@ -35,6 +37,7 @@
 #include <backend/Handle.h>
 
 #include <utils/compiler.h>
+#include <utils/Entity.h>
 #include <utils/Allocator.h>
 #include <utils/StructureOfArrays.h>
 #include <utils/Slice.h>
@@ -43,12 +46,16 @@
 #include <math/scalar.h>
 
 #include <array>
+#include <vector>
 
 namespace utils {
 class JobSystem;
 } // namespace utils;
 
 namespace filament {
+
+class FrameInfo;
+
 namespace details {
 
 class FEngine;
@@ -65,8 +72,10 @@ public:
 
     void terminate(FEngine& engine);
 
+    // frameInfo, if not null, receives the timings of the scene preparation, culling and shadows
     void prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& arena,
-            Viewport const& viewport, math::float4 const& userTime) noexcept;
+            Viewport const& viewport, math::float4 const& userTime,
+            FrameInfo* frameInfo = nullptr) noexcept;
 
     void setScene(FScene* scene) { mScene = scene; }
     FScene const* getScene() const noexcept { return mScene; }
@@ -122,8 +131,11 @@ public:
     }
 
     void prepareCamera(const CameraInfo& camera, const Viewport& viewport) const noexcept;
+    // returns whether shadow casters must be culled, against shadowFrustum
+    bool prepareShadowCamera(FEngine& engine,
+            FScene::LightSoa const& lightData, Frustum& shadowFrustum) noexcept;
     void prepareShadowing(FEngine& engine, backend::DriverApi& driver,
-            FScene::RenderableSoa& renderableData, FScene::LightSoa const& lightData) noexcept;
+            FScene::LightSoa const& lightData) noexcept;
     void prepareLighting(FEngine& engine, FEngine::DriverApi& driver,
             ArenaScope& arena, Viewport const& viewport) noexcept;
     void prepareSSAO(backend::Handle<backend::HwTexture> ssao) const noexcept;
@@ -140,8 +152,18 @@ public:
             FEngine& engine, const CameraInfo& camera,
             FScene::RenderableSoa& renderableData, Range visible) noexcept;
 
+    // Replaces the primitives of the visible renderables that have clusters with per-frame
+    // copies that only draw the clusters that can be seen from the culling camera. This must be
+    // called after updatePrimitivesLod(), and only affects the passes generated afterwards.
+    // Returns the index ranges the copies refer to, see RenderPass::setIndexRanges().
+    utils::Slice<const FRenderPrimitive::IndexRange> cullClusters(FEngine& engine,
+            ArenaScope& arena, FScene::RenderableSoa& renderableData, Range visible) const noexcept;
+
     void setShadowsEnabled(bool enabled) noexcept { mShadowingEnabled = enabled; }
 
+    void setLodBias(float bias) noexcept { mLodBias = bias; }
+    float getLodBias() const noexcept { return mLodBias; }
+
     ShadowMap const& getShadowMap() const { return mDirectionalShadowMap; }
     ShadowMap& getShadowMap() { return mDirectionalShadowMap; }
 
@@ -208,6 +230,22 @@ public:
         return mDynamicResolution;
     }
 
+    // Feeds the timings of the last completed frame to the CPU budget controller, frameId is
+    // the frame about to be rendered. Each frame's timings are only used once.
+    void updateCpuBudget(Renderer::FrameTimings const& timings, uint32_t frameId) noexcept;
+
+    void setCpuBudgetOptions(CpuBudgetOptions const& options) noexcept;
+
+    CpuBudgetOptions getCpuBudgetOptions() const noexcept {
+        return mCpuBudget.options;
+    }
+
+    // these account for the steps taken by the CPU budget controller
+    float getEffectiveLodBias() const noexcept;
+    float getShadowDistanceScale() const noexcept;
+    size_t getMaxLightCount() const noexcept;
+    size_t getMaxFroxelCount() const noexcept;
+
     void setRenderQuality(RenderQuality const& renderQuality) noexcept {
         mRenderQuality = renderQuality;
     }
@@ -281,21 +319,54 @@ public:
         return mRenderTarget == nullptr ? kEmptyHandle : mRenderTarget->getHwHandle();
     }
 
+    // Lights are culled in chunks of LIGHT_CULLING_CHUNK_SIZE lights, each chunk in parallel.
+    static constexpr uint32_t LIGHT_CULLING_CHUNK_SIZE = 256;
+    static_assert(LIGHT_CULLING_CHUNK_SIZE % Culler::MODULO == 0,
+            "light culling chunks must be a multiple of Culler::MODULO");
+
+    static uint32_t getLightCullingChunkCount(size_t lightCount) noexcept {
+        return uint32_t((lightCount + LIGHT_CULLING_CHUNK_SIZE - 1) / LIGHT_CULLING_CHUNK_SIZE);
+    }
+
+    // chunkCounts is scratch space for getLightCullingChunkCount(lightData.size()) counts
+    static void prepareVisibleLights(utils::JobSystem& js, Frustum const& frustum,
+            FScene::LightSoa& lightData, uint32_t* chunkCounts) noexcept;
+
+    // eye is the homogeneous position of the culling camera, in the same space as frustum. For
+    // orthographic projections it is at infinity: w is 0 and xyz points away from the view
+    // direction.
+    static utils::Slice<const FRenderPrimitive::IndexRange> cullClusters(utils::JobSystem& js,
+            ArenaScope& arena, Frustum const& frustum, math::float4 eye, bool inverseFrontFaces,
+            FScene::RenderableSoa& renderableData, Range visible) noexcept;
+
+    static void cullSpotLights(Culler::result_type* visible, math::float4 const* planes,
+            math::float4 const* spheres, math::float3 const* directions,
+            float const* cosOuterSquared, size_t count) noexcept;
+
 private:
     static constexpr size_t MAX_FRAMETIME_HISTORY = 32u;
 
-    void prepareVisibleRenderables(utils::JobSystem& js,
-            Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept;
+    // settings adjusted by the CPU budget controller, each moves by CPU_BUDGET_STEP_COUNT steps
+    enum class CpuBudgetSetting : uint8_t {
+        GEOMETRY,       // level of detail bias
+        SHADOWS,        // shadow distance
+        LIGHTING,       // light count and froxel count
+    };
+    static constexpr size_t CPU_BUDGET_SETTING_COUNT = 3;
+    static constexpr uint8_t CPU_BUDGET_STEP_COUNT = 4;
 
-    static void prepareVisibleShadowCasters(utils::JobSystem& js,
-            Frustum const& lightFrustum, FScene::RenderableSoa& renderableData) noexcept;
+    // fraction of the way from full quality to the lowest quality of a setting
+    float getCpuBudgetRatio(CpuBudgetSetting setting) const noexcept {
+        return float(mCpuBudget.steps[size_t(setting)]) / CPU_BUDGET_STEP_COUNT;
+    }
 
-    static void prepareVisibleLights(
-            FLightManager const& lcm, utils::JobSystem& js, Frustum const& frustum,
-            FScene::LightSoa& lightData) noexcept;
+    // culls against frustum and, if not null, shadowFrustum in a single pass
+    void prepareVisibleRenderables(utils::JobSystem& js,
+            Frustum const& frustum, Frustum const* shadowFrustum,
+            FScene::RenderableSoa& renderableData) const noexcept;
 
-    static void cullRenderables(utils::JobSystem& js,
-            FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit) noexcept;
+    static void cullRenderables(utils::JobSystem& js, FScene::RenderableSoa& renderableData,
+            Frustum const* frustums, size_t frustumCount, size_t bit) noexcept;
 
     void computeVisibilityMasks(
             uint8_t visibleLayers, uint8_t const* layers,
@@ -318,6 +389,7 @@ private:
     backend::Handle<backend::HwUniformBuffer> mPerViewUbh;
     backend::Handle<backend::HwUniformBuffer> mLightUbh;
     backend::Handle<backend::HwUniformBuffer> mRenderableUbh;
+    backend::Handle<backend::HwUniformBuffer> mBonesUbh;
 
     backend::Handle<backend::HwSamplerGroup> getUsh() const noexcept { return mPerViewSbh; }
     backend::Handle<backend::HwUniformBuffer> getUbh() const noexcept { return mPerViewUbh; }
@@ -330,6 +402,23 @@ private:
     CameraInfo mViewingCameraInfo;
     Frustum mCullingFrustum;
 
+    // what's needed to compute the screen size of renderables as seen by the culling camera
+    struct LodCamera {
+        math::float4 clipW;     // the row of the culling view-projection that yields clip-space w
+        float scale;            // projection[1][1], maps view-space heights to NDC at w = 1
+    } mLodCamera = {};
+    math::float4 mCullingEye = {};  // see cullClusters(), in the same space as mCullingFrustum
+    float mLodBias = 0.0f;
+
+    // Level of detail selected last by this view for each renderable, indexed by renderable
+    // instance. Instances are reused, so the entity tells whether the level belongs to the same
+    // renderable. Keeping this per view lets each view apply its own hysteresis.
+    struct LodState {
+        utils::Entity entity;
+        uint8_t level;
+    };
+    std::vector<LodState> mLodStates;
+
     mutable Froxelizer mFroxelizer;
 
     Viewport mViewport;
@@ -363,6 +452,18 @@ private:
     float mDynamicWorkloadScale = 1.0f;
     bool mIsDynamicResolutionSupported = false;
 
+    struct CpuBudget {
+        CpuBudgetOptions options;
+        std::array<float, MAX_FRAMETIME_HISTORY> history;   // CPU times in ms, newest first
+        size_t historySize = 0;
+        float costs[CPU_BUDGET_SETTING_COUNT] = {};         // stage times since the last step
+        uint8_t steps[CPU_BUDGET_SETTING_COUNT] = {};       // 0 is full quality
+        uint32_t underBudgetCount = 0;
+        uint32_t lastFrameId = 0;       // last frame whose timings were used
+        uint32_t settleFrameId = 0;     // earlier frames were rendered before the last step
+        bool settle = true;             // the next frame starts a new measurement
+    } mCpuBudget;
+
     RenderQuality mRenderQuality;
 
     mutable UniformBuffer mPerViewUb;
@@ -374,6 +475,7 @@ private:
     Range mVisibleRenderables;
     Range mVisibleShadowCasters;
     uint32_t mRenderableUBOSize = 0;
+    uint32_t mBonesUBOSize = 0;
     mutable bool mHasDirectionalLight = false;
     mutable bool mHasDynamicLighting = false;
     mutable bool mHasShadowing = false;
@@ -16,6 +16,8 @@
 
 #include <iostream>
 #include <random>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -29,8 +31,15 @@
 #include <filament/Camera.h>
 #include <filament/Color.h>
 #include <filament/Frustum.h>
+#include <filament/IndexBuffer.h>
 #include <filament/Material.h>
 #include <filament/Engine.h>
+#include <filament/RenderableManager.h>
+#include <filament/VertexBuffer.h>
+
+#include <utils/EntityManager.h>
+
+#include <utils/JobSystem.h>
 
 #include <private/filament/UniformInterfaceBlock.h>
 #include <private/filament/UibGenerator.h>
@@ -38,10 +47,16 @@
 #include "details/Allocators.h"
 #include "details/Material.h"
 #include "details/Camera.h"
+#include "details/Culler.h"
 #include "details/Froxelizer.h"
 #include "details/Engine.h"
+#include "details/IndexBuffer.h"
+#include "details/RenderPrimitive.h"
+#include "details/VertexBuffer.h"
+#include "details/View.h"
 #include "components/RenderableManager.h"
 #include "components/TransformManager.h"
+#include "FrameInfo.h"
 #include "UniformBuffer.h"
 
 using namespace filament;
@@ -580,6 +595,271 @@ TEST(FilamentTest, SphereCulling) {
     EXPECT_TRUE(frustum.intersects({ 0, 200 }));
 }
 
+TEST(FilamentTest, CullingKernels) {
+    using filament::details::Culler;
+    constexpr size_t COUNT = 1000; // rounded up to a multiple of 8 by the Culler
+
+    std::default_random_engine gen; // NOLINT
+    std::uniform_real_distribution<float> pos(-120.0f, 120.0f);
+    std::uniform_real_distribution<float> size(0.0f, 20.0f);
+    Frustum frustum(mat4f::perspective(60.0f, 1.5f, 0.5f, 100.0f) *
+            mat4f::lookAt(float3{ 1, 2, 3 }, float3{ -5, 0, -40 }, float3{ 0, 1, 0 }));
+
+    const size_t capacity = Culler::round(COUNT);
+    std::vector<float3> centers(capacity), extents(capacity);
+    std::vector<float4> spheres(capacity);
+    for (size_t i = 0; i < capacity; i++) {
+        centers[i] = { pos(gen), pos(gen), pos(gen) };
+        extents[i] = { size(gen), size(gen), size(gen) };
+        spheres[i] = { centers[i], size(gen) };
+    }
+
+    // several frustums looking in different directions, the first one is 'frustum'
+    constexpr size_t FRUSTUM_COUNT = 5;
+    std::vector<Frustum> frustums = { frustum };
+    for (size_t f = 1; f < FRUSTUM_COUNT; f++) {
+        float3 const target{ pos(gen), pos(gen), pos(gen) };
+        frustums.emplace_back(mat4f::perspective(45.0f, 1.0f, 0.5f, 150.0f) *
+                mat4f::lookAt(float3{ 0 }, target, float3{ 0, 1, 0 }));
+    }
+
+    auto cull = [&](std::vector<Culler::result_type>& boxes,
+            std::vector<Culler::result_type>& spheresVisibility,
+            std::vector<Culler::result_type>& multiple) {
+        boxes.assign(capacity, 0x80);
+        spheresVisibility.assign(capacity, 0x80);
+        multiple.assign(capacity, 0x01);
+        Culler::intersects(boxes.data(), frustum, centers.data(), extents.data(), COUNT, 2);
+        Culler::intersects(spheresVisibility.data(), frustum, spheres.data(), COUNT);
+        Culler::intersects(multiple.data(), frustums.data(), FRUSTUM_COUNT,
+                centers.data(), extents.data(), COUNT, 1);
+    };
+
+    const Culler::Isa best = Culler::Test::getIsa();
+    ASSERT_TRUE(Culler::Test::setIsa(Culler::Isa::SCALAR));
+    std::vector<Culler::result_type> expectedBoxes, expectedSpheres, expectedMultiple;
+    cull(expectedBoxes, expectedSpheres, expectedMultiple);
+
+    // culling against several frustums in one pass is the same as culling against each
+    std::vector<Culler::result_type> separate(capacity, 0x01);
+    for (size_t f = 0; f < FRUSTUM_COUNT; f++) {
+        Culler::intersects(separate.data(), frustums[f],
+                centers.data(), extents.data(), COUNT, f + 1);
+    }
+    EXPECT_EQ(separate, expectedMultiple);
+
+    size_t visibleCount = 0;
+    for (Culler::result_type r : expectedBoxes) {
+        EXPECT_TRUE(r == 0x80 || r == 0x84);
+        visibleCount += r == 0x84;
+    }
+    EXPECT_GT(visibleCount, 0);
+    EXPECT_LT(visibleCount, capacity);
+
+    const Culler::Isa isas[] = {
+            Culler::Isa::SSE2, Culler::Isa::AVX2, Culler::Isa::AVX512, Culler::Isa::NEON };
+    for (Culler::Isa isa : isas) {
+        if (!Culler::Test::setIsa(isa)) {
+            continue;
+        }
+        std::vector<Culler::result_type> boxes, spheresVisibility, multiple;
+        cull(boxes, spheresVisibility, multiple);
+        EXPECT_EQ(expectedBoxes, boxes) << Culler::Test::getIsaName(isa);
+        EXPECT_EQ(expectedSpheres, spheresVisibility) << Culler::Test::getIsaName(isa);
+        EXPECT_EQ(expectedMultiple, multiple) << Culler::Test::getIsaName(isa);
+    }
+    Culler::Test::setIsa(best);
+}
+
+TEST(FilamentTest, LightCulling) {
+    using namespace filament::details;
+    using Instance = FLightManager::Instance;
+
+    // more lights than fit in two culling chunks, the last one is partial
+    constexpr uint32_t COUNT = FView::LIGHT_CULLING_CHUNK_SIZE * 2 + 100;
+
+    // looking down -z from the origin, 45 degrees on each side
+    Frustum frustum(mat4f::perspective(90.0f, 1.0f, 0.5f, 100.0f));
+
+    // the directional light comes first, then a repeating mix of:
+    //  0: point light in the frustum                           (visible)
+    //  1: point light behind the camera                        (culled by its sphere)
+    //  2: spot light whose sphere intersects the frustum, but
+    //     whose cone points away from it                       (culled by its cone)
+    //  3: spot light pointing into the frustum                 (visible)
+    const float cosOuter = std::cos(20.0f * float(F_PI) / 180.0f);
+    FScene::LightSoa lights;
+    lights.setCapacity(Culler::round(COUNT));
+    lights.push_back({}, {}, Instance(0), {}, {}, FScene::NO_SPOT_CONE);
+    for (uint32_t i = 1; i < COUNT; i++) {
+        switch (i % 4) {
+            case 0:
+                lights.push_back(float4{ 0, 0, -10, 1 }, float3{ 0, 0, -1 },
+                        Instance(i), 0, {}, FScene::NO_SPOT_CONE);
+                break;
+            case 1:
+                lights.push_back(float4{ 0, 0, 50, 1 }, float3{ 0, 0, -1 },
+                        Instance(i), 0, {}, FScene::NO_SPOT_CONE);
+                break;
+            case 2:
+                lights.push_back(float4{ 12, 0, -10, 5 }, float3{ 1, 0, 0 },
+                        Instance(i), 0, {}, cosOuter * cosOuter);
+                break;
+            case 3:
+                lights.push_back(float4{ 12, 0, -10, 5 }, float3{ -1, 0, 0 },
+                        Instance(i), 0, {}, cosOuter * cosOuter);
+                break;
+        }
+    }
+    for (size_t i = lights.size(); i < Culler::round(COUNT); i++) {
+        new(lights.data<FScene::POSITION_RADIUS>() + i) float4{ 0, 0, 0, 1 };
+    }
+
+    JobSystem js;
+    js.adopt();
+    std::vector<uint32_t> chunkCounts(FView::getLightCullingChunkCount(COUNT));
+    FView::prepareVisibleLights(js, frustum, lights, chunkCounts.data());
+    js.emancipate();
+
+    // the visible lights are gathered in their original order
+    std::vector<uint32_t> expected = { 0 };
+    for (uint32_t i = 1; i < COUNT; i++) {
+        if (i % 4 == 0 || i % 4 == 3) {
+            expected.push_back(i);
+        }
+    }
+    std::vector<uint32_t> survivors;
+    for (size_t i = 0; i < lights.size(); i++) {
+        survivors.push_back(lights.elementAt<FScene::LIGHT_INSTANCE>(i).asValue());
+    }
+    EXPECT_EQ(expected, survivors);
+
+    // the other columns moved along with the instances
+    for (size_t i = 1; i < lights.size(); i++) {
+        const float4 sphere = lights.elementAt<FScene::POSITION_RADIUS>(i);
+        if (survivors[i] % 4 == 0) {
+            EXPECT_EQ(float4(0, 0, -10, 1), sphere);
+            EXPECT_EQ(float(FScene::NO_SPOT_CONE),
+                    lights.elementAt<FScene::SPOT_COS_OUTER_SQUARED>(i));
+        } else {
+            EXPECT_EQ(float4(12, 0, -10, 5), sphere);
+            EXPECT_EQ(float3(-1, 0, 0), lights.elementAt<FScene::DIRECTION>(i));
+        }
+    }
+}
+
+TEST(FilamentTest, ClusterCulling) {
+    using namespace filament::details;
+    using IndexRange = FRenderPrimitive::IndexRange;
+
+    FEngine* engine = FEngine::create(Engine::Backend::NOOP);
+
+    // four clusters of one triangle each, two of them facing +z and -z
+    RenderableManager::Cluster clusters[4];
+    const float3 centers[4] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 } };
+    for (uint32_t i = 0; i < 4; i++) {
+        clusters[i].offset = i * 3;
+        clusters[i].count = 3;
+        clusters[i].center = centers[i];
+        clusters[i].radius = 0.5f;
+        clusters[i].coneApex = centers[i];
+    }
+    clusters[0].coneAxis = { 0, 0, 1 };
+    clusters[0].coneCutoff = 0.5f;
+    clusters[1].coneAxis = { 0, 0, -1 };
+    clusters[1].coneCutoff = 0.5f;
+
+    VertexBuffer* vb = VertexBuffer::Builder()
+            .vertexCount(12)
+            .bufferCount(1)
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+            .build(*engine);
+    IndexBuffer* ib = IndexBuffer::Builder()
+            .indexCount(12)
+            .bufferType(IndexBuffer::IndexType::USHORT)
+            .build(*engine);
+    Entity entity = EntityManager::get().create();
+    RenderableManager::Builder(1)
+            .boundingBox({ {}, { 1, 1, 1 } })
+            .material(0, engine->getDefaultMaterial()->getDefaultInstance())
+            .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vb, ib)
+            .clusters(0, clusters, 4)
+            .build(*engine, entity);
+    FRenderableManager& rcm = engine->getRenderableManager();
+    const Slice<FRenderPrimitive> primitives =
+            rcm.getRenderPrimitives(rcm.getInstance(entity), 0);
+
+    // The renderable is seen from the origin, looking down -z:
+    //  0: in the frustum, the cluster facing -z is culled by its cone
+    //  1: behind the camera, all clusters are culled
+    //  2: in the frustum and turned around, the cluster facing +z is culled instead
+    //  3: to the left and turned by 70 degrees, the cluster facing -z is culled by its cone when
+    //     seen from the camera, but not when seen from the view direction as in orthographic views
+    const mat4f transforms[4] = {
+            mat4f::translation(float3{ 0, 0, -10 }),
+            mat4f::translation(float3{ 0, 0, 50 }),
+            mat4f::translation(float3{ 0, 0, -10 }) * mat4f::rotation(F_PI, float3{ 0, 1, 0 }),
+            mat4f::translation(float3{ -6, 0, -10 }) *
+                    mat4f::rotation(70.0f * F_PI / 180.0f, float3{ 0, 1, 0 }),
+    };
+    FRenderableManager::Visibility visibility = {};
+    visibility.culling = true;
+    FScene::RenderableSoa soa;
+    soa.setCapacity(4);
+    for (mat4f const& transform : transforms) {
+        soa.push_back({}, transform, false, visibility, FScene::NO_BONES, {}, 0, {}, 0, {},
+                primitives, 0);
+    }
+
+    LinearAllocatorArena arena("test", 65536);
+    filament::details::ArenaScope scope(arena);
+    Frustum frustum(mat4f::perspective(90.0f, 1.0f, 0.5f, 100.0f));
+    Slice<const IndexRange> ranges = FView::cullClusters(engine->getJobSystem(), scope,
+            frustum, float4{ 0, 0, 0, 1 }, false, soa, { 0, 4 });
+
+    // the adjacent clusters that survive are drawn together
+    struct Draw {
+        uint32_t offset;
+        uint32_t triangles;
+        bool operator==(Draw const& rhs) const noexcept {
+            return offset == rhs.offset && triangles == rhs.triangles;
+        }
+    };
+    auto draws = [&](size_t i) {
+        std::vector<Draw> result;
+        for (FRenderPrimitive const& primitive : soa.elementAt<FScene::PRIMITIVES>(i)) {
+            EXPECT_EQ(primitives[0].getHwHandle(), primitive.getHwHandle());
+            EXPECT_NE(uint32_t(FRenderPrimitive::NO_INDEX_RANGE), primitive.getIndexRange());
+            IndexRange const& range = ranges[primitive.getIndexRange()];
+            EXPECT_EQ(0, range.primitiveOffset);
+            EXPECT_EQ(12, range.primitiveCount);
+            EXPECT_EQ(RenderableManager::PrimitiveType::TRIANGLES, range.type);
+            result.push_back({ range.offset, range.count / 3 });
+        }
+        return result;
+    };
+    EXPECT_EQ((std::vector<Draw>{ { 0, 1 }, { 6, 2 } }), draws(0));
+    EXPECT_TRUE(draws(1).empty());
+    EXPECT_EQ((std::vector<Draw>{ { 3, 3 } }), draws(2));
+    EXPECT_EQ((std::vector<Draw>{ { 0, 1 }, { 6, 2 } }), draws(3));
+
+    // an orthographic camera looking down -z sees all the clusters of the last renderable
+    soa.elementAt<FScene::PRIMITIVES>(3) = primitives;
+    Frustum ortho(mat4f::ortho(-20.0f, 20.0f, -20.0f, 20.0f, 0.5f, 100.0f));
+    ranges = FView::cullClusters(engine->getJobSystem(), scope,
+            ortho, float4{ 0, 0, 1, 0 }, false, soa, { 3, 4 });
+    EXPECT_EQ((std::vector<Draw>{ { 0, 4 } }), draws(3));
+
+    // the renderable's own primitive is untouched
+    EXPECT_EQ(uint32_t(FRenderPrimitive::NO_INDEX_RANGE), primitives[0].getIndexRange());
+
+    engine->destroy(entity);
+    engine->destroy(upcast(ib));
+    engine->destroy(upcast(vb));
+    EntityManager::get().destroy(entity);
+    Engine::destroy((Engine **)&engine);
+}
+
 TEST(FilamentTest, ColorConversion) {
     // Linear to Gamma
     // 0.0 stays 0.0
@@ -688,8 +968,8 @@ TEST(FilamentTest, FroxelData) {
     LightManager::Instance instance = engine->getLightManager().getInstance(e);
 
     FScene::LightSoa lights;
-    lights.push_back({}, {}, {}, {}, {});   // first one is always skipped
-    lights.push_back(float4{ 0, 0, -5, 1 }, {}, instance, 1, {});
+    lights.push_back({}, {}, {}, {}, {}, {});   // first one is always skipped
+    lights.push_back(float4{ 0, 0, -5, 1 }, {}, instance, 1, {}, FScene::NO_SPOT_CONE);
 
     {
         froxelData.froxelizeLights(*engine, {}, lights);
@@ -863,6 +1143,183 @@ TEST(FilamentTest, Bones) {
     }
 }
 
+TEST(FilamentTest, LevelOfDetail) {
+    using filament::details::FRenderableManager;
+    const float h = FRenderableManager::LOD_HYSTERESIS;
+
+    FRenderableManager::LevelOfDetail lod = { { 0.5f, 0.2f, 0.05f }, 4 };
+    uint8_t current = 0;
+    auto select = [&lod, &current](float screenSize) {
+        return current = FRenderableManager::selectLevel(lod, current, screenSize);
+    };
+
+    // far from the thresholds, the level only depends on the size
+    EXPECT_EQ(0, select(1.0f));
+    EXPECT_EQ(1, select(0.3f));
+    EXPECT_EQ(2, select(0.1f));
+    EXPECT_EQ(3, select(0.01f));
+    EXPECT_EQ(0, select(100.0f));
+
+    // within the hysteresis band, the current level is kept in both directions
+    EXPECT_EQ(0, select(0.5f * (1.0f - h * 0.5f)));
+    EXPECT_EQ(1, select(0.5f * (1.0f - h * 2.0f)));
+    EXPECT_EQ(1, select(0.5f * (1.0f + h * 0.5f)));
+    EXPECT_EQ(0, select(0.5f * (1.0f + h * 2.0f)));
+
+    // large changes skip levels
+    EXPECT_EQ(3, select(0.001f));
+    EXPECT_EQ(1, select(0.25f));
+
+    // a single level is always selected
+    FRenderableManager::LevelOfDetail single = { {}, 1 };
+    EXPECT_EQ(0, FRenderableManager::selectLevel(single, 0, 0.0f));
+    EXPECT_EQ(0, FRenderableManager::selectLevel(single, 0, 1.0f));
+}
+
+TEST(FilamentTest, FrameStageScopes) {
+    using Stage = FrameInfo::Stage;
+    using std::chrono::milliseconds;
+    using std::chrono::nanoseconds;
+
+    FrameInfo info;
+    std::fill(std::begin(info.stageTimes), std::end(info.stageTimes), 0);
+    auto stageTime = [&info](Stage stage) { return nanoseconds(info.stageTimes[size_t(stage)]); };
+
+    const auto begin = FrameInfo::clock::now();
+    {
+        FrameStageScope culling(&info, Stage::CULLING);
+        std::this_thread::sleep_for(milliseconds(2));
+        {
+            FrameStageScope shadows(&info, Stage::SHADOWS);
+            std::this_thread::sleep_for(milliseconds(4));
+        }
+        std::this_thread::sleep_for(milliseconds(2));
+    }
+    const auto elapsed = FrameInfo::clock::now() - begin;
+
+    // the nested stage is not counted in the enclosing one, and nothing is counted twice
+    EXPECT_GE(stageTime(Stage::SHADOWS), milliseconds(4));
+    EXPECT_GE(stageTime(Stage::CULLING), milliseconds(4));
+    EXPECT_LE(stageTime(Stage::CULLING) + stageTime(Stage::SHADOWS), elapsed);
+
+    // scopes of the same stage accumulate, scopes without a frame do nothing
+    const nanoseconds shadows = stageTime(Stage::SHADOWS);
+    {
+        FrameStageScope more(&info, Stage::SHADOWS);
+        FrameStageScope none(nullptr, Stage::CULLING);
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    EXPECT_GE(stageTime(Stage::SHADOWS), shadows + milliseconds(1));
+    EXPECT_EQ(0, info.stageTimes[size_t(Stage::FROXELIZE)]);
+}
+
+TEST(FilamentTest, CpuBudget) {
+    using namespace filament::details;
+    using Stage = Renderer::FrameStage;
+
+    FEngine* engine = FEngine::create(Engine::Backend::NOOP);
+    FView* view = engine->createView();
+    view->setLodBias(0.25f);
+
+    View::CpuBudgetOptions options;
+    options.enabled = true;
+    options.targetFrameTimeMilli = 10.0f;
+    options.headRoomRatio = 0.2f;
+    options.history = 3;
+    options.restoreDelay = 10;
+    view->setCpuBudgetOptions(options);
+
+    // A simulated frame loop: the cost of each stage, in ms, follows the view's settings, and
+    // the timings of a frame become available two frames after it was rendered. Froxelization
+    // runs on another thread, in parallel with the command generation.
+    struct Workload {
+        float geometry;
+        float shadows;
+        float lighting;
+        float generationRatio = 0.0f;   // fraction of the geometry spent generating commands
+    };
+    std::vector<Renderer::FrameTimings> timings;
+    auto run = [&timings, view](Workload const& workload, size_t frameCount, float spike = 0.0f) {
+        auto ns = [](float ms) { return uint64_t(ms * 1e6f); };
+        for (size_t i = 0; i < frameCount; i++) {
+            const uint32_t frameId = uint32_t(timings.size() + 1);
+            if (frameId > 2) {
+                view->updateCpuBudget(timings[frameId - 3], frameId);
+            }
+            const float lodBias = view->getEffectiveLodBias() - 0.25f;
+            const float lightRatio = float(view->getMaxLightCount()) / CONFIG_MAX_LIGHT_COUNT;
+            const float geometry = workload.geometry * std::exp2(-lodBias);
+            const float shadows = workload.shadows * view->getShadowDistanceScale();
+            const float lighting = workload.lighting * lightRatio;
+            const float generation = geometry * workload.generationRatio;
+            Renderer::FrameTimings t;
+            t.frameId = frameId;
+            t.stages[size_t(Stage::SCENE_PREPARE)] = ns(1.0f);
+            t.stages[size_t(Stage::CULLING)] = ns(geometry * 0.25f);
+            t.stages[size_t(Stage::COMMAND_GENERATION)] = ns(generation);
+            t.stages[size_t(Stage::COMMAND_RECORDING)] = ns(geometry * 0.75f - generation);
+            t.stages[size_t(Stage::SHADOWS)] = ns(shadows);
+            t.stages[size_t(Stage::FROXELIZE)] = ns(lighting);
+            t.stages[size_t(Stage::FLUSH_WAIT)] = ns(1.0f);
+            t.stages[size_t(Stage::DRIVER)] = ns(2.0f);
+            t.frameTime = ns(2.0f + geometry + shadows + std::max(0.0f, lighting - generation) +
+                    (i == 0 ? spike : 0.0f));
+            timings.push_back(t);
+        }
+    };
+
+    auto expectFullQuality = [view]() {
+        EXPECT_FLOAT_EQ(0.25f, view->getEffectiveLodBias());
+        EXPECT_FLOAT_EQ(1.0f, view->getShadowDistanceScale());
+        EXPECT_EQ(CONFIG_MAX_LIGHT_COUNT, view->getMaxLightCount());
+        EXPECT_EQ(FROXEL_BUFFER_ENTRY_COUNT_MAX, view->getMaxFroxelCount());
+    };
+
+    // under budget, and a single slow frame doesn't lower the quality
+    const Workload light = { 2.0f, 2.0f, 1.0f };
+    run(light, 50);
+    expectFullQuality();
+    run(light, 20, 50.0f);
+    expectFullQuality();
+
+    // 13.5 ms, the geometry is the most expensive and is lowered twice, to 9.5 ms which is
+    // within the hysteresis band
+    run({ 8.0f, 2.5f, 2.0f }, 200);
+    EXPECT_FLOAT_EQ(0.25f + options.maxLodBias * 0.5f, view->getEffectiveLodBias());
+    EXPECT_FLOAT_EQ(1.0f, view->getShadowDistanceScale());
+    EXPECT_EQ(CONFIG_MAX_LIGHT_COUNT, view->getMaxLightCount());
+
+    // the quality is restored once the workload gets lighter
+    run(light, 200);
+    expectFullQuality();
+
+    // 11.5 ms, froxelization is mostly hidden by the command generation so only the geometry is
+    // lowered, twice, to 9.75 ms
+    run({ 7.0f, 1.0f, 6.0f, 0.5f }, 200);
+    EXPECT_FLOAT_EQ(0.25f + options.maxLodBias * 0.5f, view->getEffectiveLodBias());
+    EXPECT_FLOAT_EQ(1.0f, view->getShadowDistanceScale());
+    EXPECT_EQ(CONFIG_MAX_LIGHT_COUNT, view->getMaxLightCount());
+    run(light, 200);
+    expectFullQuality();
+
+    // 15 ms, the lighting is lowered three times, to 8.25 ms
+    run({ 1.0f, 1.0f, 12.0f }, 200);
+    EXPECT_FLOAT_EQ(0.25f, view->getEffectiveLodBias());
+    EXPECT_FLOAT_EQ(1.0f, view->getShadowDistanceScale());
+    EXPECT_LT(view->getMaxLightCount(), CONFIG_MAX_LIGHT_COUNT / 2);
+    EXPECT_LT(view->getMaxFroxelCount(), FROXEL_BUFFER_ENTRY_COUNT_MAX / 2);
+
+    // disabling the controller restores the full quality right away
+    options.enabled = false;
+    view->setCpuBudgetOptions(options);
+    expectFullQuality();
+    run({ 20.0f, 20.0f, 20.0f }, 50);
+    expectFullQuality();
+
+    engine->destroy(view);
+    Engine::destroy((Engine **)&engine);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
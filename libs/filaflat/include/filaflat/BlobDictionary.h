@@ -17,7 +17,6 @@
 #ifndef TNT_FILAFLAT_BLOBDICTIONARY_H
 #define TNT_FILAFLAT_BLOBDICTIONARY_H
 
-#include <cstdint>
 #include <vector>
 
 #include <stddef.h>
@@ -25,19 +24,15 @@
 namespace filaflat {
 
 // Flat list of blobs that can be referenced by index.
+// Blobs are not copied: they point into the material package, which must outlive the dictionary.
 class BlobDictionary {
 public:
     BlobDictionary() = default;
     ~BlobDictionary() = default;
 
-    using Blob = std::vector<uint8_t>;
-
+    // For text dictionaries, blobs are null-terminated strings and len excludes the trailing null.
     inline void addBlob(const char* blob, size_t len) noexcept {
-        mBlobs.emplace_back(blob, blob + len);
-    }
-
-    inline void addBlob(Blob&& blob) noexcept {
-        mBlobs.push_back(std::move(blob));
+        mBlobs.push_back({ blob, len });
     }
 
     inline bool isEmpty() const noexcept {
@@ -49,15 +44,19 @@ public:
     }
 
     inline const char* getBlob(size_t index, size_t* size) const noexcept {
-        *size = mBlobs[index].size();
-        return (const char*) mBlobs[index].data();
+        *size = mBlobs[index].size;
+        return mBlobs[index].data;
     }
 
     inline const char* getString(size_t index) const noexcept {
-        return (const char*) mBlobs[index].data();
+        return mBlobs[index].data;
     }
 
 private:
+    struct Blob {
+        const char* data;
+        size_t size;
+    };
     std::vector<Blob> mBlobs;
 };
 
@@ -40,6 +40,10 @@ public:
     // Append a data blob to the shader. Returns true if successful.
     void append(const char* data, size_t size) noexcept;
 
+    // Append size uninitialized bytes to the shader and return them, so they can be filled in
+    // place (e.g. by a decompressor) without an intermediate copy.
+    char* append(size_t size) noexcept;
+
     // returns the shader blob. valid until next api call.
     void const* data() const noexcept { return mShader; }
 
@@ -19,11 +19,6 @@
 #include <filaflat/BlobDictionary.h>
 #include <filaflat/Unflattener.h>
 
-#if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
-#include <utils/Log.h>
-#include <smolv.h>
-#endif
-
 #include <assert.h>
 
 using namespace filamat;
@@ -39,6 +34,10 @@ bool DictionaryReader::unflatten(ChunkContainer const& container,
             container.getChunkEnd(dictionaryTag));
 
     if (dictionaryTag == ChunkType::DictionarySpirv) {
+#if !defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
+        // SPIR-V blobs are SMOL-V compressed and cannot be decoded without Vulkan support.
+        return false;
+#endif
         uint32_t compressionScheme;
         if (!unflattener.read(&compressionScheme)) {
             return false;
@@ -60,20 +59,8 @@ bool DictionaryReader::unflatten(ChunkContainer const& container,
                 return false;
             }
 
-#if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
-            size_t spirvSize = smolv::GetDecodedBufferSize(compressed, compressedSize);
-            if (spirvSize == 0) {
-                return false;
-            }
-            BlobDictionary::Blob spirv(spirvSize);
-            if (!smolv::Decode(compressed, compressedSize, spirv.data(), spirvSize)) {
-                return false;
-            }
-            dictionary.addBlob(std::move(spirv));
-#else
-            return false;
-#endif
-
+            // Keep the SMOL-V blob as-is, MaterialChunk decodes it when the shader is requested.
+            dictionary.addBlob(compressed, compressedSize);
         }
         return true;
     } else if (dictionaryTag == ChunkType::DictionaryGlsl
@@ -89,9 +76,8 @@ bool DictionaryReader::unflatten(ChunkContainer const& container,
             if (!unflattener.read(&str)) {
                 return false;
             }
-            // BlobDictionary hold binary chunks and does not care if the data holds text, it is
-            // therefore crucial to include the trailing null.
-            dictionary.addBlob(str, strlen(str) + 1);
+            // The string is referenced in place, Unflattener has already skipped its null.
+            dictionary.addBlob(str, size_t(unflattener.getCursor() - (const uint8_t*) str) - 1);
         }
         return true;
     }
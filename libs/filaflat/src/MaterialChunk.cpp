@@ -21,6 +21,10 @@
 
 #include <utils/Log.h>
 
+#if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
+#include <smolv.h>
+#endif
+
 namespace filaflat {
 
 static inline uint32_t makeKey(uint8_t shaderModel, uint8_t variant, uint8_t type) noexcept {
@@ -124,8 +128,9 @@ bool MaterialChunk::getTextShader(Unflattener unflattener, BlobDictionary const&
         if (!unflattener.read(&lineIndex)) {
             return false;
         }
-        const char* string = dictionary.getString(lineIndex);
-        shaderBuilder.append(string, strlen(string));
+        size_t lineSize;
+        const char* string = dictionary.getBlob(lineIndex, &lineSize);
+        shaderBuilder.append(string, lineSize);
         shaderBuilder.append("\n", 1);
     }
 
@@ -150,13 +155,22 @@ bool MaterialChunk::getSpirvShader(BlobDictionary const& dictionary,
     }
 
     size_t index = pos->second;
-    size_t shaderSize;
-    const char* shaderContent = dictionary.getBlob(index, &shaderSize);
+
+#if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
+    // The dictionary holds SMOL-V compressed blobs, only decode the one we need.
+    size_t compressedSize;
+    const char* compressed = dictionary.getBlob(index, &compressedSize);
+    size_t spirvSize = smolv::GetDecodedBufferSize(compressed, compressedSize);
+    if (spirvSize == 0) {
+        return false;
+    }
 
     shaderBuilder.reset();
-    shaderBuilder.announce(shaderSize);
-    shaderBuilder.append(shaderContent, shaderSize);
-    return true;
+    shaderBuilder.announce(spirvSize);
+    return smolv::Decode(compressed, compressedSize, shaderBuilder.append(spirvSize), spirvSize);
+#else
+    return false;
+#endif
 }
 
 bool MaterialChunk::getShader(ShaderBuilder& shaderBuilder,
@@ -48,4 +48,11 @@ void ShaderBuilder::append(const char* data, size_t size) noexcept {
     mCursor += size;
 }
 
+char* ShaderBuilder::append(size_t size) noexcept {
+    assert(size <= (mCapacity - mCursor));
+    char* data = mShader + mCursor;
+    mCursor += size;
+    return data;
+}
+
 }
@@ -37,10 +37,15 @@
 #include <utils/compiler.h>
 #include <utils/CString.h>
 
+namespace utils {
+class JobSystem;
+}
+
 namespace filamat {
 
 struct MaterialInfo;
 class ChunkContainer;
+class ShaderCache;
 struct Variant;
 
 class UTILS_PUBLIC MaterialBuilderBase {
@@ -99,6 +104,7 @@ protected:
     Optimization mOptimization = Optimization::PERFORMANCE;
     bool mPrintShaders = false;
     bool mGenerateDebugInfo = false;
+    ShaderCache* mShaderCache = nullptr;
     utils::bitset32 mShaderModels;
     struct CodeGenParams {
         int shaderModel;
@@ -426,9 +432,23 @@ public:
     //! Specifies a list of variants that should be filtered out during code generation.
     MaterialBuilder& variantFilter(uint8_t variantFilter) noexcept;
 
+    /**
+     * Specifies a cache of post-processed shaders that is consulted before running the shader
+     * optimizer and cross-compilers. The cache is not owned by the builder and must outlive the
+     * calls to build(). This is ignored by filamat_lite.
+     */
+    MaterialBuilder& shaderCache(ShaderCache* cache) noexcept;
+
     //! Build the material.
     Package build() noexcept;
 
+    /**
+     * Build the material, compiling the shader variants concurrently on the given JobSystem.
+     * The resulting package is identical to the one produced by build().
+     * The calling thread must be part of the JobSystem's thread pool, see JobSystem::adopt().
+     */
+    Package build(utils::JobSystem& jobSystem) noexcept;
+
 public:
     // The methods and types below are for internal use
     /// @cond never
@@ -498,8 +518,10 @@ private:
     void writeCommonChunks(ChunkContainer& container, MaterialInfo& info) const noexcept;
     void writeSurfaceChunks(ChunkContainer& container) const noexcept;
 
-    bool generateShaders(const std::vector<Variant>& variants, ChunkContainer& container,
-            const MaterialInfo& info) const noexcept;
+    Package build(utils::JobSystem* jobSystem) noexcept;
+
+    bool generateShaders(utils::JobSystem* jobSystem, const std::vector<Variant>& variants,
+            ChunkContainer& container, const MaterialInfo& info) const noexcept;
 
     bool isLit() const noexcept { return mShading != filament::Shading::UNLIT; }
 
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMAT_SHADERCACHE_H
+#define TNT_FILAMAT_SHADERCACHE_H
+
+#include <utils/compiler.h>
+#include <utils/Path.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filamat {
+
+/**
+ * A persistent, content-addressed cache of post-processed shaders.
+ *
+ * MaterialBuilder uses this cache to skip the glslang / SPIR-V optimizer / spirv-cross pipeline
+ * when it has already processed an identical shader, possibly while building a different material
+ * or during a previous run of matc. The key of an entry is everything that determines the output
+ * of the post-processor: the generated shader source, the stage, the shader model, the target API
+ * and the optimization level. An entry holds the resulting GLSL, SPIR-V and MSL.
+ *
+ * Each entry is stored as its own file in the cache directory, which can be shared by several
+ * processes. When the total size of the entries exceeds the size limit, the least recently used
+ * ones are evicted by trim(), which is called automatically on destruction if put() wrote any
+ * entry. Other files in the directory are left alone.
+ *
+ * All methods are thread-safe. Not available in filamat_lite.
+ */
+class UTILS_PUBLIC ShaderCache {
+public:
+    struct Stats {
+        size_t hits;        //!< number of successful lookups
+        size_t misses;      //!< number of failed lookups
+        size_t evictions;   //!< number of entries removed by trim()
+    };
+
+    /**
+     * @param directory where cache entries are stored, created if it does not exist
+     * @param maxSize size limit in bytes enforced by trim()
+     */
+    ShaderCache(const char* directory, size_t maxSize) noexcept;
+    ~ShaderCache() noexcept;
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    //! Returns false if the cache directory could not be created.
+    bool isValid() const noexcept { return mValid; }
+
+    /**
+     * Looks up the entry for the given key. On a hit, the requested outputs are filled in and
+     * true is returned. Any of the outputs can be null.
+     */
+    bool get(const std::string& key, std::string* glsl, std::vector<uint32_t>* spirv,
+            std::string* msl) noexcept;
+
+    //! Stores an entry for the given key. Any of the outputs can be null.
+    void put(const std::string& key, const std::string* glsl, const std::vector<uint32_t>* spirv,
+            const std::string* msl) noexcept;
+
+    //! Evicts the least recently used entries until the cache fits within its size limit.
+    void trim() noexcept;
+
+    Stats getStats() const noexcept;
+
+private:
+    utils::Path getEntryPath(const std::string& key) const noexcept;
+
+    const utils::Path mDirectory;
+    const size_t mMaxSize;
+    bool mValid = false;
+    std::atomic<size_t> mHits = { 0 };
+    std::atomic<size_t> mMisses = { 0 };
+    std::atomic<size_t> mEvictions = { 0 };
+    std::atomic<bool> mWritten = { false };
+};
+
+} // namespace filamat
+
+#endif // TNT_FILAMAT_SHADERCACHE_H
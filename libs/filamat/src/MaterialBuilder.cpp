@@ -15,11 +15,13 @@
  */
 
 #include "filamat/MaterialBuilder.h"
+#include "filamat/ShaderCache.h"
 
 #include <vector>
 
-#include <utils/Panic.h>
+#include <utils/JobSystem.h>
 #include <utils/Log.h>
+#include <utils/Panic.h>
 
 #include <private/filament/UniformInterfaceBlock.h>
 #include <private/filament/SamplerInterfaceBlock.h>
@@ -344,6 +346,11 @@ MaterialBuilder& MaterialBuilder::variantFilter(uint8_t variantFilter) noexcept
     return *this;
 }
 
+MaterialBuilder& MaterialBuilder::shaderCache(ShaderCache* cache) noexcept {
+    mShaderCache = cache;
+    return *this;
+}
+
 bool MaterialBuilder::hasExternalSampler() const noexcept {
     for (size_t i = 0, c = mParameterCount; i < c; i++) {
         auto const& param = mParameters[i];
@@ -512,6 +519,26 @@ bool MaterialBuilder::ShaderCode::resolveIncludes(IncludeCallback callback) noex
     return true;
 }
 
+#ifndef FILAMAT_LITE
+#ifndef FILAMAT_SHADER_TOOLS_VERSION
+#define FILAMAT_SHADER_TOOLS_VERSION "unknown"
+#endif
+
+// Everything that determines the output of GLSLPostProcessor::process(), followed by its input.
+static std::string getShaderCacheKey(const std::string& shader,
+        filament::backend::ShaderType stage, filament::backend::ShaderModel shaderModel,
+        MaterialBuilder::TargetApi targetApi, MaterialBuilder::Optimization optimization,
+        bool generateDebugInfo) {
+    char header[192];
+    snprintf(header, sizeof(header),
+            "tools=%s material=%u stage=%u model=%u api=%u opt=%u debug=%u\n",
+            FILAMAT_SHADER_TOOLS_VERSION,
+            unsigned(filament::MATERIAL_VERSION), unsigned(stage), unsigned(shaderModel),
+            unsigned(targetApi), unsigned(optimization), unsigned(generateDebugInfo));
+    return header + shader;
+}
+#endif
+
 static void showErrorMessage(const char* materialName, uint8_t variant,
         MaterialBuilder::TargetApi targetApi, filament::backend::ShaderType shaderType,
         const std::string& shaderCode) {
@@ -528,16 +555,8 @@ static void showErrorMessage(const char* materialName, uint8_t variant,
             << shaderCode;
 }
 
-bool MaterialBuilder::generateShaders(const std::vector<Variant>& variants, ChunkContainer& container,
-        const MaterialInfo& info) const noexcept {
-    // Create a postprocessor to optimize / compile to Spir-V if necessary.
-#ifndef FILAMAT_LITE
-    uint32_t flags = 0;
-    flags |= mPrintShaders ? GLSLPostProcessor::PRINT_SHADERS : 0;
-    flags |= mGenerateDebugInfo ? GLSLPostProcessor::GENERATE_DEBUG_INFO : 0;
-    GLSLPostProcessor postProcessor(mOptimization, flags);
-#endif
-
+bool MaterialBuilder::generateShaders(JobSystem* jobSystem, const std::vector<Variant>& variants,
+        ChunkContainer& container, const MaterialInfo& info) const noexcept {
     // Generate all shaders.
     std::vector<TextEntry> glslEntries;
     std::vector<SpirvEntry> spirvEntries;
@@ -547,8 +566,6 @@ bool MaterialBuilder::generateShaders(const std::vector<Variant>& variants, Chun
     BlobDictionary spirvDictionary;
     LineDictionary metalDictionary;
 #endif
-    std::vector<uint32_t> spirv;
-    std::string msl;
 
     ShaderGenerator sg(mProperties, mVariables, mMaterialCode.getResolved(),
             mMaterialCode.getLineOffset(), mMaterialVertexCode.getResolved(),
@@ -560,84 +577,143 @@ bool MaterialBuilder::generateShaders(const std::vector<Variant>& variants, Chun
     container.addSimpleChild<bool>(ChunkType::MaterialHasCustomDepthShader, customDepth);
 
     for (const auto& params : mCodeGenPermutations) {
+        assertSingleTargetApi(params.targetApi);
+    }
+
+    // Every (permutation, variant) pair is an independent compilation. They are all generated
+    // first, possibly in parallel, and then added to the dictionaries in a fixed order below so
+    // that the resulting package does not depend on the scheduling.
+    struct ShaderResult {
+        std::string shader;
+        std::vector<uint32_t> spirv;
+        std::string msl;
+        bool ok = false;
+    };
+    const size_t variantCount = variants.size();
+    std::vector<ShaderResult> results(mCodeGenPermutations.size() * variantCount);
+
+    auto compile = [&](size_t index) {
+        const auto& params = mCodeGenPermutations[index / variantCount];
+        const auto& v = variants[index % variantCount];
         const ShaderModel shaderModel = ShaderModel(params.shaderModel);
         const TargetApi targetApi = params.targetApi;
         const TargetLanguage targetLanguage = params.targetLanguage;
-
-        assertSingleTargetApi(targetApi);
+        ShaderResult& result = results[index];
 
         // Metal Shading Language is cross-compiled from Vulkan.
         const bool targetApiNeedsSpirv =
                 (targetApi == TargetApi::VULKAN || targetApi == TargetApi::METAL);
         const bool targetApiNeedsMsl = targetApi == TargetApi::METAL;
-        std::vector<uint32_t>* pSpirv = targetApiNeedsSpirv ? &spirv : nullptr;
-        std::string* pMsl = targetApiNeedsMsl ? &msl : nullptr;
-
-        TextEntry glslEntry{0};
-        SpirvEntry spirvEntry{0};
-        TextEntry metalEntry{0};
-
-        glslEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
-        spirvEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
-        metalEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
+        std::vector<uint32_t>* pSpirv = targetApiNeedsSpirv ? &result.spirv : nullptr;
+        std::string* pMsl = targetApiNeedsMsl ? &result.msl : nullptr;
+
+        // Generate raw shader code.
+        std::string& shader = result.shader;
+        if (v.stage == filament::backend::ShaderType::VERTEX) {
+            shader = sg.createVertexProgram(
+                    shaderModel, targetApi, targetLanguage, info, v.variant,
+                    mInterpolation, mVertexDomain);
+        } else if (v.stage == filament::backend::ShaderType::FRAGMENT) {
+            shader = sg.createFragmentProgram(
+                    shaderModel, targetApi, targetLanguage, info, v.variant, mInterpolation);
+        }
 
-        for (const auto& v : variants) {
-            glslEntry.variant = v.variant;
-            spirvEntry.variant = v.variant;
-            metalEntry.variant = v.variant;
+#ifndef FILAMAT_LITE
+        // The cache key is the post-processor's full input. Printing needs the post-processor
+        // to run, so the cache is bypassed in that case.
+        ShaderCache* const cache = mPrintShaders ? nullptr : mShaderCache;
+        std::string cacheKey;
+        if (cache) {
+            cacheKey = getShaderCacheKey(shader, v.stage, shaderModel, targetApi, mOptimization,
+                    mGenerateDebugInfo);
+            result.ok = cache->get(cacheKey, &shader, pSpirv, pMsl);
+        }
 
-            // Generate raw shader code.
-            std::string shader;
-            if (v.stage == filament::backend::ShaderType::VERTEX) {
-                shader = sg.createVertexProgram(
-                        shaderModel, targetApi, targetLanguage, info, v.variant,
-                        mInterpolation, mVertexDomain);
-            } else if (v.stage == filament::backend::ShaderType::FRAGMENT) {
-                shader = sg.createFragmentProgram(
-                        shaderModel, targetApi, targetLanguage, info, v.variant, mInterpolation);
+        if (!result.ok) {
+            // The post-processor keeps per-shader state, so each compilation needs its own.
+            uint32_t flags = 0;
+            flags |= mPrintShaders ? GLSLPostProcessor::PRINT_SHADERS : 0;
+            flags |= mGenerateDebugInfo ? GLSLPostProcessor::GENERATE_DEBUG_INFO : 0;
+            GLSLPostProcessor postProcessor(mOptimization, flags);
+            result.ok = postProcessor.process(shader, v.stage, shaderModel, &shader, pSpirv, pMsl);
+            if (result.ok && cache) {
+                cache->put(cacheKey, &shader, pSpirv, pMsl);
             }
-
-#ifndef FILAMAT_LITE
-            bool ok = postProcessor.process(shader, v.stage, shaderModel, &shader, pSpirv, pMsl);
+        }
 #else
-            bool ok = true;
+        result.ok = true;
 #endif
-            if (!ok) {
-                showErrorMessage(mMaterialName.c_str_safe(), v.variant, targetApi, v.stage, shader);
-                return false;
-            }
 
-            if (targetApi == TargetApi::OPENGL) {
-                if (targetLanguage == TargetLanguage::SPIRV) {
-                    sg.fixupExternalSamplers(shaderModel, shader, info);
-                }
+        if (result.ok && targetApi == TargetApi::OPENGL &&
+                targetLanguage == TargetLanguage::SPIRV) {
+            sg.fixupExternalSamplers(shaderModel, shader, info);
+        }
+    };
+
+    // Printed shaders must come out in order, so we never go wide in that case.
+    if (jobSystem && !mPrintShaders) {
+        JobSystem::Job* parent = jobSystem->createJob();
+        JobSystem::Job* job = jobs::parallel_for(*jobSystem, parent, 0, uint32_t(results.size()),
+                [&compile](uint32_t start, uint32_t count) {
+                    for (uint32_t i = start, end = start + count; i < end; i++) {
+                        compile(i);
+                    }
+                }, jobs::CountSplitter<1>());
+        jobSystem->run(job);
+        jobSystem->runAndWait(parent);
+    } else {
+        for (size_t i = 0, n = results.size(); i < n; i++) {
+            compile(i);
+        }
+    }
 
-                glslEntry.stage = v.stage;
-                glslEntry.shader = shader;
-                glslDictionary.addText(glslEntry.shader);
-                glslEntries.push_back(glslEntry);
-            }
+    for (size_t i = 0, n = results.size(); i < n; i++) {
+        const auto& params = mCodeGenPermutations[i / variantCount];
+        const auto& v = variants[i % variantCount];
+        const TargetApi targetApi = params.targetApi;
+        ShaderResult& result = results[i];
+
+        if (!result.ok) {
+            showErrorMessage(mMaterialName.c_str_safe(), v.variant, targetApi, v.stage,
+                    result.shader);
+            return false;
+        }
+
+        if (targetApi == TargetApi::OPENGL) {
+            TextEntry glslEntry{0};
+            glslEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
+            glslEntry.variant = v.variant;
+            glslEntry.stage = v.stage;
+            glslEntry.shader = std::move(result.shader);
+            glslDictionary.addText(glslEntry.shader);
+            glslEntries.push_back(std::move(glslEntry));
+        }
 
 #ifndef FILAMAT_LITE
-            if (targetApi == TargetApi::VULKAN) {
-                assert(!spirv.empty());
-                spirvEntry.stage = v.stage;
-                spirvEntry.dictionaryIndex = spirvDictionary.addBlob(spirv);
-                spirv.clear();
-                spirvEntries.push_back(spirvEntry);
-            }
-            if (targetApi == TargetApi::METAL) {
-                assert(!spirv.empty());
-                assert(msl.length() > 0);
-                metalEntry.stage = v.stage;
-                metalEntry.shader = msl;
-                spirv.clear();
-                msl.clear();
-                metalDictionary.addText(metalEntry.shader);
-                metalEntries.push_back(metalEntry);
-            }
-#endif
+        if (targetApi == TargetApi::VULKAN) {
+            assert(!result.spirv.empty());
+            SpirvEntry spirvEntry{0};
+            spirvEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
+            spirvEntry.variant = v.variant;
+            spirvEntry.stage = v.stage;
+            spirvEntry.dictionaryIndex = spirvDictionary.addBlob(result.spirv);
+            spirvEntries.push_back(spirvEntry);
+        }
+        if (targetApi == TargetApi::METAL) {
+            assert(!result.spirv.empty());
+            assert(result.msl.length() > 0);
+            TextEntry metalEntry{0};
+            metalEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
+            metalEntry.variant = v.variant;
+            metalEntry.stage = v.stage;
+            metalEntry.shader = std::move(result.msl);
+            metalDictionary.addText(metalEntry.shader);
+            metalEntries.push_back(std::move(metalEntry));
         }
+#endif
+
+        // Release the memory as we go, a full material can hold a lot of shader text.
+        result = {};
     }
 
     // Emit GLSL chunks (TextDictionaryReader and MaterialTextChunk).
@@ -669,6 +745,14 @@ bool MaterialBuilder::generateShaders(const std::vector<Variant>& variants, Chun
 }
 
 Package MaterialBuilder::build() noexcept {
+    return build(nullptr);
+}
+
+Package MaterialBuilder::build(JobSystem& jobSystem) noexcept {
+    return build(&jobSystem);
+}
+
+Package MaterialBuilder::build(JobSystem* jobSystem) noexcept {
     if (materialBuilderClients == 0) {
         utils::slog.e << "Error: MaterialBuilder::init() must be called before build()."
             << utils::io::endl;
@@ -710,7 +794,7 @@ Package MaterialBuilder::build() noexcept {
     const auto variants = mMaterialDomain == MaterialDomain::SURFACE ?
         determineSurfaceVariants(mVariantFilter, isLit(), mShadowMultiplier) :
         determinePostProcessVariants();
-    bool success = generateShaders(variants, container, info);
+    bool success = generateShaders(jobSystem, variants, container, info);
 
     // Flatten all chunks in the container into a Package.
     Package package(container.getSize());
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "filamat/ShaderCache.h"
+
+#include <utils/Log.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(WIN32)
+#   include <sys/utime.h>
+#   define utime _utime
+#   define utimbuf _utimbuf
+#else
+#   include <utime.h>
+#endif
+
+namespace filamat {
+
+// Bump this whenever the layout of an entry changes.
+static constexpr uint32_t CACHE_ENTRY_MAGIC = 0x31434853; // 'SHC1'
+
+// 64-bit FNV-1a, only used to name the entry files. Collisions are detected by comparing the
+// full key stored in the entry.
+static uint64_t hashKey(const std::string& key) noexcept {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : key) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static void writeString(std::ostream& out, const std::string* str) {
+    const uint32_t size = str ? uint32_t(str->size()) : 0;
+    out.write((const char*) &size, sizeof(size));
+    if (size) {
+        out.write(str->data(), size);
+    }
+}
+
+static bool readString(std::istream& in, std::string* str) {
+    uint32_t size = 0;
+    if (!in.read((char*) &size, sizeof(size))) {
+        return false;
+    }
+    std::string value(size, '\0');
+    if (size && !in.read(&value[0], size)) {
+        return false;
+    }
+    if (str) {
+        *str = std::move(value);
+    }
+    return true;
+}
+
+ShaderCache::ShaderCache(const char* directory, size_t maxSize) noexcept
+        : mDirectory(directory), mMaxSize(maxSize) {
+    mValid = mDirectory.isDirectory() || mDirectory.mkdirRecursive();
+    if (!mValid) {
+        utils::slog.e << "Unable to create shader cache directory " << mDirectory.c_str()
+                << utils::io::endl;
+    }
+}
+
+ShaderCache::~ShaderCache() noexcept {
+    // Nothing can have grown the directory past its limit on our behalf if we never wrote to it,
+    // so skip the directory scan for sessions that only hit the cache.
+    if (mWritten.load(std::memory_order_relaxed)) {
+        trim();
+    }
+}
+
+utils::Path ShaderCache::getEntryPath(const std::string& key) const noexcept {
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long) hashKey(key));
+    return mDirectory.concat(name);
+}
+
+bool ShaderCache::get(const std::string& key, std::string* glsl, std::vector<uint32_t>* spirv,
+        std::string* msl) noexcept {
+    if (!mValid) {
+        return false;
+    }
+
+    const utils::Path path = getEntryPath(key);
+    std::ifstream in(path.c_str(), std::ios::binary);
+
+    uint32_t magic = 0;
+    std::string storedKey;
+    std::string spirvBytes;
+    bool hit = in.read((char*) &magic, sizeof(magic)) && magic == CACHE_ENTRY_MAGIC &&
+            readString(in, &storedKey) && storedKey == key;
+
+    // Only touch the outputs once the whole entry has been read successfully.
+    std::string glslValue;
+    std::string mslValue;
+    hit = hit && readString(in, &glslValue) && readString(in, &spirvBytes) &&
+            readString(in, &mslValue) && (spirvBytes.size() % sizeof(uint32_t)) == 0;
+
+    if (!hit) {
+        mMisses++;
+        return false;
+    }
+
+    if (glsl) {
+        *glsl = std::move(glslValue);
+    }
+    if (spirv) {
+        spirv->resize(spirvBytes.size() / sizeof(uint32_t));
+        std::copy(spirvBytes.begin(), spirvBytes.end(), (char*) spirv->data());
+    }
+    if (msl) {
+        *msl = std::move(mslValue);
+    }
+
+    // Refresh the modification time, which trim() uses as the last access time.
+    utime(path.c_str(), nullptr);
+
+    mHits++;
+    return true;
+}
+
+void ShaderCache::put(const std::string& key, const std::string* glsl,
+        const std::vector<uint32_t>* spirv, const std::string* msl) noexcept {
+    if (!mValid) {
+        return;
+    }
+
+    // Write to a temporary file first and rename it into place, so that concurrent readers
+    // (possibly other matc processes) never observe a partial entry. Temporary files are
+    // ignored by trim().
+    const utils::Path path = getEntryPath(key);
+    const size_t unique = std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+            size_t(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    char tmpName[64];
+    snprintf(tmpName, sizeof(tmpName), ".tmp-%s-%zx", path.getName().c_str(), unique);
+    utils::Path tmpPath = mDirectory.concat(tmpName);
+
+    {
+        std::ofstream out(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+        std::string spirvBytes;
+        if (spirv) {
+            spirvBytes.assign((const char*) spirv->data(), spirv->size() * sizeof(uint32_t));
+        }
+        out.write((const char*) &CACHE_ENTRY_MAGIC, sizeof(CACHE_ENTRY_MAGIC));
+        writeString(out, &key);
+        writeString(out, glsl);
+        writeString(out, &spirvBytes);
+        writeString(out, msl);
+        if (!out) {
+            tmpPath.unlinkFile();
+            return;
+        }
+    }
+
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        // Another writer got there first, which is fine since entries are immutable.
+        tmpPath.unlinkFile();
+        return;
+    }
+    mWritten.store(true, std::memory_order_relaxed);
+}
+
+// Entries are named after the hash of their key and start with CACHE_ENTRY_MAGIC.
+static bool isEntry(const utils::Path& path) noexcept {
+    const std::string name = path.getName();
+    if (name.size() != 16 || !std::all_of(name.begin(), name.end(),
+            [](unsigned char c) { return isxdigit(c); })) {
+        return false;
+    }
+    std::ifstream in(path.c_str(), std::ios::binary);
+    uint32_t magic = 0;
+    return in.read((char*) &magic, sizeof(magic)) && magic == CACHE_ENTRY_MAGIC;
+}
+
+void ShaderCache::trim() noexcept {
+    if (!mValid) {
+        return;
+    }
+
+    struct Entry {
+        utils::Path path;
+        size_t size;
+        time_t lastAccess;
+    };
+
+    // The directory is user-supplied and can hold other files, only our entries count.
+    std::vector<Entry> entries;
+    size_t totalSize = 0;
+    for (const utils::Path& path : mDirectory.listContents()) {
+        struct stat st;
+        if (isEntry(path) && stat(path.c_str(), &st) == 0) {
+            entries.push_back({ path, size_t(st.st_size), st.st_mtime });
+            totalSize += size_t(st.st_size);
+        }
+    }
+
+    if (totalSize <= mMaxSize) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+        return lhs.lastAccess < rhs.lastAccess;
+    });
+
+    for (Entry& entry : entries) {
+        if (totalSize <= mMaxSize) {
+            break;
+        }
+        if (entry.path.unlinkFile()) {
+            totalSize -= entry.size;
+            mEvictions++;
+        }
+    }
+}
+
+ShaderCache::Stats ShaderCache::getStats() const noexcept {
+    return { mHits.load(), mMisses.load(), mEvictions.load() };
+}
+
+} // namespace filamat
@@ -22,6 +22,11 @@
 #include "MockIncluder.h"
 
 #include <filamat/Enums.h>
+#include <filamat/ShaderCache.h>
+
+#include <utils/JobSystem.h>
+
+#include <fstream>
 
 using namespace ASTUtils;
 using namespace filament::backend;
@@ -677,6 +682,129 @@ TEST_F(MaterialCompiler, Arrays) {
     EXPECT_TRUE(result.isValid());
 }
 
+TEST_F(MaterialCompiler, ParallelBuildMatchesSerialBuild) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+            material.baseColor = materialParams.color;
+        }
+    )");
+
+    auto setup = [&shaderCode](filamat::MaterialBuilder& builder) {
+        builder.material(shaderCode.c_str());
+        builder.parameter(UniformType::FLOAT4, "color");
+        builder.targetApi(MaterialBuilder::TargetApi::ALL);
+    };
+
+    filamat::MaterialBuilder serialBuilder;
+    setup(serialBuilder);
+    filamat::Package serial = serialBuilder.build();
+    ASSERT_TRUE(serial.isValid());
+
+    filamat::MaterialBuilder parallelBuilder;
+    setup(parallelBuilder);
+    utils::JobSystem jobSystem;
+    jobSystem.adopt();
+    filamat::Package parallel = parallelBuilder.build(jobSystem);
+    jobSystem.emancipate();
+    ASSERT_TRUE(parallel.isValid());
+
+    ASSERT_EQ(serial.getSize(), parallel.getSize());
+    EXPECT_EQ(memcmp(serial.getData(), parallel.getData(), serial.getSize()), 0);
+}
+
+TEST(ShaderCache, StoreAndEvict) {
+    utils::Path directory = utils::Path::getTemporaryDirectory() + "test_filamat_shader_cache";
+    for (auto& entry : directory.listContents()) {
+        entry.unlinkFile();
+    }
+
+    const std::string glsl = "void main() { }";
+    const std::vector<uint32_t> spirv = { 0x07230203, 1, 2, 3 };
+    const std::string msl = "fragment void main0() { }";
+
+    {
+        filamat::ShaderCache cache(directory.c_str(), 1024 * 1024);
+        ASSERT_TRUE(cache.isValid());
+
+        std::string outGlsl;
+        std::vector<uint32_t> outSpirv;
+        std::string outMsl;
+        EXPECT_FALSE(cache.get("key", &outGlsl, &outSpirv, &outMsl));
+
+        cache.put("key", &glsl, &spirv, &msl);
+        EXPECT_TRUE(cache.get("key", &outGlsl, &outSpirv, &outMsl));
+        EXPECT_EQ(outGlsl, glsl);
+        EXPECT_EQ(outSpirv, spirv);
+        EXPECT_EQ(outMsl, msl);
+
+        // Outputs that are not requested are simply skipped.
+        EXPECT_TRUE(cache.get("key", nullptr, nullptr, nullptr));
+        EXPECT_FALSE(cache.get("other key", &outGlsl, nullptr, nullptr));
+
+        auto stats = cache.getStats();
+        EXPECT_EQ(stats.hits, 2);
+        EXPECT_EQ(stats.misses, 2);
+        EXPECT_EQ(stats.evictions, 0);
+    }
+
+    {
+        // A session that only reads from the cache does not trim it on destruction.
+        filamat::ShaderCache cache(directory.c_str(), 0);
+        EXPECT_TRUE(cache.get("key", nullptr, nullptr, nullptr));
+    }
+
+    {
+        // A zero-sized cache keeps its entries until it is trimmed, which doesn't touch files
+        // that aren't entries.
+        utils::Path other = directory + "notes.txt";
+        std::ofstream(other.c_str()) << "not a cache entry";
+        filamat::ShaderCache cache(directory.c_str(), 0);
+        EXPECT_TRUE(cache.get("key", nullptr, nullptr, nullptr));
+        cache.trim();
+        EXPECT_EQ(cache.getStats().evictions, 1);
+        EXPECT_FALSE(cache.get("key", nullptr, nullptr, nullptr));
+        EXPECT_TRUE(other.exists());
+        other.unlinkFile();
+    }
+}
+
+TEST_F(MaterialCompiler, ShaderCacheMatchesUncachedBuild) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+        }
+    )");
+
+    utils::Path directory = utils::Path::getTemporaryDirectory() + "test_filamat_build_cache";
+    for (auto& entry : directory.listContents()) {
+        entry.unlinkFile();
+    }
+    filamat::ShaderCache cache(directory.c_str(), 64 * 1024 * 1024);
+
+    auto build = [&shaderCode](filamat::ShaderCache* cache) {
+        filamat::MaterialBuilder builder;
+        builder.material(shaderCode.c_str());
+        builder.targetApi(MaterialBuilder::TargetApi::ALL);
+        builder.shaderCache(cache);
+        return builder.build();
+    };
+
+    filamat::Package uncached = build(nullptr);
+    filamat::Package cold = build(&cache);
+    const auto coldStats = cache.getStats();
+    EXPECT_GT(coldStats.misses, 0);
+    filamat::Package warm = build(&cache);
+    const auto warmStats = cache.getStats();
+    EXPECT_EQ(warmStats.misses, coldStats.misses);
+    EXPECT_EQ(warmStats.hits - coldStats.hits, coldStats.hits + coldStats.misses);
+
+    ASSERT_TRUE(uncached.isValid() && cold.isValid() && warm.isValid());
+    ASSERT_EQ(uncached.getSize(), warm.getSize());
+    EXPECT_EQ(memcmp(uncached.getData(), cold.getData(), uncached.getSize()), 0);
+    EXPECT_EQ(memcmp(uncached.getData(), warm.getData(), uncached.getSize()), 0);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
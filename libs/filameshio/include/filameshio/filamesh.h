@@ -36,6 +36,7 @@ enum Flags : uint32_t {
     INTERLEAVED         = 1 << 0,
     TEXCOORD_SNORM16    = 1 << 1,
     COMPRESSION         = 1 << 2,
+    CLUSTERS            = 1 << 3,
 };
 
 // Each of these fields specifies a number of bytes within the compressed data. This is ignored
@@ -79,6 +80,19 @@ struct Part {
     Box aabb;
 };
 
+// When the CLUSTERS flag is set, each part's indices are sorted by cluster and the material names
+// are followed, for each part, by a uint32_t cluster count and that many Cluster records.
+// offset is in indices from the start of the index buffer; the bounds are in object space.
+struct Cluster {
+    uint32_t offset;
+    uint32_t indexCount;
+    filament::math::float3 center;
+    float radius;
+    filament::math::float3 coneApex;
+    filament::math::float3 coneAxis;
+    float coneCutoff;
+};
+
 } // namespace filamesh
 
 #endif // TNT_FILAMENT_FILAMESHIO_FILAMESH_H
@@ -226,6 +226,27 @@ MeshReader::Mesh MeshReader::loadMeshFromBuffer(filament::Engine* engine,
         p += nameLength + 1; // null terminated
     }
 
+    // Clusters are stored per part, after the materials.
+    std::vector<RenderableManager::Cluster> clusters;
+    std::vector<uint32_t> clusterCounts;
+    if (header->flags & CLUSTERS) {
+        for (size_t i = 0; i < header->parts; i++) {
+            uint32_t clusterCount;
+            memcpy(&clusterCount, p, sizeof(uint32_t));
+            p += sizeof(uint32_t);
+            for (size_t c = 0; c < clusterCount; c++) {
+                Cluster cluster;
+                memcpy(&cluster, p, sizeof(Cluster));
+                p += sizeof(Cluster);
+                clusters.push_back({
+                        cluster.offset, cluster.indexCount,
+                        cluster.center, cluster.radius,
+                        cluster.coneApex, cluster.coneAxis, cluster.coneCutoff });
+            }
+            clusterCounts.push_back(clusterCount);
+        }
+    }
+
     Mesh mesh;
 
     mesh.indexBuffer = IndexBuffer::Builder()
@@ -352,10 +373,15 @@ MeshReader::Mesh MeshReader::loadMeshFromBuffer(filament::Engine* engine,
     RenderableManager::Builder builder(header->parts);
     builder.boundingBox(header->aabb);
     const auto defaultmi = materials.getMaterialInstance(utils::CString(DEFAULT_MATERIAL));
+    size_t partClusters = 0;
     for (size_t i = 0; i < header->parts; i++) {
         builder.geometry(i, RenderableManager::PrimitiveType::TRIANGLES,
                             mesh.vertexBuffer, mesh.indexBuffer, parts[i].offset,
                             parts[i].minIndex, parts[i].maxIndex, parts[i].indexCount);
+        if (!clusterCounts.empty()) {
+            builder.clusters(i, clusters.data() + partClusters, clusterCounts[i]);
+            partClusters += clusterCounts[i];
+        }
         const utils::CString materialName(partsMaterial[i].c_str(), partsMaterial[i].size());
         const auto mat = materials.getMaterialInstance(materialName);
         if (mat == nullptr) {
@@ -216,6 +216,65 @@ TEST_F(FilameshTest, Interleaved) {
     engine->destroy(mi);
 }
 
+TEST_F(FilameshTest, Clusters) {
+    // Serialize a single-triangle mesh split into a single cluster
+    const Header header {
+        .version = VERSION,
+        .parts = 1,
+        .aabb = unitBox,
+        .flags = CLUSTERS,
+        .offsetTangents = sizeof(positions),
+        .offsetColor = sizeof(positions) + sizeof(tangents),
+        .offsetUV0 = sizeof(positions) + sizeof(tangents) + sizeof(colors),
+        .strideUV1 = maxint,
+        .vertexCount = vertexCount,
+        .vertexSize = sizeof(positions) + sizeof(tangents) + sizeof(colors) + sizeof(uv0),
+        .indexType = IndexType::UI16,
+        .indexCount = 3,
+        .indexSize = sizeof(uint16_t) * 3
+    };
+    const uint32_t nmats = 1;
+    const string matname = "DefaultMaterial";
+    const uint32_t matnamelength = matname.size();
+    const uint32_t nclusters = 1;
+    const Cluster cluster {
+        .offset = 0,
+        .indexCount = 3,
+        .center = float3(4, 5, 6),
+        .radius = 7,
+        .coneApex = float3(4, 5, 6),
+        .coneAxis = float3(0, 0, 1),
+        .coneCutoff = 1
+    };
+
+    stringstream stream(ios_base::out);
+    write(stream, MAGICID, sizeof(MAGICID));
+    write(stream, &header, sizeof(header));
+    write(stream, positions, sizeof(positions));
+    write(stream, tangents, sizeof(tangents));
+    write(stream, colors, sizeof(colors));
+    write(stream, uv0, sizeof(uv0));
+    write(stream, indices, sizeof(indices));
+    write(stream, parts, sizeof(parts));
+    write(stream, &nmats, sizeof(nmats));
+    write(stream, &matnamelength, sizeof(matnamelength));
+    write(stream, matname.c_str(), matnamelength + 1);
+    write(stream, &nclusters, sizeof(nclusters));
+    write(stream, &cluster, sizeof(cluster));
+
+    // The clusters must tile the part, otherwise the renderable wouldn't be built.
+    MaterialInstance* mi = engine->getDefaultMaterial()->createInstance();
+    auto mesh = MeshReader::loadMeshFromBuffer(engine, stream.str().data(), nullptr, nullptr, mi);
+    auto& rm = engine->getRenderableManager();
+    auto inst = rm.getInstance(mesh.renderable);
+    ASSERT_TRUE(inst);
+    EXPECT_EQ(rm.getPrimitiveCount(inst), 1);
+
+    // Cleanup.
+    engine->destroy(mesh.renderable);
+    engine->destroy(mi);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
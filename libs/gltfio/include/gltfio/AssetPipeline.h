@@ -139,11 +139,19 @@ public:
      */
     using RenderDoneCallback = filament::rays::DoneCallback;
 
+    /**
+     * Signals that a progressive pass of a path-traced image is available. Returning false stops
+     * rendering early. This can be called from any thread.
+     */
+    using RenderPassCallback = filament::rays::PassCallback;
+
     struct RenderOptions {
         RenderTileCallback progress = nullptr;
         RenderDoneCallback done = nullptr;
+        RenderPassCallback pass = nullptr;
         void* userData = nullptr;
         size_t samplesPerPixel = 256;
+        size_t samplesPerPass = 0;
         float aoRayNear = std::numeric_limits<float>::epsilon() * 100.0f;
         bool enableDenoise = true;
         bool enableDilation = true;
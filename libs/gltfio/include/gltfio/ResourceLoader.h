@@ -52,6 +52,11 @@ struct ResourceConfiguration {
     //! If true, computes the bounding boxes of all \c POSITION attibutes. Well formed glTF files
     //! do not need this, but it is useful for robustness.
     bool recomputeBoundingBoxes;
+
+    //! Maximum number of texel bytes, decoded images or KTX payloads, that asyncUpdateLoad() hands
+    //! over to the engine in a single call. Zero means no limit. At least one texture is uploaded per call (if one is
+    //! ready) so that loading always makes progress.
+    size_t asyncUploadBudget = 0;
 };
 
 /**
@@ -69,7 +74,22 @@ struct ResourceConfiguration {
  * because it listens to filament::backend::BufferDescriptor callbacks in order to determine when to
  * free CPU-side data blobs.
  *
- * \todo The GPU upload is asynchronous but the load-from-disk and image decode is not.
+ * Images that contain KTX data (detected from their contents, or from the \c .ktx extension for
+ * files) are uploaded as-is, including pre-compressed formats and pre-baked mipmaps, without any
+ * CPU decoding. Other images are decoded with stb_image into RGBA8 and mipmapped at runtime.
+ *
+ * Resources can either be loaded in a single blocking call to loadResources(), or progressively
+ * with asyncBeginLoad() followed by one call to asyncUpdateLoad() per frame:
+ *
+ * ~~~~~~~~~~~{.cpp}
+ * resourceLoader->asyncBeginLoad(asset);
+ * ...
+ * // once per frame:
+ * resourceLoader->asyncUpdateLoad();
+ * float progress = resourceLoader->asyncGetLoadProgress();
+ * ~~~~~~~~~~~
+ *
+ * \todo The GPU upload and the image decode are asynchronous but the load-from-disk is not.
  */
 class ResourceLoader {
 public:
@@ -88,6 +108,41 @@ public:
      */
     bool loadResources(FilamentAsset* asset);
 
+    /**
+     * Starts an asynchronous resource load.
+     *
+     * Vertex and index buffers are handed to the engine immediately, while image files are decoded
+     * in the background by the JobSystem. The decoded textures are uploaded by subsequent calls to
+     * asyncUpdateLoad(), which should be called once per frame until asyncGetLoadProgress()
+     * returns 1.
+     *
+     * Returns false if resources have already been loaded, if another asynchronous load is still
+     * in progress, or if one or more resources could not be loaded.
+     *
+     * The calling thread must be part of the JobSystem's thread pool.
+     */
+    bool asyncBeginLoad(FilamentAsset* asset);
+
+    /**
+     * Cancels pending decoder jobs and frees all CPU-side texel data that has not been uploaded
+     * yet. This blocks until in-flight decoder jobs have finished. Textures that have not been
+     * uploaded are left undefined.
+     */
+    void asyncCancelLoad();
+
+    /**
+     * Gets the fraction of textures that have been decoded and uploaded, between 0 and 1.
+     * Returns 1 when no asynchronous load is in progress.
+     */
+    float asyncGetLoadProgress() const;
+
+    /**
+     * Uploads textures that have finished decoding, within the limit set by
+     * ResourceConfiguration::asyncUploadBudget. This must be called from the same thread that
+     * called asyncBeginLoad(), typically once per frame.
+     */
+    void asyncUpdateLoad();
+
     /**
      * Adds raw resource data into a cache for platforms that do not have filesystem or network
      * access.
@@ -95,7 +150,11 @@ public:
     void addResourceData(std::string url, BufferDescriptor&& buffer);
 
 private:
-    bool createTextures(details::FFilamentAsset* asset) const;
+    struct TextureLoadState;
+
+    bool loadResources(details::FFilamentAsset* asset, bool async);
+    bool createTextures(details::FFilamentAsset* asset, TextureLoadState& state) const;
+    size_t uploadTextures(TextureLoadState& state, size_t budget) const;
     void applySparseData(details::FFilamentAsset* asset) const;
     void computeTangents(details::FFilamentAsset* asset) const;
     void normalizeSkinningWeights(details::FFilamentAsset* asset) const;
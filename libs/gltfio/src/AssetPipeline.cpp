@@ -734,6 +734,7 @@ void Pipeline::bakeAmbientOcclusion(const cgltf_data* sourceAsset, image::Linear
         .uvCamera(options.enableDilation)
         .denoise(options.enableDilation)
         .samplesPerPixel(options.samplesPerPixel)
+        .progressive(options.samplesPerPass, options.pass, options.userData)
         .occlusionRayBounds(options.aoRayNear, std::numeric_limits<float>::infinity())
         .tileCallback(options.progress, options.userData)
         .doneCallback(options.done, options.userData);
@@ -754,6 +755,7 @@ void Pipeline::renderAmbientOcclusion(const cgltf_data* sourceAsset, image::Line
         .filmCamera(camera)
         .denoise(options.enableDenoise)
         .samplesPerPixel(options.samplesPerPixel)
+        .progressive(options.samplesPerPass, options.pass, options.userData)
         .occlusionRayBounds(options.aoRayNear, std::numeric_limits<float>::infinity())
         .tileCallback(options.progress, options.userData)
         .doneCallback(options.done, options.userData);
@@ -779,6 +781,7 @@ void Pipeline::bakeAllOutputs(const cgltf_data* sourceAsset,
         .uvCamera(options.enableDilation)
         .denoise()
         .samplesPerPixel(options.samplesPerPixel)
+        .progressive(options.samplesPerPass, options.pass, options.userData)
         .occlusionRayBounds(options.aoRayNear, std::numeric_limits<float>::infinity())
         .tileCallback(options.progress, options.userData)
         .doneCallback(options.done, options.userData);
@@ -27,6 +27,9 @@
 
 #include <geometry/SurfaceOrientation.h>
 
+#include <image/KtxBundle.h>
+#include <image/KtxUtility.h>
+
 #include <math/quat.h>
 #include <math/vec3.h>
 #include <math/vec4.h>
@@ -40,7 +43,14 @@
 
 #include <tsl/robin_map.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
 #include <string>
+#include <vector>
 
 using namespace filament;
 using namespace filament::math;
@@ -50,8 +60,43 @@ static const auto FREE_CALLBACK = [](void* mem, size_t, void*) { free(mem); };
 
 namespace gltfio {
 
+// Multiple glTF textures might be loaded from the same URL or buffer pointer, so we prevent
+// needless re-decoding with a cache of Filament Texture objects composed of two maps, where
+// the map keys are URL strings or source data pointers.
+struct TextureCacheEntry {
+    Texture* texture = nullptr;
+    stbi_uc* texels = nullptr;
+    std::unique_ptr<image::KtxBundle> ktx;    // KTX payloads are uploaded as-is
+    std::atomic<bool> decoded = { false };
+    bool uploaded = false;
+};
+
+// Holds the state of the texture decoders for the duration of a load. For synchronous loads this
+// lives on the stack, for asynchronous loads it persists across calls to asyncUpdateLoad().
+struct ResourceLoader::TextureLoadState {
+    tsl::robin_map<const void*, std::unique_ptr<TextureCacheEntry>> bufTextureCache;
+    tsl::robin_map<std::string, std::unique_ptr<TextureCacheEntry>> urlTextureCache;
+
+    // Unique textures in creation order, used to drive uploads and compute progress.
+    std::vector<TextureCacheEntry*> entries;
+    size_t uploadedCount = 0;
+
+    JobSystem* jobSystem = nullptr;
+    JobSystem::Job* decoderRootJob = nullptr;
+
+    ~TextureLoadState() {
+        if (decoderRootJob) {
+            jobSystem->waitAndRelease(decoderRootJob);
+        }
+        for (auto entry : entries) {
+            free(entry->texels);
+        }
+    }
+};
+
 struct ResourceLoader::Impl {
     tsl::robin_map<std::string, BufferDescriptor> mUserCache;
+    std::unique_ptr<TextureLoadState> mAsyncState;
 };
 
 namespace details {
@@ -102,6 +147,7 @@ ResourceLoader::ResourceLoader(const ResourceConfiguration& config) :
         mPool(new AssetPool), mConfig(config), pImpl(new Impl) {}
 
 ResourceLoader::~ResourceLoader() {
+    asyncCancelLoad();
     mPool->onLoaderDestroyed();
     delete pImpl;
 }
@@ -133,8 +179,130 @@ static void generateTrivialIndices(uint32_t* dst, size_t numVertices) {
     }
 }
 
+// Checks that a KTX payload describes a single 2D texture that the engine can sample, and that the
+// payload is large enough for its header, key/value data and every mip level. KtxBundle asserts on
+// malformed input, so this must pass before the bundle is constructed. Returns nullptr on success,
+// or a description of the problem.
+static const char* validateKtx(Engine& engine, const uint8_t* data, size_t size, bool srgb) {
+    using TextureFormat = Texture::InternalFormat;
+    struct Header {
+        uint8_t magic[12];
+        image::KtxInfo info;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    } header;
+    if (!image::KtxBundle::isKtx(data, size) || size < sizeof(header)) {
+        return "not a KTX file";
+    }
+    memcpy(&header, data, sizeof(header));
+    const image::KtxInfo& info = header.info;
+
+    if (header.numberOfFaces > 1 || header.numberOfArrayElements > 0 || info.pixelDepth > 0 ||
+            info.pixelWidth == 0 || info.pixelHeight == 0) {
+        return "only 2D textures are supported";
+    }
+
+    const uint32_t maxLevels = 1 + uint32_t(std::log2(std::max(info.pixelWidth, info.pixelHeight)));
+    const uint32_t levels = std::max(header.numberOfMipmapLevels, 1u);
+    if (levels > maxLevels) {
+        return "too many mip levels";
+    }
+
+    if (image::ktx::isCompressed(info)) {
+        if (image::ktx::toCompressedPixelDataType(info) == Texture::CompressedType(0xffff)) {
+            return "unknown compressed format";
+        }
+    } else if (image::ktx::toPixelDataType(info) == Texture::Type(0xff) ||
+            image::ktx::toPixelDataFormat(info) == Texture::Format(0xff)) {
+        return "unknown pixel format";
+    }
+    TextureFormat format = image::ktx::toTextureFormat(info);
+    if (format == TextureFormat(0xffff)) {
+        return "unknown internal format";
+    }
+    if (srgb) {
+        format = image::ktx::toSrgbTextureFormat(format);
+    }
+    if (!Texture::isTextureFormatSupported(engine, format)) {
+        return "format not supported by this backend";
+    }
+
+    // Walk the key/value pairs and the mip levels exactly like KtxBundle does, bounds checking
+    // each step against the end of the payload.
+    const uint8_t* const end = data + size;
+    const uint8_t* p = data + sizeof(header);
+    if (header.bytesOfKeyValueData > size_t(end - p)) {
+        return "truncated key/value data";
+    }
+    const uint8_t* const kvend = p + header.bytesOfKeyValueData;
+    while (p < kvend) {
+        uint32_t kvsize;
+        if (size_t(kvend - p) < sizeof(kvsize)) {
+            return "truncated key/value data";
+        }
+        memcpy(&kvsize, p, sizeof(kvsize));
+        p += sizeof(kvsize);
+        const size_t padded = kvsize + 3 - ((kvsize + 3) % 4);
+        if (padded > size_t(end - p) || !memchr(p, 0, kvsize)) {
+            return "malformed key/value data";
+        }
+        p += padded;
+    }
+    for (uint32_t level = 0; level < levels; ++level) {
+        uint32_t imageSize;
+        if (size_t(end - p) < sizeof(imageSize)) {
+            return "truncated image data";
+        }
+        memcpy(&imageSize, p, sizeof(imageSize));
+        p += sizeof(imageSize);
+        if (imageSize == 0 || imageSize > size_t(end - p)) {
+            return "truncated image data";
+        }
+        p += imageSize;
+    }
+    return nullptr;
+}
+
 bool ResourceLoader::loadResources(FilamentAsset* asset) {
-    FFilamentAsset* fasset = upcast(asset);
+    return loadResources(upcast(asset), false);
+}
+
+bool ResourceLoader::asyncBeginLoad(FilamentAsset* asset) {
+    if (pImpl->mAsyncState) {
+        slog.e << "An asynchronous load is already in progress." << io::endl;
+        return false;
+    }
+    return loadResources(upcast(asset), true);
+}
+
+void ResourceLoader::asyncCancelLoad() {
+    // Destroying the state waits for the in-flight decoders and frees any texels not yet uploaded.
+    pImpl->mAsyncState.reset();
+}
+
+float ResourceLoader::asyncGetLoadProgress() const {
+    const TextureLoadState* state = pImpl->mAsyncState.get();
+    if (!state || state->entries.empty()) {
+        return 1.0f;
+    }
+    return float(state->uploadedCount) / float(state->entries.size());
+}
+
+void ResourceLoader::asyncUpdateLoad() {
+    TextureLoadState* state = pImpl->mAsyncState.get();
+    if (!state) {
+        return;
+    }
+    uploadTextures(*state, mConfig.asyncUploadBudget);
+    if (state->uploadedCount == state->entries.size()) {
+        pImpl->mAsyncState.reset();
+    }
+}
+
+bool ResourceLoader::loadResources(FFilamentAsset* fasset, bool async) {
+    FilamentAsset* asset = fasset;
     if (fasset->mResourcesLoaded) {
         return false;
     }
@@ -276,11 +444,25 @@ bool ResourceLoader::loadResources(FilamentAsset* asset) {
         computeTangents(fasset);
     }
 
-    // Finally, load image files and create Filament Textures.
-    return createTextures(fasset);
+    // Finally, load image files and create Filament Textures. The decoding happens in the
+    // JobSystem, for asynchronous loads the uploads are deferred to asyncUpdateLoad().
+    auto state = std::make_unique<TextureLoadState>();
+    if (!createTextures(fasset, *state)) {
+        return false;
+    }
+
+    if (async) {
+        pImpl->mAsyncState = std::move(state);
+        return true;
+    }
+
+    state->jobSystem->waitAndRelease(state->decoderRootJob);
+    uploadTextures(*state, 0);
+    return true;
 }
 
-bool ResourceLoader::createTextures(details::FFilamentAsset* asset) const {
+bool ResourceLoader::createTextures(details::FFilamentAsset* asset,
+        TextureLoadState& state) const {
     // Define a simple functor that creates a Filament Texture.
     // TODO: this could be optimized, e.g. do not generate mips if never mipmap-sampled, and use a
     // more compact format when possible.
@@ -295,24 +477,54 @@ bool ResourceLoader::createTextures(details::FFilamentAsset* asset) const {
         return tex;
     };
 
-    // Multiple glTF textures might be loaded from the same URL or buffer pointer, so we prevent
-    // needless re-decoding with a cache of Filament Texture objects composed of two maps, where
-    // the map keys are URL strings or source data pointers.
-
-    struct TextureCacheEntry {
-        Texture* texture;
-        stbi_uc* texels;
+    // KTX payloads are already in a GPU-ready format, possibly compressed and with a full mip
+    // chain, so they bypass the decoder jobs entirely and are uploaded by uploadTextures() like
+    // decoded images. The bundle copies the source blobs. Payloads that fail validation leave
+    // the cache entry without a texture, like images that stb cannot decode.
+    auto createKtxTexture = [this, asset, &state](TextureCacheEntry* cacheEntry,
+            const uint8_t* data, size_t size, bool srgb, const char* name) {
+        if (const char* error = validateKtx(*mConfig.engine, data, size, srgb)) {
+            slog.e << "Unable to load KTX texture " << name << ": " << error << io::endl;
+            return false;
+        }
+        cacheEntry->ktx.reset(new image::KtxBundle(data, uint32_t(size)));
+        const image::KtxInfo& info = cacheEntry->ktx->getInfo();
+        Texture::InternalFormat format = image::ktx::toTextureFormat(info);
+        if (srgb) {
+            format = image::ktx::toSrgbTextureFormat(format);
+        }
+        cacheEntry->texture = Texture::Builder()
+                .width(info.pixelWidth)
+                .height(info.pixelHeight)
+                .levels(uint8_t(cacheEntry->ktx->getNumMipLevels()))
+                .format(format)
+                .build(*mConfig.engine);
+        cacheEntry->decoded = true;
+        asset->mTextures.push_back(cacheEntry->texture);
+        state.entries.push_back(cacheEntry);
+        return true;
     };
-    tsl::robin_map<const void*, std::unique_ptr<TextureCacheEntry>> bufTextureCache;
-    tsl::robin_map<std::string, std::unique_ptr<TextureCacheEntry>> urlTextureCache;
+
+    auto& bufTextureCache = state.bufTextureCache;
+    auto& urlTextureCache = state.urlTextureCache;
 
     // The following loop does a fair bit of synchronous work but it offloads the actual PNG / JPEG
     // decoding into the job system. Synchronously, it invokes stbi_info() over each image, creates
     // Filament Textures, and updates the above caches. Along the way, it kicks off jobs that
-    // perform the decoding.
+    // perform the decoding. The root job is retained so that the caller can decide whether to
+    // wait on it or to poll the individual cache entries.
 
     utils::JobSystem* js = utils::JobSystem::getJobSystem();
     utils::JobSystem::Job* parent = js->createJob();
+    state.jobSystem = js;
+
+    auto decode = [js, parent](TextureCacheEntry* cacheEntry, auto loader) {
+        utils::JobSystem::Job* job = utils::jobs::createJob(*js, parent, [=] {
+            cacheEntry->texels = loader();
+            cacheEntry->decoded.store(true, std::memory_order_release);
+        });
+        js->run(job);
+    };
 
     for (size_t i = 0, n = asset->getTextureBindingCount(); i < n; ++i) {
         const TextureBinding* texbindings = asset->getTextureBindings();
@@ -325,22 +537,36 @@ bool ResourceLoader::createTextures(details::FFilamentAsset* asset) const {
             const uint8_t* sourceData = tb.offset + (const uint8_t*) *tb.data;
             cacheEntry = bufTextureCache[sourceData] ? bufTextureCache[sourceData].get() : nullptr;
             if (cacheEntry) {
-                tb.materialInstance->setParameter(tb.materialParameter, cacheEntry->texture, tb.sampler);
+                if (cacheEntry->texture) {
+                    tb.materialInstance->setParameter(tb.materialParameter, cacheEntry->texture,
+                            tb.sampler);
+                }
                 continue;
             }
 
             cacheEntry = (bufTextureCache[sourceData] = std::make_unique<TextureCacheEntry>()).get();
 
-            if (stbi_info_from_memory(sourceData, tb.totalSize, &width, &height, &comp)) {
-                utils::JobSystem::Job* decode = utils::jobs::createJob(*js, parent, [=] {
-                    int width, height, comp;
-                    cacheEntry->texels = stbi_load_from_memory(sourceData, tb.totalSize, &width, &height, &comp, 4);
-                });
-                js->run(decode);
+            if (image::KtxBundle::isKtx(sourceData, tb.totalSize)) {
+                if (!createKtxTexture(cacheEntry, sourceData, tb.totalSize, tb.srgb,
+                        "(BufferView)")) {
+                    continue;
+                }
+                tb.materialInstance->setParameter(tb.materialParameter, cacheEntry->texture,
+                        tb.sampler);
+                continue;
+            }
+
+            if (!stbi_info_from_memory(sourceData, tb.totalSize, &width, &height, &comp)) {
+                slog.e << "Unable to decode BufferView texture." << io::endl;
+                continue;
             }
 
             cacheEntry->texture = createTexture(width, height, tb.srgb);
-            cacheEntry->texels = nullptr;
+            state.entries.push_back(cacheEntry);
+            decode(cacheEntry, [=] {
+                int width, height, comp;
+                return stbi_load_from_memory(sourceData, tb.totalSize, &width, &height, &comp, 4);
+            });
             tb.materialInstance->setParameter(tb.materialParameter, cacheEntry->texture, tb.sampler);
             continue;
         }
@@ -348,7 +574,10 @@ bool ResourceLoader::createTextures(details::FFilamentAsset* asset) const {
         // Check if we already created a Texture object for this URL.
         cacheEntry = urlTextureCache[tb.uri] ? urlTextureCache[tb.uri].get() : nullptr;
         if (cacheEntry) {
-            tb.materialInstance->setParameter(tb.materialParameter, cacheEntry->texture, tb.sampler);
+            if (cacheEntry->texture) {
+                tb.materialInstance->setParameter(tb.materialParameter, cacheEntry->texture,
+                        tb.sampler);
+            }
             continue;
         }
 
@@ -358,60 +587,146 @@ bool ResourceLoader::createTextures(details::FFilamentAsset* asset) const {
         auto iter = pImpl->mUserCache.find(tb.uri);
         if (iter != pImpl->mUserCache.end()) {
             const uint8_t* sourceData = (const uint8_t*) iter->second.buffer;
-            if (stbi_info_from_memory(sourceData, iter->second.size, &width, &height, &comp)) {
-                utils::JobSystem::Job* decode = utils::jobs::createJob(*js, parent, [=] {
-                    int width, height, comp;
-                    cacheEntry->texels = stbi_load_from_memory(sourceData, iter->second.size, &width, &height, &comp, 4);
-                });
-                js->run(decode);
+            const size_t sourceSize = iter->second.size;
+            if (image::KtxBundle::isKtx(sourceData, sourceSize)) {
+                if (!createKtxTexture(cacheEntry, sourceData, sourceSize, tb.srgb, tb.uri)) {
+                    continue;
+                }
+                tb.materialInstance->setParameter(tb.materialParameter, cacheEntry->texture,
+                        tb.sampler);
+                continue;
             }
+            if (!stbi_info_from_memory(sourceData, sourceSize, &width, &height, &comp)) {
+                slog.e << "Unable to decode texture: " << tb.uri << io::endl;
+                continue;
+            }
+            decode(cacheEntry, [=] {
+                int width, height, comp;
+                return stbi_load_from_memory(sourceData, sourceSize, &width, &height, &comp, 4);
+            });
         } else {
             #if defined(__EMSCRIPTEN__)
                 slog.e << "Unable to load texture: " << tb.uri << io::endl;
+                state.decoderRootJob = js->runAndRetain(parent);
                 return false;
             #else
                 utils::Path fullpath = this->mConfig.gltfPath.getParent() + tb.uri;
-                if (stbi_info(fullpath.c_str(), &width, &height, &comp)) {
-                    utils::JobSystem::Job* decode = utils::jobs::createJob(*js, parent, [=] {
-                        int width, height, comp;
-                        cacheEntry->texels = stbi_load(fullpath.c_str(), &width, &height, &comp, 4);
-                    });
-                    js->run(decode);
+                if (fullpath.getExtension() == "ktx") {
+                    std::ifstream in(fullpath.c_str(), std::ifstream::binary | std::ifstream::ate);
+                    std::vector<uint8_t> contents(in ? size_t(in.tellg()) : 0);
+                    in.seekg(0);
+                    if (!in.read((char*) contents.data(), contents.size()) ||
+                            !image::KtxBundle::isKtx(contents.data(), contents.size())) {
+                        slog.e << "Unable to load KTX texture: " << tb.uri << io::endl;
+                        continue;
+                    }
+                    if (!createKtxTexture(cacheEntry, contents.data(), contents.size(), tb.srgb,
+                            tb.uri)) {
+                        continue;
+                    }
+                    tb.materialInstance->setParameter(tb.materialParameter, cacheEntry->texture,
+                            tb.sampler);
+                    continue;
                 }
+                if (!stbi_info(fullpath.c_str(), &width, &height, &comp)) {
+                    slog.e << "Unable to decode texture: " << tb.uri << io::endl;
+                    continue;
+                }
+                decode(cacheEntry, [=] {
+                    int width, height, comp;
+                    return stbi_load(fullpath.c_str(), &width, &height, &comp, 4);
+                });
             #endif
         }
 
         cacheEntry->texture = createTexture(width, height, tb.srgb);
+        state.entries.push_back(cacheEntry);
         tb.materialInstance->setParameter(tb.materialParameter, cacheEntry->texture, tb.sampler);
     }
 
-    js->runAndWait(parent);
+    state.decoderRootJob = js->runAndRetain(parent);
+    return true;
+}
 
-    // Upload all texture data and generate mipmaps.
+static size_t getKtxSize(const image::KtxBundle& ktx) {
+    size_t total = 0;
+    for (uint32_t level = 0, n = ktx.getNumMipLevels(); level < n; ++level) {
+        uint8_t* data;
+        uint32_t size;
+        ktx.getBlob({ level, 0, 0 }, &data, &size);
+        total += size;
+    }
+    return total;
+}
 
-    auto upload = [](TextureCacheEntry* cacheEntry, Engine& engine) {
-        Texture* texture = cacheEntry->texture;
-        if (texture) {
-            uint8_t* texels = cacheEntry->texels;
-            Texture::PixelBufferDescriptor pbd(texels,
-                    texture->getWidth() * texture->getHeight() * 4,
-                    Texture::Format::RGBA,
-                    Texture::Type::UBYTE,
-                    [] (void* buffer, size_t, void*) { free(buffer); });
-            texture->setImage(engine, 0, std::move(pbd));
-            texture->generateMipmaps(engine);
-            cacheEntry->texture = nullptr;
+// Uploads every level of a 2D KTX texture, see validateKtx(). The bundle is deleted once the
+// engine is done with all of them.
+static void uploadKtx(Engine& engine, Texture* texture, image::KtxBundle* ktx) {
+    struct Upload {
+        std::unique_ptr<image::KtxBundle> ktx;
+        uint32_t remainingLevels;
+    };
+    const uint32_t levels = ktx->getNumMipLevels();
+    Upload* upload = new Upload{ std::unique_ptr<image::KtxBundle>(ktx), levels };
+    auto release = [](void*, size_t, void* user) {
+        Upload* upload = (Upload*) user;
+        if (--upload->remainingLevels == 0) {
+            delete upload;
         }
     };
 
-    for (auto& pair : bufTextureCache) {
-        upload(pair.second.get(), *mConfig.engine);
-    }
-    for (auto& pair : urlTextureCache) {
-        upload(pair.second.get(), *mConfig.engine);
+    const image::KtxInfo& info = ktx->getInfo();
+    const bool compressed = image::ktx::isCompressed(info);
+    for (uint32_t level = 0; level < levels; ++level) {
+        uint8_t* data;
+        uint32_t size;
+        ktx->getBlob({ level, 0, 0 }, &data, &size);
+        Texture::PixelBufferDescriptor pbd = compressed ?
+                Texture::PixelBufferDescriptor(data, size,
+                        image::ktx::toCompressedPixelDataType(info), size, release, upload) :
+                Texture::PixelBufferDescriptor(data, size,
+                        image::ktx::toPixelDataFormat(info), image::ktx::toPixelDataType(info),
+                        release, upload);
+        texture->setImage(engine, level, std::move(pbd));
     }
+}
 
-    return true;
+size_t ResourceLoader::uploadTextures(TextureLoadState& state, size_t budget) const {
+    Engine& engine = *mConfig.engine;
+    size_t uploadedBytes = 0;
+    size_t uploadedCount = 0;
+    for (TextureCacheEntry* cacheEntry : state.entries) {
+        if (cacheEntry->uploaded || !cacheEntry->decoded.load(std::memory_order_acquire)) {
+            continue;
+        }
+        Texture* texture = cacheEntry->texture;
+        const size_t size = cacheEntry->ktx ? getKtxSize(*cacheEntry->ktx) :
+                texture->getWidth() * texture->getHeight() * 4;
+        if (budget && uploadedCount > 0 && uploadedBytes + size > budget) {
+            break;
+        }
+        cacheEntry->uploaded = true;
+        uploadedBytes += size;
+        uploadedCount++;
+        if (cacheEntry->ktx) {
+            uploadKtx(engine, texture, cacheEntry->ktx.release());
+            continue;
+        }
+        uint8_t* texels = cacheEntry->texels;
+        cacheEntry->texels = nullptr;
+        if (!texels) {
+            slog.e << "Unable to decode texture." << io::endl;
+            continue;
+        }
+        Texture::PixelBufferDescriptor pbd(texels, size,
+                Texture::Format::RGBA,
+                Texture::Type::UBYTE,
+                [] (void* buffer, size_t, void*) { free(buffer); });
+        texture->setImage(engine, 0, std::move(pbd));
+        texture->generateMipmaps(engine);
+    }
+    state.uploadedCount += uploadedCount;
+    return uploadedCount;
 }
 
 void ResourceLoader::applySparseData(FFilamentAsset* asset) const {
@@ -50,11 +50,14 @@ public:
      * @param linearRoughness   roughness
      * @param maxNumSamples     number of samples for importance sampling
      * @param updater           a callback for the caller to track progress
+     * @param lodBias           added to the lod each sample is filtered at, when prefilter is set.
+     *                          Each level quadruples the filtered area, which hides the noise of
+     *                          a low sample count at the cost of a blurrier result.
      */
     static void roughnessFilter(
             utils::JobSystem& js, Cubemap& dst, const std::vector<Cubemap>& levels,
             float linearRoughness, size_t maxNumSamples, math::float3 mirror, bool prefilter,
-            Progress updater = {});
+            Progress updater = {}, float lodBias = 0.0f);
 
     //! Computes the "DFG" term of the "split-sum" approximation and stores it in a 2D image
     static void DFG(utils::JobSystem& js, Image& dst, bool multiscatter, bool cloth);
@@ -294,7 +294,7 @@ static float UTILS_UNUSED VisibilityAshikhmin(float NoV, float NoL, float /*a*/)
 void CubemapIBL::roughnessFilter(
         utils::JobSystem& js, Cubemap& dst, const std::vector<Cubemap>& levels,
         float linearRoughness, size_t maxNumSamples, math::float3 mirror, bool prefilter,
-        Progress updater)
+        Progress updater, float lodBias)
 {
     const float numSamples = maxNumSamples;
     const float inumSamples = 1.0f / numSamples;
@@ -381,7 +381,7 @@ void CubemapIBL::roughnessFilter(
             // K is a LOD bias that allows a bit of overlapping between samples
             constexpr float K = 4;
             const float omegaS = 1 / (numSamples * pdf);
-            const float l = float(log4(omegaS) - log4(omegaP) + log4(K));
+            const float l = float(log4(omegaS) - log4(omegaP) + log4(K)) + lodBias;
             const float mipLevel = prefilter ? clamp(float(l), 0.0f, maxLevelf) : 0.0f;
 
             const float brdf_NoL = float(NoL);
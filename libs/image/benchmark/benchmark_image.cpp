@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <image/ImageOps.h>
+#include <image/ImageSampler.h>
+#include <image/LinearImage.h>
+
+#include <utils/JobSystem.h>
+
+#include <random>
+#include <vector>
+
+using namespace image;
+
+// Arguments: width, height, channels, and whether the JobSystem is used.
+
+static LinearImage createNoise(uint32_t width, uint32_t height, uint32_t channels) {
+    LinearImage image(width, height, channels);
+    std::default_random_engine generator;
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    float* data = image.getPixelRef();
+    for (size_t i = 0, n = size_t(width) * height * channels; i < n; i++) {
+        data[i] = distribution(generator);
+    }
+    return image;
+}
+
+static void BM_generateMipmaps(benchmark::State& state) {
+    const LinearImage source = createNoise(
+            uint32_t(state.range(0)), uint32_t(state.range(1)), uint32_t(state.range(2)));
+    utils::JobSystem js;
+    js.adopt();
+    utils::JobSystem* const jobSystem = state.range(3) ? &js : nullptr;
+
+    const uint32_t count = getMipmapCount(source);
+    std::vector<LinearImage> mips(count);
+
+    // Check the parallel path against the single-threaded one, they must match exactly.
+    if (jobSystem) {
+        std::vector<LinearImage> reference(count);
+        generateMipmaps(source, Filter::DEFAULT, reference.data(), count);
+        generateMipmaps(source, Filter::DEFAULT, mips.data(), count, jobSystem);
+        for (uint32_t i = 0; i < count; i++) {
+            if (compare(reference[i], mips[i]) != 0) {
+                state.SkipWithError("parallel and single-threaded mipmaps differ");
+                break;
+            }
+        }
+    }
+
+    for (auto _ : state) {
+        generateMipmaps(source, Filter::DEFAULT, mips.data(), count, jobSystem);
+        benchmark::DoNotOptimize(mips.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) *
+            int64_t(source.getWidth()) * source.getHeight() * source.getChannels() * sizeof(float));
+
+    js.emancipate();
+}
+
+static void BM_computeCoordField(benchmark::State& state) {
+    const LinearImage source = createNoise(uint32_t(state.range(0)), uint32_t(state.range(1)), 1);
+    utils::JobSystem js;
+    js.adopt();
+    utils::JobSystem* const jobSystem = state.range(3) ? &js : nullptr;
+
+    auto presence = [](const LinearImage& img, uint32_t col, uint32_t row, void*) {
+        return img.getPixelRef(col, row)[0] > 0.999f;
+    };
+
+    if (jobSystem) {
+        if (compare(computeCoordField(source, presence, nullptr),
+                computeCoordField(source, presence, nullptr, jobSystem)) != 0) {
+            state.SkipWithError("parallel and single-threaded coordinate fields differ");
+        }
+    }
+
+    for (auto _ : state) {
+        LinearImage field = computeCoordField(source, presence, nullptr, jobSystem);
+        benchmark::DoNotOptimize(field.getPixelRef());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) *
+            int64_t(source.getWidth()) * source.getHeight());
+
+    js.emancipate();
+}
+
+BENCHMARK(BM_generateMipmaps)
+        ->Args({ 1024, 1024, 4, 0 })->Args({ 1024, 1024, 4, 1 })
+        ->Args({ 8192, 4096, 1, 0 })->Args({ 8192, 4096, 1, 1 })
+        ->Args({ 8192, 4096, 3, 0 })->Args({ 8192, 4096, 3, 1 })
+        ->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_computeCoordField)
+        ->Args({ 1024, 1024, 1, 0 })->Args({ 1024, 1024, 1, 1 })
+        ->Args({ 8192, 4096, 1, 0 })->Args({ 8192, 4096, 1, 1 })
+        ->Unit(benchmark::kMillisecond);
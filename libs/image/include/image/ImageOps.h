@@ -22,6 +22,10 @@
 #include <cstddef>
 #include <initializer_list>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace image {
 
 // Concatenates images horizontally to create a filmstrip atlas, similar to numpy's hstack.
@@ -66,7 +70,11 @@ using PresenceCallback = bool(*)(const LinearImage& img, uint32_t col, uint32_t
 // Generates a two-channel field of non-normalized coordinates that indicate the nearest pixel
 // whose presence function returns true. This is the first step before generating a distance
 // field or generalized Voronoi map.
-LinearImage computeCoordField(const LinearImage& src, PresenceCallback presence, void* user);
+//
+// If a JobSystem is given, rows are processed in parallel. The calling thread must be adopted by
+// the JobSystem.
+LinearImage computeCoordField(const LinearImage& src, PresenceCallback presence, void* user,
+        utils::JobSystem* js = nullptr);
 
 // Generates a single-channel Euclidean distance field with positive values outside the region
 // of interest in the source image, and zero values inside. If sqrt is false, the computed
@@ -19,6 +19,10 @@
 
 #include <image/LinearImage.h>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace image {
 
 /**
@@ -100,15 +104,18 @@ struct ImageSampler {
 
 /**
  * Resizes or blurs the given linear image, producing a new linear image with the given dimensions.
+ *
+ * If a JobSystem is given, rows are filtered in parallel. The calling thread must be adopted by
+ * the JobSystem. The result doesn't depend on whether a JobSystem is used.
  */
 LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
-        const ImageSampler& sampler);
+        const ImageSampler& sampler, utils::JobSystem* js = nullptr);
 
 /**
  * Resizes the given linear image using a simplified API that takes target dimensions and filter.
  */
 LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
-        Filter filter = Filter::DEFAULT);
+        Filter filter = Filter::DEFAULT, utils::JobSystem* js = nullptr);
 
 /**
  * Computes a single sample for the given texture coordinate and writes the resulting color
@@ -133,11 +140,14 @@ void computeSingleSample(const LinearImage& source, float x, float y, SingleSamp
  * Generates a sequence of miplevels using the requested filter. To determine the number of mips
  * it would take to get down to 1x1, see getMipmapCount.
  *
+ * If a JobSystem is given, each level is filtered in parallel, see resampleImage().
+ *
  * Source image need not be power-of-two. In the result vector, the half-size image is returned at
  * index 0, the quarter-size image is at index 1, etc. Please note that the original-sized image is
  * not included.
  */
-void generateMipmaps(const LinearImage& source, Filter, LinearImage* result, uint32_t mipCount);
+void generateMipmaps(const LinearImage& source, Filter, LinearImage* result, uint32_t mipCount,
+        utils::JobSystem* js = nullptr);
 
 /**
  * Returns the number of miplevels it would take to downsample the given image down to 1x1. This
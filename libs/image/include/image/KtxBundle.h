@@ -78,6 +78,12 @@ public:
      */
     KtxBundle(uint8_t const* bytes, uint32_t nbytes);
 
+    /**
+     * Returns true if the given data is large enough to contain a KTX header and starts with the
+     * KTX file identifier. This can be used to sniff arbitrary image data before deserializing it.
+     */
+    static bool isKtx(uint8_t const* bytes, uint32_t nbytes);
+
     /**
      * Serializes the bundle into the given target memory. Returns false if there's not enough
      * memory.
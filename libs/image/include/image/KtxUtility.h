@@ -48,6 +48,7 @@ namespace ktx {
     PixelDataFormat toPixelDataFormat(const KtxInfo& info);
     bool isCompressed(const KtxInfo& info);
     TextureFormat toTextureFormat(const KtxInfo& info);
+    TextureFormat toSrgbTextureFormat(TextureFormat format);
 
     /**
      * Creates a Texture object from a KTX file and populates all of its faces and miplevels.
@@ -69,12 +70,7 @@ namespace ktx {
 
         auto texformat = toTextureFormat(ktxinfo);
         if (srgb) {
-            if (texformat == Texture::InternalFormat::RGB8) {
-                texformat = Texture::InternalFormat::SRGB8;
-            }
-            if (texformat == Texture::InternalFormat::RGBA8) {
-                texformat = Texture::InternalFormat::SRGB8_A8;
-            }
+            texformat = toSrgbTextureFormat(texformat);
         }
 
         Texture* texture = Texture::Builder()
@@ -300,6 +296,36 @@ namespace ktx {
         return toCompressedFilamentEnum<TextureFormat>(info.glInternalFormat);
     }
 
+    /**
+     * Returns the sRGB variant of the given format, or the format itself if there is none. This
+     * covers the compressed formats as well, since the backends use the texture's internal format
+     * (not the pixel buffer's compressed type) when uploading.
+     */
+    inline TextureFormat toSrgbTextureFormat(TextureFormat format) {
+        switch (format) {
+            case TextureFormat::RGB8: return TextureFormat::SRGB8;
+            case TextureFormat::RGBA8: return TextureFormat::SRGB8_A8;
+            case TextureFormat::ETC2_RGB8: return TextureFormat::ETC2_SRGB8;
+            case TextureFormat::ETC2_RGB8_A1: return TextureFormat::ETC2_SRGB8_A1;
+            case TextureFormat::ETC2_EAC_RGBA8: return TextureFormat::ETC2_EAC_SRGBA8;
+            case TextureFormat::RGBA_ASTC_4x4: return TextureFormat::SRGB8_ALPHA8_ASTC_4x4;
+            case TextureFormat::RGBA_ASTC_5x4: return TextureFormat::SRGB8_ALPHA8_ASTC_5x4;
+            case TextureFormat::RGBA_ASTC_5x5: return TextureFormat::SRGB8_ALPHA8_ASTC_5x5;
+            case TextureFormat::RGBA_ASTC_6x5: return TextureFormat::SRGB8_ALPHA8_ASTC_6x5;
+            case TextureFormat::RGBA_ASTC_6x6: return TextureFormat::SRGB8_ALPHA8_ASTC_6x6;
+            case TextureFormat::RGBA_ASTC_8x5: return TextureFormat::SRGB8_ALPHA8_ASTC_8x5;
+            case TextureFormat::RGBA_ASTC_8x6: return TextureFormat::SRGB8_ALPHA8_ASTC_8x6;
+            case TextureFormat::RGBA_ASTC_8x8: return TextureFormat::SRGB8_ALPHA8_ASTC_8x8;
+            case TextureFormat::RGBA_ASTC_10x5: return TextureFormat::SRGB8_ALPHA8_ASTC_10x5;
+            case TextureFormat::RGBA_ASTC_10x6: return TextureFormat::SRGB8_ALPHA8_ASTC_10x6;
+            case TextureFormat::RGBA_ASTC_10x8: return TextureFormat::SRGB8_ALPHA8_ASTC_10x8;
+            case TextureFormat::RGBA_ASTC_10x10: return TextureFormat::SRGB8_ALPHA8_ASTC_10x10;
+            case TextureFormat::RGBA_ASTC_12x10: return TextureFormat::SRGB8_ALPHA8_ASTC_12x10;
+            case TextureFormat::RGBA_ASTC_12x12: return TextureFormat::SRGB8_ALPHA8_ASTC_12x12;
+            default: return format;
+        }
+    }
+
 } // namespace ktx
 
 } // namespace image
@@ -18,9 +18,11 @@
 
 #include <math/vec3.h>
 #include <math/vec4.h>
+#include <utils/JobSystem.h>
 #include <utils/Panic.h>
 
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <ratio>
 
@@ -202,13 +204,22 @@ LinearImage transpose(const LinearImage& image) {
     LinearImage result(height, width, channels);
     float const* source = image.getPixelRef();
     float* target = result.getPixelRef();
-    for (uint32_t n = 0; n < width * height; ++n) {
-        const uint32_t i = n / width;
-        const uint32_t j = n % width;
-        float const* src = source + channels * n;
-        float* dst = target + channels * (height * j + i);
-        for (uint32_t c = 0; c < channels; ++c) {
-            dst[c] = src[c];
+    // Proceed by square tiles, so that the rows being read and the rows being written both stay
+    // in the cache.
+    constexpr uint32_t TILE = 32;
+    for (uint32_t i0 = 0; i0 < height; i0 += TILE) {
+        const uint32_t i1 = std::min(i0 + TILE, height);
+        for (uint32_t j0 = 0; j0 < width; j0 += TILE) {
+            const uint32_t j1 = std::min(j0 + TILE, width);
+            for (uint32_t i = i0; i < i1; ++i) {
+                float const* src = source + channels * (size_t(width) * i + j0);
+                for (uint32_t j = j0; j < j1; ++j, src += channels) {
+                    float* dst = target + channels * (size_t(height) * j + i);
+                    for (uint32_t c = 0; c < channels; ++c) {
+                        dst[c] = src[c];
+                    }
+                }
+            }
         }
     }
     return result;
@@ -311,21 +322,31 @@ static void edt(const float* f, float* d, float* z, float* v, float* i, size_t n
     }
 }
 
-static LinearImage computeHorizontalEdt(const LinearImage& src, LinearImage cx) {
+static LinearImage computeHorizontalEdt(const LinearImage& src, LinearImage& cx,
+        utils::JobSystem* js) {
     const uint32_t width = src.getWidth();
     const uint32_t height = src.getHeight();
     LinearImage tmp0(width + 1, height + 1, 1);
     LinearImage tmp1(width + 1, height + 1, 1);
     LinearImage dst(width, height, 1);
 
-    // TODO: use utils::job::parallel_for.
-    for (uint32_t row = 0; row < height; ++row) {
-        const float* f = src.getPixelRef(0, row);
-        float* d = dst.getPixelRef(0, row);
-        float* z = tmp0.getPixelRef(0, row);
-        float* v = tmp1.getPixelRef(0, row);
-        float* i = cx.getPixelRef(0, row);
-        edt(f, d, z, v, i, width);
+    // each row only touches its own row of the images above, so they can run in parallel
+    auto edtRows = [&](uint32_t begin, uint32_t count) {
+        for (uint32_t row = begin; row < begin + count; ++row) {
+            const float* f = src.getPixelRef(0, row);
+            float* d = dst.getPixelRef(0, row);
+            float* z = tmp0.getPixelRef(0, row);
+            float* v = tmp1.getPixelRef(0, row);
+            float* i = cx.getPixelRef(0, row);
+            edt(f, d, z, v, i, width);
+        }
+    };
+    if (js) {
+        auto job = utils::jobs::parallel_for(*js, nullptr, 0, height,
+                std::ref(edtRows), utils::jobs::CountSplitter<16>());
+        js->runAndWait(job);
+    } else {
+        edtRows(0, height);
     }
 
     return dst;
@@ -334,7 +355,8 @@ static LinearImage computeHorizontalEdt(const LinearImage& src, LinearImage cx)
 // Implements the paper 'Distance Transforms of Sampled Functions' by Felzenszwalb and Huttenlocher
 // but generalized to compute a coordinate field rather than a distance field. Coordinate fields are
 // more broadly useful and transforming them into distance fields is extremely cheap.
-LinearImage computeCoordField(const LinearImage& src, PresenceCallback presence, void* user) {
+LinearImage computeCoordField(const LinearImage& src, PresenceCallback presence, void* user,
+        utils::JobSystem* js) {
     const uint32_t width = src.getWidth();
     const uint32_t height = src.getHeight();
     LinearImage f0(width, height, 1);
@@ -348,9 +370,9 @@ LinearImage computeCoordField(const LinearImage& src, PresenceCallback presence,
     LinearImage cx(width, height, 1);
     LinearImage cy(height, width, 1);
 
-    f0 = computeHorizontalEdt(f0, cx);
+    f0 = computeHorizontalEdt(f0, cx, js);
     f0 = transpose(f0);
-    f0 = computeHorizontalEdt(f0, cy);
+    f0 = computeHorizontalEdt(f0, cy, js);
     f0 = transpose(f0);
 
     // NOTE: this could be extended to compute a volumetric distance field by transposing
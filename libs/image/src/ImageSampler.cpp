@@ -21,14 +21,18 @@
 #include <math/vec3.h>
 #include <math/vec4.h>
 
-#include <utils/Panic.h>
+#include <utils/compiler.h>
 #include <utils/CString.h>
+#include <utils/JobSystem.h>
+#include <utils/Panic.h>
 
+#include <functional>
 #include <memory>
 #include <vector>
 #include <unordered_map>
 
 using namespace image;
+using namespace utils;
 
 namespace {
 
@@ -132,7 +136,7 @@ void generateMadProgram(uint32_t ntarget, uint32_t nsource, float left, float ri
     // the [0,1] domain. If this were a huge number, the filtered results would look the same, but
     // the filter would perform very poorly because it would be iterating over a lot more samples
     // than necessary.
-    const float filterBounds = domainScale * std::abs(filter.boundingRadius);
+    const float filterBounds = std::abs(filter.boundingRadius) / domainScale;
 
     // Iterate through target samples. "xtarget" points to the center of each target pixel.
     float xtarget = dtarget / 2.0f;
@@ -143,9 +147,17 @@ void generateMadProgram(uint32_t ntarget, uint32_t nsource, float left, float ri
         uint32_t count = 0;
         float sum = 0;
 
-        // Iterate through source samples that lie within the bounded region.
-        const auto isource_lower = int32_t((xtarget - filterBounds) * nsource);
-        const auto isource_upper = int32_t(std::ceil((xtarget + filterBounds) * nsource));
+        // Iterate through source samples that lie within the bounded region, mapped from the
+        // source range to source indices. We allow one extra sample on each side for rounding.
+        // A filter without extent (i.e. NEAREST) only considers the two samples around xtarget.
+        int32_t isource_lower = int32_t(xtarget * nsource);
+        int32_t isource_upper = int32_t(std::ceil(xtarget * nsource));
+        if (filterBounds > 0) {
+            const float xlower = (xtarget - filterBounds) * (right - left) + left;
+            const float xupper = (xtarget + filterBounds) * (right - left) + left;
+            isource_lower = int32_t(std::floor(xlower * nsource - 0.5f)) - 1;
+            isource_upper = int32_t(std::ceil(xupper * nsource - 0.5f)) + 1;
+        }
         for (int32_t isource = isource_lower; isource <= isource_upper; ++isource) {
             const float xsource = (((isource + 0.5f) / nsource) - left) / (right - left);
             const bool outside_image = isource < 0 || isource >= int32_t(nsource);
@@ -172,22 +184,72 @@ void generateMadProgram(uint32_t ntarget, uint32_t nsource, float left, float ri
     }
 }
 
-// Transforms a MAD program intended for single-channel data into a program intended for
-// multi-channel data.
-void expandMadProgram(uint32_t nchannels, MadProgram* program) {
-    if (nchannels == 1) {
-        return;
-    }
-    MadProgram result;
-    result.reserve(program->size() * nchannels);
-    for (auto mad : *program) {
-        mad.sourceIndex *= nchannels;
-        mad.targetIndex *= nchannels;
-        for (uint32_t j = 0; j < nchannels; ++j, ++mad.sourceIndex, ++mad.targetIndex) {
-            result.push_back(mad);
+// Executes a MAD program intended for single-channel data over ROWS rows of multi-channel data.
+// Each instruction is loaded once and applied to all channels of all rows; when the number of
+// channels N is known at compile time (N > 0) these inner loops are unrolled and vectorized.
+// The instructions are executed in order, so the result is the same as executing the program on
+// each channel of each row separately.
+template<uint32_t N, uint32_t ROWS, bool MINIMUM>
+UTILS_ALWAYS_INLINE
+inline void executeMadProgram(MadProgram const& program, uint32_t nchan,
+        float const* UTILS_RESTRICT source, size_t sourceStride,
+        float* UTILS_RESTRICT target, size_t targetStride) {
+    const uint32_t nc = N ? N : nchan;
+    for (MadInstruction const& mad : program) {
+        float const* UTILS_RESTRICT src = source + mad.sourceIndex * nc;
+        float* UTILS_RESTRICT dst = target + mad.targetIndex * nc;
+        const float weight = mad.weight;
+        for (uint32_t r = 0; r < ROWS; ++r) {
+            for (uint32_t c = 0; c < nc; ++c) {
+                const float a = src[r * sourceStride + c];
+                float& b = dst[r * targetStride + c];
+                b = MINIMUM ? std::min(a, b) : b + a * weight;
+            }
         }
     }
-    program->swap(result);
+}
+
+// Executes a MAD program over the rows [begin, end) of an image, four rows at a time.
+template<uint32_t N, bool MINIMUM>
+void executeMadProgram(MadProgram const& program, uint32_t nchan,
+        float const* source, uint32_t swidth, float* target, uint32_t twidth,
+        uint32_t begin, uint32_t end) {
+    const size_t sourceStride = size_t(swidth) * nchan;
+    const size_t targetStride = size_t(twidth) * nchan;
+    uint32_t row = begin;
+    for (; row + 4 <= end; row += 4) {
+        executeMadProgram<N, 4, MINIMUM>(program, nchan,
+                source + row * sourceStride, sourceStride,
+                target + row * targetStride, targetStride);
+    }
+    for (; row < end; ++row) {
+        executeMadProgram<N, 1, MINIMUM>(program, nchan,
+                source + row * sourceStride, sourceStride,
+                target + row * targetStride, targetStride);
+    }
+}
+
+template<bool MINIMUM>
+void executeMadProgram(MadProgram const& program, uint32_t nchan,
+        float const* source, uint32_t swidth, float* target, uint32_t twidth,
+        uint32_t begin, uint32_t end) {
+    switch (nchan) {
+        case 1:
+            executeMadProgram<1, MINIMUM>(program, nchan, source, swidth, target, twidth, begin, end);
+            break;
+        case 2:
+            executeMadProgram<2, MINIMUM>(program, nchan, source, swidth, target, twidth, begin, end);
+            break;
+        case 3:
+            executeMadProgram<3, MINIMUM>(program, nchan, source, swidth, target, twidth, begin, end);
+            break;
+        case 4:
+            executeMadProgram<4, MINIMUM>(program, nchan, source, swidth, target, twidth, begin, end);
+            break;
+        default:
+            executeMadProgram<0, MINIMUM>(program, nchan, source, swidth, target, twidth, begin, end);
+            break;
+    }
 }
 
 FilterFunction createFilterFunction(Filter ftype) {
@@ -227,7 +289,8 @@ void normalize(LinearImage& image) {
 }
 
 LinearImage resampleImage1D(const LinearImage& source, MadProgram* program,
-        uint32_t twidth, Filter filter, float left, float right, float filterRadiusMultiplier) {
+        uint32_t twidth, Filter filter, float left, float right, float filterRadiusMultiplier,
+        JobSystem* js) {
     const uint32_t swidth = source.getWidth();
     const uint32_t sheight = source.getHeight();
     const uint32_t nchan = source.getChannels();
@@ -238,37 +301,40 @@ LinearImage resampleImage1D(const LinearImage& source, MadProgram* program,
     // Generate a flat list of multiply-add (MAD) instructions.
     program->clear();
     generateMadProgram(twidth, swidth, left, right, hfn, filterRadiusMultiplier, program);
-    expandMadProgram(nchan, program);
 
     // Allocate the target image.
     LinearImage result(twidth, sheight, nchan);
-    float const* sourceRow = source.getPixelRef();
-    float* targetRow = result.getPixelRef();
+    float const* sourcePixels = source.getPixelRef();
+    float* targetPixels = result.getPixelRef();
 
     // The MIN filter is special because it starts with non-zero values and ignores filter weights.
-    if (filter == Filter::MINIMUM) {
+    const bool minimum = filter == Filter::MINIMUM;
+    if (minimum) {
         for (uint32_t n = 0; n < twidth * sheight * nchan; ++n) {
-            targetRow[n] = std::numeric_limits<float>::max();
+            targetPixels[n] = std::numeric_limits<float>::max();
         }
-        for (uint32_t row = 0; row < sheight; ++row) {
-            for (auto mad : *program) {
-                const float a = sourceRow[mad.sourceIndex];
-                const float b = targetRow[mad.targetIndex];
-                targetRow[mad.targetIndex] = std::min(a, b);
-            }
-            targetRow += twidth * nchan;
-            sourceRow += swidth * nchan;
-        }
-        return result;
     }
 
-    // Resize the image horizontally by executing the MAD instructions over each row.
-    for (uint32_t row = 0; row < sheight; ++row) {
-        for (auto mad : *program) {
-            targetRow[mad.targetIndex] += sourceRow[mad.sourceIndex] * mad.weight;
+    // Resize the image horizontally by executing the MAD instructions over each row. Rows are
+    // independent, so they're processed in parallel if we have a JobSystem.
+    auto filterRows = [&](uint32_t begin, uint32_t count) {
+        if (minimum) {
+            executeMadProgram<true>(*program, nchan,
+                    sourcePixels, swidth, targetPixels, twidth, begin, begin + count);
+        } else {
+            executeMadProgram<false>(*program, nchan,
+                    sourcePixels, swidth, targetPixels, twidth, begin, begin + count);
         }
-        targetRow += twidth * nchan;
-        sourceRow += swidth * nchan;
+    };
+    if (js) {
+        auto job = jobs::parallel_for(*js, nullptr, 0, sheight,
+                std::ref(filterRows), jobs::CountSplitter<64>());
+        js->runAndWait(job);
+    } else {
+        filterRows(0, sheight);
+    }
+    if (minimum) {
+        return result;
     }
 
     // Perform post processing for the current pass.
@@ -287,7 +353,7 @@ SingleSample::~SingleSample() {
 }
 
 LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
-        const ImageSampler& sampler) {
+        const ImageSampler& sampler, JobSystem* js) {
     ASSERT_PRECONDITION(
         sampler.east.mode == Boundary::EXCLUDE &&
         sampler.north.mode == Boundary::EXCLUDE &&
@@ -302,17 +368,17 @@ LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t he
     const float bottom = sampler.sourceRegion.bottom;
     MadProgram program;
     LinearImage result;
-    result = transpose(resampleImage1D(source, &program, width, hfilter, left, right, radius));
-    result = transpose(resampleImage1D(result, &program, height, vfilter, top, bottom, radius));
+    result = transpose(resampleImage1D(source, &program, width, hfilter, left, right, radius, js));
+    result = transpose(resampleImage1D(result, &program, height, vfilter, top, bottom, radius, js));
     return result;
 }
 
 LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
-        Filter filter) {
+        Filter filter, JobSystem* js) {
     return resampleImage(source, width, height, ImageSampler {
         .horizontalFilter = filter,
         .verticalFilter = filter
-    });
+    }, js);
 }
 
 void computeSingleSample(const LinearImage& source, float x, float y, SingleSample* result,
@@ -323,8 +389,9 @@ void computeSingleSample(const LinearImage& source, float x, float y, SingleSamp
     const float right = x + radius / source.getWidth();
     const float bottom = y + radius / source.getHeight();
     MadProgram program;
-    LinearImage row = transpose(resampleImage1D(source, &program, 1, filter, left, right, radius));
-    row = resampleImage1D(row, &program, 1, filter, top, bottom, radius);
+    LinearImage row = transpose(
+            resampleImage1D(source, &program, 1, filter, left, right, radius, nullptr));
+    row = resampleImage1D(row, &program, 1, filter, top, bottom, radius, nullptr);
     if (!result->data) {
         result->data = new float[source.getChannels()];
     }
@@ -337,14 +404,15 @@ void computeSingleSample(const LinearImage& source, float x, float y, SingleSamp
 
 // Unlike traditional mipmap generation, our implementation generates all levels from the original
 // image, under the premise that this produces a higher quality result.
-void generateMipmaps(const LinearImage& source, Filter filter, LinearImage* result, uint32_t mips) {
+void generateMipmaps(const LinearImage& source, Filter filter, LinearImage* result, uint32_t mips,
+        JobSystem* js) {
     mips = std::min(mips, getMipmapCount(source));
     uint32_t width = source.getWidth();
     uint32_t height = source.getHeight();
     for (uint32_t n = 0; n < mips; ++n) {
        width = std::max(width >> 1u, 1u);
        height = std::max(height >> 1u, 1u);
-       result[n] = resampleImage(source, width, height, filter);
+       result[n] = resampleImage(source, width, height, filter, js);
     }
 }
 
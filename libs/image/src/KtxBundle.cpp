@@ -169,6 +169,10 @@ KtxBundle::KtxBundle(uint8_t const* bytes, uint32_t nbytes) :
     }
 }
 
+bool KtxBundle::isKtx(uint8_t const* bytes, uint32_t nbytes) {
+    return nbytes >= sizeof(SerializationHeader) && memcmp(bytes, MAGIC, sizeof(MAGIC)) == 0;
+}
+
 bool KtxBundle::serialize(uint8_t* destination, uint32_t numBytes) const {
     uint32_t requiredLength = getSerializedLength();
     if (numBytes < requiredLength) {
@@ -26,6 +26,7 @@
 
 #include <gtest/gtest.h>
 
+#include <utils/JobSystem.h>
 #include <utils/Panic.h>
 #include <utils/Path.h>
 
@@ -362,6 +363,40 @@ TEST_F(ImageTest, Mipmaps) { // NOLINT
     }
 }
 
+TEST_F(ImageTest, JobSystem) { // NOLINT
+    utils::JobSystem js;
+    js.adopt();
+
+    // an image tall enough to be split in many jobs, with a channel count that isn't a multiple
+    // of the vector size
+    LinearImage src = createColorFromAscii("01234 56701 23456 70123");
+    src = resampleImage(src, 301, 517, Filter::GAUSSIAN_SCALARS);
+
+    // the parallel result must be exactly the serial result
+    const Filter filters[] = { Filter::DEFAULT, Filter::BOX, Filter::MINIMUM, Filter::LANCZOS };
+    for (Filter filter : filters) {
+        LinearImage serial = resampleImage(src, 130, 257, filter);
+        LinearImage parallel = resampleImage(src, 130, 257, filter, &js);
+        EXPECT_EQ(0, compare(serial, parallel));
+    }
+
+    const uint32_t count = getMipmapCount(src);
+    vector<LinearImage> serial(count), parallel(count);
+    generateMipmaps(src, Filter::DEFAULT, serial.data(), count);
+    generateMipmaps(src, Filter::DEFAULT, parallel.data(), count, &js);
+    for (uint32_t index = 0; index < count; ++index) {
+        EXPECT_EQ(0, compare(serial[index], parallel[index]));
+    }
+
+    auto presence = [] (const LinearImage& img, uint32_t col, uint32_t row, void*) {
+        return img.getPixelRef(col, row)[0] > 0.5f;
+    };
+    EXPECT_EQ(0, compare(computeCoordField(src, presence, nullptr),
+            computeCoordField(src, presence, nullptr, &js)));
+
+    js.emancipate();
+}
+
 TEST_F(ImageTest, Ktx) { // NOLINT
     uint8_t foo[] = {1, 2, 3};
     uint8_t* data;
@@ -378,6 +413,12 @@ TEST_F(ImageTest, Ktx) { // NOLINT
 
     const uint32_t KTX_HEADER_SIZE = 16 * 4;
 
+    vector<uint8_t> serialized(nascent.getSerializedLength());
+    ASSERT_TRUE(nascent.serialize(serialized.data(), serialized.size()));
+    ASSERT_TRUE(KtxBundle::isKtx(serialized.data(), serialized.size()));
+    ASSERT_FALSE(KtxBundle::isKtx(serialized.data(), KTX_HEADER_SIZE - 1));
+    ASSERT_FALSE(KtxBundle::isKtx(foo, sizeof(foo)));
+
     auto getFileSize = [](const char* filename) {
         std::ifstream in(filename, std::ifstream::ate | std::ifstream::binary);
         return in.tellg();
@@ -28,6 +28,10 @@
 
 #include <stdint.h>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace image {
 
 enum class CompressedFormat {
@@ -120,7 +124,12 @@ struct AstcConfig {
 
 // Uses the CPU to compress a linear image (1 to 4 channels) into an ASTC texture. The 16-byte
 // header block that ARM uses in their file format is not included.
-CompressedTexture astcCompress(const LinearImage& source, AstcConfig config);
+//
+// By default the encoder creates one thread per CPU for each call. If a JobSystem is given, the
+// image is instead split into bands of block rows which are compressed in parallel on it, which
+// allows several images to be compressed concurrently; the progress counter is then disabled.
+CompressedTexture astcCompress(const LinearImage& source, AstcConfig config,
+        utils::JobSystem* js = nullptr);
 
 // Parses a simple underscore-delimited string to produce an ASTC compression configuration. This
 // makes it easy to incorporate the compression API into command-line tools. If the string is
@@ -147,7 +156,13 @@ struct EtcConfig {
 };
 
 // Uses the CPU to compress a linear image (1 to 4 channels) into an ETC texture.
-CompressedTexture etcCompress(const LinearImage& source, EtcConfig config);
+//
+// By default the encoder creates one thread per CPU for each call. If a JobSystem is given, the
+// image is instead split into bands of block rows which are compressed in parallel on it. The
+// effort is then spent per band rather than across the whole image, so the result can differ
+// slightly when the effort is below 100.
+CompressedTexture etcCompress(const LinearImage& source, EtcConfig config,
+        utils::JobSystem* js = nullptr);
 
 // Converts a string into an ETC compression configuration where the string has the form
 // FORMAT_METRIC_EFFORT where:
@@ -165,8 +180,10 @@ struct S3tcConfig {
     bool srgb;
 };
 
-// Uses the CPU to compress a linear image (1 to 4 channels) into an S3TC texture.
-CompressedTexture s3tcCompress(const LinearImage& source, S3tcConfig config);
+// Uses the CPU to compress a linear image (1 to 4 channels) into an S3TC texture. If a JobSystem is
+// given, block rows are compressed in parallel on it.
+CompressedTexture s3tcCompress(const LinearImage& source, S3tcConfig config,
+        utils::JobSystem* js = nullptr);
 
 // Parses an underscore-delimited string to produce an S3TC compression configuration. Currently
 // this only accepts "rgb_dxt1" and "rgba_dxt5". If the string is malformed, this returns a config
@@ -184,7 +201,10 @@ struct CompressionConfig {
 
 bool parseOptionString(const std::string& options, CompressionConfig* config);
 
-CompressedTexture compressTexture(const CompressionConfig& config, const LinearImage& image);
+// Compresses an image with any of the above encoders. This can be called concurrently, e.g. from
+// several jobs of the given JobSystem.
+CompressedTexture compressTexture(const CompressionConfig& config, const LinearImage& image,
+        utils::JobSystem* js = nullptr);
 
 } // namespace image
 
@@ -18,9 +18,13 @@
 
 #include <image/ImageOps.h>
 
+#include <utils/JobSystem.h>
+
 #include <algorithm>
 #include <cmath>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include <astcenc.h>
 #include <Etc.h>
@@ -28,14 +32,43 @@
 #define STB_DXT_IMPLEMENTATION
 #include <stb_dxt.h>
 
+// Not declared in astcenc.h, this disables the progress counter printed by the encoder.
+extern int suppress_progress_counter;
+
 namespace image {
 
+using namespace utils;
+
 static LinearImage extendToFourChannels(LinearImage source);
 
-CompressedTexture astcCompress(const LinearImage& original, AstcConfig config) {
+// The ARM encoder builds its tables lazily, the first time it sees a given block size, which is
+// not thread-safe. This lock is held by anything that may build them. The block mode histogram
+// that the encoder updates for each block isn't thread-safe either, it is compiled out.
+static std::mutex sAstcLock;
+
+// The progress counter isn't thread-safe either, so it is suppressed while job-based encodes are
+// in flight, and restored to the value it had when the last one finishes. Guarded by sAstcLock.
+static int sSuppressProgressCount = 0;
+static int sSavedSuppressProgress = 0;
+
+static void suppressAstcProgress() noexcept {
+    if (sSuppressProgressCount++ == 0) {
+        sSavedSuppressProgress = suppress_progress_counter;
+        suppress_progress_counter = 1;
+    }
+}
+
+static void restoreAstcProgress() noexcept {
+    if (--sSuppressProgressCount == 0) {
+        suppress_progress_counter = sSavedSuppressProgress;
+    }
+}
+
+CompressedTexture astcCompress(const LinearImage& original, AstcConfig config, JobSystem* js) {
 
     // If this is the first time, initialize the ARM encoder tables.
 
+    std::unique_lock<std::mutex> lock(sAstcLock);
     static bool first = true;
     if (first) {
         test_inappropriate_extended_precision();
@@ -43,6 +76,7 @@ CompressedTexture astcCompress(const LinearImage& original, AstcConfig config) {
         build_quantization_mode_table();
         first = false;
     }
+    lock.unlock();
 
     // Check the validity of the given block size.
 
@@ -289,8 +323,6 @@ CompressedTexture astcCompress(const LinearImage& original, AstcConfig config) {
             break;
     }
 
-    const int threadcount = std::thread::hardware_concurrency();
-
     const int xsize = input_image->xsize;
     const int ysize = input_image->ysize;
     const int zsize = input_image->zsize;
@@ -301,8 +333,51 @@ CompressedTexture astcCompress(const LinearImage& original, AstcConfig config) {
     uint32_t size = xblocks * yblocks * zblocks * 16;
     uint8_t* buffer = new uint8_t[size];
 
-    encode_astc_image(input_image, nullptr, xdim, ydim, zdim, &ewp, decode_mode,
-            swz_encode, swz_decode, buffer, 0, threadcount);
+    if (!js) {
+        lock.lock();
+        encode_astc_image(input_image, nullptr, xdim, ydim, zdim, &ewp, decode_mode,
+                swz_encode, swz_decode, buffer, 0, std::thread::hardware_concurrency());
+        lock.unlock();
+        destroy_image(input_image);
+        return {
+            .format = format,
+            .size = size,
+            .data = decltype(CompressedTexture::data)(buffer)
+        };
+    }
+
+    // Blocks are encoded independently, so each band of block rows is encoded as an image of its
+    // own, which shares the rows of the source image. Only the last band can have partial blocks,
+    // and those are clamped to the edge of the source image as they would be otherwise.
+    auto encodeRows = [&](uint32_t start, uint32_t count) {
+        uint16_t** rows = input_image->imagedata16[0] + start * ydim;
+        astc_codec_image band = {
+            .imagedata8 = nullptr,
+            .imagedata16 = &rows,
+            .xsize = xsize,
+            .ysize = std::min(int(count) * ydim, ysize - int(start) * ydim),
+            .zsize = 1,
+            .padding = 0
+        };
+        encode_astc_image(&band, nullptr, xdim, ydim, zdim, &ewp, decode_mode,
+                swz_encode, swz_decode, buffer + start * xblocks * 16, 0, 1);
+    };
+
+    // The first block row is encoded under the lock to build the tables for this block size.
+    lock.lock();
+    suppressAstcProgress();
+    encodeRows(0, 1);
+    lock.unlock();
+
+    if (yblocks > 1) {
+        auto job = jobs::parallel_for(*js, nullptr, 1, yblocks - 1,
+                std::ref(encodeRows), jobs::CountSplitter<4>());
+        js->runAndWait(job);
+    }
+
+    lock.lock();
+    restoreAstcProgress();
+    lock.unlock();
 
     destroy_image(input_image);
 
@@ -375,6 +450,9 @@ static void extract4x4RGBA(uint8_t* dst, const LinearImage& source, uint32_t x0,
     }
 }
 
+// STB builds its tables the first time it compresses a block, which is not thread-safe.
+static std::mutex sS3tcLock;
+
 // Our S3TC / DXT encoder uses the STB implementation by Fabian Giesen.
 //
 // Due to limitations in STB, this only supports the following formats:
@@ -382,22 +460,45 @@ static void extract4x4RGBA(uint8_t* dst, const LinearImage& source, uint32_t x0,
 //  - DXT5 with alpha (16 input pixels into 128 bits of output, 4:1)
 //
 // TODO: investigate using something more capable than STB (eg AMD Compressenator, bimg, libsquish)
-CompressedTexture s3tcCompress(const LinearImage& original, S3tcConfig config) {
+CompressedTexture s3tcCompress(const LinearImage& original, S3tcConfig config, JobSystem* js) {
     const bool dxt5 = config.format == CompressedFormat::RGBA_S3TC_DXT5;
     LinearImage source = extendToFourChannels(original);
-    uint8_t block[64];
+    const uint32_t blockSize = dxt5 ? 16 : 8;
     uint32_t xblocks = (source.getWidth() + 3) / 4;
     uint32_t yblocks = (source.getHeight() + 3) / 4;
-    uint32_t size = xblocks * yblocks * (dxt5 ? 16 : 8);
+    uint32_t size = xblocks * yblocks * blockSize;
     uint8_t* buffer = new uint8_t[size];
-    uint8_t* dst = buffer;
-    for (int y = 0, h = source.getHeight(); y < h; y += 4) {
-        for (int x = 0, w = source.getWidth(); x < w; x += 4) {
-            extract4x4RGBA(block, source, x, y);
-            stb_compress_dxt_block(dst, block, dxt5, 8);
-            dst += dxt5 ? 16 : 8;
+
+    // build the STB tables before compressing blocks in parallel
+    {
+        std::lock_guard<std::mutex> lock(sS3tcLock);
+        static bool first = true;
+        if (first) {
+            uint8_t block[64] = {};
+            uint8_t dst[16];
+            stb_compress_dxt_block(dst, block, 1, 8);
+            first = false;
         }
     }
+
+    auto compressRows = [&](uint32_t start, uint32_t count) {
+        uint8_t block[64];
+        uint8_t* dst = buffer + start * xblocks * blockSize;
+        for (uint32_t y = start * 4, h = (start + count) * 4; y < h; y += 4) {
+            for (uint32_t x = 0, w = source.getWidth(); x < w; x += 4) {
+                extract4x4RGBA(block, source, x, y);
+                stb_compress_dxt_block(dst, block, dxt5, 8);
+                dst += blockSize;
+            }
+        }
+    };
+    if (js) {
+        auto job = jobs::parallel_for(*js, nullptr, 0, yblocks,
+                std::ref(compressRows), jobs::CountSplitter<8>());
+        js->runAndWait(job);
+    } else {
+        compressRows(0, yblocks);
+    }
     return {
         .format = config.format,
         .size = size,
@@ -415,9 +516,8 @@ S3tcConfig s3tcParseOptionString(const std::string& options) {
     return {};
 }
 
-CompressedTexture etcCompress(const LinearImage& original, EtcConfig config) {
+CompressedTexture etcCompress(const LinearImage& original, EtcConfig config, JobSystem* js) {
     LinearImage source = extendToFourChannels(original);
-    const int threadcount = std::thread::hardware_concurrency();
     Etc::Image::Format etcformat;
     switch (config.format) {
         case CompressedFormat::R11_EAC: etcformat = Etc::Image::Format::R11; break;
@@ -451,16 +551,60 @@ CompressedTexture etcCompress(const LinearImage& original, EtcConfig config) {
     // commented-out "delete[] m_paucEncodingBits" in their Image destructor, which is essentially
     // what our unique_ptr wrapper does (CompressedTexture::data).
 
-    Etc::Encode(source.getPixelRef(0, 0),
-        source.getWidth(), source.getHeight(),
-        etcformat,
-        etcmetric,
-        config.effort,
-        threadcount,
-        1024,
-        &paucEncodingBits, &uiEncodingBitsBytes,
-        &uiExtendedWidth, &uiExtendedHeight,
-        &iEncodingTime_ms);
+    if (!js) {
+        Etc::Encode(source.getPixelRef(0, 0),
+            source.getWidth(), source.getHeight(),
+            etcformat,
+            etcmetric,
+            config.effort,
+            std::thread::hardware_concurrency(),
+            1024,
+            &paucEncodingBits, &uiEncodingBitsBytes,
+            &uiExtendedWidth, &uiExtendedHeight,
+            &iEncodingTime_ms);
+        return {
+            .format = config.format,
+            .size = uiEncodingBitsBytes,
+            .data = decltype(CompressedTexture::data)(paucEncodingBits)
+        };
+    }
+
+    // Encode bands of block rows on the JobSystem and concatenate them, blocks are stored in
+    // row-major order so each band is a contiguous range of the output.
+    const uint32_t width = source.getWidth();
+    const uint32_t height = source.getHeight();
+    const uint32_t yblocks = (height + 3) / 4;
+    std::vector<std::unique_ptr<uint8_t[]>> bands(yblocks);
+    std::vector<uint32_t> bandSizes(yblocks, 0);
+    auto encodeRows = [&](uint32_t start, uint32_t count) {
+        unsigned char* bits;
+        unsigned int bytes, extendedWidth, extendedHeight;
+        int encodingTime;
+        Etc::Encode(source.getPixelRef(0, start * 4),
+            width, std::min(count * 4, height - start * 4),
+            etcformat,
+            etcmetric,
+            config.effort,
+            1,
+            1,
+            &bits, &bytes,
+            &extendedWidth, &extendedHeight,
+            &encodingTime);
+        bands[start].reset(bits);
+        bandSizes[start] = bytes;
+    };
+    auto job = jobs::parallel_for(*js, nullptr, 0, yblocks,
+            std::ref(encodeRows), jobs::CountSplitter<4>());
+    js->runAndWait(job);
+
+    uiEncodingBitsBytes = 0;
+    for (uint32_t bytes : bandSizes) {
+        uiEncodingBitsBytes += bytes;
+    }
+    paucEncodingBits = new unsigned char[uiEncodingBitsBytes];
+    for (uint32_t offset = 0, i = 0; i < yblocks; offset += bandSizes[i], i++) {
+        std::copy_n(bands[i].get(), bandSizes[i], paucEncodingBits + offset);
+    }
 
     return {
         .format = config.format,
@@ -533,15 +677,16 @@ bool parseOptionString(const std::string& options, CompressionConfig* config) {
     return config->type != CompressionConfig::INVALID;
 }
 
-CompressedTexture compressTexture(const CompressionConfig& config, const LinearImage& image) {
+CompressedTexture compressTexture(const CompressionConfig& config, const LinearImage& image,
+        JobSystem* js) {
     if (config.type == CompressionConfig::ASTC) {
-        return astcCompress(image, config.astc);
+        return astcCompress(image, config.astc, js);
     }
     if (config.type == CompressionConfig::S3TC) {
-        return s3tcCompress(image, config.s3tc);
+        return s3tcCompress(image, config.s3tc, js);
     }
     if (config.type == CompressionConfig::ETC) {
-        return etcCompress(image, config.etc);
+        return etcCompress(image, config.etc, js);
     }
     return {};
 }
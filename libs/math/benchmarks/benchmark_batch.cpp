@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PerformanceCounters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <math/batch.h>
+#include <math/mat3.h>
+#include <math/mat4.h>
+#include <math/quat.h>
+
+#include <random>
+#include <vector>
+
+using namespace filament::math;
+
+struct Scalar{};
+struct Batch{};
+
+static constexpr size_t COUNT = 1024;
+
+struct Data {
+    std::vector<mat4f> transforms;
+    std::vector<quatf> rotations;
+    std::vector<quatf> targets;
+    std::vector<float3> translations;
+    std::vector<float3> scales;
+    std::vector<float> weights;
+
+    Data() {
+        std::default_random_engine engine(1234);
+        std::uniform_real_distribution<float> rand(-1.0f, 1.0f);
+        for (size_t i = 0; i < COUNT; i++) {
+            quatf q = normalize(quatf{ rand(engine), rand(engine), rand(engine), rand(engine) });
+            float3 t = { rand(engine), rand(engine), rand(engine) };
+            float3 s = float3{ rand(engine), rand(engine), rand(engine) } * 0.5f + 1.0f;
+            rotations.push_back(q);
+            translations.push_back(t);
+            scales.push_back(s);
+            transforms.push_back(mat4f::translation(t) * mat4f(q) * mat4f::scaling(s));
+            weights.push_back(0.5f + 0.5f * rand(engine));
+        }
+        targets.assign(rotations.rbegin(), rotations.rend());
+    }
+};
+
+template <typename A, typename T>
+static void BM_batch(benchmark::State& state) noexcept {
+    T f;
+    state.SetLabel(T::label());
+    Data const data;
+    typename T::result_type res(COUNT);
+
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            if (std::is_same<A, Batch>::value) {
+                f.batch(res, data);
+            } else if (std::is_same<A, Scalar>::value) {
+                f.scalar(res, data);
+            }
+            benchmark::ClobberMemory();
+            benchmark::DoNotOptimize(res);
+        }
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * COUNT);
+    }
+}
+
+struct Multiply {
+    using result_type = std::vector<mat4f>;
+    static const char* label() { return "multiply"; }
+    void scalar(result_type& out, Data const& data) {
+        for (size_t i = 0; i < COUNT; i++) {
+            out[i] = data.transforms[i] * data.transforms[i];
+        }
+    }
+    void batch(result_type& out, Data const& data) {
+        std::vector<mat4f> const& m = data.transforms;
+        batch::multiply(out.data(), m.data(), m.data(), COUNT);
+    }
+};
+
+struct Inverse {
+    using result_type = std::vector<mat4f>;
+    static const char* label() { return "inverse"; }
+    void scalar(result_type& out, Data const& data) {
+        for (size_t i = 0; i < COUNT; i++) {
+            out[i] = inverse(data.transforms[i]);
+        }
+    }
+    void batch(result_type& out, Data const& data) {
+        batch::inverse(out.data(), data.transforms.data(), COUNT);
+    }
+};
+
+struct NormalMatrices {
+    using result_type = std::vector<mat3f>;
+    static const char* label() { return "normalMatrices"; }
+    void scalar(result_type& out, Data const& data) {
+        for (size_t i = 0; i < COUNT; i++) {
+            out[i] = mat3f::getTransformForNormals(data.transforms[i].upperLeft());
+        }
+    }
+    void batch(result_type& out, Data const& data) {
+        batch::normalMatrices(out.data(), data.transforms.data(), COUNT);
+    }
+};
+
+struct TransformBoxes {
+    using result_type = std::vector<float3>;
+    static const char* label() { return "transformBoxes"; }
+    void scalar(result_type& out, Data const& data) {
+        for (size_t i = 0; i < COUNT; i++) {
+            mat4f const& m = data.transforms[i];
+            mat3f const u = m.upperLeft();
+            out[i] = u * data.translations[i] + m[3].xyz;
+            extents[i] = abs(u) * data.scales[i];
+        }
+    }
+    void batch(result_type& out, Data const& data) {
+        batch::transformBoxes(out.data(), extents.data(), data.transforms.data(),
+                data.translations.data(), data.scales.data(), COUNT);
+    }
+    std::vector<float3> extents = std::vector<float3>(COUNT);
+};
+
+struct Slerp {
+    using result_type = std::vector<quatf>;
+    static const char* label() { return "slerp"; }
+    void scalar(result_type& out, Data const& data) {
+        for (size_t i = 0; i < COUNT; i++) {
+            out[i] = slerp(data.rotations[i], data.targets[i], data.weights[i]);
+        }
+    }
+    void batch(result_type& out, Data const& data) {
+        batch::slerp(out.data(), data.rotations.data(), data.targets.data(),
+                data.weights.data(), COUNT);
+    }
+};
+
+struct Compose {
+    using result_type = std::vector<mat4f>;
+    static const char* label() { return "compose"; }
+    void scalar(result_type& out, Data const& data) {
+        for (size_t i = 0; i < COUNT; i++) {
+            out[i] = mat4f::translation(data.translations[i]) * mat4f(data.rotations[i]) *
+                     mat4f::scaling(data.scales[i]);
+        }
+    }
+    void batch(result_type& out, Data const& data) {
+        batch::compose(out.data(), data.translations.data(), data.rotations.data(),
+                data.scales.data(), COUNT);
+    }
+};
+
+BENCHMARK_TEMPLATE(BM_batch, Scalar, Multiply);
+BENCHMARK_TEMPLATE(BM_batch, Batch, Multiply);
+
+BENCHMARK_TEMPLATE(BM_batch, Scalar, Inverse);
+BENCHMARK_TEMPLATE(BM_batch, Batch, Inverse);
+
+BENCHMARK_TEMPLATE(BM_batch, Scalar, NormalMatrices);
+BENCHMARK_TEMPLATE(BM_batch, Batch, NormalMatrices);
+
+BENCHMARK_TEMPLATE(BM_batch, Scalar, TransformBoxes);
+BENCHMARK_TEMPLATE(BM_batch, Batch, TransformBoxes);
+
+BENCHMARK_TEMPLATE(BM_batch, Scalar, Slerp);
+BENCHMARK_TEMPLATE(BM_batch, Batch, Slerp);
+
+BENCHMARK_TEMPLATE(BM_batch, Scalar, Compose);
+BENCHMARK_TEMPLATE(BM_batch, Batch, Compose);
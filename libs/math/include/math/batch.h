@@ -0,0 +1,844 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_MATH_BATCH_H
+#define TNT_MATH_BATCH_H
+
+#include <math/compiler.h>
+#include <math/mat3.h>
+#include <math/mat4.h>
+#include <math/quat.h>
+#include <math/vec3.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX__)
+#   include <immintrin.h>
+#   define MATH_BATCH_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define MATH_BATCH_SSE 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#   include <arm_neon.h>
+#   define MATH_BATCH_NEON 1
+#endif
+
+/*
+ * Batched kernels for the transform math done in hot loops, i.e. on many elements per frame.
+ *
+ * Each function processes arrays of elements, as many elements at a time as fit in a SIMD
+ * register: 8 with AVX, 4 with SSE2 or NEON (aarch64), and 1 otherwise. The instruction set is
+ * chosen at compile time. Results match the scalar templates (mat4.h, quat.h, ...) up to
+ * floating-point rounding, except for slerp() which uses a polynomial approximation.
+ *
+ * Most functions take arrays of structures (e.g. mat4f const*). Some also take structures of
+ * arrays (e.g. Float3Soa), which saves transposing the data in and out of SIMD registers.
+ *
+ * Unless noted otherwise, outputs can alias inputs of the same type.
+ */
+
+namespace filament {
+namespace math {
+namespace batch {
+
+// a structure of arrays of 3-component vectors
+struct Float3Soa {
+    float* x;
+    float* y;
+    float* z;
+};
+
+struct ConstFloat3Soa {
+    float const* x;
+    float const* y;
+    float const* z;
+    ConstFloat3Soa(float const* x, float const* y, float const* z) noexcept : x(x), y(y), z(z) { }
+    ConstFloat3Soa(Float3Soa const& soa) noexcept : x(soa.x), y(soa.y), z(soa.z) { } // NOLINT
+};
+
+// a structure of arrays of quaternions
+struct QuatfSoa {
+    float* x;
+    float* y;
+    float* z;
+    float* w;
+};
+
+struct ConstQuatfSoa {
+    float const* x;
+    float const* y;
+    float const* z;
+    float const* w;
+    ConstQuatfSoa(float const* x, float const* y, float const* z, float const* w) noexcept
+            : x(x), y(y), z(z), w(w) { }
+    ConstQuatfSoa(QuatfSoa const& soa) noexcept : x(soa.x), y(soa.y), z(soa.z), w(soa.w) { } // NOLINT
+};
+
+namespace details {
+
+/*
+ * A "lane" type holds one float per element being processed. The kernels below are written
+ * once in terms of lanes, and instantiated with the native SIMD lane for full batches and with
+ * LaneScalar for the remaining elements.
+ *
+ * Memory accesses:
+ * - load/store access WIDTH consecutive floats (structures of arrays)
+ * - gather/scatter access WIDTH floats 'stride' floats apart (arrays of structures)
+ * - loadTransposed/storeTransposed access 4 consecutive floats of WIDTH elements 'stride'
+ *   floats apart, e.g. a column of WIDTH matrices.
+ */
+
+struct LaneScalar {
+    static constexpr size_t WIDTH = 1;
+    float v;
+
+    static LaneScalar set(float x) noexcept { return { x }; }
+    static LaneScalar load(float const* p) noexcept { return { *p }; }
+    void store(float* p) const noexcept { *p = v; }
+    static LaneScalar gather(float const* p, size_t) noexcept { return { *p }; }
+    void scatter(float* p, size_t) const noexcept { *p = v; }
+
+    static void loadTransposed(LaneScalar out[4], float const* p, size_t) noexcept {
+        out[0].v = p[0];
+        out[1].v = p[1];
+        out[2].v = p[2];
+        out[3].v = p[3];
+    }
+    static void storeTransposed(float* p, size_t, LaneScalar const in[4]) noexcept {
+        p[0] = in[0].v;
+        p[1] = in[1].v;
+        p[2] = in[2].v;
+        p[3] = in[3].v;
+    }
+
+    friend LaneScalar operator+(LaneScalar a, LaneScalar b) noexcept { return { a.v + b.v }; }
+    friend LaneScalar operator-(LaneScalar a, LaneScalar b) noexcept { return { a.v - b.v }; }
+    friend LaneScalar operator*(LaneScalar a, LaneScalar b) noexcept { return { a.v * b.v }; }
+    friend LaneScalar operator/(LaneScalar a, LaneScalar b) noexcept { return { a.v / b.v }; }
+    friend LaneScalar abs(LaneScalar a) noexcept { return { std::abs(a.v) }; }
+    friend LaneScalar sqrt(LaneScalar a) noexcept { return { std::sqrt(a.v) }; }
+    // a with its sign flipped where b is negative
+    friend LaneScalar mulsign(LaneScalar a, LaneScalar b) noexcept {
+        return { std::signbit(b.v) ? -a.v : a.v };
+    }
+};
+
+#if defined(MATH_BATCH_SSE) || defined(MATH_BATCH_AVX)
+
+struct LaneSSE {
+    static constexpr size_t WIDTH = 4;
+    __m128 v;
+
+    static LaneSSE set(float x) noexcept { return { _mm_set1_ps(x) }; }
+    static LaneSSE load(float const* p) noexcept { return { _mm_loadu_ps(p) }; }
+    void store(float* p) const noexcept { _mm_storeu_ps(p, v); }
+
+    static LaneSSE gather(float const* p, size_t stride) noexcept {
+        return { _mm_setr_ps(p[0], p[stride], p[2 * stride], p[3 * stride]) };
+    }
+    void scatter(float* p, size_t stride) const noexcept {
+        alignas(16) float t[4];
+        _mm_store_ps(t, v);
+        p[0] = t[0];
+        p[stride] = t[1];
+        p[2 * stride] = t[2];
+        p[3 * stride] = t[3];
+    }
+
+    static void loadTransposed(LaneSSE out[4], float const* p, size_t stride) noexcept {
+        __m128 r0 = _mm_loadu_ps(p);
+        __m128 r1 = _mm_loadu_ps(p + stride);
+        __m128 r2 = _mm_loadu_ps(p + 2 * stride);
+        __m128 r3 = _mm_loadu_ps(p + 3 * stride);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        out[0].v = r0;
+        out[1].v = r1;
+        out[2].v = r2;
+        out[3].v = r3;
+    }
+    static void storeTransposed(float* p, size_t stride, LaneSSE const in[4]) noexcept {
+        __m128 r0 = in[0].v;
+        __m128 r1 = in[1].v;
+        __m128 r2 = in[2].v;
+        __m128 r3 = in[3].v;
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(p, r0);
+        _mm_storeu_ps(p + stride, r1);
+        _mm_storeu_ps(p + 2 * stride, r2);
+        _mm_storeu_ps(p + 3 * stride, r3);
+    }
+
+    friend LaneSSE operator+(LaneSSE a, LaneSSE b) noexcept { return { _mm_add_ps(a.v, b.v) }; }
+    friend LaneSSE operator-(LaneSSE a, LaneSSE b) noexcept { return { _mm_sub_ps(a.v, b.v) }; }
+    friend LaneSSE operator*(LaneSSE a, LaneSSE b) noexcept { return { _mm_mul_ps(a.v, b.v) }; }
+    friend LaneSSE operator/(LaneSSE a, LaneSSE b) noexcept { return { _mm_div_ps(a.v, b.v) }; }
+    friend LaneSSE abs(LaneSSE a) noexcept { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+    friend LaneSSE sqrt(LaneSSE a) noexcept { return { _mm_sqrt_ps(a.v) }; }
+    friend LaneSSE mulsign(LaneSSE a, LaneSSE b) noexcept {
+        return { _mm_xor_ps(a.v, _mm_and_ps(b.v, _mm_set1_ps(-0.0f))) };
+    }
+};
+
+#endif
+
+#if defined(MATH_BATCH_AVX)
+
+struct LaneAVX {
+    static constexpr size_t WIDTH = 8;
+    __m256 v;
+
+    static LaneAVX set(float x) noexcept { return { _mm256_set1_ps(x) }; }
+    static LaneAVX load(float const* p) noexcept { return { _mm256_loadu_ps(p) }; }
+    void store(float* p) const noexcept { _mm256_storeu_ps(p, v); }
+
+    static LaneAVX gather(float const* p, size_t stride) noexcept {
+        return { _mm256_setr_ps(p[0], p[stride], p[2 * stride], p[3 * stride],
+                p[4 * stride], p[5 * stride], p[6 * stride], p[7 * stride]) };
+    }
+    void scatter(float* p, size_t stride) const noexcept {
+        alignas(32) float t[8];
+        _mm256_store_ps(t, v);
+        for (size_t i = 0; i < 8; i++) {
+            p[i * stride] = t[i];
+        }
+    }
+
+    // the first 4 elements go in the low half of the registers, the last 4 in the high half
+    static void loadTransposed(LaneAVX out[4], float const* p, size_t stride) noexcept {
+        LaneSSE lo[4], hi[4];
+        LaneSSE::loadTransposed(lo, p, stride);
+        LaneSSE::loadTransposed(hi, p + 4 * stride, stride);
+        for (size_t i = 0; i < 4; i++) {
+            out[i].v = _mm256_insertf128_ps(_mm256_castps128_ps256(lo[i].v), hi[i].v, 1);
+        }
+    }
+    static void storeTransposed(float* p, size_t stride, LaneAVX const in[4]) noexcept {
+        LaneSSE lo[4], hi[4];
+        for (size_t i = 0; i < 4; i++) {
+            lo[i].v = _mm256_castps256_ps128(in[i].v);
+            hi[i].v = _mm256_extractf128_ps(in[i].v, 1);
+        }
+        LaneSSE::storeTransposed(p, stride, lo);
+        LaneSSE::storeTransposed(p + 4 * stride, stride, hi);
+    }
+
+    friend LaneAVX operator+(LaneAVX a, LaneAVX b) noexcept { return { _mm256_add_ps(a.v, b.v) }; }
+    friend LaneAVX operator-(LaneAVX a, LaneAVX b) noexcept { return { _mm256_sub_ps(a.v, b.v) }; }
+    friend LaneAVX operator*(LaneAVX a, LaneAVX b) noexcept { return { _mm256_mul_ps(a.v, b.v) }; }
+    friend LaneAVX operator/(LaneAVX a, LaneAVX b) noexcept { return { _mm256_div_ps(a.v, b.v) }; }
+    friend LaneAVX abs(LaneAVX a) noexcept {
+        return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) };
+    }
+    friend LaneAVX sqrt(LaneAVX a) noexcept { return { _mm256_sqrt_ps(a.v) }; }
+    friend LaneAVX mulsign(LaneAVX a, LaneAVX b) noexcept {
+        return { _mm256_xor_ps(a.v, _mm256_and_ps(b.v, _mm256_set1_ps(-0.0f))) };
+    }
+};
+
+using LaneNative = LaneAVX;
+
+#elif defined(MATH_BATCH_SSE)
+
+using LaneNative = LaneSSE;
+
+#elif defined(MATH_BATCH_NEON)
+
+struct LaneNEON {
+    static constexpr size_t WIDTH = 4;
+    float32x4_t v;
+
+    static LaneNEON set(float x) noexcept { return { vdupq_n_f32(x) }; }
+    static LaneNEON load(float const* p) noexcept { return { vld1q_f32(p) }; }
+    void store(float* p) const noexcept { vst1q_f32(p, v); }
+
+    static LaneNEON gather(float const* p, size_t stride) noexcept {
+        float32x4_t r = vld1q_dup_f32(p);
+        r = vld1q_lane_f32(p + stride, r, 1);
+        r = vld1q_lane_f32(p + 2 * stride, r, 2);
+        r = vld1q_lane_f32(p + 3 * stride, r, 3);
+        return { r };
+    }
+    void scatter(float* p, size_t stride) const noexcept {
+        vst1q_lane_f32(p, v, 0);
+        vst1q_lane_f32(p + stride, v, 1);
+        vst1q_lane_f32(p + 2 * stride, v, 2);
+        vst1q_lane_f32(p + 3 * stride, v, 3);
+    }
+
+    static void transpose(float32x4_t out[4], float32x4_t r0, float32x4_t r1,
+            float32x4_t r2, float32x4_t r3) noexcept {
+        const float32x4x2_t t01 = vtrnq_f32(r0, r1);
+        const float32x4x2_t t23 = vtrnq_f32(r2, r3);
+        out[0] = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+        out[1] = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+        out[2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+        out[3] = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+    }
+
+    static void loadTransposed(LaneNEON out[4], float const* p, size_t stride) noexcept {
+        if (stride == 4) {
+            const float32x4x4_t r = vld4q_f32(p);
+            out[0].v = r.val[0];
+            out[1].v = r.val[1];
+            out[2].v = r.val[2];
+            out[3].v = r.val[3];
+            return;
+        }
+        float32x4_t r[4];
+        transpose(r, vld1q_f32(p), vld1q_f32(p + stride),
+                vld1q_f32(p + 2 * stride), vld1q_f32(p + 3 * stride));
+        out[0].v = r[0];
+        out[1].v = r[1];
+        out[2].v = r[2];
+        out[3].v = r[3];
+    }
+    static void storeTransposed(float* p, size_t stride, LaneNEON const in[4]) noexcept {
+        if (stride == 4) {
+            vst4q_f32(p, (float32x4x4_t{{ in[0].v, in[1].v, in[2].v, in[3].v }}));
+            return;
+        }
+        float32x4_t r[4];
+        transpose(r, in[0].v, in[1].v, in[2].v, in[3].v);
+        vst1q_f32(p, r[0]);
+        vst1q_f32(p + stride, r[1]);
+        vst1q_f32(p + 2 * stride, r[2]);
+        vst1q_f32(p + 3 * stride, r[3]);
+    }
+
+    friend LaneNEON operator+(LaneNEON a, LaneNEON b) noexcept { return { vaddq_f32(a.v, b.v) }; }
+    friend LaneNEON operator-(LaneNEON a, LaneNEON b) noexcept { return { vsubq_f32(a.v, b.v) }; }
+    friend LaneNEON operator*(LaneNEON a, LaneNEON b) noexcept { return { vmulq_f32(a.v, b.v) }; }
+    friend LaneNEON operator/(LaneNEON a, LaneNEON b) noexcept { return { vdivq_f32(a.v, b.v) }; }
+    friend LaneNEON abs(LaneNEON a) noexcept { return { vabsq_f32(a.v) }; }
+    friend LaneNEON sqrt(LaneNEON a) noexcept { return { vsqrtq_f32(a.v) }; }
+    friend LaneNEON mulsign(LaneNEON a, LaneNEON b) noexcept {
+        const uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(b.v), vdupq_n_u32(0x80000000u));
+        return { vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a.v), sign)) };
+    }
+};
+
+using LaneNative = LaneNEON;
+
+#else
+
+using LaneNative = LaneScalar;
+
+#endif
+
+// calls f(LaneNative{}, i) for each full batch of elements, then f(LaneScalar{}, i) for the rest
+template<typename F>
+inline void forEachBatch(size_t count, F f) noexcept {
+    size_t i = 0;
+    for (const size_t c = count - count % LaneNative::WIDTH; i < c; i += LaneNative::WIDTH) {
+        f(LaneNative{}, i);
+    }
+    for (; i < count; i++) {
+        f(LaneScalar{}, i);
+    }
+}
+
+inline float const* floats(void const* p) noexcept { return static_cast<float const*>(p); }
+inline float* floats(void* p) noexcept { return static_cast<float*>(p); }
+
+// a 4x4 matrix per lane, column-major like mat4f: m[column][row]
+template<typename L>
+struct Mat4Lanes {
+    L m[4][4];
+
+    static Mat4Lanes load(mat4f const* p) noexcept {
+        Mat4Lanes r;
+        for (size_t c = 0; c < 4; c++) {
+            L::loadTransposed(r.m[c], floats(p) + 4 * c, 16);
+        }
+        return r;
+    }
+    void store(mat4f* p) const noexcept {
+        for (size_t c = 0; c < 4; c++) {
+            L::storeTransposed(floats(p) + 4 * c, 16, m[c]);
+        }
+    }
+};
+
+template<typename L>
+struct Float3Lanes {
+    L x, y, z;
+
+    static Float3Lanes load(float3 const* p) noexcept {
+        return { L::gather(floats(p), 3), L::gather(floats(p) + 1, 3), L::gather(floats(p) + 2, 3) };
+    }
+    static Float3Lanes load(ConstFloat3Soa const& p, size_t i) noexcept {
+        return { L::load(p.x + i), L::load(p.y + i), L::load(p.z + i) };
+    }
+    void store(float3* p) const noexcept {
+        x.scatter(floats(p), 3);
+        y.scatter(floats(p) + 1, 3);
+        z.scatter(floats(p) + 2, 3);
+    }
+    void store(Float3Soa const& p, size_t i) const noexcept {
+        x.store(p.x + i);
+        y.store(p.y + i);
+        z.store(p.z + i);
+    }
+};
+
+template<typename L>
+struct QuatLanes {
+    L q[4]; // x, y, z, w
+
+    static QuatLanes load(quatf const* p) noexcept {
+        QuatLanes r;
+        L::loadTransposed(r.q, floats(p), 4);
+        return r;
+    }
+    static QuatLanes load(ConstQuatfSoa const& p, size_t i) noexcept {
+        return {{ L::load(p.x + i), L::load(p.y + i), L::load(p.z + i), L::load(p.w + i) }};
+    }
+    void store(quatf* p) const noexcept {
+        L::storeTransposed(floats(p), 4, q);
+    }
+    void store(QuatfSoa const& p, size_t i) const noexcept {
+        q[0].store(p.x + i);
+        q[1].store(p.y + i);
+        q[2].store(p.z + i);
+        q[3].store(p.w + i);
+    }
+};
+
+// center and half-extent of boxes transformed by m, same as rigidTransform() in filament/Box.h
+template<typename L>
+inline void transformBox(Float3Lanes<L>& center, Float3Lanes<L>& halfExtent,
+        Mat4Lanes<L> const& m, Float3Lanes<L> const& c, Float3Lanes<L> const& e) noexcept {
+    auto const& a = m.m;
+    center = {
+            a[0][0] * c.x + a[1][0] * c.y + a[2][0] * c.z + a[3][0],
+            a[0][1] * c.x + a[1][1] * c.y + a[2][1] * c.z + a[3][1],
+            a[0][2] * c.x + a[1][2] * c.y + a[2][2] * c.z + a[3][2] };
+    halfExtent = {
+            abs(a[0][0]) * e.x + abs(a[1][0]) * e.y + abs(a[2][0]) * e.z,
+            abs(a[0][1]) * e.x + abs(a[1][1]) * e.y + abs(a[2][1]) * e.z,
+            abs(a[0][2]) * e.x + abs(a[1][2]) * e.y + abs(a[2][2]) * e.z };
+}
+
+// general 4x4 inverse by cofactors, the matrices must be invertible
+template<typename L>
+inline Mat4Lanes<L> inverse(Mat4Lanes<L> const& in) noexcept {
+    auto const& m = in.m;
+
+    // 2x2 sub-determinants of the last two columns
+    const L c00 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+    const L c02 = m[1][2] * m[3][3] - m[3][2] * m[1][3];
+    const L c03 = m[1][2] * m[2][3] - m[2][2] * m[1][3];
+    const L c04 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+    const L c06 = m[1][1] * m[3][3] - m[3][1] * m[1][3];
+    const L c07 = m[1][1] * m[2][3] - m[2][1] * m[1][3];
+    const L c08 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+    const L c10 = m[1][1] * m[3][2] - m[3][1] * m[1][2];
+    const L c11 = m[1][1] * m[2][2] - m[2][1] * m[1][2];
+    const L c12 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+    const L c14 = m[1][0] * m[3][3] - m[3][0] * m[1][3];
+    const L c15 = m[1][0] * m[2][3] - m[2][0] * m[1][3];
+    const L c16 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+    const L c18 = m[1][0] * m[3][2] - m[3][0] * m[1][2];
+    const L c19 = m[1][0] * m[2][2] - m[2][0] * m[1][2];
+    const L c20 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+    const L c22 = m[1][0] * m[3][1] - m[3][0] * m[1][1];
+    const L c23 = m[1][0] * m[2][1] - m[2][0] * m[1][1];
+
+    const L fac0[4] = { c00, c00, c02, c03 };
+    const L fac1[4] = { c04, c04, c06, c07 };
+    const L fac2[4] = { c08, c08, c10, c11 };
+    const L fac3[4] = { c12, c12, c14, c15 };
+    const L fac4[4] = { c16, c16, c18, c19 };
+    const L fac5[4] = { c20, c20, c22, c23 };
+
+    const L vec0[4] = { m[1][0], m[0][0], m[0][0], m[0][0] };
+    const L vec1[4] = { m[1][1], m[0][1], m[0][1], m[0][1] };
+    const L vec2[4] = { m[1][2], m[0][2], m[0][2], m[0][2] };
+    const L vec3[4] = { m[1][3], m[0][3], m[0][3], m[0][3] };
+
+    Mat4Lanes<L> r;
+    for (size_t i = 0; i < 4; i++) {
+        const L inv0 = vec1[i] * fac0[i] - vec2[i] * fac1[i] + vec3[i] * fac2[i];
+        const L inv1 = vec0[i] * fac0[i] - vec2[i] * fac3[i] + vec3[i] * fac4[i];
+        const L inv2 = vec0[i] * fac1[i] - vec1[i] * fac3[i] + vec3[i] * fac5[i];
+        const L inv3 = vec0[i] * fac2[i] - vec1[i] * fac4[i] + vec2[i] * fac5[i];
+        // alternate signs, starting with + for even columns and - for odd columns
+        const bool even = (i & 1u) == 0;
+        r.m[0][i] = even ? inv0 : L::set(0) - inv0;
+        r.m[1][i] = even ? L::set(0) - inv1 : inv1;
+        r.m[2][i] = even ? inv2 : L::set(0) - inv2;
+        r.m[3][i] = even ? L::set(0) - inv3 : inv3;
+    }
+
+    // the determinant is the dot product of the first column with the first row of the adjugate
+    const L det = (m[0][0] * r.m[0][0] + m[0][1] * r.m[1][0]) +
+                  (m[0][2] * r.m[2][0] + m[0][3] * r.m[3][0]);
+    const L invDet = L::set(1) / det;
+    for (size_t c = 0; c < 4; c++) {
+        for (size_t i = 0; i < 4; i++) {
+            r.m[c][i] = r.m[c][i] * invDet;
+        }
+    }
+    return r;
+}
+
+// cofactor matrix of the upper-left 3x3 of m, same as mat3f::getTransformForNormals()
+template<typename L>
+inline void normalMatrix(L out[3][3], Mat4Lanes<L> const& in) noexcept {
+    auto const& m = in.m;
+    const L a = m[0][0], b = m[1][0], c = m[2][0];
+    const L d = m[0][1], e = m[1][1], f = m[2][1];
+    const L g = m[0][2], h = m[1][2], i = m[2][2];
+    out[0][0] = e * i - f * h;
+    out[0][1] = c * h - b * i;
+    out[0][2] = b * f - c * e;
+    out[1][0] = f * g - d * i;
+    out[1][1] = a * i - c * g;
+    out[1][2] = c * d - a * f;
+    out[2][0] = d * h - e * g;
+    out[2][1] = b * g - a * h;
+    out[2][2] = a * e - b * d;
+}
+
+/*
+ * Spherical linear interpolation of unit quaternions along the shortest path. This is based on
+ * "A Fast and Accurate Algorithm for Computing SLERP", David Eberly, which approximates the
+ * slerp coefficients with polynomials of cos(theta), so it vectorizes without any trigonometry.
+ * The result is within 1e-5 of slerp() in quat.h, and is always normalized.
+ */
+template<typename L>
+inline QuatLanes<L> slerp(QuatLanes<L> const& p, QuatLanes<L> q, L t) noexcept {
+    constexpr float mu = 1.90110745351730037f;
+    static constexpr float u[8] = {
+            1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9),
+            1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), mu / (8 * 17) };
+    static constexpr float v[8] = {
+            1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9,
+            5.0f / 11, 6.0f / 13, 7.0f / 15, mu * 8 / 17 };
+
+    // take the short path by flipping q when the quaternions are more than 90 degrees apart
+    const L d = p.q[0] * q.q[0] + p.q[1] * q.q[1] + p.q[2] * q.q[2] + p.q[3] * q.q[3];
+    for (size_t i = 0; i < 4; i++) {
+        q.q[i] = mulsign(q.q[i], d);
+    }
+
+    const L one = L::set(1);
+    const L xm1 = abs(d) - one;
+    const L s = one - t;
+    const L t2 = t * t;
+    const L s2 = s * s;
+    L ft = one;
+    L fs = one;
+    for (size_t i = 8; i-- > 0;) {
+        ft = one + (L::set(u[i]) * t2 - L::set(v[i])) * xm1 * ft;
+        fs = one + (L::set(u[i]) * s2 - L::set(v[i])) * xm1 * fs;
+    }
+    const L ct = t * ft;
+    const L cs = s * fs;
+
+    QuatLanes<L> r;
+    for (size_t i = 0; i < 4; i++) {
+        r.q[i] = p.q[i] * cs + q.q[i] * ct;
+    }
+    const L n = L::set(1) / sqrt(r.q[0] * r.q[0] + r.q[1] * r.q[1] + r.q[2] * r.q[2] + r.q[3] * r.q[3]);
+    for (size_t i = 0; i < 4; i++) {
+        r.q[i] = r.q[i] * n;
+    }
+    return r;
+}
+
+// translation(t) * mat4f(r) * scaling(s)
+template<typename L>
+inline Mat4Lanes<L> compose(Float3Lanes<L> const& t, QuatLanes<L> const& r,
+        Float3Lanes<L> const& s) noexcept {
+    // same as the mat3f(quatf) constructor, for non-zero quaternions
+    const L n = r.q[0] * r.q[0] + r.q[1] * r.q[1] + r.q[2] * r.q[2] + r.q[3] * r.q[3];
+    const L k = L::set(2) / n;
+    const L x = k * r.q[0];
+    const L y = k * r.q[1];
+    const L z = k * r.q[2];
+    const L xx = x * r.q[0], xy = x * r.q[1], xz = x * r.q[2], xw = x * r.q[3];
+    const L yy = y * r.q[1], yz = y * r.q[2], yw = y * r.q[3];
+    const L zz = z * r.q[2], zw = z * r.q[3];
+    const L one = L::set(1);
+    const L zero = L::set(0);
+
+    Mat4Lanes<L> m;
+    m.m[0][0] = (one - yy - zz) * s.x;
+    m.m[0][1] = (xy + zw) * s.x;
+    m.m[0][2] = (xz - yw) * s.x;
+    m.m[0][3] = zero;
+    m.m[1][0] = (xy - zw) * s.y;
+    m.m[1][1] = (one - xx - zz) * s.y;
+    m.m[1][2] = (yz + xw) * s.y;
+    m.m[1][3] = zero;
+    m.m[2][0] = (xz + yw) * s.z;
+    m.m[2][1] = (yz - xw) * s.z;
+    m.m[2][2] = (one - xx - yy) * s.z;
+    m.m[2][3] = zero;
+    m.m[3][0] = t.x;
+    m.m[3][1] = t.y;
+    m.m[3][2] = t.z;
+    m.m[3][3] = one;
+    return m;
+}
+
+/*
+ * Matrix products are computed one matrix at a time, as linear combinations of the columns of
+ * lhs, which is how SIMD registers fit a 4x4 matrix best and needs no transposition.
+ */
+
+#if defined(MATH_BATCH_AVX)
+
+// two columns at a time
+struct Mat4Columns {
+    __m256 c[4]; // each column of lhs, in both halves
+
+    explicit Mat4Columns(mat4f const& m) noexcept {
+        for (size_t i = 0; i < 4; i++) {
+            c[i] = _mm256_broadcast_ps(reinterpret_cast<__m128 const*>(floats(&m) + 4 * i));
+        }
+    }
+    void multiply(mat4f* out, mat4f const& rhs) const noexcept {
+        const __m256 r01 = _mm256_loadu_ps(floats(&rhs));
+        const __m256 r23 = _mm256_loadu_ps(floats(&rhs) + 8);
+        _mm256_storeu_ps(floats(out), combine(r01));
+        _mm256_storeu_ps(floats(out) + 8, combine(r23));
+    }
+    __m256 combine(__m256 r) const noexcept {
+        __m256 a = _mm256_mul_ps(c[0], _mm256_shuffle_ps(r, r, 0x00));
+        __m256 b = _mm256_mul_ps(c[1], _mm256_shuffle_ps(r, r, 0x55));
+        a = _mm256_add_ps(a, _mm256_mul_ps(c[2], _mm256_shuffle_ps(r, r, 0xAA)));
+        b = _mm256_add_ps(b, _mm256_mul_ps(c[3], _mm256_shuffle_ps(r, r, 0xFF)));
+        return _mm256_add_ps(a, b);
+    }
+};
+
+#elif defined(MATH_BATCH_SSE)
+
+struct Mat4Columns {
+    __m128 c[4];
+
+    explicit Mat4Columns(mat4f const& m) noexcept {
+        for (size_t i = 0; i < 4; i++) {
+            c[i] = _mm_loadu_ps(floats(&m) + 4 * i);
+        }
+    }
+    void multiply(mat4f* out, mat4f const& rhs) const noexcept {
+        __m128 r[4];
+        for (size_t i = 0; i < 4; i++) {
+            r[i] = _mm_loadu_ps(floats(&rhs) + 4 * i);
+        }
+        for (size_t i = 0; i < 4; i++) {
+            __m128 a = _mm_mul_ps(c[0], _mm_shuffle_ps(r[i], r[i], 0x00));
+            __m128 b = _mm_mul_ps(c[1], _mm_shuffle_ps(r[i], r[i], 0x55));
+            a = _mm_add_ps(a, _mm_mul_ps(c[2], _mm_shuffle_ps(r[i], r[i], 0xAA)));
+            b = _mm_add_ps(b, _mm_mul_ps(c[3], _mm_shuffle_ps(r[i], r[i], 0xFF)));
+            _mm_storeu_ps(floats(out) + 4 * i, _mm_add_ps(a, b));
+        }
+    }
+};
+
+#elif defined(MATH_BATCH_NEON)
+
+struct Mat4Columns {
+    float32x4_t c[4];
+
+    explicit Mat4Columns(mat4f const& m) noexcept {
+        for (size_t i = 0; i < 4; i++) {
+            c[i] = vld1q_f32(floats(&m) + 4 * i);
+        }
+    }
+    void multiply(mat4f* out, mat4f const& rhs) const noexcept {
+        float32x4_t r[4];
+        for (size_t i = 0; i < 4; i++) {
+            r[i] = vld1q_f32(floats(&rhs) + 4 * i);
+        }
+        for (size_t i = 0; i < 4; i++) {
+            float32x4_t a = vmulq_laneq_f32(c[0], r[i], 0);
+            float32x4_t b = vmulq_laneq_f32(c[1], r[i], 1);
+            a = vfmaq_laneq_f32(a, c[2], r[i], 2);
+            b = vfmaq_laneq_f32(b, c[3], r[i], 3);
+            vst1q_f32(floats(out) + 4 * i, vaddq_f32(a, b));
+        }
+    }
+};
+
+#else
+
+struct Mat4Columns {
+    mat4f m;
+    explicit Mat4Columns(mat4f const& m) noexcept : m(m) { }
+    void multiply(mat4f* out, mat4f const& rhs) const noexcept { *out = m * rhs; }
+};
+
+#endif
+
+} // namespace details
+
+/**
+ * Computes out[i] = lhs[i] * rhs[i] for count matrices.
+ */
+inline void multiply(mat4f* out, mat4f const* lhs, mat4f const* rhs, size_t count) noexcept {
+    for (size_t i = 0; i < count; i++) {
+        details::Mat4Columns(lhs[i]).multiply(out + i, rhs[i]);
+    }
+}
+
+/**
+ * Computes out[i] = lhs * rhs[i] for count matrices, e.g. to apply a parent transform.
+ */
+inline void multiply(mat4f* out, mat4f const& lhs, mat4f const* rhs, size_t count) noexcept {
+    const details::Mat4Columns columns(lhs);
+    for (size_t i = 0; i < count; i++) {
+        columns.multiply(out + i, rhs[i]);
+    }
+}
+
+/**
+ * Transforms count boxes, each by its own rigid transform. Same as rigidTransform() in
+ * filament/Box.h, i.e. the result bounds the transformed box.
+ */
+inline void transformBoxes(float3* outCenter, float3* outHalfExtent, mat4f const* transforms,
+        float3 const* center, float3 const* halfExtent, size_t count) noexcept {
+    details::forEachBatch(count, [=](auto lane, size_t i) {
+        using L = decltype(lane);
+        using F3 = details::Float3Lanes<L>;
+        F3 c, e;
+        details::transformBox(c, e, details::Mat4Lanes<L>::load(transforms + i),
+                F3::load(center + i), F3::load(halfExtent + i));
+        c.store(outCenter + i);
+        e.store(outHalfExtent + i);
+    });
+}
+
+/**
+ * Transforms count boxes stored as structures of arrays by the same rigid transform.
+ */
+inline void transformBoxes(Float3Soa const& outCenter, Float3Soa const& outHalfExtent,
+        mat4f const& transform, ConstFloat3Soa const& center, ConstFloat3Soa const& halfExtent,
+        size_t count) noexcept {
+    details::forEachBatch(count, [&](auto lane, size_t i) {
+        using L = decltype(lane);
+        using F3 = details::Float3Lanes<L>;
+        details::Mat4Lanes<L> m;
+        for (size_t c = 0; c < 4; c++) {
+            for (size_t r = 0; r < 4; r++) {
+                m.m[c][r] = L::set(transform[c][r]);
+            }
+        }
+        F3 c, e;
+        details::transformBox(c, e, m, F3::load(center, i), F3::load(halfExtent, i));
+        c.store(outCenter, i);
+        e.store(outHalfExtent, i);
+    });
+}
+
+/**
+ * Inverts count matrices, which must be invertible. Same as inverse() in mat4.h.
+ */
+inline void inverse(mat4f* out, mat4f const* in, size_t count) noexcept {
+    details::forEachBatch(count, [=](auto lane, size_t i) {
+        using L = decltype(lane);
+        details::inverse(details::Mat4Lanes<L>::load(in + i)).store(out + i);
+    });
+}
+
+/**
+ * Computes the matrices transforming normals for count transforms, i.e. the cofactor matrix of
+ * their upper-left 3x3. Same as mat3f::getTransformForNormals(m.upperLeft()). Transformed
+ * normals must be normalized.
+ */
+inline void normalMatrices(mat3f* out, mat4f const* in, size_t count) noexcept {
+    details::forEachBatch(count, [=](auto lane, size_t i) {
+        using L = decltype(lane);
+        L n[3][3];
+        details::normalMatrix(n, details::Mat4Lanes<L>::load(in + i));
+        // a mat3f is 9 floats, written as 3 overlapping groups of 4 to avoid scattering
+        float* p = details::floats(out + i);
+        const L first[4] = { n[0][0], n[0][1], n[0][2], n[1][0] };
+        const L middle[4] = { n[1][1], n[1][2], n[2][0], n[2][1] };
+        const L last[4] = { n[1][2], n[2][0], n[2][1], n[2][2] };
+        L::storeTransposed(p, 9, first);
+        L::storeTransposed(p + 4, 9, middle);
+        L::storeTransposed(p + 5, 9, last);
+    });
+}
+
+/**
+ * Spherical linear interpolation of count pairs of unit quaternions, along the shortest path.
+ * The result is normalized.
+ *
+ * This uses a polynomial approximation, which is within 1e-5 of slerp() in quat.h.
+ */
+inline void slerp(quatf* out, quatf const* p, quatf const* q, float const* t,
+        size_t count) noexcept {
+    details::forEachBatch(count, [=](auto lane, size_t i) {
+        using L = decltype(lane);
+        using Q = details::QuatLanes<L>;
+        details::slerp(Q::load(p + i), Q::load(q + i), L::load(t + i)).store(out + i);
+    });
+}
+
+inline void slerp(quatf* out, quatf const* p, quatf const* q, float t, size_t count) noexcept {
+    details::forEachBatch(count, [=](auto lane, size_t i) {
+        using L = decltype(lane);
+        using Q = details::QuatLanes<L>;
+        details::slerp(Q::load(p + i), Q::load(q + i), L::set(t)).store(out + i);
+    });
+}
+
+inline void slerp(QuatfSoa const& out, ConstQuatfSoa const& p, ConstQuatfSoa const& q,
+        float const* t, size_t count) noexcept {
+    details::forEachBatch(count, [&](auto lane, size_t i) {
+        using L = decltype(lane);
+        using Q = details::QuatLanes<L>;
+        details::slerp(Q::load(p, i), Q::load(q, i), L::load(t + i)).store(out, i);
+    });
+}
+
+/**
+ * Composes count transforms from their translation, rotation and scale, i.e.
+ * out[i] = mat4f::translation(t[i]) * mat4f(r[i]) * mat4f::scaling(s[i]).
+ * The rotations must be non-zero quaternions.
+ */
+inline void compose(mat4f* out, float3 const* t, quatf const* r, float3 const* s,
+        size_t count) noexcept {
+    details::forEachBatch(count, [=](auto lane, size_t i) {
+        using L = decltype(lane);
+        using F3 = details::Float3Lanes<L>;
+        details::compose(F3::load(t + i), details::QuatLanes<L>::load(r + i),
+                F3::load(s + i)).store(out + i);
+    });
+}
+
+inline void compose(mat4f* out, ConstFloat3Soa const& t, ConstQuatfSoa const& r,
+        ConstFloat3Soa const& s, size_t count) noexcept {
+    details::forEachBatch(count, [&](auto lane, size_t i) {
+        using L = decltype(lane);
+        using F3 = details::Float3Lanes<L>;
+        details::compose(F3::load(t, i), details::QuatLanes<L>::load(r, i),
+                F3::load(s, i)).store(out + i);
+    });
+}
+
+} // namespace batch
+} // namespace math
+} // namespace filament
+
+#endif // TNT_MATH_BATCH_H
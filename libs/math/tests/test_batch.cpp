@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <math/batch.h>
+#include <math/mat3.h>
+#include <math/mat4.h>
+#include <math/quat.h>
+#include <math/vec3.h>
+
+#include <random>
+#include <vector>
+
+using namespace filament::math;
+
+// not a multiple of any SIMD width, so that all code paths are exercised
+static constexpr size_t COUNT = 37;
+
+class BatchTest : public testing::Test {
+protected:
+    void SetUp() override {
+        std::default_random_engine engine(1234);
+        std::uniform_real_distribution<float> rand(-1.0f, 1.0f);
+        for (size_t i = 0; i < COUNT; i++) {
+            quatf q = normalize(quatf{ rand(engine), rand(engine), rand(engine), rand(engine) });
+            float3 t = { rand(engine), rand(engine), rand(engine) };
+            float3 s = { 0.5f + std::abs(rand(engine)), 0.5f + std::abs(rand(engine)),
+                         0.5f + std::abs(rand(engine)) };
+            rotations.push_back(q);
+            translations.push_back(t * 10.0f);
+            scales.push_back(s);
+            transforms.push_back(mat4f::translation(t * 10.0f) * mat4f(q) * mat4f::scaling(s));
+            weights.push_back(0.5f + 0.5f * rand(engine));
+        }
+    }
+
+    static void expectNear(mat4f const& expected, mat4f const& actual, float eps) {
+        for (size_t c = 0; c < 4; c++) {
+            for (size_t r = 0; r < 4; r++) {
+                EXPECT_NEAR(expected[c][r], actual[c][r], eps) << "[" << c << "][" << r << "]";
+            }
+        }
+    }
+
+    std::vector<quatf> rotations;
+    std::vector<float3> translations;
+    std::vector<float3> scales;
+    std::vector<mat4f> transforms;
+    std::vector<float> weights;
+};
+
+TEST_F(BatchTest, Multiply) {
+    std::vector<mat4f> rhs(transforms.rbegin(), transforms.rend());
+    std::vector<mat4f> out(COUNT);
+    batch::multiply(out.data(), transforms.data(), rhs.data(), COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        expectNear(transforms[i] * rhs[i], out[i], 1e-4f);
+    }
+
+    // in-place, with a shared left-hand side
+    std::vector<mat4f> inout(rhs);
+    batch::multiply(inout.data(), transforms[3], inout.data(), COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        expectNear(transforms[3] * rhs[i], inout[i], 1e-4f);
+    }
+}
+
+TEST_F(BatchTest, Inverse) {
+    std::vector<mat4f> out(COUNT);
+    batch::inverse(out.data(), transforms.data(), COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        expectNear(inverse(transforms[i]), out[i], 1e-4f);
+        expectNear(mat4f{}, transforms[i] * out[i], 1e-4f);
+    }
+
+    // a projection, which isn't affine
+    mat4f const p = mat4f::perspective(45.0f, 1.5f, 0.1f, 100.0f);
+    mat4f inv;
+    batch::inverse(&inv, &p, 1);
+    expectNear(inverse(p), inv, 1e-3f);
+}
+
+TEST_F(BatchTest, NormalMatrices) {
+    std::vector<mat3f> out(COUNT);
+    batch::normalMatrices(out.data(), transforms.data(), COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        mat3f const expected = mat3f::getTransformForNormals(transforms[i].upperLeft());
+        for (size_t c = 0; c < 3; c++) {
+            for (size_t r = 0; r < 3; r++) {
+                EXPECT_NEAR(expected[c][r], out[i][c][r], 1e-5f);
+            }
+        }
+    }
+}
+
+TEST_F(BatchTest, TransformBoxes) {
+    std::vector<float3> centers(translations);
+    std::vector<float3> halfExtents(scales);
+    std::vector<float3> outCenters(COUNT);
+    std::vector<float3> outHalfExtents(COUNT);
+    batch::transformBoxes(outCenters.data(), outHalfExtents.data(), transforms.data(),
+            centers.data(), halfExtents.data(), COUNT);
+
+    auto expectBox = [&](mat4f const& m, size_t i, float3 const& c, float3 const& e) {
+        mat3f const u = m.upperLeft();
+        float3 const center = u * centers[i] + m[3].xyz;
+        float3 const halfExtent = abs(u) * halfExtents[i];
+        EXPECT_NEAR(center.x, c.x, 1e-4f);
+        EXPECT_NEAR(center.y, c.y, 1e-4f);
+        EXPECT_NEAR(center.z, c.z, 1e-4f);
+        EXPECT_NEAR(halfExtent.x, e.x, 1e-4f);
+        EXPECT_NEAR(halfExtent.y, e.y, 1e-4f);
+        EXPECT_NEAR(halfExtent.z, e.z, 1e-4f);
+    };
+    for (size_t i = 0; i < COUNT; i++) {
+        expectBox(transforms[i], i, outCenters[i], outHalfExtents[i]);
+    }
+
+    // structure of arrays, with a single transform
+    std::vector<float> soa(COUNT * 12);
+    batch::Float3Soa const c{ &soa[0], &soa[COUNT], &soa[2 * COUNT] };
+    batch::Float3Soa const e{ &soa[3 * COUNT], &soa[4 * COUNT], &soa[5 * COUNT] };
+    batch::Float3Soa const oc{ &soa[6 * COUNT], &soa[7 * COUNT], &soa[8 * COUNT] };
+    batch::Float3Soa const oe{ &soa[9 * COUNT], &soa[10 * COUNT], &soa[11 * COUNT] };
+    for (size_t i = 0; i < COUNT; i++) {
+        c.x[i] = centers[i].x; c.y[i] = centers[i].y; c.z[i] = centers[i].z;
+        e.x[i] = halfExtents[i].x; e.y[i] = halfExtents[i].y; e.z[i] = halfExtents[i].z;
+    }
+    batch::transformBoxes(oc, oe, transforms[5], c, e, COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        expectBox(transforms[5], i, { oc.x[i], oc.y[i], oc.z[i] }, { oe.x[i], oe.y[i], oe.z[i] });
+    }
+}
+
+TEST_F(BatchTest, Slerp) {
+    std::vector<quatf> targets(rotations.rbegin(), rotations.rend());
+    std::vector<quatf> out(COUNT);
+
+    auto expectSlerp = [](quatf const& expected, quatf const& actual) {
+        // q and -q are the same rotation
+        float const sign = dot(expected, actual) < 0 ? -1.0f : 1.0f;
+        EXPECT_NEAR(expected.x, sign * actual.x, 1e-5f);
+        EXPECT_NEAR(expected.y, sign * actual.y, 1e-5f);
+        EXPECT_NEAR(expected.z, sign * actual.z, 1e-5f);
+        EXPECT_NEAR(expected.w, sign * actual.w, 1e-5f);
+        EXPECT_NEAR(1.0f, length(actual), 1e-5f);
+    };
+
+    batch::slerp(out.data(), rotations.data(), targets.data(), weights.data(), COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        expectSlerp(slerp(rotations[i], targets[i], weights[i]), out[i]);
+    }
+
+    for (float t : { 0.0f, 0.25f, 1.0f }) {
+        batch::slerp(out.data(), rotations.data(), targets.data(), t, COUNT);
+        for (size_t i = 0; i < COUNT; i++) {
+            expectSlerp(slerp(rotations[i], targets[i], t), out[i]);
+        }
+    }
+
+    // identical quaternions, where slerp() falls back to nlerp()
+    batch::slerp(out.data(), rotations.data(), rotations.data(), 0.3f, COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        expectSlerp(rotations[i], out[i]);
+    }
+
+    // structure of arrays, in-place
+    std::vector<float> soa(COUNT * 8);
+    batch::QuatfSoa const p{ &soa[0], &soa[COUNT], &soa[2 * COUNT], &soa[3 * COUNT] };
+    batch::QuatfSoa const q{ &soa[4 * COUNT], &soa[5 * COUNT], &soa[6 * COUNT], &soa[7 * COUNT] };
+    for (size_t i = 0; i < COUNT; i++) {
+        p.x[i] = rotations[i].x; p.y[i] = rotations[i].y;
+        p.z[i] = rotations[i].z; p.w[i] = rotations[i].w;
+        q.x[i] = targets[i].x; q.y[i] = targets[i].y;
+        q.z[i] = targets[i].z; q.w[i] = targets[i].w;
+    }
+    batch::slerp(p, p, q, weights.data(), COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        expectSlerp(slerp(rotations[i], targets[i], weights[i]),
+                quatf{ p.w[i], p.x[i], p.y[i], p.z[i] });
+    }
+}
+
+TEST_F(BatchTest, Compose) {
+    std::vector<mat4f> out(COUNT);
+    batch::compose(out.data(), translations.data(), rotations.data(), scales.data(), COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        expectNear(transforms[i], out[i], 1e-5f);
+    }
+
+    std::vector<float> soa(COUNT * 10);
+    batch::Float3Soa const t{ &soa[0], &soa[COUNT], &soa[2 * COUNT] };
+    batch::Float3Soa const s{ &soa[3 * COUNT], &soa[4 * COUNT], &soa[5 * COUNT] };
+    batch::QuatfSoa const r{ &soa[6 * COUNT], &soa[7 * COUNT], &soa[8 * COUNT], &soa[9 * COUNT] };
+    for (size_t i = 0; i < COUNT; i++) {
+        t.x[i] = translations[i].x; t.y[i] = translations[i].y; t.z[i] = translations[i].z;
+        s.x[i] = scales[i].x; s.y[i] = scales[i].y; s.z[i] = scales[i].z;
+        r.x[i] = rotations[i].x; r.y[i] = rotations[i].y;
+        r.z[i] = rotations[i].z; r.w[i] = rotations[i].w;
+    }
+    std::fill(out.begin(), out.end(), mat4f{});
+    batch::compose(out.data(), t, r, s, COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        expectNear(transforms[i], out[i], 1e-5f);
+    }
+}
@@ -57,9 +57,16 @@ using TileCallback = void(*)(filament::math::ushort2 topLeft, filament::math::us
  */
 using DoneCallback = void(*)(void* userData);
 
+/**
+ * Signals that a progressive pass has been accumulated into all render targets, which now hold
+ * an estimate made of samplesDone samples per pixel. Returning false stops rendering early, in
+ * which case the done callback is still triggered. This can be called from any thread.
+ */
+using PassCallback = bool(*)(size_t samplesDone, size_t samplesPerPixel, void* userData);
+
 /**
  * PathTracer renders an asset by splitting the render target into tiles and invoking a JobSystem
- * task for each tile.
+ * task for each tile. Primary rays are traced in packets and occlusion rays in streams.
  *
  * The lifetime of the PathTracer object is independent of the background rendering process, so
  * clients can create a PathTracer and immediately discard it. However the passed-in mesh list and
@@ -75,6 +82,7 @@ public:
         const SimpleMesh* meshes = nullptr;
         size_t numMeshes = 0;
         size_t samplesPerPixel = 256;
+        size_t samplesPerPass = 0;
         SimpleCamera filmCamera;
         bool uvCamera = false;
         bool dilate = true;
@@ -83,6 +91,8 @@ public:
         void* tileUserData = nullptr;
         DoneCallback doneCallback = nullptr;
         void* doneUserData = nullptr;
+        PassCallback passCallback = nullptr;
+        void* passUserData = nullptr;
         float aoRayNear = std::numeric_limits<float>::epsilon() * 10.0f;
         float aoRayFar = std::numeric_limits<float>::infinity();
     };
@@ -133,6 +143,14 @@ public:
          */
         Builder& samplesPerPixel(size_t numSamples);
 
+        /**
+         * Accumulates the secondary rays over several passes of samplesPerPass samples each
+         * instead of a single one. Each pass updates all render targets and triggers the pass
+         * callback, which can stop rendering early. 0 (the default) renders a single pass.
+         */
+        Builder& progressive(size_t samplesPerPass, PassCallback onPass = nullptr,
+                void* userData = nullptr);
+
         /**
          * Sets the tmin and tfar for secondary rays.
          */
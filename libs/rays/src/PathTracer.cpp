@@ -25,6 +25,9 @@
 
 #include <utils/JobSystem.h>
 
+#include <algorithm>
+#include <random>
+
 #ifdef FILAMENT_HAS_EMBREE
 #include <embree3/rtcore.h>
 #include <embree3/rtcore_ray.h>
@@ -41,6 +44,12 @@ using namespace image;
 static constexpr size_t MIN_TILE_SIZE = 32;
 static constexpr size_t MAX_TILES_COUNT = 2048;
 
+// Primary rays are traced in packets of adjacent pixels within a row, which are coherent.
+static constexpr size_t PACKET_SIZE = 8;
+
+// Occlusion rays are incoherent, they are traced in streams of up to this many rays.
+static constexpr size_t OCCLUSION_STREAM_SIZE = 64;
+
 static constexpr float inf = std::numeric_limits<float>::infinity();
 
 static constexpr float EMPTY_SENTINEL = 2.0f;
@@ -128,6 +137,14 @@ PathTracer::Builder& PathTracer::Builder::samplesPerPixel(size_t numSamples) {
     return *this;
 }
 
+PathTracer::Builder& PathTracer::Builder::progressive(size_t samplesPerPass, PassCallback onPass,
+        void* userData) {
+    mConfig.samplesPerPass = samplesPerPass;
+    mConfig.passCallback = onPass;
+    mConfig.passUserData = userData;
+    return *this;
+}
+
 PathTracer::Builder& PathTracer::Builder::occlusionRayBounds(float aoRayNear, float aoRayFar) {
     mConfig.aoRayNear = aoRayNear;
     mConfig.aoRayFar = aoRayFar;
@@ -155,17 +172,42 @@ struct EmbreeContext {
     std::atomic<int> numRemainingTiles;
     RTCDevice device;
     RTCScene scene;
+
+    // Accumulated occlusion: the number of occluded samples, and the sum of their directions.
+    LinearImage occlusion;
+    size_t samplesDone = 0;
+    size_t passSamples = 0;
+    uint32_t passIndex = 0;
 };
 
-static void renderTile(EmbreeContext* context, PixelRectangle rect) {
+static void setRay(RTCRayHit8& packet, size_t i, const RTCRay& ray) {
+    packet.ray.org_x[i] = ray.org_x;
+    packet.ray.org_y[i] = ray.org_y;
+    packet.ray.org_z[i] = ray.org_z;
+    packet.ray.tnear[i] = ray.tnear;
+    packet.ray.dir_x[i] = ray.dir_x;
+    packet.ray.dir_y[i] = ray.dir_y;
+    packet.ray.dir_z[i] = ray.dir_z;
+    packet.ray.time[i] = ray.time;
+    packet.ray.tfar[i] = ray.tfar;
+    packet.ray.mask[i] = ray.mask;
+    packet.ray.id[i] = 0;
+    packet.ray.flags[i] = 0;
+    packet.hit.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+}
+
+// Renders the positions and normals of the visible surfaces into the G-Buffer. With the UV camera
+// these are interpolated from the vertex attributes of the 2D scene, with the film camera they
+// come from the hit point and the geometric normal.
+static void renderTileToGbuffer(EmbreeContext* context, PixelRectangle rect) {
     LinearImage& ao = context->config.renderTargets[(int) AMBIENT_OCCLUSION];
+    LinearImage& meshNormals = context->config.renderTargets[(int) MESH_NORMALS];
+    LinearImage& meshPositions = context->config.renderTargets[(int) MESH_POSITIONS];
     RTCScene embreeScene = context->scene;
-    const float inverseSampleCount = 1.0f / context->config.samplesPerPixel;
+    const bool uvCamera = context->config.uvCamera;
 
     // Precompute some camera parameters.
     const SimpleCamera& camera = context->config.filmCamera;
-    const float tnear = context->config.aoRayNear;
-    const float tfar = context->config.aoRayFar;
     const float iw = 1.0f / ao.getWidth();
     const float ih = 1.0f / ao.getHeight();
     const float theta = camera.vfovDegrees * F_PI / 180;
@@ -200,64 +242,6 @@ static void renderTile(EmbreeContext* context, PixelRectangle rect) {
         };
     };
 
-    // Loop over all pixels in the tile.
-    for (size_t row = rect.topLeft.y, len = rect.bottomRight.y; row < len; ++row) {
-        for (size_t col = rect.topLeft.x, len = rect.bottomRight.x; col < len; ++col) {
-            RTCIntersectContext intersector;
-            rtcInitIntersectContext(&intersector);
-            RTCRay ray = generateCameraRay(row, col);
-
-            RTCRayHit rayhit { .ray = ray };
-            intersector.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
-            rtcIntersect1(embreeScene, &intersector, &rayhit);
-            if (rayhit.ray.tfar != inf) {
-
-                intersector.flags = RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
-
-                // TODO: For now we are using the geometric normal provided by embree which is not
-                // necessarily normalized.
-                float3 n = normalize(float3 { rayhit.hit.Ng_x, rayhit.hit.Ng_y, rayhit.hit.Ng_z });
-                float3 b = randomPerp(n);
-                float3 t = cross(n, b);
-                mat3 tangentFrame = {t, b, n};
-
-                RTCRay aoray {
-                    .org_x = rayhit.ray.org_x + rayhit.ray.dir_x * rayhit.ray.tfar,
-                    .org_y = rayhit.ray.org_y + rayhit.ray.dir_y * rayhit.ray.tfar,
-                    .org_z = rayhit.ray.org_z + rayhit.ray.dir_z * rayhit.ray.tfar
-                };
-
-                float sum = 0;
-                for (size_t nsamp = 0, len = context->config.samplesPerPixel; nsamp < len; nsamp++) {
-                    const double2 u = hammersley(nsamp, inverseSampleCount);
-                    const float3 dir = tangentFrame * hemisphereCosSample(u);
-                    aoray.dir_x = dir.x;
-                    aoray.dir_y = dir.y;
-                    aoray.dir_z = dir.z;
-                    aoray.tnear = tnear;
-                    aoray.tfar = tfar;
-                    rtcOccluded1(embreeScene, &intersector, &aoray);
-                    if (aoray.tfar == -inf) {
-                        sum += 1.0f;
-                    }
-                }
-                ao.getPixelRef(col, row)[0] = 1.0f - sum * inverseSampleCount;
-            }
-        }
-    }
-}
-
-static void renderTileToGbuffer(EmbreeContext* context, PixelRectangle rect) {
-    LinearImage& ao = context->config.renderTargets[(int) AMBIENT_OCCLUSION];
-    LinearImage& meshNormals = context->config.renderTargets[(int) MESH_NORMALS];
-    LinearImage& meshPositions = context->config.renderTargets[(int) MESH_POSITIONS];
-    RTCScene embreeScene = context->scene;
-
-    const float tnear = context->config.aoRayNear;
-    const float tfar = context->config.aoRayFar;
-    const float iw = 1.0f / ao.getWidth();
-    const float ih = 1.0f / ao.getHeight();
-
     auto generateOrthoCameraRay = [=] (uint16_t row, uint16_t col) {
         return RTCRay {
             .org_x = float(col) * iw,
@@ -273,30 +257,59 @@ static void renderTileToGbuffer(EmbreeContext* context, PixelRectangle rect) {
         };
     };
 
-    for (size_t row = rect.topLeft.y, len = rect.bottomRight.y; row < len; ++row) {
-        for (size_t col = rect.topLeft.x, len = rect.bottomRight.x; col < len; ++col) {
-            RTCIntersectContext intersector;
-            rtcInitIntersectContext(&intersector);
-
-            RTCRay ray = generateOrthoCameraRay(row, col);
-            RTCRayHit rayhit { .ray = ray };
-            intersector.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
-            rtcIntersect1(embreeScene, &intersector, &rayhit);
+    RTCIntersectContext intersector;
+    rtcInitIntersectContext(&intersector);
+    intersector.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
 
-            float* position = meshPositions.getPixelRef(col, row);
-            float* normal = meshNormals.getPixelRef(col, row);
-            if (rayhit.ray.tfar != inf) {
-                RTCGeometry geo = rtcGetGeometry(embreeScene, rayhit.hit.geomID);
-                rtcInterpolate0(geo, rayhit.hit.primID, rayhit.hit.u, rayhit.hit.v,
-                        RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, position, 3);
-                rtcInterpolate0(geo, rayhit.hit.primID, rayhit.hit.u, rayhit.hit.v,
-                        RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 1, normal, 3);
-
-                // AO won't be computed until the second pass, but we show an instant preview of
-                // the chart shapes by setting a placeholder value in the AO map.
-                ao.getPixelRef(col, row)[0] = 0.5f;
-            } else {
-                normal[0] = EMPTY_SENTINEL;
+    for (size_t row = rect.topLeft.y, len = rect.bottomRight.y; row < len; ++row) {
+        for (size_t col0 = rect.topLeft.x, len = rect.bottomRight.x; col0 < len;
+                col0 += PACKET_SIZE) {
+            const size_t count = std::min(PACKET_SIZE, len - col0);
+
+            // Lanes past the end of the row are disabled. Embree requires the mask to be aligned
+            // like the packet.
+            alignas(32) int valid[PACKET_SIZE];
+            RTCRayHit8 rayhit;
+            for (size_t i = 0; i < PACKET_SIZE; i++) {
+                const size_t col = col0 + std::min(i, count - 1);
+                valid[i] = i < count ? -1 : 0;
+                setRay(rayhit, i, uvCamera ?
+                        generateOrthoCameraRay(row, col) : generateCameraRay(row, col));
+            }
+            rtcIntersect8(valid, embreeScene, &intersector, &rayhit);
+
+            for (size_t i = 0; i < count; i++) {
+                const size_t col = col0 + i;
+                float* position = meshPositions.getPixelRef(col, row);
+                float* normal = meshNormals.getPixelRef(col, row);
+                const float tfar = rayhit.ray.tfar[i];
+                if (tfar == inf) {
+                    normal[0] = EMPTY_SENTINEL;
+                    continue;
+                }
+                if (uvCamera) {
+                    RTCGeometry geo = rtcGetGeometry(embreeScene, rayhit.hit.geomID[i]);
+                    rtcInterpolate0(geo, rayhit.hit.primID[i], rayhit.hit.u[i], rayhit.hit.v[i],
+                            RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, position, 3);
+                    rtcInterpolate0(geo, rayhit.hit.primID[i], rayhit.hit.u[i], rayhit.hit.v[i],
+                            RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 1, normal, 3);
+
+                    // AO won't be computed until the second pass, but we show an instant preview
+                    // of the chart shapes by setting a placeholder value in the AO map.
+                    ao.getPixelRef(col, row)[0] = 0.5f;
+                } else {
+                    position[0] = rayhit.ray.org_x[i] + rayhit.ray.dir_x[i] * tfar;
+                    position[1] = rayhit.ray.org_y[i] + rayhit.ray.dir_y[i] * tfar;
+                    position[2] = rayhit.ray.org_z[i] + rayhit.ray.dir_z[i] * tfar;
+
+                    // TODO: For now we are using the geometric normal provided by embree which is
+                    // not necessarily normalized.
+                    float3 n = normalize(float3 {
+                            rayhit.hit.Ng_x[i], rayhit.hit.Ng_y[i], rayhit.hit.Ng_z[i] });
+                    normal[0] = n.x;
+                    normal[1] = n.y;
+                    normal[2] = n.z;
+                }
             }
         }
     }
@@ -368,56 +381,85 @@ static void denoise(EmbreeContext* context) {
 #endif
 }
 
+// Accumulates one pass of occlusion samples into the tile, then updates the render targets with
+// the estimate so far.
 static void renderTileFromGbuffer(EmbreeContext* context, PixelRectangle rect) {
     LinearImage& ao = context->config.renderTargets[(int) AMBIENT_OCCLUSION];
     LinearImage& meshNormals = context->config.renderTargets[(int) MESH_NORMALS];
     LinearImage& meshPositions = context->config.renderTargets[(int) MESH_POSITIONS];
     LinearImage& bentNormals = context->config.renderTargets[(int) BENT_NORMALS];
+    LinearImage& occlusion = context->occlusion;
     RTCScene embreeScene = context->scene;
-    const float inverseSampleCount = 1.0f / context->config.samplesPerPixel;
 
     const float tnear = context->config.aoRayNear;
     const float tfar = context->config.aoRayFar;
-    const size_t spp = context->config.samplesPerPixel;
+    const size_t passSamples = context->passSamples;
+    const float inverseSampleCount = 1.0f / passSamples;
+    const float inverseTotalCount = 1.0f / (context->samplesDone + passSamples);
+
+    // Each pass is a Hammersley set. When there are several passes, each pixel rotates it by a
+    // random offset so that the passes don't all use the same directions. The random generator
+    // is seeded by the tile and the pass, which keeps renders reproducible.
+    const bool jitter = passSamples < context->config.samplesPerPixel;
+    const uint32_t tile = (uint32_t(rect.topLeft.y) << 16u) | rect.topLeft.x;
+    std::minstd_rand rng(1u + (tile ^ (context->passIndex * 0x9E3779B9u)));
+    std::uniform_real_distribution<double> random(0.0, 1.0);
+
+    RTCIntersectContext intersector;
+    rtcInitIntersectContext(&intersector);
+    intersector.flags = RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
+    RTCRay aorays[OCCLUSION_STREAM_SIZE];
 
     for (size_t row = rect.topLeft.y, len = rect.bottomRight.y; row < len; ++row) {
         for (size_t col = rect.topLeft.x, len = rect.bottomRight.x; col < len; ++col) {
-            RTCIntersectContext intersector;
-            rtcInitIntersectContext(&intersector);
-            intersector.flags = RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
             float* position = meshPositions.getPixelRef(col, row);
             float* normal = meshNormals.getPixelRef(col, row);
-            if (normal[0] != EMPTY_SENTINEL) {
-                float3 n = { normal[0], normal[1], normal[2] };
-                float3 b = randomPerp(n);
-                float3 t = cross(n, b);
-                mat3 tangentFrame = {t, b, n};
-                RTCRay aoray { .org_x = position[0], .org_y = position[1], .org_z = position[2] };
-                float sum = 0;
-                float3 bentNormal = {0, 0, 0};
-                for (size_t nsamp = 0; nsamp < spp; nsamp++) {
-                    const double2 u = hammersley(nsamp, inverseSampleCount);
+            if (normal[0] == EMPTY_SENTINEL) {
+                continue;
+            }
+            float3 n = { normal[0], normal[1], normal[2] };
+            float3 b = randomPerp(n);
+            float3 t = cross(n, b);
+            mat3 tangentFrame = {t, b, n};
+            const double2 rotation = jitter ? double2 { random(rng), random(rng) } : double2(0);
+            float* sum = occlusion.getPixelRef(col, row);
+            for (size_t first = 0; first < passSamples; first += OCCLUSION_STREAM_SIZE) {
+                const size_t count = std::min(OCCLUSION_STREAM_SIZE, passSamples - first);
+                for (size_t i = 0; i < count; i++) {
+                    double2 u = hammersley(first + i, inverseSampleCount) + rotation;
+                    u -= floor(u);
                     const float3 dir = tangentFrame * hemisphereCosSample(u);
-                    aoray.dir_x = dir.x;
-                    aoray.dir_y = dir.y;
-                    aoray.dir_z = dir.z;
-                    aoray.tnear = tnear;
-                    aoray.tfar = tfar;
-                    rtcOccluded1(embreeScene, &intersector, &aoray);
-                    if (aoray.tfar == -inf) {
-                        bentNormal += dir;
-                        sum += 1.0f;
-                    }
+                    aorays[i] = RTCRay {
+                        .org_x = position[0],
+                        .org_y = position[1],
+                        .org_z = position[2],
+                        .tnear = tnear,
+                        .dir_x = dir.x,
+                        .dir_y = dir.y,
+                        .dir_z = dir.z,
+                        .time = 0,
+                        .tfar = tfar,
+                        .mask = 0xffffffff
+                    };
                 }
-                if (bentNormals) {
-                    bentNormal = normalize(bentNormal);
-                    float* pBentNormal = bentNormals.getPixelRef(col, row);
-                    pBentNormal[0] = bentNormal[0];
-                    pBentNormal[1] = bentNormal[1];
-                    pBentNormal[2] = bentNormal[2];
+                rtcOccluded1M(embreeScene, &intersector, aorays, count, sizeof(RTCRay));
+                for (size_t i = 0; i < count; i++) {
+                    if (aorays[i].tfar == -inf) {
+                        sum[0] += 1.0f;
+                        sum[1] += aorays[i].dir_x;
+                        sum[2] += aorays[i].dir_y;
+                        sum[3] += aorays[i].dir_z;
+                    }
                 }
-                ao.getPixelRef(col, row)[0] = 1.0f - sum * inverseSampleCount;
             }
+            if (bentNormals) {
+                float3 bentNormal = normalize(float3 { sum[1], sum[2], sum[3] });
+                float* pBentNormal = bentNormals.getPixelRef(col, row);
+                pBentNormal[0] = bentNormal[0];
+                pBentNormal[1] = bentNormal[1];
+                pBentNormal[2] = bentNormal[2];
+            }
+            ao.getPixelRef(col, row)[0] = 1.0f - sum[0] * inverseTotalCount;
         }
     }
 }
@@ -454,6 +496,8 @@ void spawnTileJobs(EmbreeContext* context, RenderFn render, CompletionFn done) {
             rect.bottomRight.y = std::min(rect.bottomRight.y, (uint16_t) height);
             utils::JobSystem::Job* tile = utils::jobs::createJob(*js, parent, [=] {
                 render(context, rect);
+                context->config.tileCallback(rect.topLeft, rect.bottomRight,
+                        context->config.tileUserData);
                 // Decrement an atomic tile count to know when we're done.
                 if (--context->numRemainingTiles == 0) {
                     done(context);
@@ -465,6 +509,85 @@ void spawnTileJobs(EmbreeContext* context, RenderFn render, CompletionFn done) {
     js->run(parent);
 }
 
+// Populates an embree scene from 3D position data, ignoring normals and UVs.
+static void populate3DScene(EmbreeContext* context) {
+    context->scene = rtcNewScene(context->device);
+    for (size_t i = 0; i < context->config.numMeshes; ++i) {
+        const SimpleMesh& mesh = context->config.meshes[i];
+        RTCGeometry geo = rtcNewGeometry(context->device, RTC_GEOMETRY_TYPE_TRIANGLE);
+        rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3,
+                mesh.positions, 0, mesh.positionsStride, mesh.numVertices);
+        rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3,
+                mesh.indices, 0, sizeof(uint32_t) * 3, mesh.numIndices / 3);
+        rtcCommitGeometry(geo);
+        rtcAttachGeometry(context->scene, geo);
+        rtcReleaseGeometry(geo);
+    }
+    rtcCommitScene(context->scene);
+}
+
+// Populates an embree scene from 2D position data sourced from UV rather than the standard 3D
+// vertex positions.
+static void populate2DScene(EmbreeContext* context) {
+    context->scene = rtcNewScene(context->device);
+    for (size_t i = 0; i < context->config.numMeshes; ++i) {
+        const SimpleMesh& mesh = context->config.meshes[i];
+        RTCGeometry geo = rtcNewGeometry(context->device, RTC_GEOMETRY_TYPE_TRIANGLE);
+        rtcSetGeometryVertexAttributeCount(geo, 2);
+        rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3,
+                mesh.uvs, 0, mesh.uvsStride, mesh.numVertices);
+        rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, RTC_FORMAT_FLOAT3,
+                mesh.positions, 0, mesh.positionsStride, mesh.numVertices);
+        rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 1, RTC_FORMAT_FLOAT3,
+                mesh.normals, 0, mesh.normalsStride, mesh.numVertices);
+        rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3,
+                mesh.indices, 0, sizeof(uint32_t) * 3, mesh.numIndices / 3);
+        rtcCommitGeometry(geo);
+        rtcAttachGeometry(context->scene, geo);
+        rtcReleaseGeometry(geo);
+    }
+    rtcCommitScene(context->scene);
+}
+
+static void finish(EmbreeContext* context) {
+    if (context->config.uvCamera && context->config.dilate) {
+        dilateCharts(context);
+    }
+    if (context->config.denoise) {
+        denoise(context);
+    }
+    context->config.doneCallback(context->config.doneUserData);
+    rtcReleaseScene(context->scene);
+    rtcReleaseDevice(context->device);
+    delete context;
+}
+
+static void spawnOcclusionPass(EmbreeContext* context);
+
+static void finishOcclusionPass(EmbreeContext* context) {
+    const size_t spp = context->config.samplesPerPixel;
+    context->samplesDone += context->passSamples;
+    context->passIndex++;
+    bool more = context->samplesDone < spp;
+    if (context->config.passCallback) {
+        more = context->config.passCallback(context->samplesDone, spp,
+                context->config.passUserData) && more;
+    }
+    if (more) {
+        spawnOcclusionPass(context);
+    } else {
+        finish(context);
+    }
+}
+
+static void spawnOcclusionPass(EmbreeContext* context) {
+    const size_t spp = context->config.samplesPerPixel;
+    const size_t samplesPerPass = context->config.samplesPerPass;
+    const size_t remaining = spp - context->samplesDone;
+    context->passSamples = samplesPerPass ? std::min(samplesPerPass, remaining) : remaining;
+    spawnTileJobs(context, renderTileFromGbuffer, finishOcclusionPass);
+}
+
 bool PathTracer::render() {
     const LinearImage& ao = mConfig.renderTargets[(int) AMBIENT_OCCLUSION];
     const size_t width = ao.getWidth();
@@ -488,103 +611,27 @@ bool PathTracer::render() {
         context->config.doneCallback = [] (void* userData) {};
     }
 
+    context->occlusion = LinearImage(width, height, 4);
+
     // Create the embree device.
     RTCDevice device = context->device = rtcNewDevice(nullptr);
     rtcSetDeviceErrorFunction(device, [](void* userPtr, RTCError code, const char* str) {
         printf("Embree error: %s.\n", str);
     }, nullptr);
 
-    // Populates an embree scene from 3D position data, ignoring normals and UVs.
-    auto populate3DScene = [=] () {
-        for (size_t i = 0; i < context->config.numMeshes; ++i) {
-            const SimpleMesh& mesh = context->config.meshes[i];
-            RTCGeometry geo = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_TRIANGLE);
-            rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3,
-                    mesh.positions, 0, mesh.positionsStride, mesh.numVertices);
-            rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3,
-                    mesh.indices, 0, sizeof(uint32_t) * 3, mesh.numIndices / 3);
-            rtcCommitGeometry(geo);
-            rtcAttachGeometry(context->scene, geo);
-            rtcReleaseGeometry(geo);
-        }
-        rtcCommitScene(context->scene);
-    };
-
-    // Populates an embree scene from 2D position data sourced from UV rather than the standard 3D
-    // vertex positions.
-    auto populate2DScene = [=] () {
-        for (size_t i = 0; i < context->config.numMeshes; ++i) {
-            const SimpleMesh& mesh = context->config.meshes[i];
-            RTCGeometry geo = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_TRIANGLE);
-            rtcSetGeometryVertexAttributeCount(geo, 2);
-            rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3,
-                    mesh.uvs, 0, mesh.uvsStride, mesh.numVertices);
-            rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, RTC_FORMAT_FLOAT3,
-                    mesh.positions, 0, mesh.positionsStride, mesh.numVertices);
-            rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 1, RTC_FORMAT_FLOAT3,
-                    mesh.normals, 0, mesh.normalsStride, mesh.numVertices);
-            rtcSetSharedGeometryBuffer(geo, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3,
-                    mesh.indices, 0, sizeof(uint32_t) * 3, mesh.numIndices / 3);
-            rtcCommitGeometry(geo);
-            rtcAttachGeometry(context->scene, geo);
-            rtcReleaseGeometry(geo);
-        }
-        rtcCommitScene(context->scene);
-    };
-
+    // First render positions and normals into the G-Buffer, then accumulate the occlusion rays
+    // from there, in one or more passes.
     if (mConfig.uvCamera) {
-
-        context->scene = rtcNewScene(device);
-        populate2DScene();
-
-        // First render XYZ positions into the G-Buffer.
-        spawnTileJobs(context, [](EmbreeContext* context, PixelRectangle rect) {
-            renderTileToGbuffer(context, rect);
-            context->config.tileCallback(rect.topLeft, rect.bottomRight,
-                    context->config.tileUserData);
-        }, [populate3DScene](EmbreeContext* context) {
-
-            rtcReleaseScene(context->scene);
-
+        populate2DScene(context);
+        spawnTileJobs(context, renderTileToGbuffer, [](EmbreeContext* context) {
             // Now that the G-Buffer is ready, render the 3D scene.
-            context->scene = rtcNewScene(context->device);
-            populate3DScene();
-            spawnTileJobs(context, [](EmbreeContext* context, PixelRectangle rect) {
-                renderTileFromGbuffer(context, rect);
-                context->config.tileCallback(rect.topLeft, rect.bottomRight,
-                        context->config.tileUserData);
-            }, [](EmbreeContext* context) {
-                if (context->config.dilate) {
-                    dilateCharts(context);
-                }
-                if (context->config.denoise) {
-                    denoise(context);
-                }
-                context->config.doneCallback(context->config.doneUserData);
-                rtcReleaseScene(context->scene);
-                rtcReleaseDevice(context->device);
-                delete context;
-            });
-        });
-
-    } else {
-
-        // For the simple case of rendering from a film camera, we need only one pass.
-        context->scene = rtcNewScene(device);
-        populate3DScene();
-        spawnTileJobs(context, [](EmbreeContext* context, PixelRectangle rect) {
-            renderTile(context, rect);
-            context->config.tileCallback(rect.topLeft, rect.bottomRight,
-                    context->config.tileUserData);
-        }, [](EmbreeContext* context) {
-            if (context->config.denoise) {
-                denoise(context);
-            }
-            context->config.doneCallback(context->config.doneUserData);
             rtcReleaseScene(context->scene);
-            rtcReleaseDevice(context->device);
-            delete context;
+            populate3DScene(context);
+            spawnOcclusionPass(context);
         });
+    } else {
+        populate3DScene(context);
+        spawnTileJobs(context, renderTileToGbuffer, spawnOcclusionPass);
     }
 
     return true;
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PerformanceCounters.h"
+
+#include <utils/EntityManager.h>
+#include <utils/SingleInstanceComponentManager.h>
+#include <utils/compiler.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace utils;
+
+namespace {
+
+struct Manager : public SingleInstanceComponentManager<uint32_t> {
+    explicit Manager(Lookup lookup) noexcept : SingleInstanceComponentManager<uint32_t>(lookup) { }
+};
+
+// Measures Entity -> Instance lookups, i.e. what FScene::prepare() does for every entity of the
+// scene, for a given number of entities. The count is clamped to what the EntityManager supports.
+class ComponentManager : public benchmark::Fixture {
+protected:
+    void run(benchmark::State& state, Manager::Lookup lookup, bool shuffle);
+};
+
+void ComponentManager::run(benchmark::State& state, Manager::Lookup lookup, bool shuffle) {
+    EntityManager& em = EntityManager::get();
+    const size_t count = std::min(size_t(state.range(0)), EntityManager::getMaxEntityCount());
+    std::vector<Entity> entities(count);
+    em.create(count, entities.data());
+
+    Manager manager(lookup);
+    for (Entity e : entities) {
+        manager.addComponent(e);
+    }
+
+    std::vector<Entity> queries(entities);
+    if (shuffle) {
+        std::shuffle(queries.begin(), queries.end(), std::default_random_engine{ 123 });
+    }
+
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            uint32_t sum = 0;
+            for (Entity e : queries) {
+                sum += manager.getInstance(e);
+            }
+            benchmark::DoNotOptimize(sum);
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations() * count));
+
+    em.destroy(count, entities.data());
+}
+
+} // anonymous namespace
+
+BENCHMARK_DEFINE_F(ComponentManager, HashMap)(benchmark::State& state) {
+    run(state, Manager::Lookup::HASH_MAP, false);
+}
+
+BENCHMARK_DEFINE_F(ComponentManager, SparseSet)(benchmark::State& state) {
+    run(state, Manager::Lookup::SPARSE_SET, false);
+}
+
+BENCHMARK_DEFINE_F(ComponentManager, HashMapShuffled)(benchmark::State& state) {
+    run(state, Manager::Lookup::HASH_MAP, true);
+}
+
+BENCHMARK_DEFINE_F(ComponentManager, SparseSetShuffled)(benchmark::State& state) {
+    run(state, Manager::Lookup::SPARSE_SET, true);
+}
+
+BENCHMARK_REGISTER_F(ComponentManager, HashMap)->RangeMultiplier(10)->Range(10000, 1000000);
+BENCHMARK_REGISTER_F(ComponentManager, SparseSet)->RangeMultiplier(10)->Range(10000, 1000000);
+BENCHMARK_REGISTER_F(ComponentManager, HashMapShuffled)->RangeMultiplier(10)->Range(10000, 1000000);
+BENCHMARK_REGISTER_F(ComponentManager, SparseSetShuffled)->RangeMultiplier(10)->Range(10000, 1000000);
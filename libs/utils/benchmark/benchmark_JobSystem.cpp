@@ -21,6 +21,8 @@
 
 #include <benchmark/benchmark.h>
 
+#include <vector>
+
 using namespace utils;
 
 
@@ -61,6 +63,57 @@ static void BM_JobSystemAsChildren4k(benchmark::State& state) {
     js.emancipate();
 }
 
+static void BM_JobSystemAsChildren16k(benchmark::State& state) {
+    // more jobs than fit in a work queue, this exercises the overflow queue and job segments
+    JobSystem js;
+    js.adopt();
+
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            auto root = js.create(nullptr, &emptyJob);
+            for (size_t i = 0; i < 16383; i++) {
+                js.run(js.create(root, &emptyJob), JobSystem::DONT_SIGNAL);
+            }
+            js.runAndWait(root);
+        }
+    }
+    state.SetItemsProcessed((int64_t)state.iterations() * 16384);
+
+    js.emancipate();
+}
+
+static void BM_JobSystemMixedPriorities(benchmark::State& state) {
+    // 4k critical jobs competing with 4k background jobs, we only wait for the critical ones
+    JobSystem js;
+    js.adopt();
+
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            auto background = js.create(nullptr, &emptyJob);
+            for (size_t i = 0; i < 4095; i++) {
+                js.run(js.create(background, &emptyJob),
+                        JobSystem::BACKGROUND | JobSystem::DONT_SIGNAL);
+            }
+            background = js.runAndRetain(background, JobSystem::BACKGROUND);
+
+            auto root = js.create(nullptr, &emptyJob);
+            for (size_t i = 0; i < 4095; i++) {
+                js.run(js.create(root, &emptyJob), JobSystem::DONT_SIGNAL);
+            }
+            js.runAndWait(root);
+
+            state.PauseTiming();
+            js.waitAndRelease(background);
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed((int64_t)state.iterations() * 4096);
+
+    js.emancipate();
+}
+
 static void BM_JobSystemParallelFor(benchmark::State& state) {
     JobSystem js;
     js.adopt();
@@ -77,8 +130,35 @@ static void BM_JobSystemParallelFor(benchmark::State& state) {
 
     js.emancipate();
 }
+static void BM_JobSystemThreadPlacement(benchmark::State& state) {
+    // each job touches its own 4 KiB of a 16 MiB buffer, which is sensitive to where jobs run
+    JobSystem js(0, 1, JobSystem::ThreadPlacement(state.range(0)));
+    js.adopt();
+
+    std::vector<uint32_t> buffer(4096 * 1024);
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            auto job = jobs::parallel_for(js, nullptr, buffer.data(), 4096 * 1024,
+                    [](uint32_t* data, size_t count) {
+                        for (size_t i = 0; i < count; i++) {
+                            data[i]++;
+                        }
+                    }, jobs::CountSplitter<1024>());
+            js.runAndWait(job);
+        }
+    }
+    state.SetItemsProcessed((int64_t)state.iterations() * 4096);
 
+    js.emancipate();
+}
 
 BENCHMARK(BM_JobSystem);
 BENCHMARK(BM_JobSystemAsChildren4k);
+BENCHMARK(BM_JobSystemAsChildren16k);
+BENCHMARK(BM_JobSystemMixedPriorities);
 BENCHMARK(BM_JobSystemParallelFor);
+BENCHMARK(BM_JobSystemThreadPlacement)
+        ->Arg(int(JobSystem::ThreadPlacement::CORES))
+        ->Arg(int(JobSystem::ThreadPlacement::CPUS))
+        ->Arg(int(JobSystem::ThreadPlacement::UNPINNED));
@@ -17,7 +17,10 @@
 #ifndef TNT_UTILS_ENTITYMANAGER_H
 #define TNT_UTILS_ENTITYMANAGER_H
 
+#include <atomic>
+
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include <utils/Entity.h>
@@ -46,9 +49,11 @@ public:
     }
 
     // create n entities. Thread safe.
+    // Creating entities in batches is much cheaper than one at a time.
     void create(size_t n, Entity* entities);
 
     // destroys n entities. Thread safe.
+    // Destroying entities in batches is much cheaper than one at a time.
     void destroy(size_t n, Entity* entities) noexcept;
 
     // create a new Entity. Thread safe.
@@ -68,7 +73,7 @@ public:
     // Thread safe.
     bool isAlive(Entity e) const noexcept {
         assert(getIndex(e) < RAW_INDEX_COUNT);
-        return (!e.isNull()) && (getGeneration(e) == mGens[getIndex(e)]);
+        return (!e.isNull()) && (getGeneration(e) == getGenerationForIndex(getIndex(e)));
     }
 
     // registers a listener to be called when an entity is destroyed. thread safe.
@@ -83,7 +88,8 @@ public:
 
     // current generation of the given index. Use for debugging and testing.
     uint8_t getGenerationForIndex(size_t index) const noexcept {
-        return mGens[index];
+        return mGens[index >> GENERATION_PAGE_SHIFT].load(std::memory_order_relaxed)
+                [index & GENERATION_PAGE_MASK].load(std::memory_order_relaxed);
     }
     // singleton, can't be copied
     EntityManager(const EntityManager& rhs) = delete;
@@ -91,15 +97,22 @@ public:
 
 private:
     friend class EntityManagerImpl;
+    template<typename ...> friend class SingleInstanceComponentManager;
     EntityManager();
     ~EntityManager();
 
-    // GENERATION_SHIFT determines how many simultaneous Entities are available, the
-    // minimum memory requirement is 2^GENERATION_SHIFT bytes.
-    static constexpr const int GENERATION_SHIFT = 17;
+    // GENERATION_SHIFT determines how many simultaneous Entities are available. Generations
+    // are stored one byte per index, in pages that are allocated as indices get used, so the
+    // memory requirement is proportional to the maximum number of Entities alive at any time.
+    static constexpr const int GENERATION_SHIFT = 22;
     static constexpr const size_t RAW_INDEX_COUNT = (1 << GENERATION_SHIFT);
     static constexpr const Entity::Type INDEX_MASK = (1 << GENERATION_SHIFT) - 1u;
 
+    static constexpr const int GENERATION_PAGE_SHIFT = 16;
+    static constexpr const size_t GENERATION_PAGE_SIZE = (1 << GENERATION_PAGE_SHIFT);
+    static constexpr const size_t GENERATION_PAGE_MASK = GENERATION_PAGE_SIZE - 1u;
+    static constexpr const size_t GENERATION_PAGE_COUNT = RAW_INDEX_COUNT / GENERATION_PAGE_SIZE;
+
     static inline Entity::Type getGeneration(Entity e) noexcept {
         return e.getId() >> GENERATION_SHIFT;
     }
@@ -110,8 +123,10 @@ private:
         return (g << GENERATION_SHIFT) | (i & INDEX_MASK);
     }
 
-    // stores the generation of each index.
-    uint8_t * const mGens;
+    // stores the generation of each index. Pages that are not allocated yet point to a shared
+    // read-only page of zeros, so that looking up a generation never needs a branch.
+    // Generations are atomic because destroy() bumps them with a compare-and-swap.
+    std::atomic<std::atomic<uint8_t>*> mGens[GENERATION_PAGE_COUNT];
 };
 
 } // namespace utils
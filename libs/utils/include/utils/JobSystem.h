@@ -18,9 +18,11 @@
 #define TNT_UTILS_JOBSYSTEM_H
 
 #include <assert.h>
+#include <stdint.h>
 
 #include <atomic>
 #include <functional>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -36,10 +38,29 @@
 
 namespace utils {
 
+class CpuTopology;
+
 class JobSystem {
-    static constexpr size_t MAX_JOB_COUNT = 4096;
-    static_assert(MAX_JOB_COUNT <= 0x7FFE, "MAX_JOB_COUNT must be <= 0x7FFE");
-    using WorkQueue = WorkStealingDequeue<uint16_t, MAX_JOB_COUNT>;
+    // Jobs are allocated in segments of JOB_SEGMENT_SIZE, new segments are allocated as needed.
+    static constexpr size_t JOB_SEGMENT_SHIFT = 12;
+    static constexpr size_t JOB_SEGMENT_SIZE = 1u << JOB_SEGMENT_SHIFT;
+    static constexpr size_t MAX_JOB_SEGMENT_COUNT = 64;
+    static constexpr size_t MAX_JOB_COUNT = JOB_SEGMENT_SIZE * MAX_JOB_SEGMENT_COUNT;
+
+    // Each thread has one work queue per priority, jobs that don't fit in them go to a shared
+    // overflow queue.
+    static constexpr size_t WORK_QUEUE_SIZE = 4096;
+    using WorkQueue = WorkStealingDequeue<uint32_t, WORK_QUEUE_SIZE>;
+
+    static constexpr size_t MAX_THREAD_COUNT = 64;
+
+    // value of Job::parent when the job has no parent
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    // Job::runningJobCount and Job::refCount are 16 bits to keep a Job within a cache line, which
+    // is less than MAX_JOB_COUNT. A parent with this many unfinished children (+1 for itself) gets
+    // new children only as older ones finish, see addChild().
+    static constexpr uint16_t MAX_RUNNING_JOB_COUNT = UINT16_MAX;
 
 public:
     class Job;
@@ -67,14 +88,29 @@ public:
                                                                 // v7 | v8
         void* storage[JOB_STORAGE_SIZE_WORDS];                  // 48 | 48
         JobFunc function;                                       //  4 |  8
-        uint16_t parent;                                        //  2 |  2
+        uint32_t parent;                                        //  4 |  4
         std::atomic<uint16_t> runningJobCount = { 1 };          //  2 |  2
         mutable std::atomic<uint16_t> refCount = { 1 };         //  2 |  2
-                                                                //  6 |  2 (padding)
+                                                                //  4 |  0 (padding)
                                                                 // 64 | 64
     };
 
-    explicit JobSystem(size_t threadCount = 0, size_t adoptableThreadsCount = 1) noexcept;
+    /*
+     * How the threads of the pool are laid out on the CPUs.
+     *
+     * On Linux and Android, the CPU topology (SMT siblings, last-level caches and NUMA nodes) is
+     * read from sysfs. Pinned threads steal from the closest threads first: same core, then same
+     * last-level cache, then same NUMA node, then any thread. Elsewhere, the thread count is
+     * derived from std::thread::hardware_concurrency() and stealing is uniformly random.
+     */
+    enum class ThreadPlacement : uint8_t {
+        CORES,      // one thread per physical core, pinned (default)
+        CPUS,       // one thread per logical CPU, i.e. using SMT, pinned
+        UNPINNED,   // one thread per physical core, not pinned, random stealing
+    };
+
+    explicit JobSystem(size_t threadCount = 0, size_t adoptableThreadsCount = 1,
+            ThreadPlacement placement = ThreadPlacement::CORES) noexcept;
 
     ~JobSystem();
 
@@ -158,6 +194,13 @@ public:
      *
      */
 
+    /*
+     * A job can have at most 65534 unfinished children (MAX_RUNNING_JOB_COUNT - 1). Past that,
+     * creating a child runs queued jobs until one of them finishes, so that many children must be
+     * run as they're created, like parallel_for() does. Creating more children than that without
+     * running them is an error and panics.
+     */
+
     // creates an empty (no-op) job with an optional parent
     Job* createJob(Job* parent = nullptr) noexcept {
         return create(parent, nullptr);
@@ -250,11 +293,16 @@ public:
      *
      * The job can't be used after this call.
      */
-    enum runFlags { DONT_SIGNAL = 0x1 };
+    enum runFlags {
+        DONT_SIGNAL = 0x1,
+        // Run the job with background priority: it only runs when no other job is pending.
+        // Jobs run from a background job are background jobs as well.
+        BACKGROUND = 0x2
+    };
     void run(Job*& job, uint32_t flags = 0) noexcept;
     void run(Job*&& job, uint32_t flags = 0) noexcept { // allows run(createJob(...));
         Job* p = job;
-        run(p);
+        run(p, flags);
     }
 
     void signal() noexcept;
@@ -325,9 +373,18 @@ private:
         }
     };
 
+    // Candidates for stealing are grouped in rings of increasing distance, see CpuTopology.
+    static constexpr size_t STEAL_RING_COUNT = 4;
+
+    enum JobPriority : uint8_t {
+        PRIORITY_CRITICAL,      // default, e.g. work needed for the current frame
+        PRIORITY_BACKGROUND,    // only runs when no critical job is pending
+        PRIORITY_COUNT
+    };
+
     struct alignas(CACHELINE_SIZE) ThreadState {    // this causes 40-bytes padding
         // make sure storage is cache-line aligned
-        WorkQueue workQueue;
+        WorkQueue workQueues[PRIORITY_COUNT];
 
         // these are not accessed by the worker threads
         alignas(CACHELINE_SIZE)     // this causes 56-bytes padding
@@ -335,6 +392,24 @@ private:
         std::thread thread;
         default_random_engine rndGen;
         uint32_t id;
+        JobPriority priority;       // priority of the job currently executing on this thread
+        int16_t cpu;                // CPU this thread is pinned to, or -1
+        uint8_t stealRing;          // ring to steal from at the next attempt
+        // stealOrder[0, stealRingEnd[i]) are the pool threads in ring i, closest first
+        uint8_t stealRingEnd[STEAL_RING_COUNT];
+        uint8_t stealOrder[MAX_THREAD_COUNT];
+    };
+
+    struct JobSegment {
+        Job* jobs = nullptr;
+        AtomicFreeList freeList;
+    };
+
+    // jobs that didn't fit in a work queue
+    struct OverflowQueue {
+        utils::Mutex lock;
+        std::vector<uint32_t> jobs;
+        std::atomic<uint32_t> count = { 0 };
     };
 
     static_assert(sizeof(ThreadState) % CACHELINE_SIZE == 0,
@@ -345,35 +420,85 @@ private:
     void incRef(Job const* job) noexcept;
     void decRef(Job const* job) noexcept;
 
+    void initThreadPlacement(ThreadState& state, ThreadPlacement placement,
+            CpuTopology const& topology) noexcept;
+
     Job* allocateJob() noexcept;
+    Job* allocateJobSegment(size_t segmentCount) noexcept;
+    void destroyJob(Job const* job) noexcept;
     JobSystem::ThreadState* getStateToStealFrom(JobSystem::ThreadState& state) noexcept;
     bool hasJobCompleted(Job const* job) noexcept;
 
     void requestExit() noexcept;
     bool exitRequested() const noexcept;
     bool hasActiveJobs() const noexcept;
+    bool hasActiveJobs(JobPriority priority) const noexcept;
+    bool hasRunnableJobs(JobPriority lowest) const noexcept;
+    JobPriority getWaiterPriority(ThreadState const& state) const noexcept;
 
     void loop(ThreadState* state) noexcept;
-    bool execute(JobSystem::ThreadState& state) noexcept;
-    Job* steal(JobSystem::ThreadState& state) noexcept;
+    // execute() and steal() only pick jobs of priority 'lowest' or higher
+    bool execute(JobSystem::ThreadState& state, JobPriority lowest) noexcept;
+    Job* steal(JobSystem::ThreadState& state, JobPriority lowest, JobPriority* priority) noexcept;
+    Job* steal(JobPriority priority, JobSystem::ThreadState* stateToStealFrom) noexcept;
     void finish(Job* job) noexcept;
+    void addChild(Job* parent) noexcept;
+
+    // Converts between a job and its index. The index of a job never changes and only needs
+    // 32-bits, which is what we store in the work queues (+1, since 0 means "no job").
+    uint32_t getJobIndex(Job const* job) const noexcept {
+        // in practice, there are very few segments and we find the job in the first one.
+        JobSegment const* const segments = mJobSegments;
+        for (size_t i = 0, c = mJobSegmentCount.load(std::memory_order_acquire); i < c; i++) {
+            Job const* const jobs = segments[i].jobs;
+            if (job >= jobs && job < jobs + JOB_SEGMENT_SIZE) {
+                return uint32_t((i << JOB_SEGMENT_SHIFT) + (job - jobs));
+            }
+        }
+        assert(false);
+        return 0;
+    }
 
-    void put(WorkQueue& workQueue, Job* job) noexcept {
-        size_t index = job - mJobStorageBase;
-        assert(index >= 0 && index < MAX_JOB_COUNT);
-        workQueue.push(uint16_t(index + 1));
+    Job* getJob(uint32_t index) const noexcept {
+        assert(index < MAX_JOB_COUNT);
+        return mJobSegments[index >> JOB_SEGMENT_SHIFT].jobs + (index & (JOB_SEGMENT_SIZE - 1));
+    }
+
+    void put(WorkQueue& workQueue, OverflowQueue& overflowQueue, Job* job) noexcept {
+        const uint32_t index = getJobIndex(job);
+        // only this thread pushes to workQueue, so getCount() can only overestimate its count.
+        if (UTILS_LIKELY(workQueue.getCount() < workQueue.getSize())) {
+            workQueue.push(index + 1);
+        } else {
+            std::lock_guard<Mutex> lock(overflowQueue.lock);
+            overflowQueue.jobs.push_back(index);
+            overflowQueue.count.store(uint32_t(overflowQueue.jobs.size()),
+                    std::memory_order_relaxed);
+        }
     }
 
     Job* pop(WorkQueue& workQueue) noexcept {
-        size_t index = workQueue.pop();
-        assert(index <= MAX_JOB_COUNT);
-        return !index ? nullptr : &mJobStorageBase[index - 1];
+        uint32_t index = workQueue.pop();
+        return !index ? nullptr : getJob(index - 1);
     }
 
     Job* steal(WorkQueue& workQueue) noexcept {
-        size_t index = workQueue.steal();
-        assert(index <= MAX_JOB_COUNT);
-        return !index ? nullptr : &mJobStorageBase[index - 1];
+        uint32_t index = workQueue.steal();
+        return !index ? nullptr : getJob(index - 1);
+    }
+
+    Job* steal(OverflowQueue& overflowQueue) noexcept {
+        if (UTILS_LIKELY(!overflowQueue.count.load(std::memory_order_relaxed))) {
+            return nullptr;
+        }
+        std::lock_guard<Mutex> lock(overflowQueue.lock);
+        if (overflowQueue.jobs.empty()) {
+            return nullptr;
+        }
+        uint32_t index = overflowQueue.jobs.back();
+        overflowQueue.jobs.pop_back();
+        overflowQueue.count.store(uint32_t(overflowQueue.jobs.size()), std::memory_order_relaxed);
+        return getJob(index);
     }
 
     void wait(std::unique_lock<Mutex>& lock) noexcept;
@@ -384,8 +509,12 @@ private:
     utils::Condition mWaiterCondition;
     uint32_t mWaiterCount = 0;
 
-    std::atomic<uint32_t> mActiveJobs = { 0 };
-    utils::Arena<utils::ThreadSafeObjectPoolAllocator<Job>, LockingPolicy::NoLock> mJobPool;
+    std::atomic<uint32_t> mActiveJobs[PRIORITY_COUNT] = {};
+
+    OverflowQueue mOverflowQueues[PRIORITY_COUNT];
+
+    // protects the allocation of new job segments
+    utils::Mutex mJobSegmentLock;
 
     template <typename T>
     using aligned_vector = std::vector<T, utils::STLAlignedAllocator<T>>;
@@ -400,7 +529,8 @@ private:
     aligned_vector<ThreadState> mThreadStates;          // actual data is stored offline
     std::atomic<bool> mExitRequested = { false };       // this one is almost never written
     std::atomic<uint16_t> mAdoptedThreads = { 0 };      // this one is almost never written
-    Job* const mJobStorageBase;                         // Base for conversion to indices
+    std::atomic<uint32_t> mJobSegmentCount = { 0 };     // this one is almost never written
+    JobSegment mJobSegments[MAX_JOB_SEGMENT_COUNT];     // Bases for conversion to indices
     uint16_t mThreadCount = 0;                          // total # of threads in the pool
     uint8_t mParallelSplitCount = 0;                    // # of split allowable in parallel_for
     Job* mMasterJob = nullptr;
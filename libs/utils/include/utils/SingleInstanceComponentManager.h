@@ -24,6 +24,9 @@
 
 #include <tsl/robin_map.h>
 
+#include <memory>
+#include <vector>
+
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -38,6 +41,12 @@ class EntityManager;
  * This handles the component's storage as a structure-of-arrays, as well
  * as the garbage collection.
  *
+ * Entities are mapped to instances either with a hash map (the default), or with a paged sparse
+ * set indexed by the Entity's index. The latter makes getInstance() a couple of loads instead of a
+ * hash lookup, at the cost of memory proportional to the range of Entity indices that have a
+ * component, rather than to the number of components. It is a good fit for managers that most
+ * entities have a component of, and that are queried every frame.
+ *
  * This is intended to be used as base class for a real component manager. When doing so,
  * and the real component manager is a public API, make sure to forward the public methods
  * to the implementation.
@@ -64,7 +73,15 @@ public:
 
     using Instance = EntityInstanceBase::Type;
 
-    SingleInstanceComponentManager() noexcept {
+    // How Entities are mapped to Instances. SPARSE_SET suits managers whose getInstance() is
+    // called for every entity of the scene each frame.
+    enum class Lookup : uint8_t {
+        HASH_MAP,       // memory proportional to the number of components
+        SPARSE_SET      // faster, memory proportional to the range of entity indices
+    };
+
+    explicit SingleInstanceComponentManager(Lookup lookup = Lookup::HASH_MAP) noexcept
+            : mLookup(lookup) {
         // We always start with a dummy entry because index=0 is reserved. The component
         // at index = 0, is guaranteed to be default-initialized.
         // Sub-classes can use this to their advantage.
@@ -86,12 +103,18 @@ public:
     }
 
     // Get instance of this Entity to be used to retrieve components
-    UTILS_NOINLINE
     Instance getInstance(Entity e) const noexcept {
-        auto const& map = mInstanceMap;
-        // find() generates quite a bit of code
-        auto pos = map.find(e);
-        return pos != map.end() ? pos->second : 0;
+        if (mLookup == Lookup::SPARSE_SET) {
+            // this is small enough to be inlined
+            Slot const* slot = getSlot(e);
+            if (UTILS_LIKELY(slot && slot->entity == e)) {
+                return slot->instance;
+            }
+            if (UTILS_LIKELY(mInstanceMap.empty())) {
+                return 0;
+            }
+        }
+        return findInstance(e);
     }
 
     // returns the number of components (i.e. size of each arrays)
@@ -217,15 +240,14 @@ protected:
         assert(j);
         if (i && j) {
             // update the index map
-            auto& map = mInstanceMap;
             Entity& ei = elementAt<ENTITY_INDEX>(i);
             Entity& ej = elementAt<ENTITY_INDEX>(j);
             std::swap(ei, ej);
             if (ei) {
-                map[ei] = i;
+                setInstance(ei, i);
             }
             if (ej) {
-                map[ej] = j;
+                setInstance(ej, j);
             }
         }
     }
@@ -255,11 +277,93 @@ protected:
     SoA mData;
 
 private:
-    // maps an entity to an instance index
+    // An entry of the sparse set. The whole Entity is stored so that stale entries, left by a
+    // previous generation of the same index, are never mistaken for a match.
+    struct Slot {
+        Entity entity;
+        Instance instance;
+    };
+
+    static constexpr size_t PAGE_SHIFT = 12;    // 4096 slots, or 32 KiB, per page
+    static constexpr size_t PAGE_SIZE = 1u << PAGE_SHIFT;
+    static constexpr size_t PAGE_MASK = PAGE_SIZE - 1u;
+
+    Slot* getSlot(Entity e) const noexcept {
+        const size_t index = EntityManager::getIndex(e);
+        const size_t page = index >> PAGE_SHIFT;
+        return page < mPages.size() && mPages[page] ? &mPages[page][index & PAGE_MASK] : nullptr;
+    }
+
+    Slot& getOrCreateSlot(Entity e) {
+        const size_t index = EntityManager::getIndex(e);
+        const size_t page = index >> PAGE_SHIFT;
+        if (UTILS_UNLIKELY(page >= mPages.size())) {
+            mPages.resize(page + 1);
+        }
+        if (UTILS_UNLIKELY(!mPages[page])) {
+            mPages[page].reset(new Slot[PAGE_SIZE]());
+        }
+        return mPages[page][index & PAGE_MASK];
+    }
+
+    UTILS_NOINLINE
+    Instance findInstance(Entity e) const noexcept {
+        auto const& map = mInstanceMap;
+        // find() generates quite a bit of code
+        auto pos = map.find(e);
+        return pos != map.end() ? pos->second : 0;
+    }
+
+    inline void setInstance(Entity e, Instance i);
+    inline void eraseInstance(Entity e) noexcept;
+
+    // Maps an entity to an instance index. With Lookup::SPARSE_SET, this only holds the entities
+    // whose slot was taken by a newer generation of the same index before they were removed
+    // (i.e. destroyed entities that have not been garbage collected yet), and is usually empty.
     tsl::robin_map<Entity, Instance> mInstanceMap;
+    std::vector<std::unique_ptr<Slot[]>> mPages;
+    Lookup mLookup = Lookup::HASH_MAP;
     default_random_engine mRng;
 };
 
+template<typename ... Elements>
+void SingleInstanceComponentManager<Elements ...>::setInstance(Entity e, Instance i) {
+    if (mLookup == Lookup::SPARSE_SET) {
+        Slot& slot = getOrCreateSlot(e);
+        if (slot.entity == e) {
+            slot.instance = i;
+            return;
+        }
+        if (UTILS_UNLIKELY(!mInstanceMap.empty())) {
+            auto pos = mInstanceMap.find(e);
+            if (pos != mInstanceMap.end()) {
+                pos.value() = i;
+                return;
+            }
+        }
+        if (slot.instance) {
+            // The slot belongs to an older generation of this index which still has its
+            // component, move it aside since newer entities are the likely ones to be looked up.
+            mInstanceMap[slot.entity] = slot.instance;
+        }
+        slot = { e, i };
+        return;
+    }
+    mInstanceMap[e] = i;
+}
+
+template<typename ... Elements>
+void SingleInstanceComponentManager<Elements ...>::eraseInstance(Entity e) noexcept {
+    if (mLookup == Lookup::SPARSE_SET) {
+        Slot* slot = getSlot(e);
+        if (slot && slot->entity == e) {
+            slot->instance = 0;
+            return;
+        }
+    }
+    mInstanceMap.erase(e);
+}
+
 // Keep these outside of the class because CLion has trouble parsing them
 template<typename ... Elements>
 typename SingleInstanceComponentManager<Elements ...>::Instance
@@ -271,10 +375,10 @@ SingleInstanceComponentManager<Elements ...>::addComponent(Entity e) {
             mData.push_back().template back<ENTITY_INDEX>() = e;
             // index 0 is used when the component doesn't exist
             ci = Instance(mData.size() - 1);
-            mInstanceMap[e] = ci;
+            setInstance(e, ci);
         } else {
             // if the entity already has this component, just return its instance
-            ci = mInstanceMap[e];
+            ci = getInstance(e);
         }
     }
     assert(ci != 0);
@@ -285,11 +389,8 @@ SingleInstanceComponentManager<Elements ...>::addComponent(Entity e) {
 template <typename ... Elements>
 typename SingleInstanceComponentManager<Elements ...>::Instance
 SingleInstanceComponentManager<Elements ... >::removeComponent(Entity e) {
-    auto& map = mInstanceMap;
-    auto pos = map.find(e);
-    if (UTILS_LIKELY(pos != map.end())) {
-        size_t index = pos->second;
-        assert(index != 0);
+    Instance index = getInstance(e);
+    if (UTILS_LIKELY(index != 0)) {
         size_t last = mData.size() - 1;
         if (last != index) {
             // move the last item to where we removed this component, as to keep
@@ -299,10 +400,10 @@ SingleInstanceComponentManager<Elements ... >::removeComponent(Entity e) {
             });
 
             Entity lastEntity = mData.template elementAt<ENTITY_INDEX>(index);
-            map[lastEntity] = index;
+            setInstance(lastEntity, index);
         }
         mData.pop_back();
-        map.erase(pos);
+        eraseInstance(e);
         return last;
     }
     return 0;
@@ -24,7 +24,15 @@
 #define SYSTRACE_TAG_JOBSYSTEM      (1<<2)
 
 
-#if defined(ANDROID)
+/*
+ * On Android, events are sent to atrace.
+ *
+ * On Linux, events are recorded in memory, in a ring buffer per thread, when the FILAMENT_SYSTRACE
+ * environment variable is set. They are written to the file it names, if any, when the process
+ * exits, or at any time with SYSTRACE_DUMP(). The output uses the Chrome JSON trace format, which
+ * can be opened with chrome://tracing or https://ui.perfetto.dev.
+ */
+#if defined(ANDROID) || defined(__linux__)
 
 #include <atomic>
 
@@ -94,6 +102,18 @@
 #define SYSTRACE_VALUE64(name, val) \
         ___tracer.value(SYSTRACE_TAG, name, int64_t(val))
 
+/**
+ * Writes the events recorded so far to the given file, in the Chrome JSON trace format.
+ * Only does something on Linux, Android uses atrace.
+ * Must be called while no other thread is recording events (e.g. at exit, or once the job
+ * system and the render thread are idle), otherwise some events may be dropped or garbled.
+ */
+#if defined(ANDROID)
+#define SYSTRACE_DUMP(path)
+#else
+#define SYSTRACE_DUMP(path) ::utils::details::Systrace::dumpChromeTrace(path)
+#endif
+
 // ------------------------------------------------------------------------------------------------
 // No user serviceable code below...
 // ------------------------------------------------------------------------------------------------
@@ -119,6 +139,10 @@ public:
     static void enable(uint32_t tags) noexcept;
     static void disable(uint32_t tags) noexcept;
 
+#if !defined(ANDROID)
+    static bool dumpChromeTrace(const char* path) noexcept;
+#endif
+
     inline void asyncBegin(uint32_t tag, const char* name, int32_t cookie) noexcept {
         if (tag && UTILS_UNLIKELY(mIsTracingEnabled)) {
             async_begin_body(mMarkerFd, mPid, name, cookie);
@@ -154,8 +178,12 @@ private:
 
     inline void traceEnd(uint32_t tag) noexcept {
         if (tag && UTILS_UNLIKELY(mIsTracingEnabled)) {
+#if defined(ANDROID)
             const char END_TAG = 'E';
             write(mMarkerFd, &END_TAG, 1);
+#else
+            end_body(mMarkerFd, mPid);
+#endif
         }
     }
 
@@ -181,6 +209,9 @@ private:
     static void init_once() noexcept;
 
     static void begin_body(int fd, int pid, const char* name) noexcept;
+#if !defined(ANDROID)
+    static void end_body(int fd, int pid) noexcept;
+#endif
     static void async_begin_body(int fd, int pid, const char* name, int32_t cookie) noexcept;
     static void async_end_body(int fd, int pid, const char* name, int32_t cookie) noexcept;
     static void int_body(int fd, int pid, const char* name, int32_t value) noexcept;
@@ -219,7 +250,7 @@ private:
 } // namespace utils
 
 // ------------------------------------------------------------------------------------------------
-#else // !ANDROID
+#else // !ANDROID && !__linux__
 // ------------------------------------------------------------------------------------------------
 
 #define SYSTRACE_ENABLE()
@@ -231,7 +262,8 @@ private:
 #define SYSTRACE_ASYNC_END(name, cookie)
 #define SYSTRACE_VALUE32(name, val)
 #define SYSTRACE_VALUE64(name, val)
+#define SYSTRACE_DUMP(path)
 
-#endif // ANDROID
+#endif // ANDROID || __linux__
 
 #endif // TNT_UTILS_SYSTRACE_H
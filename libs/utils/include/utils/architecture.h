@@ -17,12 +17,31 @@
 #ifndef TNT_UTILS_ARCHITECTURE_H
 #define TNT_UTILS_ARCHITECTURE_H
 
+#include <utils/compiler.h>
+
 #include <stddef.h>
+#include <stdint.h>
 
 namespace utils {
 
 constexpr size_t CACHELINE_SIZE = 64;
 
+/*
+ * Instruction set extensions that code compiled with UTILS_TARGET() can depend on. They are
+ * detected at runtime with CPUID, which also checks that the OS saves the corresponding registers.
+ * NEON is only reported when the compiler targets it, since it can't be detected portably.
+ */
+enum class CpuFeature : uint32_t {
+    SSE4_1      = 0x01,
+    AVX         = 0x02,
+    AVX2        = 0x04,
+    FMA         = 0x08,
+    AVX512F     = 0x10,
+    NEON        = 0x20,
+};
+
+UTILS_PUBLIC bool hasCpuFeature(CpuFeature feature) noexcept;
+
 } // namespace utils
 
 #endif // TNT_UTILS_ARCHITECTURE_H
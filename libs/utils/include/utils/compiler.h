@@ -127,6 +127,14 @@
 #define UTILS_UNUSED_IN_RELEASE
 #endif
 
+// compiles a function for an instruction set extension, e.g. UTILS_TARGET("avx2"). Such
+// functions must only be called after checking utils::hasCpuFeature().
+#if __has_attribute(target)
+#define UTILS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define UTILS_TARGET(isa)
+#endif
+
 #if defined(_MSC_VER) && _MSC_VER >= 1900
 #    define UTILS_RESTRICT __restrict
 #elif (defined(__clang__) || defined(__GNUC__))
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CpuTopology.h"
+
+#include <algorithm>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#   include <sched.h>
+#endif
+
+namespace utils {
+
+static bool readLine(std::string const& path, char* buffer, size_t size) noexcept {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    bool const success = fgets(buffer, int(size), file) != nullptr;
+    fclose(file);
+    return success;
+}
+
+static int readInt(std::string const& path, int defaultValue) noexcept {
+    char buffer[32];
+    if (!readLine(path, buffer, sizeof(buffer))) {
+        return defaultValue;
+    }
+    return atoi(buffer);
+}
+
+static std::vector<uint16_t> readCpuList(std::string const& path) noexcept {
+    char buffer[4096];
+    if (!readLine(path, buffer, sizeof(buffer))) {
+        return {};
+    }
+    return CpuTopology::parseCpuList(buffer);
+}
+
+// returns the index of key in keys, adding it if needed
+static uint16_t getOrAdd(std::vector<uint32_t>& keys, uint32_t key) noexcept {
+    auto pos = std::find(keys.begin(), keys.end(), key);
+    if (pos == keys.end()) {
+        pos = keys.insert(keys.end(), key);
+    }
+    return uint16_t(pos - keys.begin());
+}
+
+std::vector<uint16_t> CpuTopology::parseCpuList(const char* list) noexcept {
+    std::vector<uint16_t> cpus;
+    const char* p = list;
+    while (*p) {
+        char* end;
+        unsigned long const first = strtoul(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        unsigned long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtoul(p + 1, &end, 10);
+            if (end == p + 1) {
+                break;
+            }
+            p = end;
+        }
+        for (unsigned long cpu = first; cpu <= last && cpu <= UINT16_MAX; cpu++) {
+            cpus.push_back(uint16_t(cpu));
+        }
+        if (*p != ',') {
+            break;
+        }
+        p++;
+    }
+    return cpus;
+}
+
+CpuTopology CpuTopology::fromSysfs(const char* sysfsRoot) noexcept {
+    CpuTopology topology;
+
+    const std::string root(sysfsRoot);
+    std::vector<uint16_t> const online = readCpuList(root + "/cpu/online");
+    if (online.empty()) {
+        return topology;
+    }
+
+    // NUMA nodes are optional, without them all CPUs are on node 0
+    std::vector<uint16_t> nodeOfCpu;
+    for (uint16_t node : readCpuList(root + "/node/online")) {
+        std::string const path = root + "/node/node" + std::to_string(node) + "/cpulist";
+        for (uint16_t cpu : readCpuList(path)) {
+            if (cpu >= nodeOfCpu.size()) {
+                nodeOfCpu.resize(cpu + 1u, 0);
+            }
+            nodeOfCpu[cpu] = node;
+        }
+    }
+
+    std::vector<uint32_t> coreKeys;
+    std::vector<uint32_t> cacheKeys;
+    for (uint16_t id : online) {
+        std::string const cpuPath = root + "/cpu/cpu" + std::to_string(id);
+        uint32_t const package = uint32_t(readInt(cpuPath + "/topology/physical_package_id", 0));
+        uint32_t const coreId = uint32_t(readInt(cpuPath + "/topology/core_id", id));
+
+        // The last-level cache is the highest level data or unified cache. We identify it by the
+        // first CPU sharing it. Without cache information, we assume one cache per package.
+        uint32_t cacheKey = 0x10000u | package;
+        int lastLevel = 0;
+        for (int index = 0; ; index++) {
+            std::string const cachePath = cpuPath + "/cache/index" + std::to_string(index);
+            int const level = readInt(cachePath + "/level", -1);
+            if (level < 0) {
+                break;
+            }
+            char type[32];
+            if (level > lastLevel && readLine(cachePath + "/type", type, sizeof(type)) &&
+                    strncmp(type, "Instruction", 11) != 0) {
+                std::vector<uint16_t> const shared = readCpuList(cachePath + "/shared_cpu_list");
+                if (!shared.empty()) {
+                    cacheKey = *std::min_element(shared.begin(), shared.end());
+                    lastLevel = level;
+                }
+            }
+        }
+
+        Cpu cpu;
+        cpu.id = id;
+        cpu.core = getOrAdd(coreKeys, (package << 16u) | (coreId & 0xFFFFu));
+        cpu.cache = getOrAdd(cacheKeys, cacheKey);
+        cpu.node = id < nodeOfCpu.size() ? nodeOfCpu[id] : uint16_t(0);
+        topology.mCpus.push_back(cpu);
+    }
+
+    std::sort(topology.mCpus.begin(), topology.mCpus.end(), [](Cpu const& lhs, Cpu const& rhs) {
+        if (lhs.node != rhs.node) return lhs.node < rhs.node;
+        if (lhs.cache != rhs.cache) return lhs.cache < rhs.cache;
+        if (lhs.core != rhs.core) return lhs.core < rhs.core;
+        return lhs.id < rhs.id;
+    });
+    topology.mCoreCount = coreKeys.size();
+    return topology;
+}
+
+CpuTopology CpuTopology::discover() noexcept {
+    CpuTopology topology;
+#if defined(__linux__)
+    topology = fromSysfs("/sys/devices/system");
+
+    // only keep the CPUs we're allowed to run on
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        auto& cpus = topology.mCpus;
+        cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [&set](Cpu const& cpu) {
+            return cpu.id >= CPU_SETSIZE || !CPU_ISSET(cpu.id, &set);
+        }), cpus.end());
+        topology.mCoreCount = topology.getCores().size();
+    }
+#endif
+    return topology;
+}
+
+std::vector<CpuTopology::Cpu> CpuTopology::getCores() const noexcept {
+    // CPUs are sorted by core, so SMT siblings are next to each other
+    std::vector<Cpu> cores;
+    for (Cpu const& cpu : mCpus) {
+        if (cores.empty() || cores.back().core != cpu.core) {
+            cores.push_back(cpu);
+        }
+    }
+    return cores;
+}
+
+} // namespace utils
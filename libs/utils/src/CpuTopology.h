@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_UTILS_CPUTOPOLOGY_H
+#define TNT_UTILS_CPUTOPOLOGY_H
+
+#include <utils/compiler.h>
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace utils {
+
+/*
+ * Describes how the logical CPUs available to this process are organized into cores, last-level
+ * caches and NUMA nodes. This is used by JobSystem to size its thread pool, pin its threads and
+ * decide where to steal jobs from.
+ *
+ * The topology is read from sysfs, so it is only available on Linux and Android. Elsewhere,
+ * or if sysfs can't be read, the topology is empty.
+ */
+class UTILS_PRIVATE CpuTopology {
+public:
+    struct Cpu {
+        uint16_t id;        // logical CPU number, as used by sched_setaffinity()
+        uint16_t core;      // physical core, CPUs sharing a core are SMT siblings
+        uint16_t cache;     // last-level cache
+        uint16_t node;      // NUMA node
+    };
+
+    // how far apart two CPUs are, in increasing order of cost for sharing data
+    enum Distance : uint8_t {
+        SAME_CORE,
+        SAME_CACHE,
+        SAME_NODE,
+        REMOTE,
+        DISTANCE_COUNT
+    };
+
+    // topology of the CPUs this process is allowed to run on
+    static CpuTopology discover() noexcept;
+
+    // topology of all online CPUs, as described by a sysfs tree rooted at sysfsRoot
+    // (normally "/sys/devices/system"). This is exposed for testing.
+    static CpuTopology fromSysfs(const char* sysfsRoot) noexcept;
+
+    static Distance getDistance(Cpu const& lhs, Cpu const& rhs) noexcept {
+        if (lhs.core == rhs.core) return SAME_CORE;
+        if (lhs.cache == rhs.cache) return SAME_CACHE;
+        if (lhs.node == rhs.node) return SAME_NODE;
+        return REMOTE;
+    }
+
+    bool empty() const noexcept { return mCpus.empty(); }
+
+    // CPUs sorted by node, cache, core and id, so that close CPUs are next to each other
+    std::vector<Cpu> const& getCpus() const noexcept { return mCpus; }
+
+    size_t getCoreCount() const noexcept { return mCoreCount; }
+
+    // one CPU per physical core (the first SMT sibling), in the same order as getCpus()
+    std::vector<Cpu> getCores() const noexcept;
+
+    // parses a sysfs cpu list, e.g. "0-3,8,10-11"
+    static std::vector<uint16_t> parseCpuList(const char* list) noexcept;
+
+private:
+    std::vector<Cpu> mCpus;
+    size_t mCoreCount = 0;
+};
+
+} // namespace utils
+
+#endif // TNT_UTILS_CPUTOPOLOGY_H
@@ -16,16 +16,51 @@
 
 #include "EntityManagerImpl.h"
 
+#include <utils/ThreadLocal.h>
+
 namespace utils {
 
-EntityManager::EntityManager()
-        : mGens(new uint8_t[RAW_INDEX_COUNT]) {
-    // initialize all the generations to 0
-    std::fill_n(mGens, RAW_INDEX_COUNT, 0);
+std::atomic<uint8_t> EntityManagerImpl::sUnusedGenerations[EntityManagerImpl::GENERATION_PAGE_SIZE];
+
+EntityManager::EntityManager() {
+    // all generations start at 0, pages are allocated when their first index is handed out
+    for (auto& page : mGens) {
+        page.store(EntityManagerImpl::sUnusedGenerations, std::memory_order_relaxed);
+    }
 }
 
 EntityManager::~EntityManager() {
-    delete [] mGens;
+    for (auto& page : mGens) {
+        std::atomic<uint8_t>* gens = page.load(std::memory_order_relaxed);
+        if (gens != EntityManagerImpl::sUnusedGenerations) {
+            delete [] gens;
+        }
+    }
+}
+
+size_t EntityManagerImpl::getFreeListIndex() noexcept {
+    static std::atomic<size_t> sNextIndex = { 0 };
+    // 0 means this thread hasn't picked a free-list yet, otherwise it's the index + 1
+    static UTILS_DEFINE_TLS(size_t) sIndex(0);
+    size_t index = sIndex;
+    if (UTILS_UNLIKELY(!index)) {
+        index = sNextIndex.fetch_add(1, std::memory_order_relaxed) % FREE_LIST_COUNT + 1;
+        sIndex = index;
+    }
+    return index - 1;
+}
+
+std::atomic<uint8_t>* EntityManagerImpl::getGenerationPage(size_t page) noexcept {
+    std::atomic<uint8_t>* gens = mGens[page].load(std::memory_order_acquire);
+    if (UTILS_UNLIKELY(gens == sUnusedGenerations)) {
+        std::lock_guard<Mutex> lock(mGenerationPageLock);
+        gens = mGens[page].load(std::memory_order_relaxed);
+        if (gens == sUnusedGenerations) {
+            gens = new std::atomic<uint8_t>[GENERATION_PAGE_SIZE]();
+            mGens[page].store(gens, std::memory_order_release);
+        }
+    }
+    return gens;
 }
 
 EntityManager& EntityManager::get() noexcept {
@@ -25,6 +25,8 @@
 
 #include <tsl/robin_set.h>
 
+#include <algorithm>
+#include <atomic>
 #include <deque>
 #include <mutex> // for std::lock_guard
 #include <vector>
@@ -34,6 +36,9 @@ namespace utils {
 
 static constexpr const size_t MIN_FREE_INDICES = 1024;
 
+// Number of independent free-lists, threads are spread across them to reduce contention.
+static constexpr const size_t FREE_LIST_COUNT = 8;
+
 class UTILS_PRIVATE EntityManagerImpl : public EntityManager {
 public:
     using EntityManager::getGeneration;
@@ -41,71 +46,83 @@ public:
     using EntityManager::makeIdentity;
     using EntityManager::create;
     using EntityManager::destroy;
+    using EntityManager::GENERATION_PAGE_SIZE;
+
+    // Generation page of the indices that have never been handed out. It is never written to.
+    static std::atomic<uint8_t> sUnusedGenerations[GENERATION_PAGE_SIZE];
 
     void create(size_t n, Entity* entities) {
-        Entity::Type index;
-        auto& freeList = mFreeList;
-        uint8_t* const gens = mGens;
+        size_t i = 0;
+        while (i < n) {
+            size_t count = 0;
 
-        // this must be thread-safe, acquire the free-list mutex
-        std::lock_guard<Mutex> lock(mFreeListLock);
-        Entity::Type currentIndex = mCurrentIndex;
-        for (size_t i = 0; i < n; i++) {
-            // If we have more than a certain number of freed indices, get one from the list.
+            // If we have more than a certain number of freed indices, recycle them.
             // this is a trade-off between how often we recycle indices and how large the free list
             // can grow.
-            if (UTILS_UNLIKELY(currentIndex >= RAW_INDEX_COUNT || freeList.size() >= MIN_FREE_INDICES)) {
+            if (UTILS_UNLIKELY(mFreeIndexCount.load(std::memory_order_relaxed) >= MIN_FREE_INDICES)) {
+                count = recycleIndices(n - i, entities + i);
+            }
+
+            // In the common case, we just grab the next indices, this doesn't need a lock.
+            // This works only until all indices have been used once, at which point
+            // we're always in the slower case. The idea is that we have enough indices
+            // that it doesn't happen in practice.
+            if (!count) {
+                count = allocateIndices(n - i, entities + i);
+            }
 
-                // this could only happen if we had gone through all the indices at least once
-                if (UTILS_UNLIKELY(freeList.empty())) {
+            // we've gone through all the indices at least once, the free-lists are our only hope
+            if (UTILS_UNLIKELY(!count)) {
+                count = recycleIndices(n - i, entities + i);
+                if (!count) {
                     // return the null entity
-                    entities[i] = {};
-                    continue;
+                    std::fill(entities + i, entities + n, Entity{});
+                    break;
                 }
-
-                index = freeList.front();
-                freeList.pop_front();
-            } else {
-                // In the common case, we just grab the next index.
-                // This works only until all indices have been used once, at which point
-                // we're always in the slower case above. The idea is that we have enough indices
-                // that it doesn't happen in practice.
-                index = currentIndex++;
             }
-            entities[i] = Entity{ makeIdentity(gens[index], index) };
+
+            i += count;
         }
-        mCurrentIndex = currentIndex;
     }
 
     void destroy(size_t n, Entity* entities) noexcept {
-        auto& freeList = mFreeList;
-        uint8_t* const gens = mGens;
+        FreeList& freeList = mFreeLists[getFreeListIndex()];
 
-        std::unique_lock<Mutex> lock(mFreeListLock);
+        size_t count = 0;
+        std::unique_lock<Mutex> lock(freeList.lock);
         for (size_t i = 0; i < n; i++) {
             if (!entities[i]) {
                 // behave like free(), ok to free null Entity.
                 continue;
             }
 
-            // it's an error to delete an Entity twice...
-            assert(isAlive(entities[i]));
-
-            // ... deleting a dead Entity will corrupt the internal state, so we protect ourselves
-            // against it. We don't guarantee anything about external state -- e.g. the listeners
-            // will be called.
-            if (isAlive(entities[i])) {
-                Entity::Type index = getIndex(entities[i]);
-                freeList.push_back(index);
-
-                // The generation update doesn't require the lock because it's only used for isAlive()
-                // and entities work as weak references -- it just means that isAlive() could return
-                // true a little longer than expected in some other threads.
-                // We do need a memory fence though, it is provided by the mFreeListLock.unlock() below.
-                gens[index]++;
+            // It's an error to delete an Entity twice, but deleting a dead Entity would corrupt
+            // the internal state, so we protect ourselves against it: the generation is bumped
+            // with a compare-and-swap from the Entity's own generation, and only the thread that
+            // wins it returns the index to a free-list. Since the free-lists are sharded, this is
+            // what prevents two threads destroying the same Entity from handing its index out
+            // twice. We don't guarantee anything about external state -- e.g. the listeners will
+            // be called.
+            // The generation is only used for isAlive() and entities work as weak references --
+            // it just means that isAlive() could return true a little longer than expected in some
+            // other threads. recycleIndices() sees the new generation thanks to the memory fence
+            // provided by the freeList.lock.unlock() below.
+            Entity::Type index = getIndex(entities[i]);
+            uint8_t generation = uint8_t(getGeneration(entities[i]));
+            std::atomic<uint8_t>* const gens =
+                    mGens[index >> GENERATION_PAGE_SHIFT].load(std::memory_order_relaxed);
+            if (UTILS_UNLIKELY(gens == sUnusedGenerations)) {
+                // this index was never handed out, so this isn't one of our entities
+                continue;
+            }
+            if (gens[index & GENERATION_PAGE_MASK].compare_exchange_strong(generation,
+                    uint8_t(generation + 1), std::memory_order_relaxed)) {
+                freeList.indices.push_back(index);
+                count++;
             }
         }
         lock.unlock();
+        mFreeIndexCount.fetch_add(count, std::memory_order_relaxed);
 
         // notify our listeners that some entities are being destroyed
         auto listeners = getListeners();
@@ -136,11 +153,77 @@ public:
     }
 
 private:
-    uint32_t mCurrentIndex = 1;
+    struct FreeList {
+        Mutex lock;
+        std::deque<Entity::Type> indices;
+    };
+
+    // the generation of an index, only valid for indices that have been handed out.
+    std::atomic<uint8_t>& generationOf(Entity::Type index) noexcept {
+        return mGens[index >> GENERATION_PAGE_SHIFT].load(std::memory_order_relaxed)
+                [index & GENERATION_PAGE_MASK];
+    }
+
+    // returns the generation page, allocating it if needed. Thread safe.
+    std::atomic<uint8_t>* getGenerationPage(size_t page) noexcept;
+
+    // Each thread always uses the same free-list, which it picks the first time it needs one.
+    static size_t getFreeListIndex() noexcept;
+
+    // Hands out up to n never used indices, returns how many. Lock-free, except when a new
+    // generation page is needed.
+    size_t allocateIndices(size_t n, Entity* entities) noexcept {
+        Entity::Type first = mCurrentIndex.load(std::memory_order_relaxed);
+        size_t count;
+        do {
+            count = std::min(n, RAW_INDEX_COUNT - std::min(size_t(first), size_t(RAW_INDEX_COUNT)));
+            if (!count) {
+                return 0;
+            }
+        } while (!mCurrentIndex.compare_exchange_weak(first, Entity::Type(first + count),
+                std::memory_order_relaxed));
+
+        // make sure the generations of these indices exist before handing them out; a brand
+        // new index is always at generation 0.
+        const Entity::Type last = Entity::Type(first + count - 1);
+        for (size_t page = first >> GENERATION_PAGE_SHIFT;
+                page <= (last >> GENERATION_PAGE_SHIFT); page++) {
+            getGenerationPage(page);
+        }
+        for (size_t i = 0; i < count; i++) {
+            entities[i] = Entity{ makeIdentity(0, Entity::Type(first + i)) };
+        }
+        return count;
+    }
+
+    // Recycles up to n indices from the free-lists, starting with this thread's. Returns how many.
+    size_t recycleIndices(size_t n, Entity* entities) noexcept {
+        const size_t start = getFreeListIndex();
+        size_t count = 0;
+        for (size_t k = 0; k < FREE_LIST_COUNT && count < n; k++) {
+            FreeList& freeList = mFreeLists[(start + k) % FREE_LIST_COUNT];
+            std::lock_guard<Mutex> lock(freeList.lock);
+            auto& indices = freeList.indices;
+            while (count < n && !indices.empty()) {
+                Entity::Type index = indices.front();
+                indices.pop_front();
+                entities[count++] = Entity{ makeIdentity(
+                        generationOf(index).load(std::memory_order_relaxed), index) };
+            }
+        }
+        mFreeIndexCount.fetch_sub(count, std::memory_order_relaxed);
+        return count;
+    }
+
+    // index 0 is reserved for the null entity
+    std::atomic<Entity::Type> mCurrentIndex = { 1 };
 
     // stores indices that got freed
-    mutable Mutex mFreeListLock;
-    std::deque<Entity::Type> mFreeList;
+    FreeList mFreeLists[FREE_LIST_COUNT];
+    std::atomic<size_t> mFreeIndexCount = { 0 };
+
+    // protects the allocation of generation pages
+    Mutex mGenerationPageLock;
 
     mutable Mutex mListenerLock;
     tsl::robin_set<Listener*> mListeners;
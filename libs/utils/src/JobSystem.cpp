@@ -23,7 +23,11 @@
 
 #include <utils/JobSystem.h>
 
+#include "CpuTopology.h"
+
+#include <algorithm>
 #include <cmath>
+#include <iterator>
 #include <random>
 
 #include <utils/compiler.h>
@@ -105,17 +109,31 @@ void JobSystem::setThreadAffinityById(size_t id) noexcept {
 #endif
 }
 
-JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreadsCount) noexcept
-    : mJobPool("JobSystem Job pool", MAX_JOB_COUNT * sizeof(Job)),
-      mJobStorageBase(static_cast<Job *>(mJobPool.getAllocator().getCurrent()))
+// the CPUs our threads can run on, closest first
+static std::vector<CpuTopology::Cpu> getPlacementCpus(CpuTopology const& topology,
+        JobSystem::ThreadPlacement placement) noexcept {
+    return placement == JobSystem::ThreadPlacement::CPUS ? topology.getCpus() : topology.getCores();
+}
+
+JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreadsCount,
+        ThreadPlacement placement) noexcept
 {
     SYSTRACE_ENABLE();
 
+    // allocate our first segment of jobs upfront, this is enough for most uses
+    allocateJobSegment(0);
+
+    const CpuTopology topology = CpuTopology::discover();
+    std::vector<CpuTopology::Cpu> const cpus = getPlacementCpus(topology, placement);
+
     int threadPoolCount = userThreadCount;
-    if (threadPoolCount == 0) {
+    if (threadPoolCount == 0 && !cpus.empty()) {
+        // one of the CPUs is left to the user thread
+        threadPoolCount = int(cpus.size()) - 1;
+    } else if (threadPoolCount == 0) {
         // default value, system dependant
         int hwThreads = std::thread::hardware_concurrency();
-        if (UTILS_HAS_HYPER_THREADING) {
+        if (UTILS_HAS_HYPER_THREADING && placement != ThreadPlacement::CPUS) {
             // For now we avoid using HT, this simplifies profiling.
             // TODO: figure-out what to do with Hyper-threading
             // since we assumed HT, always round-up to an even number of cores (to play it safe)
@@ -126,7 +144,7 @@ JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreads
         // one of the thread will be the user thread
         threadPoolCount = hwThreads - 1;
     }
-    threadPoolCount = std::min(UTILS_HAS_THREADING ? 32 : 0, threadPoolCount);
+    threadPoolCount = std::min(UTILS_HAS_THREADING ? int(MAX_THREAD_COUNT) : 0, threadPoolCount);
 
     mThreadStates = aligned_vector<ThreadState>(threadPoolCount + adoptableThreadsCount);
     mThreadCount = uint16_t(threadPoolCount);
@@ -135,6 +153,7 @@ JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreads
     // this is a pity these are not compile-time checks (C++17 supports it apparently)
     assert(mExitRequested.is_lock_free());
     assert(Job().runningJobCount.is_lock_free());
+    static_assert(sizeof(Job) % CACHELINE_SIZE == 0, "Job doesn't align to a cache line");
 
     std::random_device rd;
     const size_t hardwareThreadCount = mThreadCount;
@@ -146,13 +165,55 @@ JobSystem::JobSystem(const size_t userThreadCount, const size_t adoptableThreads
         state.rndGen = default_random_engine(rd());
         state.id = (uint32_t)i;
         state.js = this;
+        state.priority = PRIORITY_CRITICAL;
+        state.cpu = -1;
+        state.stealRing = 0;
+        std::fill(std::begin(state.stealRingEnd), std::end(state.stealRingEnd), 0);
         if (i < hardwareThreadCount) {
+            initThreadPlacement(state, placement, topology);
             // don't start a thread of adoptable thread slots
             state.thread = std::thread(&JobSystem::loop, this, &state);
         }
     }
 }
 
+void JobSystem::initThreadPlacement(ThreadState& state, ThreadPlacement placement,
+        CpuTopology const& topology) noexcept {
+    std::vector<CpuTopology::Cpu> const cpus = getPlacementCpus(topology, placement);
+    const size_t threadCount = mThreadCount;
+    const size_t id = state.id;
+
+    if (cpus.empty()) {
+        // we don't know the topology, just assume thread i can run on CPU i
+        if (placement != ThreadPlacement::UNPINNED) {
+            state.cpu = int16_t(id);
+        }
+    } else if (placement != ThreadPlacement::UNPINNED) {
+        // the first CPU is left to the user thread (and whatever else the OS runs there)
+        state.cpu = int16_t(cpus[(id + 1) % cpus.size()].id);
+    }
+
+    // Sort the other threads of the pool by distance to us. Threads we don't know the location
+    // of are considered remote.
+    auto getDistance = [&](size_t other) -> size_t {
+        if (cpus.empty() || placement == ThreadPlacement::UNPINNED || state.cpu < 0) {
+            return CpuTopology::REMOTE;
+        }
+        return CpuTopology::getDistance(
+                cpus[(id + 1) % cpus.size()], cpus[(other + 1) % cpus.size()]);
+    };
+
+    size_t count = 0;
+    for (size_t distance = 0; distance < STEAL_RING_COUNT; distance++) {
+        for (size_t other = 0; other < threadCount; other++) {
+            if (other != id && getDistance(other) == distance) {
+                state.stealOrder[count++] = uint8_t(other);
+            }
+        }
+        state.stealRingEnd[distance] = uint8_t(count);
+    }
+}
+
 JobSystem::~JobSystem() {
     requestExit();
 
@@ -163,12 +224,18 @@ JobSystem::~JobSystem() {
             state.thread.join();
         }
     }
+
+    for (size_t i = 0, c = mJobSegmentCount.load(std::memory_order_relaxed); i < c; i++) {
+        utils::aligned_free(mJobSegments[i].jobs);
+    }
 }
 
 inline void JobSystem::incRef(Job const* job) noexcept {
     // no action is taken when incrementing the reference counter, therefore we can safely use
     // memory_order_relaxed.
-    job->refCount.fetch_add(1, std::memory_order_relaxed);
+    UTILS_UNUSED_IN_RELEASE
+    auto c = job->refCount.fetch_add(1, std::memory_order_relaxed);
+    assert(c < MAX_RUNNING_JOB_COUNT);
 }
 
 UTILS_NOINLINE
@@ -186,7 +253,7 @@ void JobSystem::decRef(Job const* job) noexcept {
     assert(c > 0);
     if (c == 1) {
         // This was the last reference, it's safe to destroy the job.
-        mJobPool.destroy(job);
+        destroyJob(job);
     }
 }
 
@@ -208,7 +275,23 @@ inline bool JobSystem::exitRequested() const noexcept {
 }
 
 inline bool JobSystem::hasActiveJobs() const noexcept {
-    return mActiveJobs.load(std::memory_order_relaxed) > 0;
+    return hasActiveJobs(PRIORITY_CRITICAL) || hasActiveJobs(PRIORITY_BACKGROUND);
+}
+
+inline bool JobSystem::hasActiveJobs(JobPriority priority) const noexcept {
+    return mActiveJobs[priority].load(std::memory_order_relaxed) > 0;
+}
+
+inline bool JobSystem::hasRunnableJobs(JobPriority lowest) const noexcept {
+    return lowest == PRIORITY_BACKGROUND ? hasActiveJobs() : hasActiveJobs(PRIORITY_CRITICAL);
+}
+
+inline JobSystem::JobPriority JobSystem::getWaiterPriority(
+        JobSystem::ThreadState const& state) const noexcept {
+    // A thread waiting for a job only helps with jobs of its own priority, so that e.g. a frame
+    // doesn't wait for a background job it picked up. Background jobs are left to the idle loop
+    // of the pool threads, unless there are none.
+    return mThreadCount ? state.priority : PRIORITY_BACKGROUND;
 }
 
 inline bool JobSystem::hasJobCompleted(JobSystem::Job const* job) noexcept {
@@ -236,7 +319,52 @@ inline JobSystem::ThreadState& JobSystem::getState() noexcept {
 }
 
 JobSystem::Job* JobSystem::allocateJob() noexcept {
-    return mJobPool.make<Job>();
+    const size_t segmentCount = mJobSegmentCount.load(std::memory_order_acquire);
+    for (size_t i = 0; i < segmentCount; i++) {
+        void* const p = mJobSegments[i].freeList.pop();
+        if (UTILS_LIKELY(p)) {
+            return new(p) Job;
+        }
+    }
+    // all our jobs are in use, we need a new segment
+    return allocateJobSegment(segmentCount);
+}
+
+UTILS_NOINLINE
+JobSystem::Job* JobSystem::allocateJobSegment(size_t segmentCount) noexcept {
+    SYSTRACE_CALL();
+    std::lock_guard<Mutex> lock(mJobSegmentLock);
+    size_t const currentSegmentCount = mJobSegmentCount.load(std::memory_order_relaxed);
+    if (currentSegmentCount == segmentCount) {
+        if (UTILS_UNLIKELY(segmentCount == MAX_JOB_SEGMENT_COUNT)) {
+            return nullptr;
+        }
+        JobSegment& segment = mJobSegments[segmentCount];
+        segment.jobs = static_cast<Job*>(
+                utils::aligned_alloc(JOB_SEGMENT_SIZE * sizeof(Job), alignof(Job)));
+        if (UTILS_UNLIKELY(!segment.jobs)) {
+            return nullptr;
+        }
+        new(&segment.freeList) AtomicFreeList(segment.jobs, segment.jobs + JOB_SEGMENT_SIZE,
+                sizeof(Job), alignof(Job), 0);
+        // publishes the new segment to other threads
+        mJobSegmentCount.store(uint32_t(segmentCount + 1), std::memory_order_release);
+    }
+    // another thread may have allocated a segment, or freed some jobs, while we were waiting
+    // for the lock, try again.
+    for (size_t i = 0, c = mJobSegmentCount.load(std::memory_order_relaxed); i < c; i++) {
+        void* const p = mJobSegments[i].freeList.pop();
+        if (p) {
+            return new(p) Job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::destroyJob(Job const* job) noexcept {
+    const uint32_t index = getJobIndex(job);
+    job->~Job();
+    mJobSegments[index >> JOB_SEGMENT_SHIFT].freeList.push(const_cast<Job*>(job));
 }
 
 inline JobSystem::ThreadState* JobSystem::getStateToStealFrom(JobSystem::ThreadState& state) noexcept {
@@ -249,7 +377,20 @@ inline JobSystem::ThreadState* JobSystem::getStateToStealFrom(JobSystem::ThreadS
     JobSystem::ThreadState* stateToStealFrom = nullptr;
 
     // don't try to steal from someone else if we're the only thread (infinite loop)
-    if (threadCount >= 2) {
+    if (threadCount >= 2 && state.id < mThreadCount) {
+        // We're a thread of the pool, each attempt widens the set of candidates, from threads
+        // sharing our core to all threads. Adopted threads are always candidates because we
+        // don't know where they run, and they are typically the ones producing the jobs.
+        size_t ringEnd;
+        do {
+            ringEnd = state.stealRingEnd[state.stealRing];
+            state.stealRing = uint8_t((state.stealRing + 1) % STEAL_RING_COUNT);
+        } while (ringEnd + adopted == 0);
+        size_t const index = state.rndGen() % (ringEnd + adopted);
+        stateToStealFrom = index < ringEnd ?
+                &threadStates[state.stealOrder[index]] :
+                &threadStates[mThreadCount + (index - ringEnd)];
+    } else if (threadCount >= 2) {
         do {
             // this is biased, but frankly, we don't care. it's fast.
             uint16_t index = uint16_t(state.rndGen() % threadCount);
@@ -261,39 +402,79 @@ inline JobSystem::ThreadState* JobSystem::getStateToStealFrom(JobSystem::ThreadS
     return stateToStealFrom;
 }
 
-JobSystem::Job* JobSystem::steal(JobSystem::ThreadState& state) noexcept {
+JobSystem::Job* JobSystem::steal(JobPriority priority,
+        JobSystem::ThreadState* stateToStealFrom) noexcept {
+    Job* job = nullptr;
+    if (UTILS_LIKELY(stateToStealFrom)) {
+        job = steal(stateToStealFrom->workQueues[priority]);
+    }
+    if (UTILS_UNLIKELY(!job)) {
+        job = steal(mOverflowQueues[priority]);
+    }
+    return job;
+}
+
+JobSystem::Job* JobSystem::steal(JobSystem::ThreadState& state, JobPriority lowest,
+        JobPriority* priority) noexcept {
     HEAVY_SYSTRACE_CALL();
     Job* job = nullptr;
     do {
         ThreadState* const stateToStealFrom = getStateToStealFrom(state);
-        if (UTILS_LIKELY(stateToStealFrom)) {
-            job = steal(stateToStealFrom->workQueue);
+
+        // critical jobs are always preferred, from any queue
+        if (hasActiveJobs(PRIORITY_CRITICAL)) {
+            *priority = PRIORITY_CRITICAL;
+            job = steal(PRIORITY_CRITICAL, stateToStealFrom);
+            if (job) {
+                // start from the closest threads next time
+                state.stealRing = 0;
+                break;
+            }
         }
+
+        // then our own background jobs, then anyone's
+        if (lowest == PRIORITY_BACKGROUND && hasActiveJobs(PRIORITY_BACKGROUND)) {
+            *priority = PRIORITY_BACKGROUND;
+            job = pop(state.workQueues[PRIORITY_BACKGROUND]);
+            if (!job) {
+                job = steal(PRIORITY_BACKGROUND, stateToStealFrom);
+                if (job) {
+                    state.stealRing = 0;
+                }
+            }
+        }
+
         // nullptr -> nothing to steal in that queue either, if there are active jobs,
         // continue to try stealing one.
-    } while (!job && hasActiveJobs());
+    } while (!job && hasRunnableJobs(lowest));
     return job;
 }
 
-bool JobSystem::execute(JobSystem::ThreadState& state) noexcept {
+bool JobSystem::execute(JobSystem::ThreadState& state, JobPriority lowest) noexcept {
     HEAVY_SYSTRACE_CALL();
 
-    Job* job = pop(state.workQueue);
+    JobPriority priority = PRIORITY_CRITICAL;
+    Job* job = pop(state.workQueues[PRIORITY_CRITICAL]);
     if (UTILS_UNLIKELY(job == nullptr)) {
         // our queue is empty, try to steal a job
-        job = steal(state);
+        job = steal(state, lowest, &priority);
     }
 
     if (job) {
         UTILS_UNUSED_IN_RELEASE
-        uint32_t activeJobs = mActiveJobs.fetch_sub(1, std::memory_order_relaxed);
+        uint32_t activeJobs = mActiveJobs[priority].fetch_sub(1, std::memory_order_relaxed);
         assert(activeJobs); // whoops, we were already at 0
         HEAVY_SYSTRACE_VALUE32("JobSystem::activeJobs", activeJobs - 1);
 
+        // jobs run from this job inherit its priority. execute() can be nested (e.g. in
+        // waitAndRelease()) so we need to restore the previous priority.
+        const JobPriority previousPriority = state.priority;
+        state.priority = priority;
         if (UTILS_LIKELY(job->function)) {
             HEAVY_SYSTRACE_NAME("job->function");
             job->function(job->storage, *this, job);
         }
+        state.priority = previousPriority;
         finish(job);
     }
     return job != nullptr;
@@ -305,18 +486,22 @@ void JobSystem::loop(ThreadState* state) noexcept {
 
     // set a CPU affinity on each of our JobSystem thread to prevent them from jumping from core
     // to core. On Android, it looks like the affinity needs to be reset from time to time.
-    setThreadAffinityById(state->id);
+    if (state->cpu >= 0) {
+        setThreadAffinityById(size_t(state->cpu));
+    }
 
     // record our work queue to thread-local storage
     sThreadState = state;
 
     // run our main loop...
     do {
-        if (!execute(*state)) {
+        if (!execute(*state, PRIORITY_BACKGROUND)) {
             std::unique_lock<Mutex> lock(mWaiterLock);
             while (!exitRequested() && !hasActiveJobs()) {
                 wait(lock);
-                setThreadAffinityById(state->id);
+                if (state->cpu >= 0) {
+                    setThreadAffinityById(size_t(state->cpu));
+                }
             }
         }
     } while (!exitRequested());
@@ -329,7 +514,6 @@ void JobSystem::finish(Job* job) noexcept {
     bool notify = false;
 
     // terminate this job and notify its parent
-    Job* const storage = mJobStorageBase;
     do {
         // std::memory_order_release here is needed to synchronize with JobSystem::wait()
         // which needs to "see" all changes that happened before the job terminated.
@@ -338,7 +522,7 @@ void JobSystem::finish(Job* job) noexcept {
         if (runningJobCount == 1) {
             // no more work, destroy this job and notify its parent
             notify = true;
-            Job* const parent = job->parent == 0x7FFF ? nullptr : &storage[job->parent];
+            Job* const parent = job->parent == NO_PARENT ? nullptr : getJob(job->parent);
             decRef(job);
             job = parent;
         } else {
@@ -353,6 +537,35 @@ void JobSystem::finish(Job* job) noexcept {
     }
 }
 
+void JobSystem::addChild(Job* parent) noexcept {
+    // add a reference to the parent to make sure it can't be terminated.
+    // memory_order_relaxed is safe because no action is taken at this point
+    // (the job is not started yet).
+    uint16_t count = parent->runningJobCount.load(std::memory_order_relaxed);
+    do {
+        // can't create a child job of a terminated parent
+        assert(count > 0);
+
+        // The counter is full: run jobs from the queues (likely our siblings) until one of the
+        // parent's children finishes. Children that are never run can't make room, so creating
+        // that many children requires running them as they're created, e.g. like parallel_for().
+        while (UTILS_UNLIKELY(count == MAX_RUNNING_JOB_COUNT)) {
+            ThreadState& state = getState();
+            if (!execute(state, getWaiterPriority(state))) {
+                // Nothing is queued, so all but the few children running on other threads were
+                // never run: they can't make room and we would wait forever.
+                ASSERT_POSTCONDITION(hasActiveJobs() ||
+                        parent->runningJobCount.load(std::memory_order_relaxed) < count,
+                        "a job can't have more than %u children that haven't been run",
+                        unsigned(MAX_RUNNING_JOB_COUNT - 1));
+                std::this_thread::yield();
+            }
+            count = parent->runningJobCount.load(std::memory_order_relaxed);
+        }
+    } while (!parent->runningJobCount.compare_exchange_weak(count, uint16_t(count + 1),
+            std::memory_order_relaxed));
+}
+
 // -----------------------------------------------------------------------------------------------
 // public API...
 
@@ -361,21 +574,13 @@ JobSystem::Job* JobSystem::create(JobSystem::Job* parent, JobFunc func) noexcept
     parent = (parent == nullptr) ? mMasterJob : parent;
     Job* const job = allocateJob();
     if (UTILS_LIKELY(job)) {
-        size_t index = 0x7FFF;
+        uint32_t index = NO_PARENT;
         if (parent) {
-            // add a reference to the parent to make sure it can't be terminated.
-            // memory_order_relaxed is safe because no action is taken at this point
-            // (the job is not started yet).
-            auto parentJobCount = parent->runningJobCount.fetch_add(1, std::memory_order_relaxed);
-
-            // can't create a child job of a terminated parent
-            assert(parentJobCount > 0);
-
-            index = parent - mJobStorageBase;
-            assert(index < MAX_JOB_COUNT);
+            addChild(parent);
+            index = getJobIndex(parent);
         }
         job->function = func;
-        job->parent = uint16_t(index);
+        job->parent = index;
     }
     return job;
 }
@@ -408,9 +613,10 @@ void JobSystem::run(JobSystem::Job*& job, uint32_t flags) noexcept {
     // increase the active job count before we add the job to the queue, because otherwise
     // the job could run and finish before the counter is incremented, which would trigger
     // an assert() in execute(). Either way, it's not "wrong", but the assert() is useful.
-    uint32_t activeJobs = mActiveJobs.fetch_add(1, std::memory_order_relaxed);
+    const JobPriority priority = (flags & BACKGROUND) ? PRIORITY_BACKGROUND : state.priority;
+    uint32_t activeJobs = mActiveJobs[priority].fetch_add(1, std::memory_order_relaxed);
 
-    put(state.workQueue, job);
+    put(state.workQueues[priority], mOverflowQueues[priority], job);
 
     HEAVY_SYSTRACE_VALUE32("JobSystem::activeJobs", activeJobs + 1);
 
@@ -438,8 +644,9 @@ void JobSystem::waitAndRelease(Job*& job) noexcept {
     assert(job->refCount.load(std::memory_order_relaxed) >= 1);
 
     ThreadState& state(getState());
+    const JobPriority lowest = getWaiterPriority(state);
     do {
-        if (!execute(state)) {
+        if (!execute(state, lowest)) {
             // test if job has completed first, to possibly avoid taking the lock
             if (hasJobCompleted(job)) {
                 break;
@@ -455,7 +662,7 @@ void JobSystem::waitAndRelease(Job*& job) noexcept {
             // continue to handle more jobs, as they get added.
 
             std::unique_lock<Mutex> lock(mWaiterLock);
-            if (!hasJobCompleted(job) && !hasActiveJobs() && !exitRequested()) {
+            if (!hasJobCompleted(job) && !hasRunnableJobs(lowest) && !exitRequested()) {
                 wait(lock);
             }
         }
@@ -509,7 +716,8 @@ void JobSystem::emancipate() {
 
 io::ostream& operator<<(io::ostream& out, JobSystem const& js) {
     for (auto const& item : js.mThreadStates) {
-        out << size_t(item.id) << ": " << item.workQueue.getCount() << io::endl;
+        out << size_t(item.id) << ": " << item.workQueues[JobSystem::PRIORITY_CRITICAL].getCount()
+                << ", " << item.workQueues[JobSystem::PRIORITY_BACKGROUND].getCount() << io::endl;
     }
     return out;
 }
@@ -17,26 +17,29 @@
 #include <utils/Systrace.h>
 #include <utils/Log.h>
 
-#if defined(ANDROID)
+#if defined(ANDROID) || defined(__linux__)
+
+#include <utils/Mutex.h>
+#include <utils/ThreadLocal.h>
 
+#include <algorithm>
 #include <cinttypes>
+#include <mutex>
+#include <vector>
 
 #include <string.h>
 
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
 
 namespace utils {
 namespace details {
 
-/**
- * Maximum size of a message that can be logged to the trace buffer.
- * Note this message includes a tag, the pid, and the string given as the name.
- * Names should be kept short to get the most use of the trace buffer.
- */
-#define ATRACE_MESSAGE_LENGTH 512
-
 std::atomic_bool Systrace::sIsTracingReady = { false };
 std::atomic<uint32_t> Systrace::sIsTracingEnabled = { 0 };
 bool Systrace::sIsTracingAvailable = false;
@@ -44,6 +47,15 @@ int Systrace::sMarkerFd = -1;
 
 static pthread_once_t atrace_once_control = PTHREAD_ONCE_INIT;
 
+#if defined(ANDROID)
+
+/**
+ * Maximum size of a message that can be logged to the trace buffer.
+ * Note this message includes a tag, the pid, and the string given as the name.
+ * Names should be kept short to get the most use of the trace buffer.
+ */
+#define ATRACE_MESSAGE_LENGTH 512
+
 void Systrace::init_once() noexcept {
     sMarkerFd = open("/sys/kernel/debug/tracing/trace_marker", O_WRONLY | O_CLOEXEC);
     if (UTILS_UNLIKELY(sMarkerFd == -1)) {
@@ -54,33 +66,6 @@ void Systrace::init_once() noexcept {
     std::atomic_store_explicit(&sIsTracingReady, true, std::memory_order_release);
 }
 
-void Systrace::setup() noexcept {
-    pthread_once(&atrace_once_control, init_once);
-}
-
-void Systrace::enable(uint32_t tags) noexcept {
-    init();
-    if (UTILS_LIKELY(sIsTracingAvailable)) {
-        sIsTracingEnabled.fetch_or(tags, std::memory_order_relaxed);
-    }
-}
-
-void Systrace::disable(uint32_t tags) noexcept {
-    sIsTracingEnabled.fetch_and(~tags, std::memory_order_relaxed);
-}
-
-// unfortunately, this generates quite a bit of code because reading a global is not
-// trivial. For this reason, we do not inline this method.
-bool Systrace::isTracingEnabled(uint32_t tag) noexcept {
-    if (tag) {
-        init();
-        return bool((sIsTracingEnabled.load(std::memory_order_relaxed) | SYSTRACE_TAG_ALWAYS) & tag);
-    }
-    return false;
-}
-
-// ------------------------------------------------------------------------------------------------
-
 void Systrace::begin_body(int fd, int pid, const char* name) noexcept {
     char buf[ATRACE_MESSAGE_LENGTH];
 
@@ -123,6 +108,243 @@ void Systrace::int64_body(int fd, int pid, const char* name, int64_t value) noex
     WRITE_MSG("C|%d|", "|%" PRId64, pid, name, value);
 }
 
+#else // !ANDROID
+
+/*
+ * Events are recorded in a fixed-size ring buffer per thread, which only its thread writes to.
+ * When a buffer is full, the oldest events are overwritten. Buffers are never freed, so that
+ * events from threads that have exited can still be dumped.
+ */
+
+struct alignas(64) TraceEvent {
+    uint64_t timestamp;     // CLOCK_MONOTONIC, in nanoseconds
+    int64_t value;          // value of a counter, or cookie of an async event
+    char type;              // 'B', 'E', 'C', 'b' or 'e', as in the Chrome trace format
+    char name[47];          // names are copied because they're not always literals
+};
+
+static_assert(sizeof(TraceEvent) == 64, "TraceEvent should be one cache line");
+
+struct TraceBuffer {
+    static constexpr size_t EVENT_COUNT = 16384;    // 1 MiB per thread
+    std::atomic<uint64_t> head = { 0 };             // number of events ever recorded
+    pid_t tid = 0;
+    char threadName[16] = {};
+    TraceEvent events[EVENT_COUNT];
+};
+
+// these are never destroyed, so they're still usable while the process exits
+static Mutex& getTraceBuffersLock() noexcept {
+    static Mutex* lock = new Mutex;
+    return *lock;
+}
+
+static std::vector<TraceBuffer*>& getTraceBuffers() noexcept {
+    static std::vector<TraceBuffer*>* buffers = new std::vector<TraceBuffer*>;
+    return *buffers;
+}
+
+static UTILS_DEFINE_TLS(TraceBuffer*) sTraceBuffer(nullptr);
+
+static const char* sTraceOutputPath = nullptr;
+
+UTILS_NOINLINE
+static TraceBuffer* createTraceBuffer() noexcept {
+    TraceBuffer* const buffer = new TraceBuffer;
+    buffer->tid = pid_t(syscall(SYS_gettid));
+    pthread_getname_np(pthread_self(), buffer->threadName, sizeof(buffer->threadName));
+    std::lock_guard<Mutex> lock(getTraceBuffersLock());
+    getTraceBuffers().push_back(buffer);
+    return buffer;
+}
+
+static void record(char type, const char* name, int64_t value) noexcept {
+    TraceBuffer* buffer = sTraceBuffer;
+    if (UTILS_UNLIKELY(!buffer)) {
+        sTraceBuffer = buffer = createTraceBuffer();
+    }
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[head % TraceBuffer::EVENT_COUNT];
+    event.timestamp = uint64_t(now.tv_sec) * 1000000000u + uint64_t(now.tv_nsec);
+    event.value = value;
+    event.type = type;
+    if (name) {
+        strncpy(event.name, name, sizeof(event.name) - 1);
+        event.name[sizeof(event.name) - 1] = 0;
+    } else {
+        event.name[0] = 0;
+    }
+    // publishes the event to dumpChromeTrace()
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+static void writeJsonString(FILE* file, const char* str) noexcept {
+    fputc('"', file);
+    for (const char* p = str; *p; p++) {
+        const unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            fputc('\\', file);
+            fputc(c, file);
+        } else if (c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static void dumpAtExit() noexcept {
+    Systrace::dumpChromeTrace(sTraceOutputPath);
+}
+
+void Systrace::init_once() noexcept {
+    // recording is opt-in because it's not free, even though it's cheap
+    const char* path = getenv("FILAMENT_SYSTRACE");
+    if (path) {
+        sIsTracingAvailable = true;
+        if (*path) {
+            sTraceOutputPath = strdup(path);
+            atexit(dumpAtExit);
+        }
+    }
+    std::atomic_store_explicit(&sIsTracingReady, true, std::memory_order_release);
+}
+
+bool Systrace::dumpChromeTrace(const char* path) noexcept {
+    std::vector<TraceBuffer*> buffers;
+    {
+        std::lock_guard<Mutex> lock(getTraceBuffersLock());
+        buffers = getTraceBuffers();
+    }
+
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        slog.e << "Error opening trace file " << path << ": " << strerror(errno) << io::endl;
+        return false;
+    }
+
+    const int pid = getpid();
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    std::vector<TraceEvent> events;
+    for (TraceBuffer const* buffer : buffers) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                "\"args\":{\"name\":", first ? "" : ",\n", pid, buffer->tid);
+        writeJsonString(file, buffer->threadName);
+        fprintf(file, "}}");
+        first = false;
+
+        // Dumping is only meant to happen while the traced threads are quiescent, e.g. at exit,
+        // since copying events that are being written is a data race. As a best effort when
+        // that's not the case, we discard the oldest events we copied if they could have been
+        // overwritten meanwhile. This includes the slot of event `head`, which record() fills
+        // before publishing it, hence the + 1 below.
+        const uint64_t end = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = end - std::min<uint64_t>(end, TraceBuffer::EVENT_COUNT);
+        events.clear();
+        for (uint64_t i = begin; i < end; i++) {
+            events.push_back(buffer->events[i % TraceBuffer::EVENT_COUNT]);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+        const uint64_t overwritten =
+                head + 1 - std::min<uint64_t>(head + 1, TraceBuffer::EVENT_COUNT);
+        const size_t skip = size_t(std::min<uint64_t>(end, std::max(begin, overwritten)) - begin);
+
+        int depth = 0;
+        for (size_t i = skip; i < events.size(); i++) {
+            TraceEvent const& event = events[i];
+            if (event.type == 'B') {
+                depth++;
+            } else if (event.type == 'E') {
+                // the beginning of this scope was overwritten
+                if (depth == 0) {
+                    continue;
+                }
+                depth--;
+            }
+            fprintf(file, ",\n{\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64 ".%03u",
+                    event.type, pid, buffer->tid,
+                    event.timestamp / 1000u, unsigned(event.timestamp % 1000u));
+            if (event.type != 'E') {
+                fprintf(file, ",\"name\":");
+                writeJsonString(file, event.name);
+            }
+            if (event.type == 'C') {
+                fprintf(file, ",\"args\":{\"value\":%" PRId64 "}", event.value);
+            } else if (event.type == 'b' || event.type == 'e') {
+                fprintf(file, ",\"cat\":\"async\",\"id\":%" PRId64, event.value);
+            }
+            fprintf(file, "}");
+        }
+    }
+    fprintf(file, "\n]}\n");
+    const bool success = !ferror(file);
+    fclose(file);
+    return success;
+}
+
+void Systrace::begin_body(int, int, const char* name) noexcept {
+    record('B', name, 0);
+}
+
+void Systrace::end_body(int, int) noexcept {
+    record('E', nullptr, 0);
+}
+
+void Systrace::async_begin_body(int, int, const char* name, int32_t cookie) noexcept {
+    record('b', name, cookie);
+}
+
+void Systrace::async_end_body(int, int, const char* name, int32_t cookie) noexcept {
+    record('e', name, cookie);
+}
+
+void Systrace::int_body(int, int, const char* name, int32_t value) noexcept {
+    record('C', name, value);
+}
+
+void Systrace::int64_body(int, int, const char* name, int64_t value) noexcept {
+    record('C', name, value);
+}
+
+#endif // ANDROID
+
+// ------------------------------------------------------------------------------------------------
+
+void Systrace::setup() noexcept {
+    pthread_once(&atrace_once_control, init_once);
+}
+
+void Systrace::enable(uint32_t tags) noexcept {
+    init();
+    if (UTILS_LIKELY(sIsTracingAvailable)) {
+        sIsTracingEnabled.fetch_or(tags, std::memory_order_relaxed);
+    }
+}
+
+void Systrace::disable(uint32_t tags) noexcept {
+    sIsTracingEnabled.fetch_and(~tags, std::memory_order_relaxed);
+}
+
+// unfortunately, this generates quite a bit of code because reading a global is not
+// trivial. For this reason, we do not inline this method.
+bool Systrace::isTracingEnabled(uint32_t tag) noexcept {
+    if (tag) {
+        init();
+        if (UTILS_UNLIKELY(!sIsTracingAvailable)) {
+            return false;
+        }
+        return bool((sIsTracingEnabled.load(std::memory_order_relaxed) | SYSTRACE_TAG_ALWAYS) & tag);
+    }
+    return false;
+}
+
 // ------------------------------------------------------------------------------------------------
 
 void Systrace::init(uint32_t tag) noexcept {
@@ -138,4 +360,4 @@ void Systrace::init(uint32_t tag) noexcept {
 } // namespace details
 } // namespace utils
 
-#endif // ANDROID
+#endif // ANDROID || __linux__
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utils/architecture.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#   include <cpuid.h>
+#   define UTILS_HAS_CPUID 1
+#else
+#   define UTILS_HAS_CPUID 0
+#endif
+
+namespace utils {
+
+#if UTILS_HAS_CPUID
+
+static uint64_t xgetbv(uint32_t index) noexcept {
+    uint32_t eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return (uint64_t(edx) << 32u) | eax;
+}
+
+static uint32_t detectCpuFeatures() noexcept {
+    uint32_t eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+
+    uint32_t features = 0;
+    if (ecx & bit_SSE4_1) {
+        features |= uint32_t(CpuFeature::SSE4_1);
+    }
+
+    // AVX registers are only usable if the OS saves them on context switches
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) {
+        return features;
+    }
+    uint64_t const xcr0 = xgetbv(0);
+    if ((xcr0 & 0x6u) != 0x6u) {        // XMM and YMM state
+        return features;
+    }
+    features |= uint32_t(CpuFeature::AVX);
+    if (ecx & bit_FMA) {
+        features |= uint32_t(CpuFeature::FMA);
+    }
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        if (ebx & bit_AVX2) {
+            features |= uint32_t(CpuFeature::AVX2);
+        }
+        if ((ebx & bit_AVX512F) && (xcr0 & 0xE6u) == 0xE6u) {   // opmask and ZMM state
+            features |= uint32_t(CpuFeature::AVX512F);
+        }
+    }
+    return features;
+}
+
+#else
+
+static uint32_t detectCpuFeatures() noexcept {
+#if defined(__ARM_NEON)
+    return uint32_t(CpuFeature::NEON);
+#else
+    return 0;
+#endif
+}
+
+#endif
+
+bool hasCpuFeature(CpuFeature feature) noexcept {
+    static const uint32_t sFeatures = detectCpuFeatures();
+    return (sFeatures & uint32_t(feature)) != 0;
+}
+
+} // namespace utils
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../src/CpuTopology.h"
+
+#include <utils/JobSystem.h>
+#include <utils/Path.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+using namespace utils;
+
+class SysfsWriter {
+public:
+    explicit SysfsWriter(Path root) : mRoot(std::move(root)) { }
+
+    ~SysfsWriter() {
+        for (Path& file : mFiles) {
+            file.unlinkFile();
+        }
+    }
+
+    void write(const char* name, const char* content) {
+        Path const path = mRoot.concat(name);
+        path.getParent().mkdirRecursive();
+        FILE* f = ::fopen(path.c_str(), "w");
+        ASSERT_NE(nullptr, f);
+        ::fprintf(f, "%s\n", content);
+        ::fclose(f);
+        mFiles.push_back(path);
+    }
+
+    std::string getRoot() const { return mRoot.getPath(); }
+
+private:
+    Path mRoot;
+    std::vector<Path> mFiles;
+};
+
+TEST(CpuTopologyTest, ParseCpuList) {
+    EXPECT_EQ(std::vector<uint16_t>({ 0 }), CpuTopology::parseCpuList("0"));
+    EXPECT_EQ(std::vector<uint16_t>({ 0, 1, 2, 3 }), CpuTopology::parseCpuList("0-3\n"));
+    EXPECT_EQ(std::vector<uint16_t>({ 0, 1, 4, 6, 7 }), CpuTopology::parseCpuList("0-1,4,6-7"));
+    EXPECT_TRUE(CpuTopology::parseCpuList("").empty());
+    EXPECT_TRUE(CpuTopology::parseCpuList("\n").empty());
+}
+
+TEST(CpuTopologyTest, TwoSockets) {
+    // 2 packages of 2 cores with 2 SMT threads each, one L3 and NUMA node per package.
+    // As is common on x86, the SMT siblings of CPUs 0-3 are CPUs 4-7.
+    SysfsWriter sysfs(Path::getTemporaryDirectory().concat("test_CpuTopology"));
+    sysfs.write("cpu/online", "0-7");
+    sysfs.write("node/online", "0-1");
+    sysfs.write("node/node0/cpulist", "0-1,4-5");
+    sysfs.write("node/node1/cpulist", "2-3,6-7");
+    for (int cpu = 0; cpu < 8; cpu++) {
+        const int package = (cpu / 2) % 2;
+        const std::string dir = "cpu/cpu" + std::to_string(cpu);
+        const std::string core = std::to_string(cpu % 2);
+        const std::string l1 = std::to_string(cpu % 4) + "," + std::to_string(cpu % 4 + 4);
+        const std::string l3 = package ? "2-3,6-7" : "0-1,4-5";
+        sysfs.write((dir + "/topology/physical_package_id").c_str(), package ? "1" : "0");
+        sysfs.write((dir + "/topology/core_id").c_str(), core.c_str());
+        sysfs.write((dir + "/cache/index0/level").c_str(), "1");
+        sysfs.write((dir + "/cache/index0/type").c_str(), "Data");
+        sysfs.write((dir + "/cache/index0/shared_cpu_list").c_str(), l1.c_str());
+        sysfs.write((dir + "/cache/index1/level").c_str(), "1");
+        sysfs.write((dir + "/cache/index1/type").c_str(), "Instruction");
+        sysfs.write((dir + "/cache/index1/shared_cpu_list").c_str(), l1.c_str());
+        sysfs.write((dir + "/cache/index2/level").c_str(), "3");
+        sysfs.write((dir + "/cache/index2/type").c_str(), "Unified");
+        sysfs.write((dir + "/cache/index2/shared_cpu_list").c_str(), l3.c_str());
+    }
+
+    CpuTopology const topology = CpuTopology::fromSysfs(sysfs.getRoot().c_str());
+    ASSERT_EQ(8, topology.getCpus().size());
+    EXPECT_EQ(4, topology.getCoreCount());
+
+    // close CPUs are next to each other
+    std::vector<uint16_t> ids;
+    for (auto const& cpu : topology.getCpus()) {
+        ids.push_back(cpu.id);
+    }
+    EXPECT_EQ(std::vector<uint16_t>({ 0, 4, 1, 5, 2, 6, 3, 7 }), ids);
+
+    auto const& cpus = topology.getCpus();
+    EXPECT_EQ(CpuTopology::SAME_CORE, CpuTopology::getDistance(cpus[0], cpus[1]));
+    EXPECT_EQ(CpuTopology::SAME_CACHE, CpuTopology::getDistance(cpus[0], cpus[2]));
+    EXPECT_EQ(CpuTopology::REMOTE, CpuTopology::getDistance(cpus[0], cpus[4]));
+    EXPECT_EQ(0, cpus[3].node);
+    EXPECT_EQ(1, cpus[4].node);
+
+    std::vector<CpuTopology::Cpu> const cores = topology.getCores();
+    ASSERT_EQ(4, cores.size());
+    EXPECT_EQ(0, cores[0].id);
+    EXPECT_EQ(1, cores[1].id);
+    EXPECT_EQ(2, cores[2].id);
+    EXPECT_EQ(3, cores[3].id);
+}
+
+TEST(CpuTopologyTest, MissingSysfs) {
+    CpuTopology const topology = CpuTopology::fromSysfs("/this/path/does/not/exist");
+    EXPECT_TRUE(topology.empty());
+    EXPECT_EQ(0, topology.getCoreCount());
+}
+
+TEST(CpuTopologyTest, JobSystemPlacements) {
+    const JobSystem::ThreadPlacement placements[] = {
+            JobSystem::ThreadPlacement::CORES,
+            JobSystem::ThreadPlacement::CPUS,
+            JobSystem::ThreadPlacement::UNPINNED };
+
+    for (auto placement : placements) {
+        JobSystem js(0, 1, placement);
+        js.adopt();
+
+        std::atomic_int calls = { 0 };
+        JobSystem::Job* root = js.createJob();
+        for (int i = 0; i < 1024; i++) {
+            js.run(js.createJob(root, [&calls](JobSystem&, JobSystem::Job*) {
+                calls++;
+            }), JobSystem::DONT_SIGNAL);
+        }
+        js.runAndWait(root);
+        EXPECT_EQ(1024, calls.load());
+
+        js.emancipate();
+    }
+}
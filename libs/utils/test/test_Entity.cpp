@@ -17,9 +17,12 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "../src/EntityManagerImpl.h"
 #include <utils/NameComponentManager.h>
+#include <utils/SingleInstanceComponentManager.h>
 
 using namespace utils;
 
@@ -129,6 +132,107 @@ TEST(EntityTest, Lots) {
 }
 
 
+TEST(EntityTest, MultiThreaded) {
+    EntityManagerImpl em;
+
+    // several threads creating and destroying millions of entities, while keeping a good number
+    // of them alive, forces indices to be recycled across threads.
+    constexpr size_t THREAD_COUNT = 4;
+    constexpr size_t BATCH_SIZE = 4096;
+    constexpr size_t ROUND_COUNT = 256;
+    constexpr size_t ALIVE_BATCH_COUNT = 16;
+
+    std::vector<std::thread> threads;
+    std::vector<std::vector<Entity>> alive(THREAD_COUNT);
+    for (size_t t = 0; t < THREAD_COUNT; t++) {
+        threads.emplace_back([&em, &alive = alive[t]]() {
+            std::vector<Entity> batch(BATCH_SIZE);
+            for (size_t r = 0; r < ROUND_COUNT; r++) {
+                em.create(BATCH_SIZE, batch.data());
+                for (Entity e : batch) {
+                    ASSERT_FALSE(e.isNull());
+                    ASSERT_TRUE(em.isAlive(e));
+                }
+                if (r % (ROUND_COUNT / ALIVE_BATCH_COUNT) == 0) {
+                    alive.insert(alive.end(), batch.begin(), batch.end());
+                    continue;
+                }
+                // note: we can't check that the destroyed entities are dead here, since their
+                // indices can be recycled by other threads right away.
+                em.destroy(BATCH_SIZE, batch.data());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // the entities that were kept alive must all be alive and distinct
+    std::vector<bool> used(EntityManager::getMaxEntityCount() + 1);
+    for (auto& entities : alive) {
+        EXPECT_EQ(ALIVE_BATCH_COUNT * BATCH_SIZE, entities.size());
+        for (Entity e : entities) {
+            EXPECT_TRUE(em.isAlive(e));
+            EXPECT_FALSE(used[EntityManagerImpl::getIndex(e)]);
+            used[EntityManagerImpl::getIndex(e)] = true;
+        }
+        em.destroy(entities.size(), entities.data());
+    }
+}
+
+TEST(EntityTest, ConcurrentDestroy) {
+    EntityManagerImpl em;
+
+    // two threads destroying the same entities at the same time must return each index to the
+    // free-lists only once, otherwise it would be handed out twice below.
+    constexpr size_t ENTITY_COUNT = 65536;
+    constexpr size_t ROUND_COUNT = 16;
+
+    std::vector<Entity> entities(ENTITY_COUNT);
+    for (size_t r = 0; r < ROUND_COUNT; r++) {
+        em.create(ENTITY_COUNT, entities.data());
+
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < 2; t++) {
+            threads.emplace_back([&em, &entities]() {
+                for (Entity& e : entities) {
+                    em.destroy(e);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (Entity e : entities) {
+            EXPECT_FALSE(em.isAlive(e));
+        }
+
+        // every destroyed index is recycled at most once, so all the new entities are distinct
+        std::vector<Entity> created(2 * ENTITY_COUNT);
+        em.create(created.size(), created.data());
+        std::vector<bool> used(EntityManager::getMaxEntityCount() + 1);
+        for (Entity e : created) {
+            ASSERT_FALSE(e.isNull());
+            ASSERT_FALSE(used[EntityManagerImpl::getIndex(e)]);
+            used[EntityManagerImpl::getIndex(e)] = true;
+        }
+        em.destroy(created.size(), created.data());
+    }
+}
+
+TEST(EntityTest, DestroyUnused) {
+    EntityManagerImpl em;
+
+    // destroying an index that was never handed out leaves the shared unused page alone
+    const uint32_t index = uint32_t(EntityManager::getMaxEntityCount());
+    Entity e = Entity::import(int32_t(EntityManagerImpl::makeIdentity(0, index)));
+    em.destroy(e);
+    for (auto const& generation : EntityManagerImpl::sUnusedGenerations) {
+        EXPECT_EQ(0, generation.load());
+    }
+}
+
 TEST(EntityTest, NameComponent) {
 
     EntityManagerImpl em;
@@ -176,3 +280,100 @@ TEST(EntityTest, NameComponent) {
 
     cm.gc(em);
 }
+
+namespace {
+struct TestComponentManager : public SingleInstanceComponentManager<int> {
+    explicit TestComponentManager(Lookup lookup) noexcept
+            : SingleInstanceComponentManager<int>(lookup) { }
+};
+} // anonymous namespace
+
+static constexpr TestComponentManager::Lookup LOOKUPS[] = {
+        TestComponentManager::Lookup::HASH_MAP,
+        TestComponentManager::Lookup::SPARSE_SET
+};
+
+TEST(EntityTest, LookupAddRemove) {
+    for (auto lookup : LOOKUPS) {
+        EntityManagerImpl em;
+        TestComponentManager cm(lookup);
+
+        // span several pages of the sparse set
+        constexpr size_t COUNT = 10000;
+        std::unique_ptr<Entity[]> entities(new Entity[COUNT]);
+        em.create(COUNT, entities.get());
+
+        for (size_t i = 0; i < COUNT; i += 2) {
+            auto ci = cm.addComponent(entities[i]);
+            cm.elementAt<0>(ci) = int(i);
+        }
+        EXPECT_EQ(COUNT / 2, cm.getComponentCount());
+
+        for (size_t i = 0; i < COUNT; i++) {
+            auto ci = cm.getInstance(entities[i]);
+            if (i % 2) {
+                EXPECT_EQ(0, ci);
+            } else {
+                ASSERT_NE(0, ci);
+                EXPECT_EQ(int(i), cm.elementAt<0>(ci));
+                EXPECT_EQ(entities[i], cm.getEntity(ci));
+            }
+        }
+
+        // removing moves the last component, make sure its lookup follows
+        for (size_t i = 0; i < COUNT; i += 4) {
+            cm.removeComponent(entities[i]);
+        }
+        for (size_t i = 0; i < COUNT; i += 2) {
+            auto ci = cm.getInstance(entities[i]);
+            if (i % 4 == 0) {
+                EXPECT_EQ(0, ci);
+            } else {
+                ASSERT_NE(0, ci);
+                EXPECT_EQ(int(i), cm.elementAt<0>(ci));
+            }
+        }
+
+        EXPECT_EQ(0, cm.getInstance(Entity{}));
+
+        em.destroy(COUNT, entities.get());
+        while (!cm.empty()) {
+            cm.gc(em);
+        }
+    }
+}
+
+TEST(EntityTest, LookupGenerations) {
+    for (auto lookup : LOOKUPS) {
+        EntityManagerImpl em;
+        TestComponentManager cm(lookup);
+
+        // fill the free-list so that the next entity reuses index 1 with a new generation
+        Entity entities[1024];
+        em.create(1024, entities);
+        Entity old = entities[0];
+        cm.elementAt<0>(cm.addComponent(old)) = 1;
+        em.destroy(1024, entities);
+
+        // the destroyed entity keeps its component until it's garbage collected
+        Entity e = em.create();
+        EXPECT_EQ(EntityManagerImpl::getIndex(old), EntityManagerImpl::getIndex(e));
+        EXPECT_EQ(0, cm.getInstance(e));
+
+        cm.elementAt<0>(cm.addComponent(e)) = 2;
+        ASSERT_NE(0, cm.getInstance(old));
+        ASSERT_NE(0, cm.getInstance(e));
+        EXPECT_EQ(1, cm.elementAt<0>(cm.getInstance(old)));
+        EXPECT_EQ(2, cm.elementAt<0>(cm.getInstance(e)));
+
+        cm.removeComponent(old);
+        EXPECT_EQ(0, cm.getInstance(old));
+        ASSERT_NE(0, cm.getInstance(e));
+        EXPECT_EQ(2, cm.elementAt<0>(cm.getInstance(e)));
+
+        cm.removeComponent(e);
+        EXPECT_EQ(0, cm.getInstance(e));
+        EXPECT_TRUE(cm.empty());
+        em.destroy(e);
+    }
+}
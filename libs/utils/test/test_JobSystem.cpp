@@ -218,6 +218,83 @@ TEST(JobSystem, JobSystemParallelChildren) {
     js.emancipate();
 }
 
+TEST(JobSystem, JobSystemManyChildren) {
+    // more jobs than fit in a work queue or in the initial job segment, and more children than
+    // fit in a job's 16-bits running job count
+    JobSystem js;
+    js.adopt();
+
+    std::atomic_int calls = { 0 };
+    JobSystem::Job* root = js.createJob(nullptr, [&calls](JobSystem&, JobSystem::Job*) {
+        calls++;
+    });
+    for (int i=0 ; i<100000 ; i++) {
+        JobSystem::Job* job = js.createJob(root, [&calls](JobSystem&, JobSystem::Job*) {
+            calls++;
+        });
+        ASSERT_NE(nullptr, job);
+        js.run(job, JobSystem::DONT_SIGNAL);
+    }
+    js.runAndWait(root);
+
+    EXPECT_EQ(100001, calls.load());
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemBackgroundChildren) {
+    JobSystem js;
+    js.adopt();
+
+    std::atomic_int background = { 0 };
+    std::atomic_int critical = { 0 };
+    JobSystem::Job* root = js.createJob();
+    for (int i=0 ; i<256 ; i++) {
+        // children of a background job are background jobs too
+        JobSystem::Job* job = js.createJob(root, [&background](JobSystem& js, JobSystem::Job* parent) {
+            background++;
+            js.run(js.createJob(parent, [&background](JobSystem&, JobSystem::Job*) {
+                background++;
+            }), JobSystem::DONT_SIGNAL);
+        });
+        js.run(job, JobSystem::BACKGROUND | JobSystem::DONT_SIGNAL);
+        js.run(js.createJob(root, [&critical](JobSystem&, JobSystem::Job*) {
+            critical++;
+        }), JobSystem::DONT_SIGNAL);
+    }
+    js.runAndWait(root);
+
+    EXPECT_EQ(512, background.load());
+    EXPECT_EQ(256, critical.load());
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemWaiterSkipsBackground) {
+    // a thread waiting on critical jobs leaves background jobs to the thread pool
+    JobSystem js(2);
+    js.adopt();
+
+    const std::thread::id self = std::this_thread::get_id();
+    std::atomic_int background = { 0 };
+    std::atomic_int backgroundOnWaiter = { 0 };
+    JobSystem::Job* root = js.createJob();
+    for (int i=0 ; i<256 ; i++) {
+        js.run(js.createJob(root, [&background, &backgroundOnWaiter, self](JobSystem&, JobSystem::Job*) {
+            background++;
+            if (std::this_thread::get_id() == self) {
+                backgroundOnWaiter++;
+            }
+        }), JobSystem::BACKGROUND | JobSystem::DONT_SIGNAL);
+    }
+    js.runAndWait(root);
+
+    EXPECT_EQ(256, background.load());
+    EXPECT_EQ(0, backgroundOnWaiter.load());
+
+    js.emancipate();
+}
+
 
 TEST(JobSystem, JobSystemSequentialChildren) {
     JobSystem js;
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <utils/Path.h>
+#include <utils/Systrace.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <stdlib.h>
+
+#if defined(__linux__) && !defined(ANDROID)
+
+using namespace utils;
+
+// Recording must be requested before tracing is first initialized, which happens at the first
+// traced scope in the process.
+static const int sEnableRecording = setenv("FILAMENT_SYSTRACE", "", 1);
+
+static std::string readFile(Path const& path) {
+    std::ifstream in(path.c_str());
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+TEST(SystraceTest, ChromeTrace) {
+    ASSERT_EQ(0, sEnableRecording);
+    SYSTRACE_ENABLE();
+
+    std::thread worker([]() {
+        SYSTRACE_NAME("worker \"scope\"");
+        SYSTRACE_VALUE32("workerCounter", 42);
+    });
+    {
+        SYSTRACE_NAME("outer");
+        {
+            SYSTRACE_CALL();
+            SYSTRACE_VALUE64("counter", 1234567890123);
+        }
+    }
+    {
+        SYSTRACE_CONTEXT();
+        SYSTRACE_ASYNC_BEGIN("async", 7);
+        SYSTRACE_ASYNC_END("async", 7);
+    }
+    worker.join();
+
+    Path path = Path::getTemporaryDirectory().concat("test_Systrace.json");
+    ASSERT_TRUE(SYSTRACE_DUMP(path.c_str()));
+    std::string const trace = readFile(path);
+    path.unlinkFile();
+
+    EXPECT_EQ(0, trace.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, trace.find("\"ph\":\"M\""));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"outer\""));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"TestBody\""));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"worker \\\"scope\\\"\""));
+    EXPECT_NE(std::string::npos, trace.find("\"args\":{\"value\":42}"));
+    EXPECT_NE(std::string::npos, trace.find("\"args\":{\"value\":1234567890123}"));
+    EXPECT_NE(std::string::npos, trace.find("\"ph\":\"b\""));
+    EXPECT_NE(std::string::npos, trace.find("\"ph\":\"e\""));
+    EXPECT_NE(std::string::npos, trace.find("\"id\":7"));
+
+    // every scope is closed
+    size_t begins = 0, ends = 0;
+    for (size_t pos = 0; (pos = trace.find("\"ph\":\"B\"", pos)) != std::string::npos; pos++) {
+        begins++;
+    }
+    for (size_t pos = 0; (pos = trace.find("\"ph\":\"E\"", pos)) != std::string::npos; pos++) {
+        ends++;
+    }
+    EXPECT_EQ(3, begins);
+    EXPECT_EQ(begins, ends);
+
+    SYSTRACE_DISABLE();
+}
+
+#endif
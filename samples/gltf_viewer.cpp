@@ -47,6 +47,7 @@ struct App {
     SimpleViewer* viewer;
     Config config;
     AssetLoader* loader;
+    ResourceLoader* resourceLoader = nullptr;
     FilamentAsset* asset = nullptr;
     NameComponentManager* names;
     MaterialProvider* materials;
@@ -198,7 +199,12 @@ int main(int argc, char** argv) {
         configuration.gltfPath = filename.getAbsolutePath();
         configuration.normalizeSkinningWeights = true;
         configuration.recomputeBoundingBoxes = false;
-        gltfio::ResourceLoader(configuration).loadResources(app.asset);
+        configuration.asyncUploadBudget = 4 * 1024 * 1024;
+
+        // Textures are decoded in the background and uploaded progressively from animate().
+        delete app.resourceLoader;
+        app.resourceLoader = new gltfio::ResourceLoader(configuration);
+        app.resourceLoader->asyncBeginLoad(app.asset);
 
         // Load animation data then free the source hierarchy.
         app.asset->getAnimator();
@@ -234,6 +240,8 @@ int main(int argc, char** argv) {
                 ImGui::Text("%zu entities in the asset", app.asset->getEntityCount());
                 ImGui::Text("%zu renderables (excluding UI)", scene->getRenderableCount());
                 ImGui::Text("%zu skipped frames", FilamentApp::get().getSkippedFrameCount());
+                ImGui::Text("%.0f%% textures loaded",
+                        app.resourceLoader->asyncGetLoadProgress() * 100.0f);
             }
         });
 
@@ -243,6 +251,7 @@ int main(int argc, char** argv) {
     };
 
     auto cleanup = [&app](Engine* engine, View*, Scene*) {
+        delete app.resourceLoader;
         delete app.viewer;
         app.loader->destroyAsset(app.asset);
         app.materials->destroyMaterials();
@@ -252,6 +261,7 @@ int main(int argc, char** argv) {
     };
 
     auto animate = [&app](Engine* engine, View* view, double now) {
+        app.resourceLoader->asyncUpdateLoad();
         app.viewer->applyAnimation(now);
     };
 
@@ -265,6 +275,10 @@ int main(int argc, char** argv) {
 
     filamentApp.setDropHandler([&] (std::string path) {
         app.viewer->removeAsset();
+        app.resourceLoader->asyncCancelLoad();
+        // the loader holds on to the asset until it's deleted
+        delete app.resourceLoader;
+        app.resourceLoader = nullptr;
         app.loader->destroyAsset(app.asset);
         loadAsset(path);
         loadResources(path);
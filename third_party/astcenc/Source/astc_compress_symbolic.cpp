@@ -1774,8 +1774,10 @@ float compress_symbolic_block(const astc_codec_image * input_image,
 		}
 	#endif
 
+#if 0
 	if (scb->block_mode >= 0)
 		block_mode_histogram[scb->block_mode & 0x7ff]++;
+#endif
 
 	
 	// compress/decompress to a physical block
@@ -88,6 +88,49 @@ void MeshWriter::optimize(Mesh& mesh) {
     // e.g. we already (potentially) use snorm16 for uvs, half-floats for tangents, etc.
 }
 
+void MeshWriter::buildClusters(Mesh& mesh, vector<Cluster>& clusters,
+        vector<uint32_t>& clusterCounts) {
+    // meshoptimizer needs the positions as floats, they're only used for computing the bounds.
+    vector<float3> positions(mesh.vertexCount);
+    for (size_t i = 0; i < mesh.vertexCount; i++) {
+        half4 const& p = (mFlags & INTERLEAVED) ? mesh.vertices[i].position : mesh.positions[i];
+        positions[i] = { float(p.x), float(p.y), float(p.z) };
+    }
+
+    // Meshlets are built per part, and each part's index range is rewritten in meshlet order so
+    // that every cluster is a contiguous range of the index buffer. The triangles themselves don't
+    // change, so the parts keep their offset, count and vertex range.
+    constexpr size_t MAX_VERTICES = 64;
+    constexpr size_t MAX_TRIANGLES = 124;
+    vector<meshopt_Meshlet> meshlets;
+    for (Part const& part : mesh.parts) {
+        uint32_t* indices = mesh.indices.data() + part.offset;
+        meshlets.resize(meshopt_buildMeshletsBound(part.indexCount, MAX_VERTICES, MAX_TRIANGLES));
+        meshlets.resize(meshopt_buildMeshlets(meshlets.data(), indices, part.indexCount,
+                mesh.vertexCount, MAX_VERTICES, MAX_TRIANGLES));
+
+        uint32_t offset = part.offset;
+        for (meshopt_Meshlet const& meshlet : meshlets) {
+            meshopt_Bounds const bounds = meshopt_computeMeshletBounds(meshlet,
+                    &positions[0].x, mesh.vertexCount, sizeof(float3));
+            clusters.push_back({
+                    offset, meshlet.triangle_count * 3u,
+                    float3{ bounds.center[0], bounds.center[1], bounds.center[2] },
+                    bounds.radius,
+                    float3{ bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2] },
+                    float3{ bounds.cone_axis[0], bounds.cone_axis[1], bounds.cone_axis[2] },
+                    bounds.cone_cutoff });
+            for (size_t t = 0; t < meshlet.triangle_count; t++) {
+                mesh.indices[offset++] = meshlet.vertices[meshlet.indices[t][0]];
+                mesh.indices[offset++] = meshlet.vertices[meshlet.indices[t][1]];
+                mesh.indices[offset++] = meshlet.vertices[meshlet.indices[t][2]];
+            }
+        }
+        assert(offset == part.offset + part.indexCount);
+        clusterCounts.push_back(uint32_t(meshlets.size()));
+    }
+}
+
 bool MeshWriter::serialize(ostream& out, Mesh& mesh) {
     const bool hasIndex16 = mesh.vertexCount <= numeric_limits<uint16_t>::max();
     const bool hasUV1 = !mesh.uv1.empty();
@@ -106,6 +149,14 @@ bool MeshWriter::serialize(ostream& out, Mesh& mesh) {
     // It's safe to optimize the mesh regardless of the compression setting.
     optimize(mesh);
 
+    // Clustering only reorders triangles within each part, so it must happen before the index
+    // buffer is compressed.
+    vector<Cluster> clusters;
+    vector<uint32_t> clusterCounts;
+    if (mFlags & CLUSTERS) {
+        buildClusters(mesh, clusters, clusterCounts);
+    }
+
     // Perform compression of vertex data if it has been requested.
     CompressionHeader cheader {};
     vector<unsigned char> compressedVertices;
@@ -250,5 +301,14 @@ bool MeshWriter::serialize(ostream& out, Mesh& mesh) {
         write(out, char(0));
     }
 
+    if (mFlags & CLUSTERS) {
+        const Cluster* partClusters = clusters.data();
+        for (uint32_t count : clusterCounts) {
+            write(out, count);
+            write(out, partClusters, count);
+            partClusters += count;
+        }
+    }
+
     return true;
 }
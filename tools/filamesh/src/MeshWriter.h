@@ -58,6 +58,8 @@ struct Mesh {
 class MeshWriter {
     uint32_t mFlags;
     void optimize(Mesh& mesh);
+    void buildClusters(Mesh& mesh, std::vector<Cluster>& clusters,
+            std::vector<uint32_t>& clusterCounts);
 public:
     MeshWriter(uint32_t flags) : mFlags(flags) {}
     bool serialize(std::ostream&, Mesh& mesh);
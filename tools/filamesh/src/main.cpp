@@ -47,6 +47,7 @@ using Assimp::Importer;
 bool g_interleaved = false;
 bool g_snormUVs = false;
 bool g_compression = false;
+bool g_clusters = false;
 
 Mesh g_mesh;
 float2 g_minUV = float2(std::numeric_limits<float>::max());
@@ -241,6 +242,8 @@ static void printUsage(const char* name) {
                     "       interleaves mesh attributes\n\n"
                     "   --compress, -c\n"
                     "       enable compression\n\n"
+                    "   --clusters, -k\n"
+                    "       split parts into clusters that can be culled individually at runtime\n\n"
     );
 
     const std::string from("FILAMESH");
@@ -262,12 +265,13 @@ static void license() {
 }
 
 static int handleArguments(int argc, char* argv[]) {
-    static constexpr const char* OPTSTR = "hilc";
+    static constexpr const char* OPTSTR = "hilck";
     static const struct option OPTIONS[] = {
             { "help",        no_argument, 0, 'h' },
             { "license",     no_argument, 0, 'l' },
             { "interleaved", no_argument, 0, 'i' },
             { "compress",    no_argument, 0, 'c' },
+            { "clusters",    no_argument, 0, 'k' },
             { 0, 0, 0, 0 }  // termination of the option list
     };
 
@@ -292,6 +296,9 @@ static int handleArguments(int argc, char* argv[]) {
             case 'c':
                 g_compression = true;
                 break;
+            case 'k':
+                g_clusters = true;
+                break;
         }
     }
 
@@ -399,6 +406,9 @@ int main(int argc, char* argv[]) {
     if (g_compression) {
         flags |= filamesh::COMPRESSION;
     }
+    if (g_clusters) {
+        flags |= filamesh::CLUSTERS;
+    }
     MeshWriter(flags).serialize(out, g_mesh);
 
     out.flush();
@@ -26,6 +26,8 @@
 #include <sstream>
 #include <string>
 
+#include <stdlib.h>
+
 using namespace utils;
 
 namespace matc {
@@ -63,6 +65,13 @@ static void usage(char* name) {
             "       This variant filter is merged the filter from the material, if any\n\n"
             "   --version, -v\n"
             "       Print the material version number\n\n"
+            "   --cache=<dir>\n"
+            "       Cache post-processed shaders in the specified directory, which can be\n"
+            "       shared between invocations\n\n"
+            "   --cache-size=<MiB>\n"
+            "       Size limit of the shader cache in MiB (default: 256)\n\n"
+            "   --cache-stats\n"
+            "       Print shader cache hit, miss and eviction counts\n\n"
             "Internal use and debugging only:\n"
             "   --optimize-none, -g\n"
             "       Disable all shader optimizations, for debugging\n\n"
@@ -134,6 +143,9 @@ bool CommandlineConfig::parse() {
             { "reflect",           required_argument, nullptr, 'r' },
             { "print",                   no_argument, nullptr, 't' },
             { "version",                 no_argument, nullptr, 'v' },
+            { "cache",             required_argument, nullptr, 'c' },
+            { "cache-size",        required_argument, nullptr, 'z' },
+            { "cache-stats",             no_argument, nullptr, 'y' },
             { nullptr, 0, nullptr, 0 }  // termination of the option list
     };
 
@@ -226,6 +238,22 @@ bool CommandlineConfig::parse() {
             case 't':
                 mPrintShaders = true;
                 break;
+            case 'c':
+                mShaderCacheDirectory = arg;
+                break;
+            case 'z': {
+                char* end = nullptr;
+                const unsigned long size = strtoul(arg.c_str(), &end, 10);
+                if (arg.empty() || *end != '\0') {
+                    std::cerr << "Invalid cache size. Must be a number of MiB." << std::endl;
+                    return false;
+                }
+                mShaderCacheSize = size_t(size) * 1024u * 1024u;
+                break;
+            }
+            case 'y':
+                mPrintShaderCacheStats = true;
+                break;
         }
     }
 
@@ -24,6 +24,7 @@
 
 #include <memory>
 #include <ostream>
+#include <string>
 
 #include <utils/compiler.h>
 
@@ -109,6 +110,18 @@ public:
         return mVariantFilter;
     }
 
+    const std::string& getShaderCacheDirectory() const noexcept {
+        return mShaderCacheDirectory;
+    }
+
+    size_t getShaderCacheSize() const noexcept {
+        return mShaderCacheSize;
+    }
+
+    bool printShaderCacheStats() const noexcept {
+        return mPrintShaderCacheStats;
+    }
+
 protected:
     bool mDebug = false;
     bool mIsValid = true;
@@ -119,6 +132,9 @@ protected:
     OutputFormat mOutputFormat = OutputFormat::BLOB;
     TargetApi mTargetApi = (TargetApi) 0;
     uint8_t mVariantFilter = 0;
+    std::string mShaderCacheDirectory;
+    size_t mShaderCacheSize = 256u * 1024u * 1024u;
+    bool mPrintShaderCacheStats = false;
 };
 
 }
@@ -21,9 +21,12 @@
 #include <iostream>
 
 #include <filamat/MaterialBuilder.h>
+#include <filamat/ShaderCache.h>
 
 #include <filamat/Enums.h>
 
+#include <utils/JobSystem.h>
+
 #include "DirIncluder.h"
 #include "MaterialLexeme.h"
 #include "MaterialLexer.h"
@@ -283,9 +286,29 @@ bool MaterialCompiler::run(const Config& config) {
         .generateDebugInfo(config.isDebug())
         .variantFilter(config.getVariantFilter() | builder.getVariantFilter());
 
-    // Write builder.build() to output.
-    Package package = builder.build();
+    std::unique_ptr<ShaderCache> shaderCache;
+    if (!config.getShaderCacheDirectory().empty()) {
+        shaderCache.reset(new ShaderCache(config.getShaderCacheDirectory().c_str(),
+                config.getShaderCacheSize()));
+        if (shaderCache->isValid()) {
+            builder.shaderCache(shaderCache.get());
+        }
+    }
+
+    // Compile the shader variants on all available cores, then write builder.build() to output.
+    utils::JobSystem jobSystem;
+    jobSystem.adopt();
+    Package package = builder.build(jobSystem);
+    jobSystem.emancipate();
     MaterialBuilder::shutdown();
+
+    if (shaderCache && config.printShaderCacheStats()) {
+        shaderCache->trim();
+        const ShaderCache::Stats stats = shaderCache->getStats();
+        std::cout << "Shader cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+                << stats.evictions << " evictions" << std::endl;
+    }
+
     if (!package.isValid()) {
         std::cerr << "Could not compile material " << input->getName() << std::endl;
         return false;
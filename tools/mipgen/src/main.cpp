@@ -24,13 +24,18 @@
 #include <imageio/ImageDecoder.h>
 #include <imageio/ImageEncoder.h>
 
+#include <utils/JobSystem.h>
 #include <utils/Path.h>
 
 #include <getopt/getopt.h>
 
+#include <atomic>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 using namespace image;
 using namespace std;
@@ -47,6 +52,12 @@ static bool g_grayscale = false;
 static bool g_ktxContainer = false;
 static bool g_linearized = false;
 static bool g_quietMode = false;
+static std::string g_batchFile = "";
+static CompressionConfig g_compressionConfig {};
+
+// Maximum number of input images being processed at the same time in batch mode, this bounds the
+// memory used while letting file I/O overlap with compression.
+static constexpr size_t MAX_TASKS_IN_FLIGHT = 4;
 
 static const char* USAGE = R"TXT(
 MIPGEN generates mipmaps for an image down to the 1x1 level.
@@ -58,8 +69,12 @@ Miplevel 0 is not generated since it is the original image.
 If the output format is a container format like KTX, then
 <output_pattern> is simply a filename.
 
+Several images can be processed at once by giving more pairs of
+<input_file> <output_pattern>, or with a batch file.
+
 Usage:
-    MIPGEN [options] <input_file> <output_pattern>
+    MIPGEN [options] <input_file> <output_pattern> [<input_file> <output_pattern>...]
+    MIPGEN [options] --batch=<batch_file>
 
 Options:
    --help, -h
@@ -72,6 +87,8 @@ Options:
        generate HTML page for review purposes (mipmap.html)
    --quiet, -q
        suppress console output from the mipgen tool
+   --batch=FILE, -b FILE
+       read pairs of <input_file> <output_pattern>, separated by whitespace, from FILE
    --grayscale, -g
        create a single-channel image and do not perform gamma correction
    --format=[exr|hdr|rgbm|psd|png|dds|ktx], -f [exr|hdr|rgbm|psd|png|dds|ktx]
@@ -103,6 +120,7 @@ Examples:
     MIPGEN -g --kernel=hermite grassland.png mip_%03d.png
     MIPGEN -f ktx --compression=astc_fast_ldr_4x4 grassland.png mips.ktx
     MIPGEN -f ktx --compression=etc_rgb_rgba_40 grassland.png mips.ktx
+    MIPGEN -f ktx grassland.png grassland.ktx rocks.png rocks.ktx
 )TXT";
 
 static const char* HTML_PREFIX = R"HTML(<!DOCTYPE html>
@@ -146,7 +164,7 @@ static void license() {
 }
 
 static int handleArguments(int argc, char* argv[]) {
-    static constexpr const char* OPTSTR = "hLlgpf:c:k:saq";
+    static constexpr const char* OPTSTR = "hLlgpf:c:k:saqb:";
     static const struct option OPTIONS[] = {
             { "help",                 no_argument, 0, 'h' },
             { "license",              no_argument, 0, 'L' },
@@ -159,6 +177,7 @@ static int handleArguments(int argc, char* argv[]) {
             { "strip-alpha",          no_argument, 0, 's' },
             { "add-alpha",            no_argument, 0, 'a' },
             { "quiet",                no_argument, 0, 'q' },
+            { "batch",          required_argument, 0, 'b' },
             { 0, 0, 0, 0 }  // termination of the option list
     };
 
@@ -200,6 +219,9 @@ static int handleArguments(int argc, char* argv[]) {
             case 'q':
                 g_quietMode = true;
                 break;
+            case 'b':
+                g_batchFile = arg;
+                break;
             case 'f':
                 if (arg == "png") {
                     g_format = ImageEncoder::Format::PNG;
@@ -239,29 +261,19 @@ static int handleArguments(int argc, char* argv[]) {
     return optind;
 }
 
-int main(int argc, char* argv[]) {
-    int optionIndex = handleArguments(argc, argv);
-    int numArgs = argc - optionIndex;
-    if (numArgs < 2) {
-        printUsage(argv[0]);
-        return 1;
-    }
-    Path inputPath(argv[optionIndex++]);
-    std::string outputPattern(argv[optionIndex]);
-    if (Path(outputPattern).getExtension() == "ktx") {
-        g_ktxContainer = true;
-        g_formatSpecified = true;
-    } else if (!g_formatSpecified) {
-        g_format = ImageEncoder::chooseFormat(outputPattern, !g_linearized);
-    }
+// One input image and where its miplevels go.
+struct Task {
+    Path inputPath;
+    std::string outputPattern;
+    bool failed = false;
+};
 
-    puts("Reading image...");
+static LinearImage readImage(const Path& inputPath) {
     ifstream inputStream(inputPath.getPath(), ios::binary);
     LinearImage sourceImage = ImageDecoder::decode(inputStream, inputPath.getPath(),
             g_linearized ? ImageDecoder::ColorSpace::LINEAR : ImageDecoder::ColorSpace::SRGB);
     if (!sourceImage.isValid()) {
-        cerr << "Unable to open image: " << inputPath.getPath() << endl;
-        return 1;
+        return sourceImage;
     }
     if (g_stripAlpha && sourceImage.getChannels() == 4) {
         auto r = extractChannel(sourceImage, 0);
@@ -284,162 +296,300 @@ int main(int argc, char* argv[]) {
     if (g_filter == Filter::GAUSSIAN_NORMALS) {
         sourceImage = colorsToVectors(sourceImage);
     }
+    return sourceImage;
+}
 
-    puts("Generating miplevels...");
-    uint32_t count = getMipmapCount(sourceImage);
-    vector<LinearImage> miplevels(count);
-    generateMipmaps(sourceImage, g_filter, miplevels.data(), count);
-
-    if (g_ktxContainer) {
-        puts("Writing KTX file to disk...");
-        // The libimage API does not include the original image in the mip array,
-        // which might make sense when generating individual files, but for a KTX
-        // bundle, we want to include level 0, so add 1 to the KTX level count.
-        KtxBundle container(1 + miplevels.size(), 1, false);
-        auto& info = container.info();
-        CompressionConfig config {};
-        info = {
-            .endianness = KtxBundle::ENDIAN_DEFAULT,
-            .glType = KtxBundle::UNSIGNED_BYTE,
-            .glTypeSize = 1,
-            .pixelWidth = sourceImage.getWidth(),
-            .pixelHeight = sourceImage.getHeight(),
-            .pixelDepth = 0,
-        };
-        size_t componentCount = sourceImage.getChannels();
-        if (componentCount == 1) {
-            info.glFormat = info.glBaseInternalFormat = KtxBundle::RED;
-            info.glInternalFormat = KtxBundle::R8;
-        } else if (componentCount == 3) {
-            info.glFormat = info.glBaseInternalFormat = KtxBundle::RGB;
-            info.glInternalFormat = KtxBundle::RGB8;
-        } else if (componentCount == 4) {
-            info.glFormat = info.glBaseInternalFormat = KtxBundle::RGBA;
-            info.glInternalFormat = KtxBundle::RGBA8;
-        }
-        if (!g_compression.empty()) {
-            bool valid = parseOptionString(g_compression, &config);
-            if (!valid) {
-                cerr << "Unrecognized compression: " << g_compression << endl;
-                return 1;
-            }
-            // The KTX spec says the following for compressed textures: glTypeSize should 1,
-            // glFormat should be 0, and glBaseInternalFormat should be RED, RG, RGB, or RGBA.
-            // The glInternalFormat field is the only field that specifies the actual format.
-            info.glFormat = 0;
-        }
-        uint32_t mip = 0;
-        auto addLevel = [&](LinearImage image) {
-            if (g_filter == Filter::GAUSSIAN_NORMALS) {
-                image = vectorsToColors(image);
-            }
-            std::unique_ptr<uint8_t[]> data;
-            if (config.type != CompressionConfig::INVALID) {
-                // Some encoders call exit(1) upon failure, so it's very useful to print some
-                // source image information here for when this is invoked from a build script.
-                // Note that some encoders also have limitations in terms of image size.
-                if (!g_quietMode) {
-                    printf("Starting compression for %s (%dx%d)\n", inputPath.getName().c_str(),
-                            image.getWidth(), image.getHeight());
-                }
-                CompressedTexture tex = compressTexture(config, image);
-                // Add newline here because the ASTC encoder has a progress indicator that issues a
-                // carriage return without a line feed.
-                if (!g_quietMode) {
-                    putc('\n', stdout);
-                }
-                container.setBlob({mip++}, tex.data.get(), tex.size);
-                info.glInternalFormat = (uint32_t) tex.format;
-                return;
-            }
-            if (g_grayscale && g_linearized) {
-                data = fromLinearToGrayscale<uint8_t>(image);
-            } else if (g_grayscale) {
-                data = fromLinearTosRGB<uint8_t, 1>(image);
-            } else if (g_linearized) {
-                if (componentCount == 3) {
-                    data = fromLinearToRGB<uint8_t, 3>(image);
-                } else {
-                    data = fromLinearToRGB<uint8_t, 4>(image);
-                }
-            } else {
-                if (componentCount == 3) {
-                    data = fromLinearTosRGB<uint8_t, 3>(image);
-                } else {
-                    data = fromLinearTosRGB<uint8_t, 4>(image);
-                }
-            }
-            container.setBlob({mip++, 0, 0}, data.get(), image.getWidth() * image.getHeight() *
-                    container.info().glTypeSize * componentCount);
-        };
-        addLevel(sourceImage);
-        for (auto image : miplevels) {
-            addLevel(image);
-        }
-        vector<uint8_t> fileContents(container.getSerializedLength());
-        container.serialize(fileContents.data(), fileContents.size());
-        Path(outputPattern).getParent().mkdirRecursive();
-        ofstream outputStream(outputPattern, ios::out | ios::binary);
-        outputStream.write((const char*) fileContents.data(), fileContents.size());
-        outputStream.close();
+// The data of one KTX level, compressed or not.
+struct KtxLevel {
+    std::unique_ptr<uint8_t[]> data;
+    uint32_t size = 0;
+    CompressedFormat format = CompressedFormat::INVALID;
+};
+
+static KtxLevel createKtxLevel(LinearImage image, const CompressionConfig& config,
+        const Path& inputPath, JobSystem& js) {
+    if (g_filter == Filter::GAUSSIAN_NORMALS) {
+        image = vectorsToColors(image);
+    }
+    KtxLevel level;
+    if (config.type != CompressionConfig::INVALID) {
+        // Some encoders call exit(1) upon failure, so it's very useful to print some
+        // source image information here for when this is invoked from a build script.
+        // Note that some encoders also have limitations in terms of image size.
         if (!g_quietMode) {
-            puts("Done.");
+            printf("Starting compression for %s (%dx%d)\n", inputPath.getName().c_str(),
+                    image.getWidth(), image.getHeight());
         }
-        return 0;
+        CompressedTexture tex = compressTexture(config, image, &js);
+        level.data = std::move(tex.data);
+        level.size = tex.size;
+        level.format = tex.format;
+        return level;
     }
-
-    puts("Writing image files to disk...");
-    char path[256];
-    uint32_t mip = 1; // start at 1 because 0 is the original image
-    for (auto image : miplevels) {
-        int result = snprintf(path, sizeof(path), outputPattern.c_str(), mip++);
-        if (result < 0 || result >= sizeof(path)) {
-            cerr << "Output pattern is too long." << endl;
-            return 1;
+    const size_t componentCount = image.getChannels();
+    if (g_grayscale && g_linearized) {
+        level.data = fromLinearToGrayscale<uint8_t>(image);
+    } else if (g_grayscale) {
+        level.data = fromLinearTosRGB<uint8_t, 1>(image);
+    } else if (g_linearized) {
+        if (componentCount == 3) {
+            level.data = fromLinearToRGB<uint8_t, 3>(image);
+        } else {
+            level.data = fromLinearToRGB<uint8_t, 4>(image);
         }
-        Path(path).getParent().mkdirRecursive();
-        ofstream outputStream(path, ios::binary | ios::trunc);
-        if (!outputStream) {
-            cerr << "The output file cannot be opened: " << path << endl;
+    } else {
+        if (componentCount == 3) {
+            level.data = fromLinearTosRGB<uint8_t, 3>(image);
         } else {
-            if (!ImageEncoder::encode(outputStream, g_format, image, g_compression, path)) {
+            level.data = fromLinearTosRGB<uint8_t, 4>(image);
+        }
+    }
+    level.size = image.getWidth() * image.getHeight() * componentCount;
+    return level;
+}
+
+static bool writeKtx(Task& task, const LinearImage& sourceImage, JobSystem& js) {
+    const CompressionConfig config = g_compressionConfig;
+    const uint32_t count = getMipmapCount(sourceImage);
+
+    // The libimage API does not include the original image in the mip array,
+    // which might make sense when generating individual files, but for a KTX
+    // bundle, we want to include level 0, so add 1 to the KTX level count.
+    vector<LinearImage> miplevels(1 + count);
+    vector<KtxLevel> levels(1 + count);
+    miplevels[0] = sourceImage;
+
+    // Level 0 doesn't depend on the other levels, so it is compressed while they are generated.
+    JobSystem::Job* parent = js.createJob();
+    auto createLevel = [&](uint32_t mip) {
+        return js.createJob(parent, [&, mip](JobSystem& js, JobSystem::Job*) {
+            levels[mip] = createKtxLevel(miplevels[mip], config, task.inputPath, js);
+        });
+    };
+    js.run(createLevel(0));
+    generateMipmaps(sourceImage, g_filter, miplevels.data() + 1, count, &js);
+    for (uint32_t mip = 1; mip <= count; mip++) {
+        js.run(createLevel(mip));
+    }
+    js.runAndWait(parent);
+
+    KtxBundle container(1 + count, 1, false);
+    auto& info = container.info();
+    info = {
+        .endianness = KtxBundle::ENDIAN_DEFAULT,
+        .glType = KtxBundle::UNSIGNED_BYTE,
+        .glTypeSize = 1,
+        .pixelWidth = sourceImage.getWidth(),
+        .pixelHeight = sourceImage.getHeight(),
+        .pixelDepth = 0,
+    };
+    size_t componentCount = sourceImage.getChannels();
+    if (componentCount == 1) {
+        info.glFormat = info.glBaseInternalFormat = KtxBundle::RED;
+        info.glInternalFormat = KtxBundle::R8;
+    } else if (componentCount == 3) {
+        info.glFormat = info.glBaseInternalFormat = KtxBundle::RGB;
+        info.glInternalFormat = KtxBundle::RGB8;
+    } else if (componentCount == 4) {
+        info.glFormat = info.glBaseInternalFormat = KtxBundle::RGBA;
+        info.glInternalFormat = KtxBundle::RGBA8;
+    }
+    if (config.type != CompressionConfig::INVALID) {
+        // The KTX spec says the following for compressed textures: glTypeSize should 1,
+        // glFormat should be 0, and glBaseInternalFormat should be RED, RG, RGB, or RGBA.
+        // The glInternalFormat field is the only field that specifies the actual format.
+        info.glFormat = 0;
+        info.glInternalFormat = (uint32_t) levels[0].format;
+    }
+    for (uint32_t mip = 0; mip <= count; mip++) {
+        container.setBlob({mip, 0, 0}, levels[mip].data.get(), levels[mip].size);
+    }
+
+    vector<uint8_t> fileContents(container.getSerializedLength());
+    container.serialize(fileContents.data(), fileContents.size());
+    Path(task.outputPattern).getParent().mkdirRecursive();
+    ofstream outputStream(task.outputPattern, ios::out | ios::binary);
+    outputStream.write((const char*) fileContents.data(), fileContents.size());
+    outputStream.close();
+    if (!outputStream) {
+        cerr << "An error occurred while writing the output file: " << task.outputPattern << endl;
+        return false;
+    }
+    return true;
+}
+
+static bool writeImages(Task& task, const LinearImage& sourceImage, JobSystem& js) {
+    const std::string& outputPattern = task.outputPattern;
+    const ImageEncoder::Format format = g_formatSpecified ? g_format :
+            ImageEncoder::chooseFormat(outputPattern, !g_linearized);
+
+    uint32_t count = getMipmapCount(sourceImage);
+    vector<LinearImage> miplevels(count);
+    generateMipmaps(sourceImage, g_filter, miplevels.data(), count, &js);
+
+    // Each level is encoded and written by its own job.
+    std::atomic_bool failed = { false };
+    JobSystem::Job* parent = js.createJob();
+    for (uint32_t mip = 1; mip <= count; mip++) {  // start at 1 because 0 is the original image
+        js.run(js.createJob(parent, [&, mip](JobSystem&, JobSystem::Job*) {
+            const LinearImage& image = miplevels[mip - 1];
+            char path[256];
+            int result = snprintf(path, sizeof(path), outputPattern.c_str(), mip);
+            if (result < 0 || result >= sizeof(path)) {
+                cerr << "Output pattern is too long." << endl;
+                failed = true;
+                return;
+            }
+            Path(path).getParent().mkdirRecursive();
+            ofstream outputStream(path, ios::binary | ios::trunc);
+            if (!outputStream) {
+                cerr << "The output file cannot be opened: " << path << endl;
+                return;
+            }
+            if (!ImageEncoder::encode(outputStream, format, image, g_compression, path)) {
                 cerr << "An error occurred while encoding the image." << endl;
-                return 1;
+                failed = true;
+                return;
             }
             outputStream.close();
             if (!outputStream) {
                 cerr << "An error occurred while writing the output file: " << path << endl;
-                return 1;
+                failed = true;
             }
-        }
+        }));
+    }
+    js.runAndWait(parent);
+    if (failed) {
+        return false;
     }
 
     if (g_createGallery) {
         puts("Generating mipmaps.html...");
+        char path[256];
         char tag[256];
-        mip = 1;
         const char* pattern = R"(<image src="%s" width="%dpx" height="%dpx">)";
         const uint32_t width = sourceImage.getWidth();
         const uint32_t height = sourceImage.getHeight();
         ofstream html("mipmaps.html", ios::trunc);
         html << HTML_PREFIX;
-        int result = snprintf(tag, sizeof(tag), pattern, inputPath.c_str(), width, height);
+        int result = snprintf(tag, sizeof(tag), pattern, task.inputPath.c_str(), width, height);
         if (result < 0 || result >= sizeof(tag)) {
             cerr << "Output pattern is too long." << endl;
-            return 1;
+            return false;
         }
         html << tag << std::endl;
-        for (auto image: miplevels) {
-            snprintf(path, sizeof(path), outputPattern.c_str(), mip++);
+        for (uint32_t mip = 1; mip <= count; mip++) {
+            snprintf(path, sizeof(path), outputPattern.c_str(), mip);
             result = snprintf(tag, sizeof(tag), pattern, path, width, height);
             if (result < 0 || result >= sizeof(tag)) {
                 cerr << "Output pattern is too long." << endl;
-                return 1;
+                return false;
             }
             html << tag << std::endl;
         }
         html << HTML_SUFFIX;
     }
+    return true;
+}
+
+static void processTask(Task& task, JobSystem& js) {
+    if (!g_quietMode) {
+        printf("Reading %s...\n", task.inputPath.getName().c_str());
+    }
+    LinearImage sourceImage = readImage(task.inputPath);
+    if (!sourceImage.isValid()) {
+        cerr << "Unable to open image: " << task.inputPath.getPath() << endl;
+        task.failed = true;
+        return;
+    }
+    const bool ktx = g_ktxContainer || Path(task.outputPattern).getExtension() == "ktx";
+    task.failed = ktx ? !writeKtx(task, sourceImage, js) : !writeImages(task, sourceImage, js);
+    if (!task.failed && !g_quietMode) {
+        printf("Wrote %s\n", task.outputPattern.c_str());
+    }
+}
 
-    puts("Done.");
+static bool readBatchFile(const char* batchPath, vector<Task>& tasks) {
+    ifstream batchStream(batchPath);
+    if (!batchStream) {
+        cerr << "Unable to open batch file: " << batchPath << endl;
+        return false;
+    }
+    std::string inputPath, outputPattern;
+    while (batchStream >> inputPath) {
+        if (!(batchStream >> outputPattern)) {
+            cerr << "Missing output for " << inputPath << " in " << batchPath << endl;
+            return false;
+        }
+        tasks.push_back({ Path(inputPath), outputPattern });
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int optionIndex = handleArguments(argc, argv);
+    int numArgs = argc - optionIndex;
+    if (numArgs % 2 || (numArgs == 0 && g_batchFile.empty())) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    vector<Task> tasks;
+    while (optionIndex < argc) {
+        Path inputPath(argv[optionIndex++]);
+        tasks.push_back({ inputPath, argv[optionIndex++] });
+    }
+    if (!g_batchFile.empty() && !readBatchFile(g_batchFile.c_str(), tasks)) {
+        return 1;
+    }
+    if (g_createGallery && tasks.size() > 1) {
+        cerr << "The --page option can only be used with a single input." << endl;
+        return 1;
+    }
+    if (!g_compression.empty() && !parseOptionString(g_compression, &g_compressionConfig)) {
+        for (const Task& task : tasks) {
+            if (g_ktxContainer || Path(task.outputPattern).getExtension() == "ktx") {
+                cerr << "Unrecognized compression: " << g_compression << endl;
+                return 1;
+            }
+        }
+    }
+
+    // All the images are processed by the same JobSystem: the levels of an image are generated,
+    // compressed and written by concurrent jobs, and a few images are in flight at a time so that
+    // reading and writing files overlaps with the compression of other images.
+    JobSystem js;
+    js.adopt();
+    std::deque<JobSystem::Job*> inFlight;
+    for (Task& task : tasks) {
+        if (inFlight.size() == MAX_TASKS_IN_FLIGHT) {
+            js.waitAndRelease(inFlight.front());
+            inFlight.pop_front();
+        }
+        Task* pTask = &task;
+        inFlight.push_back(js.runAndRetain(js.createJob(nullptr,
+                [pTask](JobSystem& js, JobSystem::Job*) {
+            processTask(*pTask, js);
+        })));
+    }
+    while (!inFlight.empty()) {
+        js.waitAndRelease(inFlight.front());
+        inFlight.pop_front();
+    }
+    js.emancipate();
+
+    size_t failures = 0;
+    for (const Task& task : tasks) {
+        failures += task.failed ? 1 : 0;
+    }
+    if (failures) {
+        if (tasks.size() > 1) {
+            cerr << failures << " of " << tasks.size() << " images failed." << endl;
+        }
+        return 1;
+    }
+    if (!g_quietMode) {
+        puts("Done.");
+    }
+    return 0;
 }